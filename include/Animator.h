@@ -0,0 +1,129 @@
+/*
+ * @file Animator.h
+ *
+ * Definition of the Animator class, which runs all of the eased animations
+ * (object position, scale, color, rotation, video aspect, camera & earth
+ * movement) in one place. Each animated value moves a fraction of the way to
+ * its destination, like the per-object animation it replaces, but scaled by
+ * the time that has actually passed so the speed doesn't depend on the frame
+ * rate.
+ *
+ * Only values that are actually animating are kept, in flat arrays, so
+ * everything that's sitting still costs nothing per frame. Values snap to
+ * their destination and are dropped once they're close enough.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ANIMATOR_H_
+#define ANIMATOR_H_
+
+#include <map>
+#include <vector>
+#include <sys/time.h>
+
+#include <VPMedia/thread_helper.h>
+
+class Animator
+{
+
+public:
+    static Animator* getInstance();
+    static void cleanup();
+
+    /*
+     * Start moving *value towards *dest, closing 1/divisor of the distance
+     * every 60th of a second (so the same as dividing by it every frame at
+     * 60fps). dest is read on every update, so it can keep changing while the
+     * animation runs. If value is already animating this just changes the
+     * rate.
+     *
+     * owner is whatever the value belongs to, for stop(). Both pointers have
+     * to stay valid until the animation finishes or the owner is stopped.
+     */
+    void animate( void* owner, float* value, const float* dest,
+                    float divisor );
+
+    /*
+     * Drop all of an owner's animations, leaving the values where they are.
+     * Has to be called before anything that owns animations gets deleted.
+     */
+    void stop( void* owner );
+
+    /*
+     * Advance everything by the time since the last update. Should be called
+     * once per frame on the main thread, before drawing.
+     */
+    void update();
+
+    /*
+     * Advance by exactly this many seconds on every update instead of by the
+     * real time in between, so runs that aren't drawn in real time (like
+     * headless benchmarks) animate the same every time. 0 to go back to real
+     * time.
+     */
+    void setFixedStep( float seconds );
+
+    // whether anything is animating, and how many values are
+    bool isAnimating();
+    int getActiveCount();
+
+    // whether any of owner's values are still animating
+    bool isAnimating( void* owner );
+
+protected:
+    Animator();
+    ~Animator();
+
+private:
+    static Animator* instance;
+
+    // animate/stop can come from the network thread (ie, when sources are
+    // added), so everything is locked
+    mutex* animMutex;
+
+    // one entry per animating value in each of these
+    std::vector<float*> values;
+    std::vector<const float*> dests;
+    std::vector<float> divisors;
+    std::vector<void*> owners;
+
+    // where each value is in the arrays above
+    std::map<float*, unsigned int> indices;
+    // how many values each owner has animating
+    std::map<void*, int> ownerCounts;
+
+    // scratch space for update, so the math is a straight run over arrays
+    std::vector<float> current;
+    std::vector<float> target;
+    std::vector<float> keep;
+
+    timeval lastUpdate;
+    bool haveLastUpdate;
+    float fixedStep;
+
+    // swap the last entry into i & shrink everything
+    void remove( unsigned int i );
+
+    void addOwner( void* owner );
+    void removeOwner( void* owner );
+
+};
+
+#endif /* ANIMATOR_H_ */
@@ -34,6 +34,7 @@ class VPMAudioMeter;
 #include <VPMedia/VPMSessionListener.h>
 #include <VPMedia/VPMPayload.h>
 #include <VPMedia/VPMTypes.h>
+#include <VPMedia/thread_helper.h>
 #include <string>
 #include <vector>
 
@@ -84,6 +85,10 @@ public:
 private:
     std::vector<AudioSource*> sources;
 
+    // audio sessions can be on different threads from each other & from the
+    // main thread reading the levels, so sources is under this
+    mutex* sourceMutex;
+
 };
 
 #endif /*AUDIOMANAGER_H_*/
@@ -0,0 +1,227 @@
+/*
+ * @file BatchRenderer.h
+ *
+ * Definition of the BatchRenderer class, which collects the simple shapes
+ * (bordered rectangles, video quads, lines, text) that objects draw every
+ * frame and draws them with as few state changes and draw calls as possible.
+ * Shapes are transformed on the CPU and streamed to a vertex buffer in one
+ * go; a shape joins an earlier batch with the same state as long as nothing
+ * in between overlaps it on screen, so the result looks exactly the same as
+ * drawing everything in order.
+ *
+ * Usage mirrors the immediate mode calls it replaces - set the transform and
+ * state, then add shapes. Outside of begin()/end() everything gets drawn as
+ * soon as it's added.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BATCHRENDERER_H_
+#define BATCHRENDERER_H_
+
+#include <string>
+#include <vector>
+
+#include "GLUtil.h"
+#include "GlyphAtlas.h"
+
+class TextLabel;
+
+class BatchRenderer
+{
+
+public:
+    /*
+     * Vertex buffers get used if available, otherwise vertices are drawn
+     * straight from client memory. Needs a GL context.
+     */
+    BatchRenderer( bool useVertexBuffers );
+    ~BatchRenderer();
+
+    /*
+     * Start collecting shapes instead of drawing them right away. The camera
+     * needs to be set up already, since its projection decides what overlaps
+     * what.
+     */
+    void begin();
+
+    // draw whatever's left and go back to drawing shapes as they're added
+    void end();
+
+    /*
+     * Draw everything collected so far. Anything that draws with GL directly
+     * between begin() and end() has to call this first, so that it ends up
+     * on top of what was added before it.
+     */
+    void flush();
+
+    /*
+     * Back to the defaults: identity transform, white, untextured, no
+     * program, no blending, 1 pixel lines. Call before setting up each object
+     * so state doesn't carry over from whatever was added last.
+     */
+    void reset();
+
+    // transform for shapes added after this, works like the GL calls
+    void translate( float x, float y, float z );
+    void rotate( float angle, float x, float y, float z );
+
+    // state for shapes added after this
+    void setColor( float r, float g, float b, float a );
+    void setTextures( int num, const GLuint* ids );
+    void setProgram( GLUtil::ShaderProgram p, float alpha );
+    void setBlend( bool b );
+    void setLineWidth( float w, bool smooth );
+
+    /*
+     * Rectangle from (l,d) to (r,u) in the current transform's space, with
+     * texture coordinates from (0,0) at the bottom left to (s,t) at the top
+     * right.
+     */
+    void addQuad( float l, float d, float r, float u,
+                    float s = 0.0f, float t = 0.0f );
+    void addLine( float x1, float y1, float x2, float y2 );
+    void addTriangle( float x1, float y1, float x2, float y2,
+                        float x3, float y3 );
+
+    /*
+     * Text in the main font with its baseline starting at x,y, scaled
+     * uniformly. Drawn with the current color, always blended, ignoring the
+     * textures and program. With the glyph atlas, text is just textured quads
+     * so all of it can go in one batch; without, it falls back to rendering
+     * with the font.
+     */
+    void addText( const std::string& text, float x, float y, float scale );
+
+    /*
+     * Same as above, but uses the label's cached layout, so the text doesn't
+     * have to be laid out again each time it's drawn.
+     */
+    void addLabel( TextLabel& label, float x, float y, float scale );
+
+    // batches (so draw calls) used between the last begin() and end()
+    int getLastBatchCount();
+
+    static const int maxTextures = 3;
+
+private:
+    typedef struct
+    {
+        GLfloat s, t;
+        GLfloat r, g, b, a;
+        GLfloat x, y, z;
+    } Vertex;
+
+    typedef struct
+    {
+        std::string text;
+        GLfloat matrix[16];
+        GLfloat r, g, b, a;
+    } TextItem;
+
+    // everything that has to match for shapes to be drawn together
+    struct State
+    {
+        // GL_QUADS, GL_LINES, GL_TRIANGLES, or GL_NONE for font text
+        GLenum primitive;
+        int numTextures;
+        GLuint textures[ maxTextures ];
+        GLUtil::ShaderProgram program;
+        float programAlpha;
+        bool blend;
+        float lineWidth;
+        bool smooth;
+
+        bool operator==( const State& other ) const;
+    };
+
+    struct Batch
+    {
+        State state;
+        // screen area covered, in normalized device coordinates
+        float left, right, bottom, top;
+        bool unbounded;
+        std::vector<Vertex> vertices;
+        std::vector<TextItem> texts;
+        // where this batch's vertices start in the vertex buffer
+        int first;
+    };
+
+    /*
+     * Find the batch a shape with the current state & given screen bounds
+     * can go in, starting a new one if it can't go in any of the recent ones.
+     */
+    Batch* findBatch( GLenum primitive, float l, float r, float d, float u,
+                        bool unbounded );
+
+    // current transform, translated to x,y then scaled - for text
+    void getTextMatrix( float x, float y, float scale, GLfloat* matrix );
+
+    // add glyph quads laid out by the atlas, with their bounds
+    void addGlyphs( const std::vector<GlyphQuad>& glyphs, float lx, float ly,
+                    float ux, float uy, float x, float y, float scale );
+
+    // transform local points to world space & add them to a batch
+    void addVertices( GLenum primitive, const GLfloat* points, int count,
+                        const GLfloat* texCoords );
+
+    /*
+     * Screen bounds of some world space points, in normalized device
+     * coordinates. Returns false if any of them are behind the camera, since
+     * then the bounds can't be known.
+     */
+    bool project( const GLfloat* world, int count,
+                    float& l, float& r, float& d, float& u );
+
+    void applyState( const State& s );
+    void clearState( const State& s );
+
+    bool useVertexBuffers;
+    GLuint vertexBuffer;
+    unsigned int vertexBufferSize;
+
+    bool recording;
+
+    // camera transform at begin(), for screen bounds
+    Matrix viewProjection;
+    // size of a pixel in device coordinates, for padding bounds
+    float pixelWidth, pixelHeight;
+
+    Matrix transform;
+    GLfloat color[4];
+    State current;
+
+    // batches are kept around between frames so their vectors don't need to
+    // be reallocated - only the first numBatches are in use
+    std::vector<Batch> batches;
+    int numBatches;
+    std::vector<Vertex> vertexData;
+    // for laying out text that isn't in a label
+    std::vector<GlyphQuad> scratchGlyphs;
+
+    int batchCount;
+    int lastBatchCount;
+
+    // how far back to look for a batch to join, to keep adding cheap with
+    // lots of objects
+    static const int maxLookback = 32;
+
+};
+
+#endif /* BATCHRENDERER_H_ */
@@ -35,6 +35,7 @@ class Camera
 
 public:
     Camera( Point c, Point l );
+    ~Camera();
     void doGLLookat();
 
     Point getCenter();
@@ -66,13 +67,12 @@ public:
 
     void setEarth( Earth* e );
 
-    void animateValues();
-
 private:
-    Point center;
-    Point destCenter;
-    Point lookat;
-    Point destLookat;
+    // these are arrays rather than Points so the Animator can move them
+    float center[3];
+    float destCenter[3];
+    float lookat[3];
+    float destLookat[3];
 
     Vector up;
 
@@ -84,8 +84,8 @@ private:
     Earth* earth;
 
     bool animated;
-    bool centerMoving;
-    bool lookatMoving;
+    // go to dest, animated if that's on
+    void movePoint( float* point, const float* dest );
 
 };
 
@@ -0,0 +1,74 @@
+/*
+ * @file ColorConverter.h
+ *
+ * YUV420P to packed RGB conversion for when the YUV shader isn't available.
+ * There's a plain C version plus SSE2 and AVX2 ones, picked at runtime based
+ * on what the CPU supports; all of them give exactly the same output.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef COLORCONVERTER_H_
+#define COLORCONVERTER_H_
+
+class WorkerPool;
+
+namespace ColorConverter
+{
+
+    enum Kernel { KERNEL_SCALAR, KERNEL_SSE2, KERNEL_AVX2 };
+
+    /*
+     * The best kernel this CPU (and build) supports. Checked once.
+     */
+    Kernel getBestKernel();
+    const char* getKernelName( Kernel k );
+
+    /*
+     * Converts rows [startRow, endRow) of a tightly-packed YUV420P image (Y
+     * plane, then U, then V, chroma planes half width & half height) to
+     * packed RGB24 or RGBA (bytesPerPixel 3 or 4, alpha always opaque) in
+     * dst, which holds the whole image. Uses BT.601 video range. startRow
+     * should be even so rows share chroma the same way regardless of how the
+     * image is split up.
+     */
+    void YUV420toRGB( const unsigned char* src, unsigned int width,
+                      unsigned int height, unsigned char* dst,
+                      unsigned int bytesPerPixel, unsigned int startRow,
+                      unsigned int endRow, Kernel kernel );
+
+    /*
+     * Converts the whole image with the best kernel, split into row bands
+     * across pool if it isn't NULL.
+     */
+    void YUV420toRGB( const unsigned char* src, unsigned int width,
+                      unsigned int height, unsigned char* dst,
+                      unsigned int bytesPerPixel, WorkerPool* pool );
+
+    /*
+     * Times each available kernel, single threaded and across pool, on a
+     * synthetic frame of the given size, and checks they all match the plain
+     * C version. Results go to the log. Returns false on a mismatch.
+     */
+    bool runBenchmark( unsigned int width, unsigned int height,
+                       int iterations, WorkerPool* pool );
+
+}
+
+#endif /* COLORCONVERTER_H_ */
@@ -28,6 +28,10 @@
 
 #include "GLUtil.h"
 
+#include <vector>
+
+class EarthTiles;
+
 const float PI = 3.1415926535;
 
 class Earth
@@ -42,22 +46,69 @@ public:
     Point convertLatLong( float lat, float lon, bool dest = false );
     void rotate( float x, float y, float z );
     float getX(); float getY(); float getZ();
+    // current rotation in degrees, as passed to rotate()
+    void getRotation( float& x, float& y, float& z );
     Point getPos();
     float getRadius();
 
+    // how many slices around the sphere was drawn with last time
+    int getDetail();
+
+    /*
+     * Use a tile set for a sharper texture when zoomed in. Earth takes
+     * ownership of it.
+     */
+    void setTiles( EarthTiles* t );
+    EarthTiles* getTiles();
+
+    // whether something's changed that means another frame should be drawn
+    bool needsRedraw();
+
 private:
     // texture ID & info
     GLuint earthTex;
     int texWidth, texHeight;
 
-    GLUquadric* sphereQuad;
-    GLuint sphereIndex;
+    /*
+     * The sphere at several levels of detail, all in one vertex buffer & one
+     * index buffer. Laid out the same as gluSphere (poles on the z axis,
+     * texture coords going the same way) so the texture & the lat/long
+     * conversion line up the same as they did with it.
+     */
+    struct SphereVertex
+    {
+        GLfloat x, y, z;
+        GLfloat s, t;
+    };
+    struct DetailLevel
+    {
+        int slices, stacks;
+        unsigned int firstIndex;
+        unsigned int numIndices;
+    };
+    std::vector<DetailLevel> levels;
+    std::vector<SphereVertex> sphereVertices;
+    std::vector<GLushort> sphereIndices;
+
+    bool useVertexBuffers;
+    GLuint vertexBuffer;
+    GLuint indexBuffer;
+    int lastLevel;
+
+    // may be NULL
+    EarthTiles* tiles;
+
+    void buildSphere();
+    void drawSphere();
+    // the level with about the right amount of detail for how big the earth
+    // is on screen at the moment
+    int chooseLevel();
+    // roughly how big the earth is on screen, in pixels - negative if the
+    // camera's inside it or right up against it
+    float getScreenRadius();
 
     // note, only doing animation for rotation for now
     bool animated;
-    // indicator of whether the object is in motion
-    bool rotating;
-    void animateValues();
 
     float x, y, z;
     float radius;
@@ -67,9 +118,6 @@ private:
 
     float moveAmt;
 
-    // keep track of the transformation matrix to use with lat/long conversion
-    GLdouble* matrix;
-
 };
 
 #endif /*EARTH_H_*/
@@ -0,0 +1,191 @@
+/*
+ * @file EarthTiles.h
+ *
+ * Definition of the EarthTiles class, which streams in a higher resolution
+ * earth texture from a pyramid of tiles on disk, for when the earth is big
+ * enough on screen that the single earth texture looks blurry.
+ *
+ * The tile set is described by a text file (tiles.txt) in the same format as
+ * the thumbnail file:
+ *
+ *     levels: 6
+ *     tilesize: 512
+ *
+ * with the tiles next to it as <level>/<column>_<row>.png. Level 0 is the
+ * whole map in 2x1 tiles, and each level after that doubles both ways. Tiles
+ * are equirectangular, with column 0 starting at the same longitude as the
+ * left edge of earth.png, and row 0 at the north pole.
+ *
+ * Only the tiles that can be seen at the level that matches how big the
+ * earth is on screen get loaded, by a background thread (decoding) and then
+ * uploaded on the main thread a few per frame. They're kept in an LRU cache
+ * with a fixed GPU memory budget - until a tile is in, the nearest loaded
+ * tile above it in the pyramid (or the plain earth texture) is drawn in its
+ * place.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EARTHTILES_H_
+#define EARTHTILES_H_
+
+#include <VPMedia/thread_helper.h>
+
+#include <deque>
+#include <list>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "GLUtil.h"
+
+class wxSemaphore;
+
+class EarthTiles
+{
+
+public:
+    // budget is the most GPU memory to use for tiles, in bytes
+    EarthTiles( unsigned int budget );
+    ~EarthTiles();
+
+    /*
+     * Read the tile set description & start the loader thread. Returns false
+     * if the description couldn't be read or doesn't make sense.
+     */
+    bool load( std::string infoFile );
+
+    /*
+     * Draw the earth from tiles, on a sphere of the given radius at the
+     * current modelview (with the same layout as Earth's sphere). modelview
+     * is a copy of that same transform, for working out what's visible.
+     * screenRadius is roughly how big the earth is on screen in pixels, and
+     * baseWidth how wide the plain earth texture is - if that's already
+     * enough, or tiles can't be used, nothing is drawn and this returns
+     * false so the caller can draw the plain sphere instead.
+     */
+    bool draw( const Matrix& modelview, float radius, float screenRadius,
+                GLuint baseTex, int baseWidth );
+
+    // whether there are tiles loaded that haven't been put on the GPU yet
+    bool hasPendingUploads();
+
+    int getResidentCount();
+    int getLastVisibleCount();
+
+private:
+    struct TileKey
+    {
+        int level, x, y;
+        bool operator<( const TileKey& other ) const;
+        bool operator==( const TileKey& other ) const;
+    };
+
+    struct TileVertex
+    {
+        GLfloat x, y, z;
+        GLfloat s, t;
+    };
+
+    struct Resident
+    {
+        GLuint tex;
+        std::list<TileKey>::iterator lruPos;
+        unsigned int lastUsed;
+    };
+
+    struct Loaded
+    {
+        TileKey key;
+        // NULL if it couldn't be read
+        unsigned char* pixels;
+    };
+
+    std::string tileDir;
+    int numLevels;
+    int tileSize;
+    unsigned int budget;
+    int capacity;
+
+    // GPU tiles, most recently used at the front of the list
+    std::map<TileKey, Resident> resident;
+    std::list<TileKey> lru;
+    unsigned int frame;
+
+    // tiles that failed to load, so they don't get asked for again
+    std::set<TileKey> missing;
+    // asked for & not back yet
+    std::set<TileKey> pending;
+    // loaded while there was no room for them - not asked for again until
+    // the view changes, or they'd be loaded & thrown away every frame
+    std::set<TileKey> deferred;
+
+    // tiles that should be drawn this frame
+    std::vector<TileKey> visible;
+    std::set<TileKey> visibleSet;
+
+    // shared with the loader thread, under queueMutex
+    std::deque<TileKey> requests;
+    std::deque<Loaded> loaded;
+    mutex* queueMutex;
+    wxSemaphore* wake;
+    thread* loaderThread;
+    volatile bool quit;
+
+    // the triangles for a tile, which are the same for every tile with the
+    // same number of segments - the vertices get filled in for each tile
+    std::vector<GLushort> tileIndices;
+    int tileIndexSegments;
+    std::vector<TileVertex> tileVertices;
+
+    static void* loaderThreadFunc( void* args );
+    void loaderLoop();
+
+    /*
+     * Add the tiles at level under key that might be visible, from the eye
+     * position & the view's clip planes relative to a unit sphere.
+     */
+    void findVisible( const TileKey& key, int level, const float* eye,
+                        const float planes[6][4] );
+    bool isVisible( const TileKey& key, const float* eye,
+                        const float planes[6][4] );
+
+    /*
+     * The closest loaded tile at or above key, which is marked as used this
+     * frame. NULL if there isn't one.
+     */
+    Resident* findSource( const TileKey& key );
+
+    void uploadLoaded();
+    // false if there wasn't a texture to put it in
+    bool upload( const TileKey& key, unsigned char* pixels );
+    void requestVisible();
+    void drawTile( const TileKey& key, GLuint baseTex );
+    void buildTile( const TileKey& key, int segments );
+
+    // the area of the map a tile covers, in 0-1 map coordinates (v down)
+    void getArea( const TileKey& key, float& u0, float& u1, float& v0,
+                    float& v1 );
+    // a point on the unit sphere, same layout as Earth's sphere
+    static void mapToSphere( float u, float v, float* p );
+
+};
+
+#endif /* EARTHTILES_H_ */
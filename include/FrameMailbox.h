@@ -0,0 +1,133 @@
+/*
+ * @file FrameMailbox.h
+ *
+ * Definition of the FrameMailbox class, a triple-buffered handoff of video
+ * frames from a decoder thread to the render thread. The decoder writes into
+ * a back slot and publishes it with an atomic swap; the renderer picks up the
+ * newest published slot, also with an atomic swap, so neither side ever waits
+ * on the other.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAMEMAILBOX_H_
+#define FRAMEMAILBOX_H_
+
+typedef struct
+{
+    unsigned char* data;
+    unsigned int capacity;
+    unsigned int size;
+    unsigned int width;
+    unsigned int height;
+    // size of the video before any downscaling
+    unsigned int nativeWidth;
+    unsigned int nativeHeight;
+    // a VideoLayout::Type
+    int format;
+} FrameSlot;
+
+class FrameMailbox
+{
+
+public:
+    FrameMailbox();
+
+    /*
+     * The mailbox is shared by the sink (which VPMedia deletes on the network
+     * thread) and the VideoSource (deleted on the main thread), so it's
+     * reference counted - starts at 1, deletes itself when it hits 0.
+     */
+    void retain();
+    void release();
+
+    /*
+     * Producer (decoder thread) side. Returns the back slot's buffer, grown to
+     * hold size bytes if it needs to be, to write the frame into - then
+     * publish() makes it the newest frame. Only one thread should be writing.
+     */
+    unsigned char* beginWrite( unsigned int size, unsigned int width,
+                                unsigned int height, unsigned int nativeWidth,
+                                unsigned int nativeHeight, int format );
+    void publish();
+
+    /*
+     * How many times the consumer wants frames halved before they're
+     * published, since it's drawing them that much smaller. Set by the
+     * consumer, read by the producer.
+     */
+    void setScaleLevel( int level );
+    int getScaleLevel();
+
+    /*
+     * Consumer (render thread) side. Swaps the newest published frame to the
+     * front if there is one, returning false if nothing new was published
+     * since the last acquire. The front slot stays valid and untouched by the
+     * producer until the next acquire.
+     */
+    bool acquire();
+    const FrameSlot* getFront();
+
+    // whether acquire() would get a new frame, without picking it up
+    bool hasFresh();
+
+    // frames that were published but replaced before the renderer got to them
+    unsigned int getDroppedCount();
+    unsigned int getPublishedCount();
+
+    /*
+     * Stats for the queue frames wait in before they get here (see
+     * FramePipeline) - how many are waiting, and how many were thrown away
+     * because it was full. Set by the producer side.
+     */
+    void setQueueState( int queued, unsigned int dropped );
+    int getQueuedCount();
+    unsigned int getQueueDroppedCount();
+
+private:
+    ~FrameMailbox();
+
+    static const int numSlots = 3;
+    FrameSlot slots[ numSlots ];
+
+    // the index of the newest published slot, plus freshBit if it hasn't been
+    // picked up by the consumer yet - this is the only shared state, swapped
+    // atomically by both sides
+    volatile int ready;
+    static const int indexMask = 0x3;
+    static const int freshBit = 0x4;
+
+    // owned by the producer/consumer respectively
+    int back;
+    int front;
+
+    volatile int scaleLevel;
+
+    volatile int refCount;
+    volatile unsigned int droppedCount;
+    volatile unsigned int publishedCount;
+    volatile int queuedCount;
+    volatile unsigned int queueDroppedCount;
+
+    // atomically replace ready with value, returning what it was
+    int exchangeReady( int value );
+
+};
+
+#endif /* FRAMEMAILBOX_H_ */
@@ -0,0 +1,141 @@
+/*
+ * @file FramePipeline.h
+ *
+ * Definition of the FramePipeline class, which takes the work done on each
+ * decoded video frame (downscaling, color conversion) off the session threads
+ * and spreads it over a pool of its own, so a source with big or expensive
+ * frames doesn't hold up packet handling for the rest.
+ *
+ * Each source gets a Queue that the session thread copies its frames into.
+ * Queues are bounded - if the pool falls behind, the oldest frame waiting is
+ * thrown away to make room, since only the newest one is going to be shown
+ * anyway. Frames from one queue are handled one at a time & in order, and
+ * queues with frames waiting take turns a frame at a time.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAMEPIPELINE_H_
+#define FRAMEPIPELINE_H_
+
+#include <VPMedia/thread_helper.h>
+
+#include <deque>
+#include <vector>
+
+class wxSemaphore;
+
+class FramePipeline
+{
+
+public:
+    /*
+     * What gets done with each frame, on one of the pipeline's threads.
+     */
+    typedef void (*Handler)( void* data, const unsigned char* frame,
+                                unsigned int width, unsigned int height );
+
+    class Queue
+    {
+    public:
+        /*
+         * Copy a frame in to be handled. If the queue is full the oldest
+         * frame in it is dropped. Only one thread should be pushing.
+         */
+        void push( const unsigned char* frame, unsigned int size,
+                    unsigned int width, unsigned int height );
+
+        // frames waiting right now, and how many have been dropped so far
+        int getQueuedCount();
+        unsigned int getDroppedCount();
+
+    private:
+        friend class FramePipeline;
+
+        typedef struct
+        {
+            std::vector<unsigned char> data;
+            unsigned int width;
+            unsigned int height;
+        } Frame;
+
+        FramePipeline* pipeline;
+        Handler handler;
+        void* handlerData;
+        int depth;
+
+        // everything below is under the pipeline's mutex
+        std::deque<Frame*> frames;
+        // buffers to reuse
+        std::vector<Frame*> spares;
+        // waiting for a thread / being handled by one
+        bool scheduled;
+        bool running;
+        bool closed;
+        unsigned int droppedCount;
+        // set by destroyQueue if a frame's being handled when it's closed -
+        // the worker posts it once it's done with the queue
+        wxSemaphore* finished;
+    };
+
+    FramePipeline( int numThreads );
+    ~FramePipeline();
+
+    /*
+     * Make a queue whose frames go to handler, holding at most depth frames
+     * that are waiting to be handled. depth is at least 2, so there's always
+     * room for a new frame to go in behind the one a thread is about to
+     * take.
+     */
+    Queue* createQueue( Handler handler, void* data, int depth );
+
+    /*
+     * Throw away a queue & anything still in it. If one of its frames is being
+     * handled right now this waits for that to finish, so after this returns
+     * the handler won't be called again.
+     */
+    void destroyQueue( Queue* queue );
+
+    int getNumThreads();
+
+    // totals over all the queues
+    int getQueuedCount();
+    unsigned int getDroppedCount();
+
+private:
+    static void* workerThread( void* args );
+    void workerLoop();
+
+    // put a queue in line for a thread - under pipelineMutex
+    void schedule( Queue* queue );
+
+    std::vector<thread*> threads;
+    wxSemaphore* wake;
+    volatile bool quit;
+
+    // queues with frames waiting, in the order they get a thread, plus the
+    // totals, all under pipelineMutex
+    mutex* pipelineMutex;
+    std::deque<Queue*> ready;
+    int queuedCount;
+    unsigned int droppedCount;
+
+};
+
+#endif /* FRAMEPIPELINE_H_ */
@@ -51,6 +51,12 @@ public:
     void resize( wxSizeEvent& evt );
     void GLreshape( int w, int h );
 
+    /*
+     * Set up the viewport & matrices for drawing at w x h. Separate from the
+     * canvas so headless mode (which doesn't have one) can use it too.
+     */
+    static void setupView( ObjectManager* objectMan, int w, int h );
+
     void stopTimer();
     void setTimer( RenderTimer* t );
 
@@ -71,9 +77,6 @@ private:
     void testDraw();
     void testKey( wxKeyEvent& evt );
 
-    // tracks the aspect ratio of the screen for reshaping
-    float screen_width, screen_height;
-
     // if draw is being called by a timer, have a reference to it so we can stop
     // it if need be
     RenderTimer* renderTimer;
@@ -37,8 +37,10 @@
 
 #include <iostream>
 #include <map>
+#include <vector>
 
 #include "Point.h"
+#include "Matrix.h"
 
 typedef struct
 {
@@ -49,11 +51,26 @@ typedef struct
 
 class RectangleBase;
 class GLCanvas;
+class BatchRenderer;
+class GlyphAtlas;
+class ResourceLoader;
 
 class GLUtil
 {
 
 public:
+    /*
+     * Shader programs for drawing video that isn't plain RGB. All of them
+     * have an alpha uniform, and sample their planes from units 0 and up.
+     */
+    enum ShaderProgram
+    {
+        PROGRAM_NONE,
+        // separate Y, U, V textures on units 0-2 - works for any subsampling
+        PROGRAM_YUV_PLANAR,
+        NUM_PROGRAMS
+    };
+
     static GLUtil* getInstance();
 
     /*
@@ -62,9 +79,20 @@ public:
     bool initGL();
     static void cleanupGL();
 
-    // get the matrices that define the camera transforms so we can use those
-    // to convert our coordinates
-    void updateMatrices();
+    /*
+     * Set the camera transforms. These load the matrices into GL as well, and
+     * keep a copy so we can use those to convert our coordinates without
+     * asking GL for them. setModelview loads into whichever matrix mode is
+     * current (which should be modelview).
+     */
+    void setProjection( const Matrix& p );
+    void setModelview( const Matrix& m );
+    void setViewport( int x, int y, int w, int h );
+
+    // as of the last set
+    const Matrix& getProjection();
+    const Matrix& getModelview();
+    void getViewport( int* v );
 
     inline int pow2( int x )
     {
@@ -110,18 +138,40 @@ public:
                                     Point& intersect );
 
     /**
-     * Uses GLEW to load a shader (vert and frag) from the string and returns a
-     * reference to the program.
+     * Uses GLEW to compile & link a shader program from the vertex and
+     * fragment sources and returns a reference to it, or 0 on failure.
      */
-    GLuint loadShaders( const char* location );
+    GLuint loadShaders( const GLchar* vertSource, const GLchar* fragSource );
 
-    GLuint getYUV420Program();
-    GLuint getYUV420xOffsetID();
-    GLuint getYUV420yOffsetID();
-    GLuint getYUV420alphaID();
+    /*
+     * Program & alpha uniform for the given type - 0 for PROGRAM_NONE, or if
+     * it isn't available.
+     */
+    GLuint getProgram( ShaderProgram p );
+    GLint getProgramAlphaID( ShaderProgram p );
+
+    // whether things that need the given program can be drawn
+    bool isProgramAvailable( ShaderProgram p );
 
     FTFont* getMainFont();
 
+    /*
+     * Main font's glyphs packed into one texture, for batched text - NULL if
+     * it couldn't be made, in which case text falls back to the main font.
+     */
+    GlyphAtlas* getTextAtlas();
+
+    /*
+     * Bounds of a string in the main font, at the font's size. Same as
+     * getMainFont()->BBox(), but from the atlas if there is one so it matches
+     * what gets drawn. Main thread only.
+     */
+    FTBBox getTextBounds( const std::string& text );
+
+    // for drawing simple shapes without lots of immediate mode calls - NULL
+    // until initGL
+    BatchRenderer* getBatchRenderer();
+
     /*
      * Returns whether shaders are available to use or not.
      * Note shader enable needs to be set before initGL is called for the
@@ -131,6 +181,24 @@ public:
 
     void setShaderEnable( bool es );
 
+    /*
+     * Returns whether pixel buffer objects and sync objects are available, for
+     * asynchronous texture uploads. Like shaders, the enable needs to be set
+     * before initGL is called.
+     */
+    bool arePixelBuffersAvailable();
+
+    void setPixelBufferEnable( bool epb );
+
+    // whether vertex buffer objects can be used, as of initGL
+    bool areVertexBuffersAvailable();
+
+    /*
+     * Returns whether textures can be allocated at their exact size rather
+     * than rounded up to a power of 2.
+     */
+    bool areNonPow2TexturesAvailable();
+
     void setBufferFontUsage( bool buf );
 
     /*
@@ -139,10 +207,47 @@ public:
      * Note, if when calling getTexture() the input is not found, it will return
      * a Texture with 0 in all fields, which will be safe to render (will just
      * be white)
+     * The texture is allocated (at the right size) right away, but the image
+     * is decoded in the background & put in over the next few frames - until
+     * then it's just grey. With mipmap set, mipmaps are made once it's in.
      */
-    bool addTexture( std::string name, std::string fileName );
+    bool addTexture( std::string name, std::string fileName,
+                        bool mipmap = false );
     Texture getTexture( std::string name );
 
+    /*
+     * Finish some of the background loads that are done (ie, upload their
+     * textures). Called once a frame, on the main thread.
+     */
+    void finishResourceLoads();
+    // whether there are background loads that haven't been finished yet
+    bool areResourcesLoading();
+    ResourceLoader* getResourceLoader();
+
+    /*
+     * Generate mipmaps for a texture & switch it to mipmapped filtering, if
+     * the card can. Returns false if it can't.
+     */
+    bool generateMipmaps( GLuint tex );
+
+    /*
+     * Pool of textures for things that get (re)allocated often, like video
+     * planes. Borrowing returns a texture with storage for the given format
+     * and size already allocated (contents undefined), reusing one that was
+     * returned earlier if possible. Returned textures are kept around for
+     * reuse, up to a limit per format+size.
+     */
+    GLuint borrowTexture( GLenum format, int width, int height );
+    void returnTexture( GLuint tex, GLenum format, int width, int height );
+
+    /*
+     * Same as above, for pixel unpack buffers of a given size in bytes. The
+     * GL may still be reading from a buffer that was returned, so borrowers
+     * should orphan it (glBufferData with NULL) before mapping it.
+     */
+    GLuint borrowPixelBuffer( unsigned int size );
+    void returnPixelBuffer( GLuint buf, unsigned int size );
+
     void setCanvas( GLCanvas* c );
     GLCanvas* getCanvas();
 
@@ -153,27 +258,53 @@ protected:
 private:
     static GLUtil* instance;
 
-    // pointers to the GL matrices
-    GLdouble modelview[16];
-    GLdouble projection[16];
+    // copies of the GL camera matrices
+    Matrix modelview;
+    Matrix projection;
     GLint viewport[4];
+    // inverse of projection * modelview for screenToWorld, only worked out
+    // again when it's needed after one of the above changes
+    Matrix inverseViewProjection;
+    bool inverseValid;
 
-    const GLchar* frag420;
-    const GLchar* vert420;
+    const GLchar* vertVideo;
+    const GLchar* fragYUVPlanar;
 
     bool shadersAvailable;
     bool enableShaders;
 
-    GLuint YUV420Program;
-    GLuint YUV420xOffsetID;
-    GLuint YUV420yOffsetID;
-    GLuint YUV420alphaID;
+    bool pixelBuffersAvailable;
+    bool enablePixelBuffers;
+
+    bool vertexBuffersAvailable;
+
+    GLuint programs[ NUM_PROGRAMS ];
+    GLint programAlphaIDs[ NUM_PROGRAMS ];
+
+    // load one of the above & set its sampler units
+    bool loadProgram( ShaderProgram p, const GLchar* fragSource,
+                        int numSamplers, const char** samplerNames );
+
+    bool nonPow2TexturesAvailable;
 
     FTFont* mainFont;
+    GlyphAtlas* textAtlas;
+    static const unsigned int fontSize = 100;
+    BatchRenderer* batchRenderer;
     // switch to change to use buffer font - texture font is default
     bool useBufferFont;
 
     std::map<std::string, Texture> textures;
+    // NULL until initGL
+    ResourceLoader* resourceLoader;
+
+    // spare textures by format, then width & height
+    typedef std::pair<GLenum, std::pair<int, int> > TexturePoolKey;
+    std::map<TexturePoolKey, std::vector<GLuint> > texturePool;
+    // spare pixel buffers by size
+    std::map<unsigned int, std::vector<GLuint> > pixelBufferPool;
+    // limit on spares for a given key, so one-off sizes don't pile up
+    unsigned int maxPoolSize;
 
     GLCanvas* canvas;
 
@@ -0,0 +1,122 @@
+/*
+ * @file GeoOverlay.h
+ *
+ * Definition of the GeoOverlay class, which draws the markers on the globe
+ * for where each object is, and optionally curved lines from there to the
+ * object itself.
+ *
+ * Each object's marker position & line are kept from frame to frame and only
+ * worked out again when something they depend on changes (the object's
+ * lat/long, position, color or selection, or the earth's rotation). All of
+ * the markers & lines are kept in one vertex buffer, which is only uploaded
+ * when something changed, and drawn with a call for each marker size plus
+ * one for the lines.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GEOOVERLAY_H_
+#define GEOOVERLAY_H_
+
+#include <map>
+#include <vector>
+
+#include "RectangleBase.h"
+
+class Earth;
+
+class GeoOverlay
+{
+
+public:
+    GeoOverlay();
+    ~GeoOverlay();
+
+    /*
+     * Bring the markers & lines up to date with the objects - ungrouped
+     * objects get a marker, selected ones a bigger one drawn after the rest.
+     * Has to be called on the main thread with the sources locked, since it
+     * reads the object lists.
+     */
+    void update( Earth* earth, const std::vector<RectangleBase*>& drawn,
+                    const std::vector<RectangleBase*>& selected );
+
+    // draw everything as of the last update
+    void draw();
+
+    // whether to draw the lines from the markers to the objects
+    void setDrawLinks( bool l );
+    bool getDrawLinks();
+
+    // how many objects had to be worked out again on the last update
+    int getLastUpdateCount();
+
+private:
+    struct Vertex
+    {
+        GLfloat x, y, z;
+        GLfloat r, g, b, a;
+    };
+
+    struct Entry
+    {
+        // what the marker & line were worked out from
+        float lat, lon;
+        float objX, objY, objZ;
+        bool haveLink;
+
+        Vertex marker;
+        // the curve to the object, as pairs of points for GL_LINES
+        std::vector<Vertex> link;
+
+        // false until it's been worked out the first time
+        bool valid;
+        // for finding entries whose objects are gone
+        bool seen;
+    };
+
+    std::map<RectangleBase*, Entry> entries;
+
+    // earth transform the entries were worked out with
+    float earthPos[3];
+    float earthRot[3];
+
+    // markers, then selected markers, then lines
+    std::vector<Vertex> vertices;
+    int numMarkers;
+    int numSelectedMarkers;
+    int numLinkVertices;
+    // what gets built each update, to compare against the above
+    std::vector<Vertex> scratch;
+
+    bool drawLinks;
+    int lastUpdateCount;
+
+    bool useVertexBuffers;
+    GLuint vertexBuffer;
+    bool bufferDirty;
+    bool initialized;
+
+    // get the object's entry, working it out again if anything changed
+    Entry& updateEntry( Earth* earth, RectangleBase* obj, bool earthMoved );
+    void buildLink( Earth* earth, Entry& e );
+
+};
+
+#endif /* GEOOVERLAY_H_ */
@@ -0,0 +1,123 @@
+/*
+ * @file GlyphAtlas.h
+ *
+ * Definition of the GlyphAtlas class, which rasterizes the glyphs of a font
+ * with FreeType and packs them all into a single alpha texture, so any amount
+ * of text can be drawn with one texture bound. Glyphs are laid out in the
+ * same units FTGL uses (pixels at the face size, 72 dpi), so text measured or
+ * drawn through here lines up with the old FTGL text.
+ *
+ * Like FTGL's char* functions, strings are treated as one byte per character,
+ * so there are at most 256 glyphs. ASCII is loaded up front and the rest as
+ * they show up.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GLYPHATLAS_H_
+#define GLYPHATLAS_H_
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "GLUtil.h"
+
+/*
+ * One glyph's quad, relative to the start of the string's baseline, and where
+ * it is in the atlas.
+ */
+typedef struct
+{
+    GLfloat x1, y1, x2, y2;
+    GLfloat s1, t1, s2, t2;
+} GlyphQuad;
+
+class GlyphAtlas
+{
+
+public:
+    GlyphAtlas();
+    ~GlyphAtlas();
+
+    /*
+     * Load the font at the given size & make the atlas texture. Needs a GL
+     * context, as do layout and getBounds, since new glyphs get uploaded as
+     * they're needed.
+     */
+    bool load( const std::string& fontFile, unsigned int size );
+
+    GLuint getTexture();
+
+    /*
+     * Lay out a string starting at the origin on the baseline, appending a
+     * quad for each visible glyph and giving the bounds of the whole thing.
+     * Bounds are all 0 for an empty string. Text is UTF-8, like FTGL takes
+     * (and like RTCP SDES items are).
+     */
+    void layout( const std::string& text, std::vector<GlyphQuad>& quads,
+                    float& lx, float& ly, float& ux, float& uy );
+    void getBounds( const std::string& text, float& lx, float& ly,
+                    float& ux, float& uy );
+
+private:
+    typedef struct
+    {
+        // whether it has anything to draw (space doesn't, for instance)
+        bool visible;
+        FT_UInt index;
+        float advance;
+        GlyphQuad quad;
+    } Glyph;
+
+    // rasterize a glyph & find room for it in the texture, the first time
+    // a character is used
+    Glyph& getGlyph( unsigned long c );
+
+    /*
+     * The code point starting at pos, moving pos past it. Bytes that aren't
+     * part of valid UTF-8 are taken as Latin-1, so older clients' names still
+     * come out readable.
+     */
+    static unsigned long decodeUTF8( const std::string& text,
+                                        unsigned int& pos );
+
+    FT_Library library;
+    FT_Face face;
+
+    GLuint texture;
+    static const int atlasWidth = 2048;
+    static const int atlasHeight = 1024;
+    // space around each glyph so filtering doesn't pick up its neighbors
+    static const int padding = 2;
+
+    // where the next glyph goes - glyphs fill rows left to right, and a new
+    // row starts above the tallest glyph in the current one
+    int penX, penY, rowHeight;
+    bool full;
+
+    // by code point
+    std::map<unsigned long, Glyph> glyphs;
+
+};
+
+#endif /* GLYPHATLAS_H_ */
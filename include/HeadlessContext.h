@@ -0,0 +1,92 @@
+/*
+ * @file HeadlessContext.h
+ *
+ * Definition of the HeadlessContext class, which gives grav a GL context &
+ * something to draw into without any window, for timing the rendering on
+ * machines without a display (build servers etc.).
+ *
+ * The context comes from EGL, on Mesa's surfaceless platform if it's there
+ * (so it doesn't need a display server, and can run on llvmpipe without a
+ * GPU) or the default display otherwise. Since there's no surface, drawing
+ * goes to a framebuffer object that's bound for the whole run, which can be
+ * read back to save frames.
+ *
+ * Only available if grav was built with EGL (GRAV_HAVE_EGL) - otherwise
+ * init() just fails.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HEADLESSCONTEXT_H_
+#define HEADLESSCONTEXT_H_
+
+#include <string>
+#include <vector>
+
+#include "GLUtil.h"
+
+#ifdef GRAV_HAVE_EGL
+#include <EGL/egl.h>
+#endif
+
+class HeadlessContext
+{
+
+public:
+    HeadlessContext();
+    ~HeadlessContext();
+
+    /*
+     * Create the context & make it current. Has to be done before
+     * GLUtil::initGL(), since that needs a context to look at.
+     */
+    bool init();
+
+    /*
+     * Make the framebuffer to draw into & bind it. Has to be done after
+     * GLUtil::initGL(), since the FBO functions come from GLEW.
+     */
+    bool createFramebuffer( int w, int h );
+
+    /*
+     * Read the last frame back & save it as a binary PPM. Waits for the
+     * frame to finish, so it'll show up in the timing if done in between.
+     */
+    bool writeFrame( std::string fileName );
+
+    int getWidth();
+    int getHeight();
+
+private:
+#ifdef GRAV_HAVE_EGL
+    EGLDisplay display;
+    EGLContext context;
+#endif
+
+    GLuint framebuffer;
+    GLuint colorBuffer;
+    GLuint depthBuffer;
+    int width, height;
+
+    // for reading frames back into, so it's not allocated every frame
+    std::vector<unsigned char> pixels;
+
+};
+
+#endif /* HEADLESSCONTEXT_H_ */
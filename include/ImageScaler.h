@@ -0,0 +1,58 @@
+/*
+ * @file ImageScaler.h
+ *
+ * Box-filter downscaling of raw image planes, used to shrink video frames
+ * before they get uploaded when they're being shown much smaller than their
+ * native size.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IMAGESCALER_H_
+#define IMAGESCALER_H_
+
+#include <vector>
+
+namespace ImageScaler
+{
+
+    /*
+     * Halves a tightly-packed plane in both dimensions, averaging each 2x2
+     * block. Odd last rows/columns are dropped. dst can be the same as src
+     * (the output is always behind the input), otherwise they shouldn't
+     * overlap. Single-byte pixels go through SSE2 if available.
+     */
+    void halve( const unsigned char* src, unsigned int width,
+                unsigned int height, unsigned int bytesPerPixel,
+                unsigned char* dst );
+
+    /*
+     * Downscales a plane by 2^level in both dimensions into dst, which needs
+     * to hold (width>>level)*(height>>level)*bytesPerPixel bytes. scratch is
+     * used for the intermediate levels and is grown as needed, so callers
+     * can keep it around between frames.
+     */
+    void downscale( const unsigned char* src, unsigned int width,
+                    unsigned int height, unsigned int bytesPerPixel,
+                    unsigned int level, unsigned char* dst,
+                    std::vector<unsigned char>& scratch );
+
+}
+
+#endif /* IMAGESCALER_H_ */
@@ -91,6 +91,7 @@ public:
     void handleToggleAutoFocusRotate();
     void handleSelectAll();
     void handleToggleGraphicsDebug();
+    void handleToggleGeoLinks();
     void handleDownscaleSelected();
     void handleUpscaleSelected();
     void handleToggleFullscreen();
@@ -0,0 +1,85 @@
+/*
+ * @file Matrix.h
+ *
+ * Definition of the Matrix class, a 4x4 transform matrix for doing the
+ * camera & object transforms on the CPU, so things like projecting points to
+ * the screen don't have to read the matrices back from GL.
+ *
+ * Stored column-major, the same as GL, so it can be passed straight to
+ * glLoadMatrixf. Functions that modify the matrix in place (translate,
+ * rotate, scale) multiply on the right, like the GL calls they replace.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MATRIX_H_
+#define MATRIX_H_
+
+#include "Point.h"
+#include "Vector.h"
+
+class Matrix
+{
+
+public:
+    // starts out as the identity
+    Matrix();
+    Matrix( const float* values );
+
+    void loadIdentity();
+
+    float& operator[]( int i );
+    float operator[]( int i ) const;
+    const float* get() const;
+
+    Matrix operator*( const Matrix& other ) const;
+
+    void translate( float x, float y, float z );
+    // angle in degrees, around the axis x,y,z, same as glRotatef
+    void rotate( float angle, float x, float y, float z );
+    void scale( float x, float y, float z );
+
+    /*
+     * Transform a point (w = 1), without the perspective divide - for
+     * modelview-type transforms.
+     */
+    Point transformPoint( const Point& p ) const;
+
+    // transform a 4-component x,y,z,w vector
+    void transform( const float* in, float* out ) const;
+
+    /*
+     * Find the inverse of this matrix. Returns false (and leaves result
+     * alone) if it can't be inverted.
+     */
+    bool invert( Matrix& result ) const;
+
+    // same as glFrustum & gluLookAt
+    static Matrix frustum( float left, float right, float bottom, float top,
+                            float near, float far );
+    static Matrix lookAt( const Point& eye, const Point& center,
+                            const Vector& up );
+
+private:
+    // aligned so the compiler can use vector loads on the columns
+    float m[16] __attribute__(( aligned( 16 ) ));
+
+};
+
+#endif /* MATRIX_H_ */
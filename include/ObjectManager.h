@@ -29,6 +29,8 @@
 #include <wx/wx.h>
 #include <vector>
 #include <map>
+#include <set>
+#include <stdint.h>
 
 #include "RectangleBase.h"
 #include "GLCanvas.h"
@@ -50,6 +52,11 @@ class VenueClientController;
 class SessionManager;
 class Camera;
 class Point;
+class UploadScheduler;
+class SpatialIndex;
+class GeoOverlay;
+class SceneEventQueue;
+struct SceneEvent;
 
 class ObjectManager
 {
@@ -64,6 +71,23 @@ public:
      */
     void draw();
 
+    /*
+     * Whether anything on screen would change if draw() was called now - if
+     * not, the frame (and the buffer swap) can be skipped. Anything that
+     * changes the scene without starting an animation or bringing in a new
+     * frame, like input, should call markDirty(). Main thread only, but
+     * markDirty() can be called from anywhere.
+     */
+    bool needsRedraw();
+    void markDirty();
+
+    /*
+     * Longest time in ms to go without drawing even if nothing seems to have
+     * changed, as a catch-all for changes that don't mark anything dirty. 0
+     * disables the tracking, so every frame gets drawn.
+     */
+    void setMaxRedrawInterval( int ms );
+
     void clearSelected();
     void ungroupSiteIDGroups();
 
@@ -79,17 +103,12 @@ public:
      * Bool val is used when checking the object's group to prevent infinite
      * loops - group checking is done to move groups to top when moving group
      * members to top.
-     * Note these are NOT thread-safe, lockSources() should be called around
-     * them.
+     * Main thread only, like everything else that touches the lists.
      */
     void moveToTop( RectangleBase* object, bool checkGrouping = true );
     void moveToTop( std::vector<RectangleBase*>::iterator i,
                         bool checkGrouping = true );
 
-    void drawCurvedEarthLine( float lat, float lon,
-                              float destx, float desty, float destz );
-    void drawEarthPoint( float lat, float lon, float size );
-
     void setBoxSelectDrawing( bool draw );
     int getWindowWidth(); int getWindowHeight();
     void setWindowWidth( int w ); void setWindowHeight( int h );
@@ -124,6 +143,14 @@ public:
     std::vector<RectangleBase*>* getSelectedObjects();
     std::map<std::string,Group*>* getSiteIDGroups();
 
+    /*
+     * Get the drawn objects that might intersect the given rectangle, topmost
+     * first (ie, the same order as going backwards through drawnObjects).
+     * These still need an actual intersect() test.
+     */
+    void getObjectsAt( float L, float R, float U, float D,
+                        std::vector<RectangleBase*>& results );
+
     /*
      * "Movable" being defined as selectable non-groups, ie, things that will
      * be moved by the user-initiated arrangements.
@@ -137,20 +164,38 @@ public:
 
     /*
      * Manage sources in the main list of sources as well as in the lists of
-     * drawn & selected objects.
-     * Latter is an iterator so as not to have to loop through the list of
-     * sources twice - mainly because the delete-by-ssrc in videolistener
-     * needs to find its target that way.
-     * I.e., delete expects that the caller will find the source in the
-     * sources list itself.
+     * drawn & selected objects. These come from the session threads, so they
+     * don't touch the lists themselves - the change gets pushed onto a
+     * lock-free queue (see SceneEventQueue) and applied on the main thread at
+     * the start of the next draw(), so a session thread never has to wait for
+     * a frame to finish (and draw() doesn't have to hold a lock for the whole
+     * frame). From the main thread they're applied right away, along with
+     * anything queued before them, since that's where sessions get disabled
+     * & deleted and their sources can't outlive them. addNewSource takes
+     * ownership of the source.
      */
     void addNewSource( VideoSource* s );
-    void deleteSource( std::vector<VideoSource*>::iterator si );
+    void removeSource( VPMSession* session, uint32_t ssrc );
+    void setSourceSiteID( uint32_t ssrc, std::string siteID );
+
+    /*
+     * Apply the source changes that are waiting. Main thread only. Anything
+     * still halfway through being pushed gets left for the next call.
+     */
+    void applySceneEvents();
+
+    /*
+     * Like applySceneEvents(), but waits for pushes that are halfway through
+     * too, so nothing pushed before this was called gets left behind. Main
+     * thread only - should be called before anything that could delete a
+     * session.
+     */
+    void drainSceneEvents();
+
     void deleteGroup( Group* g );
 
     /*
-     * Note these are NOT thread-safe, lockSources() should be called around
-     * them.
+     * Main thread only - session threads go through addNewSource() etc.
      */
     void addToDrawList( RectangleBase* obj );
     void removeFromLists( RectangleBase* obj, bool treeRemove = true );
@@ -158,7 +203,7 @@ public:
     /*
      * Creates a group for siteID-based grouping, with the data string as the
      * name, adds it to the list, and returns a pointer to it.
-     * Note this is NOT thread-safe, lockSources() should be called around this.
+     * Main thread only.
      */
     Group* createSiteIDGroup( std::string data );
 
@@ -196,11 +241,6 @@ public:
 
     TreeControl* getTree();
 
-    void lockSources();
-    void unlockSources();
-
-    void setThreads( bool threads );
-
     bool usingRunway();
     bool usingGridAuto();
     bool usingAutoFocusRotate();
@@ -212,6 +252,31 @@ public:
     void setGraphicsDebugMode( bool g );
     bool getGraphicsDebugMode();
 
+    // whether to draw lines from the globe to each object
+    void setGeoLinks( bool l );
+    bool getGeoLinks();
+
+    /*
+     * Whether to automatically suspend texture pushes for videos that are
+     * off-screen, covered or too small to see, and whether to suspend their
+     * decoding as well.
+     */
+    void setVisibilityCulling( bool v );
+    void setHiddenDecodeSuspension( bool s );
+
+    /*
+     * Whether to have videos that are drawn much smaller than their native
+     * size get downscaled before they're uploaded to the GPU.
+     */
+    void setUploadDownscaling( bool d );
+
+    /*
+     * Most bytes of video to upload to the GPU in a single frame, 0 for no
+     * limit. Videos that don't fit keep their frame for the next one, with
+     * selected, focused and talking videos getting first pick.
+     */
+    void setUploadBudget( unsigned int bytes );
+
     void toggleShowVenueClientController();
     bool isVenueClientControllerShown();
     bool isVenueClientControllerShowable();
@@ -229,8 +294,42 @@ private:
      */
     void doDelayedDelete();
 
+    /*
+     * The parts of applySceneEvents() that actually change the lists.
+     * deleteSource takes an iterator so the source doesn't have to be looked
+     * up twice.
+     */
+    void insertSource( VideoSource* s );
+    void deleteSource( std::vector<VideoSource*>::iterator si );
+    void groupBySiteID( uint32_t ssrc, std::string siteID );
+
+    /*
+     * Classify each video source as visible, occluded (fully covered by an
+     * opaque video drawn on top of it) or off-screen (including being too
+     * small to see), and pass that on so hidden ones can be suspended. Also
+     * passes on how tall each one is on screen, for upload downscaling.
+     * Needs the camera transform to be current.
+     */
+    void updateVisibility();
+
+    /*
+     * Get the newest frame from each video and upload what fits in the
+     * budget. Has to happen after updateVisibility, so suspended videos are
+     * skipped and scale levels are current.
+     */
+    void uploadFrames();
+
+    // whether a video should go before others when uploading
+    bool isUploadPriority( VideoSource* s );
+
     std::vector<VideoSource*>* sources;
     std::vector<RectangleBase*>* drawnObjects;
+    // drawnObjects by position & draw order, for hit testing and occlusion -
+    // anything added to, removed from or raised in drawnObjects needs the
+    // same done here
+    SpatialIndex* spatialIndex;
+    // markers on the globe for each object
+    GeoOverlay* geoOverlay;
     std::vector<RectangleBase*>* selectedObjects;
     std::map<std::string,Group*>* siteIDGroups;
 
@@ -270,6 +369,7 @@ private:
     std::string headerString;
     bool useHeader;
     FTBBox headerTextBox;
+    TextLabel headerLabel;
     float textScale;
     float textOffset;
 
@@ -300,9 +400,15 @@ private:
     int intersectCounter;
     bool enableSiteIDGroups;
 
-    bool usingThreads;
-    mutex* sourceMutex; // this is owned by us
-    int lockCount;
+
+    // changes from addNewSource() etc. waiting for the main thread
+    SceneEventQueue* sceneEvents;
+    void pushSceneEvent( SceneEvent* event );
+
+    // how many events were applied since the start of this frame, and the
+    // longest any of them waited (in ms)
+    int frameEventCount;
+    double frameEventLatency;
 
     bool useRunway;
     bool gridAuto;
@@ -320,6 +426,25 @@ private:
     bool graphicsDebugView;
     long pixelCount;
 
+    bool visibilityCulling;
+    bool suspendHiddenDecoding;
+    // videos smaller than this on screen count as not visible
+    static const int minVisiblePixels = 8;
+    int suspendedCount;
+
+    bool uploadDownscaling;
+
+    UploadScheduler* uploadScheduler;
+
+    // set by markDirty, cleared when drawing - atomic, since it may be set
+    // from the network thread
+    volatile int dirty;
+    int maxRedrawInterval;
+    wxStopWatch redrawStopwatch;
+    // objects whose audio level was above the threshold last time it was
+    // checked, which gives them upload priority
+    std::set<RectangleBase*> talkingObjects;
+
 };
 
 #endif /*OBJECTMANAGER_H_*/
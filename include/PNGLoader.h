@@ -36,6 +36,29 @@ namespace PNGLoader
      */
     GLuint loadPNG( std::string filename, int &width, int &height );
 
+    /*
+     * Reads in filename and decodes it to 8-bit RGBA, bottom row first (the
+     * way GL wants it), returning the pixels (to be freed with delete[]) or
+     * NULL if it couldn't be read. Doesn't touch GL, so it's safe to call
+     * from other threads.
+     */
+    unsigned char* readPNG( std::string filename, int &width, int &height );
+
+    /*
+     * Just gets the size of the image from the header, without decoding it.
+     * Returns false if the file couldn't be read or isn't a PNG.
+     */
+    bool readPNGSize( std::string filename, int &width, int &height );
+
+    /*
+     * Allocates a texture for an image of the given size (rounded up to a
+     * power of 2), filled with grey until uploadImage() puts the actual
+     * image in it.
+     */
+    GLuint createTexture( int width, int height );
+    void uploadImage( GLuint texID, unsigned char* image, int width,
+                        int height );
+
 }
 
 #endif /*PNGLOADER_H_*/
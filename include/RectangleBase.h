@@ -32,6 +32,7 @@
 #include "GLUtil.h"
 #include "Vector.h"
 #include "Ray.h"
+#include "TextLabel.h"
 
 typedef struct
 {
@@ -61,6 +62,7 @@ enum TextStyle
 // reference each other
 class Group;
 class Point;
+class SpatialIndex;
 
 class RectangleBase
 {
@@ -220,6 +222,12 @@ public:
     void setEffectVal( float f );
     void setAnimation( bool anim );
 
+    /*
+     * Set by SpatialIndex when the object is added to or removed from it, so
+     * the index can be told when the object moves or resizes.
+     */
+    void setSpatialIndex( SpatialIndex* index );
+
     /*
      * Whether the object is movable by the user - controls whether move() calls
      * go through in InputHandler which should be the single entry point.
@@ -275,6 +283,13 @@ public:
     void updateTextBounds();
     void setSubstring( int start, int end );
 
+    /*
+     * Whether drawing this again would look any different than last time,
+     * apart from animations (which the Animator keeps track of) - ie, its
+     * name needs to be resized.
+     */
+    virtual bool needsRedraw();
+
     /*
      * Checks whether this object intersects with another rectangle, defined
      * either by its specific points or an existing rectangle object.
@@ -361,6 +376,8 @@ protected:
     int cutoffPos;
 
     FTBBox textBounds;
+    // title as it was last drawn, so it's only laid out again on changes
+    TextLabel titleLabel;
     // amount to scale the text relative to the total size
     float relativeTextScale;
     // temp thing for calculating size - possible change to an enum
@@ -393,14 +410,15 @@ protected:
 
     bool debugDraw;
 
+    // whether setters animate to their values (via the Animator) rather
+    // than jumping straight to them
     bool animated;
-    virtual void animateValues();
+    void animateColor( RGBAColor& col, const RGBAColor& dest );
 
-    bool positionAnimating;
-    bool scaleAnimating;
-    bool borderColAnimating;
-    bool secondColAnimating;
-    bool rotationAnimating;
+    // index this is in for hit testing, if it's being drawn
+    SpatialIndex* spatialIndex;
+    // tell the index our bounds changed
+    void boundsChanged();
 
 };
 
@@ -0,0 +1,118 @@
+/*
+ * @file ResourceLoader.h
+ *
+ * Definition of the ResourceLoader class, which loads things like textures
+ * in the background so startup doesn't have to wait on them.
+ *
+ * Each job is split into a part that can run on one of the loader threads
+ * (reading & decoding files) and a part that has to run on the main thread
+ * with the GL context (uploading the result). The main thread finishes a few
+ * jobs each frame, so whatever they're for shows up over the first frames
+ * rather than all at once before the window appears.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RESOURCELOADER_H_
+#define RESOURCELOADER_H_
+
+#include <VPMedia/thread_helper.h>
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "GLUtil.h"
+
+class wxSemaphore;
+
+class ResourceLoader
+{
+
+public:
+    class Job
+    {
+    public:
+        virtual ~Job() { }
+
+        // runs on one of the loader threads, so no GL calls in here
+        virtual void load() = 0;
+
+        // runs on the main thread, some time after load() is done
+        virtual void finish() = 0;
+    };
+
+    ResourceLoader( int numThreads );
+    ~ResourceLoader();
+
+    /*
+     * Queue a job to be loaded. The loader takes ownership, and deletes it
+     * once it's finished.
+     */
+    void add( Job* job );
+
+    /*
+     * Finish up to maxJobs jobs that are done loading, in the order they
+     * were done. Main thread only. Returns how many were finished.
+     */
+    int finishLoaded( int maxJobs );
+
+    // whether anything has been added that hasn't been finished yet
+    bool isBusy();
+
+private:
+    static void* loaderThread( void* args );
+
+    std::vector<thread*> threads;
+    wxSemaphore* wake;
+    volatile bool quit;
+
+    // everything below is under queueMutex
+    mutex* queueMutex;
+    std::deque<Job*> waiting;
+    std::deque<Job*> loaded;
+    int unfinished;
+
+};
+
+/*
+ * Decodes a PNG & puts it in a texture that's already been allocated for it
+ * (see PNGLoader::createTexture), optionally making mipmaps for it after.
+ */
+class TextureLoadJob : public ResourceLoader::Job
+{
+
+public:
+    TextureLoadJob( GLuint tex, std::string file, int width, int height,
+                    bool mipmap );
+    ~TextureLoadJob();
+
+    void load();
+    void finish();
+
+private:
+    GLuint texID;
+    std::string fileName;
+    int width, height;
+    bool mipmap;
+    unsigned char* image;
+
+};
+
+#endif /* RESOURCELOADER_H_ */
@@ -0,0 +1,113 @@
+/*
+ * @file SceneEventQueue.h
+ *
+ * Definition of the SceneEventQueue class, which carries changes to the scene
+ * (sources coming & going, site IDs) from the session threads to the main
+ * thread without any locking, so a session thread never waits on the main
+ * thread and vice versa.
+ *
+ * Any number of threads can push, but only one (the main thread) can pop. The
+ * queue is a linked list of the events themselves: a push swaps the new event
+ * in as the head and then links the old head to it, and the popper follows the
+ * links from the tail. Between those two steps of a push the list is briefly
+ * broken, so pop() can come up empty even though something's been pushed -
+ * that event just shows up on a later pop.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SCENEEVENTQUEUE_H_
+#define SCENEEVENTQUEUE_H_
+
+#include <string>
+#include <stdint.h>
+
+class VideoSource;
+class VPMSession;
+
+struct SceneEvent
+{
+    enum Type
+    {
+        SOURCE_ADDED,
+        SOURCE_REMOVED,
+        SITE_ID
+    };
+
+    SceneEvent( Type t );
+
+    Type type;
+    // the new source, for SOURCE_ADDED
+    VideoSource* source;
+    // which source, for SOURCE_REMOVED (session & ssrc) and SITE_ID (ssrc)
+    VPMSession* session;
+    uint32_t ssrc;
+    std::string siteID;
+
+    // how long it sat in the queue in ms, set when it's popped
+    double latency;
+
+private:
+    friend class SceneEventQueue;
+
+    double pushTime;
+    SceneEvent* next;
+};
+
+class SceneEventQueue
+{
+
+public:
+    SceneEventQueue();
+    // deletes anything that's still in it
+    ~SceneEventQueue();
+
+    /*
+     * Any thread. The queue owns the event until it's popped.
+     */
+    void push( SceneEvent* event );
+
+    /*
+     * Popping thread only. Returns the oldest event, which the caller then
+     * owns, or NULL if there isn't one ready.
+     */
+    SceneEvent* pop();
+
+    // pushed but not popped yet
+    int getBacklog();
+
+private:
+    // atomically make event the head, returning what was the head
+    SceneEvent* exchangeHead( SceneEvent* event );
+
+    // placeholder that keeps the list from ever being empty, so pushing never
+    // has to touch the tail
+    SceneEvent stub;
+
+    // newest event - swapped by the pushers. it & the next links are only
+    // touched with the __atomic builtins
+    SceneEvent* head;
+    // oldest event - only touched by the popper
+    SceneEvent* tail;
+
+    int backlog;
+
+};
+
+#endif /* SCENEEVENTQUEUE_H_ */
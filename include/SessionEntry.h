@@ -28,6 +28,8 @@
 #ifndef SESSIONENTRY_H_
 #define SESSIONENTRY_H_
 
+#include <vector>
+
 #include "RectangleBase.h"
 
 class VPMSessionListener;
@@ -63,6 +65,12 @@ public:
     uint32_t getTimestamp();
     VPMSession* getVPMSession();
 
+    /*
+     * The sockets the session is using, if they could be found (see
+     * SessionReactor) - empty if not, or if the session isn't enabled.
+     */
+    std::vector<int> getSocketFDs();
+
     bool iterate();
 
     void doubleClickAction();
@@ -87,6 +95,8 @@ private:
     VPMSession* session;
     uint32_t sessionTS;
 
+    std::vector<int> socketFDs;
+
 };
 
 #endif /* SESSIONENTRY_H_ */
@@ -0,0 +1,130 @@
+/*
+ * @file SessionExecutor.h
+ *
+ * Definition of the SessionExecutor class, which spreads the iterating of
+ * sessions (receiving packets & decoding) across a pool of threads, so one
+ * busy session doesn't hold up the rest and decoding isn't stuck on one core.
+ *
+ * Each session belongs to one worker. Rather than spinning on its sessions,
+ * a worker waits on their sockets (see SessionReactor) and only iterates the
+ * ones that have something to read - plus all of them every few ms, for
+ * whatever VPMedia does on a timer like RTCP. Sessions whose sockets aren't
+ * known get polled instead. Each session has its own lock that's held while
+ * it's being iterated, so taking one session out only has to wait for that
+ * session, not the whole worker or the rest of the pool.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SESSIONEXECUTOR_H_
+#define SESSIONEXECUTOR_H_
+
+#include <VPMedia/thread_helper.h>
+
+#include <map>
+#include <set>
+#include <vector>
+
+class SessionEntry;
+class SessionReactor;
+class VPMSession;
+class wxSemaphore;
+
+class SessionExecutor
+{
+
+public:
+    SessionExecutor( int numThreads );
+
+    /*
+     * Stops & joins the workers. The sessions themselves are left alone, so
+     * the caller can disable & delete them after.
+     */
+    ~SessionExecutor();
+
+    /*
+     * Start iterating an (initialized) session, on whichever worker has the
+     * fewest sessions.
+     */
+    void add( SessionEntry* entry );
+
+    /*
+     * Stop iterating a session. If its worker is in the middle of iterating it
+     * this waits for that to finish, so after this returns the session can be
+     * changed or deleted. Does nothing if the session wasn't added.
+     */
+    void remove( SessionEntry* entry );
+
+    /*
+     * The entry for a VPMSession that's being iterated, or NULL. Safe to call
+     * from anywhere, including the session listeners on the workers.
+     */
+    SessionEntry* find( VPMSession* session );
+
+    int getNumThreads();
+    int getSessionCount();
+
+private:
+    typedef struct
+    {
+        SessionEntry* entry;
+        // held while the entry is being iterated
+        mutex* busy;
+        // sockets to wait on - if empty, it gets polled
+        std::vector<int> fds;
+        // whether the sockets are being waited on. they aren't while the
+        // session isn't processing, since nothing would read them & the
+        // wait would keep coming right back
+        bool watching;
+    } Slot;
+
+    typedef struct
+    {
+        SessionExecutor* executor;
+        thread* handle;
+        // guards slots - only held long enough to pick the next one
+        mutex* listMutex;
+        std::vector<Slot*> slots;
+        // how many sessions it has, under registryMutex
+        int count;
+        SessionReactor* reactor;
+        // posted when a session is added (or on quit), so the worker can
+        // sleep on it while it has nothing to iterate
+        wxSemaphore* wake;
+    } Worker;
+
+    static void* workerThread( void* args );
+    void iterateLoop( Worker* worker );
+
+    // whether any of the slot's sockets are in ready
+    static bool isReady( Slot* slot, const std::set<int>& ready );
+
+    std::vector<Worker*> workers;
+    volatile bool quit;
+
+    // which worker each entry is on & the entries by VPMSession, under
+    // registryMutex. never held while waiting on a slot, since the session
+    // listeners (which run inside an iterate) look things up here
+    mutex* registryMutex;
+    std::map<SessionEntry*, Worker*> assignments;
+    std::map<VPMSession*, SessionEntry*> entries;
+
+};
+
+#endif /* SESSIONEXECUTOR_H_ */
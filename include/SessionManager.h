@@ -38,6 +38,7 @@ class SessionGroup;
 class SessionGroupButton;
 class SessionEntry;
 class ObjectManager;
+class SessionExecutor;
 
 #include <vector>
 
@@ -127,10 +128,21 @@ public:
     bool isEncryptionEnabled( std::string addr );
 
     /*
-     * Returns true if there were enabled sessions to iterate through.
+     * Returns true if there were enabled sessions to iterate through. Only for
+     * iterating on the caller's thread - does nothing once the threads below
+     * are started.
      */
     bool iterateSessions();
 
+    /*
+     * Start iterating sessions on their own pool of threads (see
+     * SessionExecutor), rather than through iterateSessions(). Stopping waits
+     * for the threads to finish.
+     */
+    void startThreads( int numThreads );
+    void stopThreads();
+    bool areThreadsRunning();
+
     int getVideoSessionCount();
     int getAudioSessionCount();
 
@@ -163,7 +175,9 @@ public:
     SessionEntry* findSessionByAddress( std::string address, SessionType type );
     /*
      * Alternate versions to find by encapsulated pointer, mostly just for
-     * VideoListener to identify sessions/pass to VideoSource.
+     * VideoListener to identify sessions/pass to VideoSource. The first one is
+     * thread safe while the session threads are running (since that's where
+     * the listeners get called from), as long as the session is enabled.
      */
     SessionEntry* findSessionByVPMSession( VPMSession* s );
     SessionEntry* findSessionByVPMSession( VPMSession* s, SessionType type );
@@ -214,7 +228,11 @@ private:
 
     mutex* sessionMutex;
     int lockCount;
-    bool pause;
+
+    // iterates the enabled sessions once the threads are started. note the
+    // session lock doesn't stop it - anything that changes an enabled
+    // session has to take it out of here first
+    SessionExecutor* executor;
 
 };
 
@@ -0,0 +1,88 @@
+/*
+ * @file SessionReactor.h
+ *
+ * Definition of the SessionReactor class, which lets a session thread sleep
+ * until one of its sessions' sockets has something to read, instead of
+ * spinning on iterate() for sessions that are mostly idle.
+ *
+ * VPMedia doesn't give out the sockets it uses, so they're found by looking
+ * at which datagram sockets appear while a session initializes that are
+ * bound to the session's RTP or RTCP port (see findSessionSockets()). Sessions
+ * whose sockets couldn't be found this way, or platforms without epoll, just
+ * get polled.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SESSIONREACTOR_H_
+#define SESSIONREACTOR_H_
+
+#include <set>
+#include <vector>
+
+class SessionReactor
+{
+
+public:
+    SessionReactor();
+    ~SessionReactor();
+
+    /*
+     * Start/stop watching sockets. Safe to call while another thread is in
+     * wait(). Sockets have to be removed before they're closed, so a new
+     * socket that reuses the number doesn't get confused for the old one.
+     */
+    void add( const std::vector<int>& fds );
+    void remove( const std::vector<int>& fds );
+
+    /*
+     * Wait up to timeoutMS for any of the sockets to be readable, adding the
+     * ones that are to ready. Returns whether any were. Without epoll, this
+     * just sleeps briefly (if the timeout isn't 0) and returns false.
+     */
+    bool wait( int timeoutMS, std::set<int>& ready );
+
+    // whether wait() can actually wait on sockets here
+    bool isAvailable();
+
+    /*
+     * All of the datagram sockets this process has open right now. Empty if
+     * that can't be found out on this platform.
+     */
+    static std::set<int> findDatagramSockets();
+
+    /*
+     * The sockets in after but not before that are bound to port (RTP) or
+     * port+1 (RTCP). Checking the port means a socket something else opened
+     * in between (another thread, say) doesn't get mistaken for the
+     * session's.
+     */
+    static std::vector<int> findSessionSockets( const std::set<int>& before,
+                                                const std::set<int>& after,
+                                                int port );
+
+    // the local port a socket is bound to, or -1 if it isn't an IP socket
+    static int getLocalPort( int fd );
+
+private:
+    int epollFD;
+
+};
+
+#endif /* SESSIONREACTOR_H_ */
@@ -0,0 +1,118 @@
+/*
+ * @file SpatialIndex.h
+ *
+ * Definition of the SpatialIndex class, which keeps the drawn objects in a
+ * uniform grid over their bounds so picking & box selection only have to
+ * look at the objects near the mouse, rather than all of them.
+ *
+ * Objects tell the index when they move or resize. Since they animate to
+ * their destinations, anything that's moved is kept aside and checked every
+ * time until it's done animating, then it goes back in the grid.
+ * Results come back in drawing order, topmost first, the same as walking the
+ * drawn objects list backwards.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPATIALINDEX_H_
+#define SPATIALINDEX_H_
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include <VPMedia/thread_helper.h>
+
+class RectangleBase;
+
+class SpatialIndex
+{
+
+public:
+    SpatialIndex();
+    ~SpatialIndex();
+
+    /*
+     * Add an object on top of everything else in the index. Objects have to
+     * be removed before they get deleted (RectangleBase's destructor does
+     * this).
+     */
+    void add( RectangleBase* obj );
+    void remove( RectangleBase* obj );
+
+    // move an object to the top of the order, for ObjectManager::moveToTop
+    void raise( RectangleBase* obj );
+
+    // called by objects when their position or size changes
+    void markMoved( RectangleBase* obj );
+
+    /*
+     * Fill results with every object whose current bounds might intersect
+     * the given rectangle, topmost first. These are candidates - the caller
+     * still has to do the exact intersect test.
+     */
+    void query( float L, float R, float U, float D,
+                std::vector<RectangleBase*>& results );
+
+    // how many objects are being checked every time since they're moving
+    int getMovingCount();
+
+private:
+    struct Entry
+    {
+        // position in the drawing order, higher is on top
+        unsigned int order;
+        bool inGrid;
+        bool oversized;
+        // range of cells it's in, if it's in the grid
+        int minX, maxX, minY, maxY;
+    };
+
+    typedef std::pair<int, int> Cell;
+
+    std::map<RectangleBase*, Entry> entries;
+    std::map<Cell, std::vector<RectangleBase*> > cells;
+    // objects that are animating or haven't been put in the grid yet
+    std::set<RectangleBase*> moving;
+    // objects covering too many cells to be worth putting in them
+    std::set<RectangleBase*> oversized;
+
+    unsigned int nextOrder;
+
+    // objects move from the network thread as well as the main one
+    mutex* indexMutex;
+
+    // put anything in the moving set that the Animator is done with back
+    // in the grid
+    void settle();
+
+    void insertCells( RectangleBase* obj, Entry& e );
+    void removeCells( RectangleBase* obj, Entry& e );
+
+    int toCell( float v );
+
+    struct OrderCompare
+    {
+        const std::map<RectangleBase*, Entry>* entries;
+        bool operator()( RectangleBase* a, RectangleBase* b ) const;
+    };
+
+};
+
+#endif /* SPATIALINDEX_H_ */
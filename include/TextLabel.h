@@ -0,0 +1,67 @@
+/*
+ * @file TextLabel.h
+ *
+ * Definition of the TextLabel class, which keeps a string laid out in the
+ * glyph atlas so it doesn't have to be laid out again every time it's drawn.
+ * The layout is only redone the next time it's needed after the text changes
+ * (or it gets marked dirty).
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TEXTLABEL_H_
+#define TEXTLABEL_H_
+
+#include <string>
+#include <vector>
+
+#include "GlyphAtlas.h"
+
+class TextLabel
+{
+
+public:
+    TextLabel();
+
+    // only marks it dirty if the text is actually different
+    void setText( const std::string& t );
+    const std::string& getText();
+
+    void markDirty();
+
+    /*
+     * Lay the text out again if it's dirty. Has to be called from the main
+     * thread, since new glyphs may need to be uploaded to the atlas.
+     */
+    void update( GlyphAtlas* atlas );
+
+    // as of the last update
+    const std::vector<GlyphQuad>& getQuads();
+    void getBounds( float& lx, float& ly, float& ux, float& uy );
+
+private:
+    std::string text;
+    bool dirty;
+
+    std::vector<GlyphQuad> quads;
+    float lowerX, lowerY, upperX, upperY;
+
+};
+
+#endif /* TEXTLABEL_H_ */
@@ -0,0 +1,97 @@
+/*
+ * @file UploadScheduler.h
+ *
+ * Definition of the UploadScheduler class, which limits how much video data
+ * gets pushed to the GPU in a single frame. Sources with a new frame ready
+ * are added each frame, then uploaded in priority order until the byte
+ * budget runs out; the rest keep their frames and try again next time.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef UPLOADSCHEDULER_H_
+#define UPLOADSCHEDULER_H_
+
+#include <map>
+#include <vector>
+
+class VideoSource;
+
+class UploadScheduler
+{
+
+public:
+    UploadScheduler();
+
+    /*
+     * Bytes of frame data to upload per frame, 0 for no limit. At least one
+     * upload always happens if anything is pending, so a frame bigger than
+     * the whole budget still gets through eventually.
+     */
+    void setBudget( unsigned int bytes );
+    unsigned int getBudget();
+
+    /*
+     * Queue up a source that has a frame ready for this draw. Priority
+     * sources (selected, focused, talking) go before everything else; the
+     * rest go least recently uploaded first, which works out to round-robin
+     * when everything is always pending.
+     */
+    void addPending( VideoSource* source, bool priority );
+
+    /*
+     * Do as many of the pending uploads as fit in the budget and clear the
+     * pending list. Call once per draw, after adding.
+     */
+    void uploadPending();
+
+    // forget about a source that's about to be deleted
+    void removeSource( VideoSource* source );
+
+    // stats from the last uploadPending, for the debug display
+    int getLastUploadCount();
+    int getLastDeferredCount();
+    unsigned int getLastUploadBytes();
+
+private:
+    typedef struct
+    {
+        VideoSource* source;
+        bool priority;
+        unsigned int size;
+        unsigned long lastUpload;
+    } PendingUpload;
+
+    static bool comparePending( const PendingUpload& a,
+                                const PendingUpload& b );
+
+    unsigned int budget;
+    std::vector<PendingUpload> pending;
+
+    // counts calls to uploadPending, and when each source last got uploaded
+    unsigned long frameNumber;
+    std::map<VideoSource*, unsigned long> lastUploads;
+
+    int lastUploadCount;
+    int lastDeferredCount;
+    unsigned int lastUploadBytes;
+
+};
+
+#endif /* UPLOADSCHEDULER_H_ */
@@ -0,0 +1,127 @@
+/*
+ * @file VideoFrameSink.h
+ *
+ * Definition of the VideoFrameSink class, the video sink grav hands to VPMedia
+ * decoders. Each decoded frame ends up in a FrameMailbox, so the renderer
+ * never has to take the sink's image lock. With a FramePipeline the decoder
+ * thread only copies the frame into the pipeline's queue, and the scaling and
+ * conversion happen on the pipeline's threads.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef VIDEOFRAMESINK_H_
+#define VIDEOFRAMESINK_H_
+
+#include <VPMedia/video/VPMVideoBufferSink.h>
+
+#include "VideoLayout.h"
+#include "FramePipeline.h"
+
+#include <vector>
+
+class FrameMailbox;
+class WorkerPool;
+
+class VideoFrameSink : public VPMVideoBufferSink
+{
+
+public:
+    /*
+     * If convertPool is given and format is YUV420, frames get converted to
+     * RGB24 by grav (split up across the pool) rather than by VPMedia, for
+     * when we can't use the YUV shader. If pipeline is given, frames are
+     * handled on its threads, through a queue holding at most queueDepth.
+     */
+    VideoFrameSink( VPMVideoFormat format, WorkerPool* convertPool = NULL,
+                    FramePipeline* pipeline = NULL, int queueDepth = 2 );
+    ~VideoFrameSink();
+
+    /*
+     * Initialises the underlying buffer sink and hooks up the new frame
+     * callback that feeds the mailbox.
+     */
+    bool initialise();
+
+    /*
+     * The mailbox outlives the sink if whoever gets it retains it, since
+     * VPMedia deletes the sink along with the decoder.
+     */
+    FrameMailbox* getMailbox();
+
+    /*
+     * The layout of the frames that end up in the mailbox - the decoder's
+     * own format, unless we're converting it.
+     */
+    const VideoLayout* getLayout();
+
+private:
+    /*
+     * Called on the decoder thread after each frame is decoded into the sink's
+     * buffer. The decoder thread is the only one that writes to that buffer
+     * and now the only one that reads it, so this doesn't take the image lock.
+     * The frame gets copied into the queue if there is one, or handled right
+     * here if not.
+     */
+    static void newFrameCallback( VPMVideoSink* sink, int bufferIndex,
+                                    void* data );
+
+    /*
+     * Gets a decoded frame into the mailbox. If the mailbox asks for a scale
+     * level the frame gets box-filtered down on the way in, which keeps that
+     * work off the render thread.
+     */
+    static void handleFrame( void* data, const unsigned char* src,
+                                unsigned int width, unsigned int height );
+
+    // pass the queue's stats on to whoever's reading the mailbox
+    void updateQueueState();
+
+    FrameMailbox* mailbox;
+
+    FramePipeline* pipeline;
+    FramePipeline::Queue* queue;
+    int queueDepth;
+
+    /*
+     * Downscales a frame in the decoder's layout by 2^level into dest, plane
+     * by plane.
+     */
+    void downscaleFrame( const unsigned char* src, unsigned int width,
+                            unsigned int height, int level,
+                            unsigned char* dest );
+
+    // what the decoder gives us, and what we give the mailbox
+    const VideoLayout* decodedLayout;
+    const VideoLayout* layout;
+
+    // intermediate buffer for downscaling, kept around between frames
+    std::vector<unsigned char> scratch;
+
+    bool convertToRGB;
+    WorkerPool* convertPool;
+    // downscaled YUV frame, when we're both downscaling and converting
+    std::vector<unsigned char> scaledFrame;
+
+    // don't downscale planes smaller than this (in either dimension)
+    static const unsigned int minScaledSize = 16;
+
+};
+
+#endif /* VIDEOFRAMESINK_H_ */
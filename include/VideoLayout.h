@@ -0,0 +1,103 @@
+/*
+ * @file VideoLayout.h
+ *
+ * Definition of the VideoLayout class, which describes how a decoded video
+ * frame is laid out in memory (number of planes, their sizes relative to the
+ * image and their bytes per pixel) and how each plane maps to a GL texture,
+ * plus which shader (if any) turns those textures into RGB. The layout for a
+ * stream is picked once when its source is created, and everything from the
+ * decoder callback to the texture upload just follows the description, so
+ * frames go to the GPU in the layout they were decoded in.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef VIDEOLAYOUT_H_
+#define VIDEOLAYOUT_H_
+
+#include <VPMedia/video/VPMVideoBufferSink.h>
+
+#include "GLUtil.h"
+
+class VideoLayout
+{
+
+public:
+    enum Type
+    {
+        NONE,
+        RGB24,
+        BGR24,
+        RGBA32,
+        BGRA32,
+        YUV420P,
+        YUV422P,
+        YUV444P,
+        NUM_TYPES
+    };
+
+    static const int maxPlanes = 3;
+
+    static const VideoLayout* get( Type t );
+
+    /*
+     * The layout a decoder format maps to if we can upload it as-is, or NONE
+     * if it has to be converted to something else first.
+     */
+    static Type fromVPMFormat( VPMVideoFormat format );
+
+    Type getType() const;
+    const char* getName() const;
+
+    int getNumPlanes() const;
+
+    /*
+     * Dimensions of a plane for an image of the given size - chroma planes
+     * are shifted down for subsampled formats.
+     */
+    unsigned int getPlaneWidth( int plane, unsigned int width ) const;
+    unsigned int getPlaneHeight( int plane, unsigned int height ) const;
+    unsigned int getBytesPerPixel( int plane ) const;
+
+    // where a plane starts in a tightly-packed frame, in bytes
+    unsigned int getPlaneOffset( int plane, unsigned int width,
+                                    unsigned int height ) const;
+    unsigned int getFrameSize( unsigned int width, unsigned int height ) const;
+
+    /*
+     * The format to allocate the plane's texture as, and the format its data
+     * is in when uploading (these differ for BGR, for instance).
+     */
+    GLenum getTextureFormat( int plane ) const;
+    GLenum getUploadFormat( int plane ) const;
+
+    // the program that needs to be bound to draw this, or PROGRAM_NONE
+    GLUtil::ShaderProgram getProgram() const;
+
+private:
+    VideoLayout( Type t );
+
+    // all the actual descriptions are in a table in the implementation
+    Type type;
+
+    static const VideoLayout layouts[ NUM_TYPES ];
+
+};
+
+#endif /* VIDEOLAYOUT_H_ */
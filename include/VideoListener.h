@@ -27,6 +27,7 @@
 #define VIDEOLISTENER_H_
 
 #include <VPMedia/VPMSession.h>
+#include <VPMedia/thread_helper.h>
 
 #include <sys/time.h>
 
@@ -35,6 +36,9 @@ class SessionManager;
 class VPMVideoSink;
 class GLCanvas;
 class wxStopWatch;
+class WorkerPool;
+class VideoSource;
+class FramePipeline;
 
 //static void newFrameCallbackTest( VPMVideoSink* sink, int buffer_idx,
 //                                void* user_data );
@@ -44,6 +48,7 @@ class VideoListener : public VPMSessionListener
 
 public:
     VideoListener( ObjectManager* o );
+    ~VideoListener();
     virtual void vpmsession_source_created( VPMSession &session,
                                           uint32_t ssrc,
                                           uint32_t pt,
@@ -60,6 +65,12 @@ public:
                                      const char *data,
                                      uint32_t data_len);
 
+    /*
+     * Called by ObjectManager on the main thread when it actually takes out
+     * a source that was deleted, to keep the counts below current.
+     */
+    void sourceRemoved( VideoSource* s );
+
     void setTimer( wxStopWatch* t );
     void setSessionManager( SessionManager* s );
 
@@ -67,6 +78,18 @@ public:
     long getPixelCount();
     void updatePixelCount( long mod );
 
+    // totals for the queues frames wait in between decoding and the mailbox
+    int getQueuedFrames();
+    unsigned int getQueueDroppedFrames();
+
+    // most threads to use for converting video to RGB, when we have to
+    static const int maxConvertThreads = 3;
+
+    // most threads to use for scaling/converting decoded frames, and how many
+    // frames each source can have waiting for them
+    static const int maxFrameThreads = 4;
+    static const int frameQueueDepth = 2;
+
 private:
     ObjectManager* objectMan;
     SessionManager* sessionMan;
@@ -79,7 +102,22 @@ private:
     float initialY;
 
     int sourceCount;
-    long pixelCount;
+    // changed from the session threads & the main thread, so atomic
+    volatile long pixelCount;
+
+    // sessions can be on different threads, so the callbacks above are
+    // serialized with this
+    mutex* listenerMutex;
+
+    // shared by all the sinks that convert to RGB - made the first time one
+    // is needed, since with shaders it never will be
+    WorkerPool* convertPool;
+    WorkerPool* getConvertPool();
+
+    // where the sinks' frames get handled, so the session threads can go
+    // back to receiving - made with the first source
+    FramePipeline* framePipeline;
+    FramePipeline* getFramePipeline();
 
 };
 
@@ -32,20 +32,43 @@
 #include <VPMedia/VPMedia_config.h>
 
 #include "RectangleBase.h"
+#include "VideoLayout.h"
 
 class VideoListener;
 class SessionEntry;
+class VideoFrameSink;
+class FrameMailbox;
 
 class VideoSource : public RectangleBase
 {
 
 public:
     VideoSource( SessionEntry* _session, VideoListener* l, uint32_t _ssrc,
-					VPMVideoBufferSink* vs, float x, float y );
+					VideoFrameSink* vs, float x, float y );
     ~VideoSource();
 
     void draw();
 
+    /*
+     * Picks up the newest frame from the decoder and gets the textures ready
+     * for it, but doesn't upload - ObjectManager does this for every source
+     * before drawing, then decides which ones get uploaded this frame. Returns
+     * true if there's a frame waiting to be uploaded.
+     */
+    bool pollFrame();
+
+    // bytes that upload() would push for the current frame
+    unsigned int getUploadSize();
+
+    /*
+     * Push the waiting frame to the textures. Returns false if it had to be
+     * skipped, in which case it's still waiting for the next pollFrame.
+     */
+    bool upload();
+
+    // also true if there's a new frame to show
+    bool needsRedraw();
+
     /*
      * Change the scale of the video to be native size
      * relative to the screen size.
@@ -69,6 +92,9 @@ public:
 
     const char* getPayloadDesc();
 
+    // name of the layout frames are uploaded in
+    const char* getLayoutName();
+
     /*
      * Gets the session this video comes from - we need to be able to check this
      * against the session in the delete callback, so we don't delete the wrong
@@ -79,6 +105,14 @@ public:
     unsigned int getVideoWidth();
     unsigned int getVideoHeight();
 
+    // frames the decoder published that got replaced before we drew them
+    unsigned int getDroppedFrames();
+
+    // frames waiting to be scaled/converted, and ones thrown away because too
+    // many were waiting
+    int getQueuedFrames();
+    unsigned int getQueueDroppedFrames();
+
     // overrides the functions from RectangleBase to account for aspect ratio
     float getWidth(); float getHeight();
     float getDestWidth(); float getDestHeight();
@@ -93,6 +127,32 @@ public:
     void setRendering( bool r );
     bool getRendering();
 
+    /*
+     * Visibility as classified by ObjectManager's visibility pass. Sources
+     * that stay hidden for a little while get their texture pushes suspended
+     * (and their decoding too, if suspendDecoding is set) until they come back
+     * into view. This is separate from, and applies on top of, the manual
+     * mute and rendering toggles above.
+     */
+    enum Visibility { VISIBLE, OCCLUDED, OFFSCREEN };
+    void setVisibility( Visibility v, bool suspendDecoding );
+    Visibility getVisibility();
+    bool isSuspended();
+
+    // whether the video currently fully covers whatever is behind it
+    bool isOpaque();
+
+    /*
+     * How tall the video is on screen in pixels, from ObjectManager's
+     * visibility pass - 0 if unknown. When the video is drawn at a fraction
+     * of its native size the decoder thread gets asked to downscale frames
+     * before they get to us, so we upload (and keep around) less.
+     */
+    void setScreenHeight( float h );
+
+    // how many times frames are currently being halved before upload
+    int getScaleLevel();
+
     // override RectangleBase::show to affect alpha usage for video rendering
     void show( bool s, bool instant );
 
@@ -114,8 +174,15 @@ private:
     // synchronization source, from rtp
     uint32_t ssrc;
 
-    // the source of the video data
-    VPMVideoBufferSink* videoSink;
+    // where the decoder thread leaves frames for us - note we don't keep the
+    // sink itself around, since VPMedia deletes it with the decoder
+    FrameMailbox* mailbox;
+
+    // whether the front frame in the mailbox still needs to be pushed
+    bool frameDirty;
+
+    // description of the decoder, grabbed on creation for the same reason
+    std::string payloadDesc;
 
     // alternate address for thumbnail (this) -> full stream
     std::string altAddress;
@@ -123,27 +190,103 @@ private:
     // original dimensions of the video
     unsigned int vwidth, vheight;
 
-    // original aspect ratio of the video
+    // how frames are laid out, and so how they map to textures & which shader
+    // draws them - comes from the sink, but follows the frames if it changes
+    const VideoLayout* layout;
+
+    // dimensions of the frames we're actually uploading - smaller than the
+    // above if they're being downscaled
+    unsigned int fwidth, fheight;
+
+    // original aspect ratio of the video - animates to the destination when
+    // the video changes size
     float aspect;
     float destAspect;
 
-    // override animate to animate aspect
-    void animateValues();
-    bool aspectAnimating;
-
     // remake the buffer when the video gets resized
     void resizeBuffer();
 
-    // dimensions rounded up to power of 2
+    // remake just the textures & pixel buffers for the front frame's size,
+    // for when the upload size changes but the video itself doesn't
+    void resizeTextures();
+
+    // pick the scale level for the current on-screen size and pass it on to
+    // the decoder side
+    void updateScaleLevel();
+
+    /*
+     * Push the front frame from the mailbox to the texture. Goes through the
+     * pixel buffer ring if PBOs are available, otherwise uploads directly.
+     * Returns false if the push had to be skipped for now.
+     */
+    bool uploadFrame();
+
+    /*
+     * Does the actual texture update for each plane of the current layout -
+     * data is either a pointer to the image or an offset into the bound PBO.
+     */
+    void pushTexture( const GLubyte* data );
+
+    // size in bytes of a frame in the current layout/dimensions
+    unsigned int getFrameSize();
+
+    // give the plane textures back to the GLUtil pool
+    void releaseTextures();
+
+    // (re)make the pixel buffer ring to fit frames of the current size
+    void resizePixelBuffers();
+    void releasePixelBuffers();
+
+    // dimensions of the (first) texture - the same as the frame dimensions,
+    // unless non-power-of-2 textures aren't available
     unsigned int tex_width, tex_height;
 
-    // GL texture identifier
-    GLuint texid;
+    // GL texture identifiers, one per plane of the layout - numPlanes is
+    // how many are currently allocated
+    static const int maxPlanes = VideoLayout::maxPlanes;
+    GLuint texids[ maxPlanes ];
+    int numPlanes;
+    // whether the textures have had one of our frames pushed to them yet -
+    // borrowed ones can still hold whatever their last owner left there
+    bool texturesFilled;
     bool init;
 
+    // ring of pixel unpack buffers for async texture uploads - the fences
+    // tell us when the GL is done reading from a buffer so we can write to it
+    // again without stalling
+    static const int numPixelBuffers = 3;
+    GLuint pixelBuffers[ numPixelBuffers ];
+    GLsync pixelBufferFences[ numPixelBuffers ];
+    int pixelBufferIndex;
+    unsigned int pixelBufferSize;
+
     // whether the texture push is enabled
     bool enableRendering;
 
+    // user-set mute state - the decoder can also be disabled by visibility
+    // suspension, so this is tracked separately from the VPMSession's state
+    bool muted;
+
+    Visibility visibility;
+    // consecutive visibility passes we've been hidden for, so things that
+    // just pass behind something briefly don't flicker on & off
+    int hiddenCount;
+    static const int suspendDelay = 15;
+    bool renderSuspended;
+    bool decodeSuspended;
+
+    // apply the mute & decode suspension state to the VPMSession
+    void updateSourceEnable();
+
+    float screenHeight;
+    int scaleLevel;
+    static const int maxScaleLevel = 3;
+    // like hiddenCount - scaling down waits until the video's been small for
+    // a while, so resize animations don't cause a bunch of reallocation.
+    // scaling back up is immediate
+    int scaleDownCount;
+    static const int scaleDownDelay = 30;
+
     // whether to apply color's alpha to video
     bool useAlpha;
 };
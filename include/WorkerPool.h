@@ -0,0 +1,95 @@
+/*
+ * @file WorkerPool.h
+ *
+ * Definition of the WorkerPool class, a small fixed set of threads for
+ * splitting a single piece of per-frame work (like a colour conversion) into
+ * bands that run in parallel.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WORKERPOOL_H_
+#define WORKERPOOL_H_
+
+#include <VPMedia/thread_helper.h>
+
+#include <vector>
+
+class wxSemaphore;
+
+class WorkerPool
+{
+
+public:
+    /*
+     * Jobs get called once per piece, with index in [0, count).
+     */
+    typedef void (*Job)( void* data, int index, int count );
+
+    /*
+     * Starts numThreads worker threads. The thread calling run() does a share
+     * of the work too, so a pool of N threads splits jobs N+1 ways.
+     */
+    WorkerPool( int numThreads );
+    ~WorkerPool();
+
+    /*
+     * Runs job over count pieces spread across the workers and the calling
+     * thread, returning once all of them are done. Calls from different
+     * threads are serialized.
+     */
+    void run( Job job, void* data, int count );
+
+    int getNumThreads();
+
+    /*
+     * A reasonable pool size for this machine - one less than the number of
+     * CPUs (since the caller works too), capped at maxThreads.
+     */
+    static int getDefaultSize( int maxThreads );
+
+private:
+    typedef struct
+    {
+        WorkerPool* pool;
+        int id;
+        thread* handle;
+        wxSemaphore* wake;
+    } Worker;
+
+    static void* workerThread( void* args );
+
+    // do the pieces for worker slot id (0 is the calling thread)
+    void doPieces( int id );
+
+    std::vector<Worker> workers;
+    wxSemaphore* done;
+    volatile bool quit;
+
+    // the current job - only written by run() while all workers are idle
+    Job job;
+    void* jobData;
+    int jobCount;
+
+    // serializes run()
+    mutex* runMutex;
+
+};
+
+#endif /* WORKERPOOL_H_ */
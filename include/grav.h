@@ -3,7 +3,8 @@
  *
  * Header file for main grav app - contains the definition for the main class,
  * which acts as the main WX app/controller and OnInit() which acts as the
- * main().
+ * main() (except for headless runs, which start from a main() of their own
+ * so they don't need a display).
  *
  * @author Andrew Ford
  * Copyright (C) 2011 Rochester Institute of Technology
@@ -55,7 +56,18 @@ class gravApp : public wxApp
 public:
 
     static bool threadDebug;
-    static int threadCounter;
+
+    /**
+     * Whether the command line asks for a headless run - checked before wx
+     * is set up, since those skip the GUI init entirely.
+     */
+    static bool isHeadlessRun( int argc, char** argv );
+
+    /**
+     * Entry for headless runs, once wx is set up as a console app. Returns
+     * the exit code.
+     */
+    int headlessMain();
 
 private:
 
@@ -69,6 +81,13 @@ private:
 
     void idleHandler( wxIdleEvent& evt );
 
+    /**
+     * The setup both OnInit & headlessMain need: parses the arguments, then
+     * makes the object & session managers. Returns false if the app should
+     * exit instead of going on.
+     */
+    bool initCommon();
+
     /**
      * Parse the command line arguments and set options accordingly.
      * Primarily for setting the video/audio/etc addresses.
@@ -81,14 +100,18 @@ private:
      */
     void mapRTP();
 
-    static void* threadTest( void* args );
-    bool isThreadRunning();
     /**
-     * Calls iterate sessions on the session manager, but also sleeps if there
-     * was no iteration (to avoid CPU spin). Used when sessions are on separate
-     * thread.
+     * Load the earth (& its tiles, if there are any).
      */
-    void iterateSessions();
+    void createEarth();
+
+    /**
+     * Render a fixed number of frames offscreen with no windows, logging
+     * how long each one took, for benchmarking on machines without a
+     * display. Cleans up everything itself after, since OnExit never runs
+     * in this mode. Returns false if it couldn't render.
+     */
+    bool runHeadless();
 
     wxCmdLineParser parser;
 
@@ -118,7 +141,7 @@ private:
 
     bool usingThreads;
     bool threadRunning;
-    thread* VPMthread;
+    long int sessionThreads;
 
     bool verbose;
     bool VPMverbose;
@@ -147,8 +170,21 @@ private:
     bool gridAuto;
 
     bool enableShaders;
+    bool enablePixelBuffers;
+    bool convertBenchmark;
+    long int headlessFrames;
+    std::string headlessDumpPrefix;
+    bool haveHeadlessDump;
     bool bufferFont;
 
+    bool visibilityCulling;
+    bool suspendHiddenDecoding;
+    bool uploadDownscaling;
+    // in KB
+    long int uploadBudget;
+    // in ms
+    long int maxRedrawInterval;
+
     bool startFullscreen;
 
     bool getAGVenueStreams;
@@ -160,6 +196,11 @@ private:
     std::string thumbnailFile;
     bool haveThumbnailFile;
 
+    std::string earthTileFile;
+    bool haveEarthTileFile;
+    // in MB
+    long int earthTileBudget;
+
 };
 
 static const wxCmdLineEntryDesc cmdLineDesc[] =
@@ -195,6 +236,13 @@ static const wxCmdLineEntryDesc cmdLineDesc[] =
             _("disables threading separation of graphics and network/decoding")
     },
 
+    {
+        wxCMD_LINE_OPTION, _("st"), _("session-threads"),
+            _("number of threads to spread network/decoding over (default "
+              "one less than the number of CPUs, up to 4)"),
+            wxCMD_LINE_VAL_NUMBER
+    },
+
     {
         wxCMD_LINE_SWITCH, _("np"), _("no-python"),
             _("disables python tools, including Access Grid integration")
@@ -207,6 +255,62 @@ static const wxCmdLineEntryDesc cmdLineDesc[] =
               "to rendering thread)")
     },
 
+    {
+        wxCMD_LINE_SWITCH, _("npbo"), _("no-pixel-buffers"),
+            _("disable asynchronous video texture uploads via pixel buffer "
+              "objects, even if they would be available")
+    },
+
+    {
+        wxCMD_LINE_SWITCH, _("cb"), _("convert-benchmark"),
+            _("time the CPU YUV to RGB conversion used when shaders aren't "
+              "available, then exit")
+    },
+
+    {
+        wxCMD_LINE_OPTION, _("hl"), _("headless"),
+            _("render this many frames offscreen with no window (at the "
+              "start width/height), log how long each took, then exit"),
+            wxCMD_LINE_VAL_NUMBER
+    },
+
+    {
+        wxCMD_LINE_OPTION, _("hld"), _("headless-dump"),
+            _("with --headless, also save each frame as "
+              "[prefix]00000.ppm etc."), wxCMD_LINE_VAL_STRING
+    },
+
+    {
+        wxCMD_LINE_SWITCH, _("nvc"), _("no-visibility-culling"),
+            _("keep updating video textures even when they're off-screen, "
+              "covered or too small to see")
+    },
+
+    {
+        wxCMD_LINE_SWITCH, _("shd"), _("suspend-hidden-decoding"),
+            _("also stop decoding videos while they're not visible (saves CPU, "
+              "but they may take a moment to reappear)")
+    },
+
+    {
+        wxCMD_LINE_SWITCH, _("nds"), _("no-upload-downscaling"),
+            _("always upload video at full resolution, even when it's drawn "
+              "much smaller than that")
+    },
+
+    {
+        wxCMD_LINE_OPTION, _("ub"), _("upload-budget"),
+            _("max KB of video to upload to the GPU per frame (0 for no "
+              "limit, default 16384)"), wxCMD_LINE_VAL_NUMBER
+    },
+
+    {
+        wxCMD_LINE_OPTION, _("mri"), _("max-redraw-interval"),
+            _("when nothing on screen is changing, skip drawing for up to this "
+              "many ms (0 to always draw, default 500)"),
+            wxCMD_LINE_VAL_NUMBER
+    },
+
     {
         wxCMD_LINE_SWITCH, _("bf"), _("use-buffer-font"),
             _("enable buffer font rendering method - may save memory and be "
@@ -258,6 +362,18 @@ static const wxCmdLineEntryDesc cmdLineDesc[] =
             wxCMD_LINE_VAL_STRING
     },
 
+    {
+        wxCMD_LINE_OPTION, _("et"), _("earth-tiles"),
+            _("tiles.txt of a tile set to use for a sharper earth when zoomed "
+              "in"), wxCMD_LINE_VAL_STRING
+    },
+
+    {
+        wxCMD_LINE_OPTION, _("etb"), _("earth-tile-budget"),
+            _("max MB of GPU memory to use for earth tiles (default 64)"),
+            wxCMD_LINE_VAL_NUMBER
+    },
+
     {
         wxCMD_LINE_SWITCH, _("agvs"), _("get-ag-venue-streams"),
             _("grab video sessions from Access Grid venue client, if running")
@@ -295,13 +411,13 @@ static const wxCmdLineEntryDesc cmdLineDesc[] =
 
     {
         wxCMD_LINE_OPTION, _("sw"), _("start-width"),
-            _("initial width for main window"),
+            _("initial width for main window (or headless frames)"),
             wxCMD_LINE_VAL_NUMBER
     },
 
     {
         wxCMD_LINE_OPTION, _("sh"), _("start-height"),
-            _("initial height for main window"),
+            _("initial height for main window (or headless frames)"),
             wxCMD_LINE_VAL_NUMBER
     },
 
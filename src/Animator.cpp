@@ -0,0 +1,238 @@
+/*
+ * @file Animator.cpp
+ *
+ * Implementation of the Animator class. See Animator.h for details.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Animator.h"
+
+#include <algorithm>
+#include <cmath>
+
+// values closer than this to their destination snap to it, since they'd
+// never quite get there otherwise
+static const float snapDistance = 0.01f;
+
+// the divisors are per 60th of a second
+static const float stepsPerSecond = 60.0f;
+
+Animator* Animator::instance = NULL;
+
+Animator* Animator::getInstance()
+{
+    if ( instance == NULL )
+    {
+        instance = new Animator();
+    }
+    return instance;
+}
+
+void Animator::cleanup()
+{
+    if ( instance )
+    {
+        delete instance;
+        instance = NULL;
+    }
+}
+
+Animator::Animator()
+{
+    animMutex = mutex_create();
+    haveLastUpdate = false;
+    fixedStep = 0.0f;
+}
+
+Animator::~Animator()
+{
+    mutex_free( animMutex );
+}
+
+void Animator::animate( void* owner, float* value, const float* dest,
+                        float divisor )
+{
+    // anything below 1 would overshoot
+    if ( divisor < 1.0f )
+        divisor = 1.0f;
+
+    mutex_lock( animMutex );
+
+    std::map<float*, unsigned int>::iterator i = indices.find( value );
+    if ( i != indices.end() )
+    {
+        dests[ i->second ] = dest;
+        divisors[ i->second ] = divisor;
+        if ( owners[ i->second ] != owner )
+        {
+            removeOwner( owners[ i->second ] );
+            addOwner( owner );
+            owners[ i->second ] = owner;
+        }
+    }
+    else
+    {
+        indices[ value ] = values.size();
+        values.push_back( value );
+        dests.push_back( dest );
+        divisors.push_back( divisor );
+        owners.push_back( owner );
+        addOwner( owner );
+    }
+
+    mutex_unlock( animMutex );
+}
+
+void Animator::stop( void* owner )
+{
+    mutex_lock( animMutex );
+
+    for ( int i = (int)owners.size() - 1; i >= 0; i-- )
+    {
+        if ( owners[i] == owner )
+            remove( i );
+    }
+
+    mutex_unlock( animMutex );
+}
+
+void Animator::update()
+{
+    timeval now;
+    gettimeofday( &now, NULL );
+
+    // if nothing was animating last time, the time since then doesn't count -
+    // just do one step's worth
+    float steps = 1.0f;
+    if ( fixedStep > 0.0f )
+    {
+        steps = fixedStep * stepsPerSecond;
+    }
+    else if ( haveLastUpdate )
+    {
+        float elapsed = (float)( now.tv_sec - lastUpdate.tv_sec ) +
+            (float)( now.tv_usec - lastUpdate.tv_usec ) / 1000000.0f;
+        steps = std::max( 0.0f, elapsed * stepsPerSecond );
+    }
+
+    mutex_lock( animMutex );
+
+    unsigned int num = values.size();
+    current.resize( num );
+    target.resize( num );
+    keep.resize( num );
+
+    // most things share a few rates, so only work out the fraction that's
+    // left after this step when the rate changes
+    float lastDivisor = 0.0f;
+    float lastKeep = 0.0f;
+    for ( unsigned int i = 0; i < num; i++ )
+    {
+        current[i] = *values[i];
+        target[i] = *dests[i];
+        if ( divisors[i] != lastDivisor )
+        {
+            lastDivisor = divisors[i];
+            lastKeep = pow( 1.0f - ( 1.0f / lastDivisor ), steps );
+        }
+        keep[i] = lastKeep;
+    }
+
+    for ( unsigned int i = 0; i < num; i++ )
+        current[i] = target[i] - ( ( target[i] - current[i] ) * keep[i] );
+
+    // backwards, so removing (which swaps in the last one) doesn't skip any
+    for ( int i = (int)num - 1; i >= 0; i-- )
+    {
+        if ( fabs( target[i] - current[i] ) < snapDistance )
+        {
+            *values[i] = target[i];
+            remove( i );
+        }
+        else
+        {
+            *values[i] = current[i];
+        }
+    }
+
+    haveLastUpdate = !values.empty();
+    lastUpdate = now;
+
+    mutex_unlock( animMutex );
+}
+
+void Animator::setFixedStep( float seconds )
+{
+    fixedStep = seconds;
+}
+
+bool Animator::isAnimating()
+{
+    return getActiveCount() > 0;
+}
+
+int Animator::getActiveCount()
+{
+    mutex_lock( animMutex );
+    int count = values.size();
+    mutex_unlock( animMutex );
+    return count;
+}
+
+bool Animator::isAnimating( void* owner )
+{
+    mutex_lock( animMutex );
+    bool animating = ownerCounts.find( owner ) != ownerCounts.end();
+    mutex_unlock( animMutex );
+    return animating;
+}
+
+void Animator::remove( unsigned int i )
+{
+    unsigned int last = values.size() - 1;
+    indices.erase( values[i] );
+    removeOwner( owners[i] );
+
+    if ( i != last )
+    {
+        values[i] = values[ last ];
+        dests[i] = dests[ last ];
+        divisors[i] = divisors[ last ];
+        owners[i] = owners[ last ];
+        indices[ values[i] ] = i;
+    }
+
+    values.pop_back();
+    dests.pop_back();
+    divisors.pop_back();
+    owners.pop_back();
+}
+
+void Animator::addOwner( void* owner )
+{
+    ownerCounts[ owner ]++;
+}
+
+void Animator::removeOwner( void* owner )
+{
+    std::map<void*, int>::iterator i = ownerCounts.find( owner );
+    if ( i != ownerCounts.end() && --i->second == 0 )
+        ownerCounts.erase( i );
+}
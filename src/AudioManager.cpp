@@ -35,12 +35,12 @@
 
 AudioManager::AudioManager()
 {
-
+    sourceMutex = mutex_create();
 }
 
 AudioManager::~AudioManager()
 {
-
+    mutex_free( sourceMutex );
 }
 
 float AudioManager::getLevel( std::string name, bool avg, bool cnames )
@@ -51,6 +51,7 @@ float AudioManager::getLevel( std::string name, bool avg, bool cnames )
     float temp = 0.0f;
     int count = 0;
 
+    mutex_lock( sourceMutex );
     for ( unsigned int i = 0; i < sources.size(); i++ )
     {
         if ( ( !cnames && sources[i]->siteID.compare( name ) == 0 ) ||
@@ -68,6 +69,7 @@ float AudioManager::getLevel( std::string name, bool avg, bool cnames )
         }
         // would fall to else clause if name was not found
     }
+    mutex_unlock( sourceMutex );
 
     if ( count == 1 )
         return temp;
@@ -84,21 +86,27 @@ float AudioManager::getLevelAvg( std::string name )
 
 void AudioManager::printLevels()
 {
+    mutex_lock( sourceMutex );
     for ( unsigned int i = 0; i < sources.size(); i++ )
     {
         gravUtil::logVerbose( "AudioManager::printLevels: "
                 "source: 0x%08x/%s: %f\n", sources[i]->ssrc,
                 sources[i]->siteID.c_str(), sources[i]->meter->level() );
     }
+    mutex_unlock( sourceMutex );
 }
 
 unsigned int AudioManager::getSourceCount()
 {
-    return sources.size();
+    mutex_lock( sourceMutex );
+    unsigned int ret = sources.size();
+    mutex_unlock( sourceMutex );
+    return ret;
 }
 
 void AudioManager::updateNames()
 {
+    mutex_lock( sourceMutex );
     for ( unsigned int i = 0; i < sources.size(); i++ )
     {
         char buffer[256];
@@ -110,6 +118,7 @@ void AudioManager::updateNames()
             sources[i]->cName = std::string( buffer );
         }
     }
+    mutex_unlock( sourceMutex );
 }
 
 void AudioManager::vpmsession_source_created( VPMSession &session,
@@ -131,7 +140,9 @@ void AudioManager::vpmsession_source_created( VPMSession &session,
 
         dec->connectAudioProcessor( m );
 
+        mutex_lock( sourceMutex );
         sources.push_back( a );
+        mutex_unlock( sourceMutex );
         gravUtil::logVerbose( "AudioManager::vpmsession_source_created: "
                 "source added\n" );
     }
@@ -146,6 +157,7 @@ void AudioManager::vpmsession_source_deleted( VPMSession &session,
 {
     gravUtil::logVerbose( "AudioManager::vpmsession_source_deleted: "
             "deleting source ssrc: 0x%08x\n", ssrc );
+    mutex_lock( sourceMutex );
     std::vector<AudioSource*>::iterator it;
     for ( it = sources.begin(); it != sources.end(); ++it )
     {
@@ -154,9 +166,10 @@ void AudioManager::vpmsession_source_deleted( VPMSession &session,
             delete (*it)->meter;
             delete (*it);
             sources.erase( it );
-            return;
+            break;
         }
     }
+    mutex_unlock( sourceMutex );
 }
 
 void AudioManager::vpmsession_source_description( VPMSession &session,
@@ -181,6 +194,7 @@ void AudioManager::vpmsession_source_app(VPMSession &session,
 
     if ( appS.compare( "site" ) == 0 )
     {
+        mutex_lock( sourceMutex );
         for ( unsigned int i = 0; i < sources.size(); i++ )
         {
             if ( sources[i]->ssrc == ssrc )
@@ -188,5 +202,6 @@ void AudioManager::vpmsession_source_app(VPMSession &session,
                 sources[i]->siteID = dataS;
             }
         }
+        mutex_unlock( sourceMutex );
     }
 }
@@ -0,0 +1,609 @@
+/*
+ * @file BatchRenderer.cpp
+ *
+ * Implementation of the BatchRenderer class. See BatchRenderer.h for details.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "BatchRenderer.h"
+#include "TextLabel.h"
+
+#include <algorithm>
+#include <cstring>
+
+bool BatchRenderer::State::operator==( const State& other ) const
+{
+    if ( primitive != other.primitive || numTextures != other.numTextures ||
+            program != other.program || blend != other.blend )
+        return false;
+
+    for ( int i = 0; i < numTextures; i++ )
+    {
+        if ( textures[i] != other.textures[i] )
+            return false;
+    }
+
+    if ( program != GLUtil::PROGRAM_NONE && programAlpha != other.programAlpha )
+        return false;
+
+    if ( primitive == GL_LINES && ( lineWidth != other.lineWidth ||
+            smooth != other.smooth ) )
+        return false;
+
+    return true;
+}
+
+BatchRenderer::BatchRenderer( bool vbo )
+{
+    useVertexBuffers = vbo;
+    vertexBuffer = 0;
+    vertexBufferSize = 0;
+    if ( useVertexBuffers )
+        glGenBuffers( 1, &vertexBuffer );
+
+    recording = false;
+    numBatches = 0;
+    batchCount = 0;
+    lastBatchCount = 0;
+    pixelWidth = 0.0f;
+    pixelHeight = 0.0f;
+
+    reset();
+}
+
+BatchRenderer::~BatchRenderer()
+{
+    if ( vertexBuffer != 0 )
+        glDeleteBuffers( 1, &vertexBuffer );
+}
+
+void BatchRenderer::begin()
+{
+    // the camera, as GLUtil last set it
+    GLUtil* glUtil = GLUtil::getInstance();
+    GLint viewport[4];
+    glUtil->getViewport( viewport );
+    viewProjection = glUtil->getProjection() * glUtil->getModelview();
+
+    // size of a pixel in device coordinates, for padding bounds
+    pixelWidth = viewport[2] > 0 ? 2.0f / (float)viewport[2] : 0.0f;
+    pixelHeight = viewport[3] > 0 ? 2.0f / (float)viewport[3] : 0.0f;
+
+    recording = true;
+    batchCount = 0;
+}
+
+void BatchRenderer::end()
+{
+    flush();
+    recording = false;
+    lastBatchCount = batchCount;
+}
+
+void BatchRenderer::flush()
+{
+    if ( numBatches == 0 )
+        return;
+
+    // lay everything out in batch order, so each batch is one range
+    vertexData.clear();
+    for ( int i = 0; i < numBatches; i++ )
+    {
+        Batch& b = batches[i];
+        b.first = vertexData.size();
+        vertexData.insert( vertexData.end(), b.vertices.begin(),
+                            b.vertices.end() );
+    }
+
+    const GLubyte* base = NULL;
+    if ( !vertexData.empty() )
+    {
+        unsigned int size = vertexData.size() * sizeof( Vertex );
+        if ( useVertexBuffers )
+        {
+            // respecify the whole buffer every time so the driver can give
+            // us new storage rather than wait on the last draw from it
+            glBindBuffer( GL_ARRAY_BUFFER, vertexBuffer );
+            if ( size > vertexBufferSize )
+                vertexBufferSize = size;
+            glBufferData( GL_ARRAY_BUFFER, vertexBufferSize, NULL,
+                            GL_STREAM_DRAW );
+            glBufferSubData( GL_ARRAY_BUFFER, 0, size, &vertexData[0] );
+        }
+        else
+        {
+            base = (const GLubyte*)&vertexData[0];
+        }
+
+        glTexCoordPointer( 2, GL_FLOAT, sizeof( Vertex ), base );
+        glColorPointer( 4, GL_FLOAT, sizeof( Vertex ),
+                        base + 2 * sizeof( GLfloat ) );
+        glVertexPointer( 3, GL_FLOAT, sizeof( Vertex ),
+                        base + 6 * sizeof( GLfloat ) );
+    }
+
+    bool arraysEnabled = false;
+    for ( int i = 0; i < numBatches; i++ )
+    {
+        Batch& b = batches[i];
+        bool text = ( b.state.primitive == GL_NONE );
+
+        // without the atlas, text is drawn by the font in immediate mode, so
+        // keep the arrays out of its way
+        if ( text == arraysEnabled )
+        {
+            if ( text )
+            {
+                glDisableClientState( GL_TEXTURE_COORD_ARRAY );
+                glDisableClientState( GL_COLOR_ARRAY );
+                glDisableClientState( GL_VERTEX_ARRAY );
+            }
+            else
+            {
+                glEnableClientState( GL_TEXTURE_COORD_ARRAY );
+                glEnableClientState( GL_COLOR_ARRAY );
+                glEnableClientState( GL_VERTEX_ARRAY );
+            }
+            arraysEnabled = !text;
+        }
+
+        applyState( b.state );
+
+        if ( text )
+        {
+            FTFont* font = GLUtil::getInstance()->getMainFont();
+            for ( unsigned int j = 0; j < b.texts.size(); j++ )
+            {
+                TextItem& item = b.texts[j];
+                glPushMatrix();
+                glMultMatrixf( item.matrix );
+                glColor4f( item.r, item.g, item.b, item.a );
+                font->Render( item.text.c_str() );
+                glPopMatrix();
+            }
+        }
+        else
+        {
+            glDrawArrays( b.state.primitive, b.first, b.vertices.size() );
+        }
+
+        clearState( b.state );
+    }
+
+    if ( arraysEnabled )
+    {
+        glDisableClientState( GL_TEXTURE_COORD_ARRAY );
+        glDisableClientState( GL_COLOR_ARRAY );
+        glDisableClientState( GL_VERTEX_ARRAY );
+    }
+    if ( useVertexBuffers )
+        glBindBuffer( GL_ARRAY_BUFFER, 0 );
+
+    numBatches = 0;
+}
+
+void BatchRenderer::reset()
+{
+    transform.loadIdentity();
+    color[0] = color[1] = color[2] = color[3] = 1.0f;
+
+    current.primitive = GL_QUADS;
+    current.numTextures = 0;
+    for ( int i = 0; i < maxTextures; i++ )
+        current.textures[i] = 0;
+    current.program = GLUtil::PROGRAM_NONE;
+    current.programAlpha = 1.0f;
+    current.blend = false;
+    current.lineWidth = 1.0f;
+    current.smooth = false;
+}
+
+void BatchRenderer::translate( float x, float y, float z )
+{
+    transform.translate( x, y, z );
+}
+
+void BatchRenderer::rotate( float angle, float x, float y, float z )
+{
+    transform.rotate( angle, x, y, z );
+}
+
+void BatchRenderer::setColor( float r, float g, float b, float a )
+{
+    color[0] = r; color[1] = g; color[2] = b; color[3] = a;
+}
+
+void BatchRenderer::setTextures( int num, const GLuint* ids )
+{
+    if ( num > maxTextures )
+        num = maxTextures;
+    current.numTextures = num;
+    for ( int i = 0; i < num; i++ )
+        current.textures[i] = ids[i];
+}
+
+void BatchRenderer::setProgram( GLUtil::ShaderProgram p, float alpha )
+{
+    current.program = p;
+    current.programAlpha = alpha;
+}
+
+void BatchRenderer::setBlend( bool b )
+{
+    current.blend = b;
+}
+
+void BatchRenderer::setLineWidth( float w, bool smooth )
+{
+    current.lineWidth = w;
+    current.smooth = smooth;
+}
+
+void BatchRenderer::addQuad( float l, float d, float r, float u,
+                                float s, float t )
+{
+    GLfloat points[] = { l, d,  l, u,  r, u,  r, d };
+    GLfloat texCoords[] = { 0.0f, 0.0f,  0.0f, t,  s, t,  s, 0.0f };
+    addVertices( GL_QUADS, points, 4, texCoords );
+}
+
+void BatchRenderer::addLine( float x1, float y1, float x2, float y2 )
+{
+    GLfloat points[] = { x1, y1,  x2, y2 };
+    addVertices( GL_LINES, points, 2, NULL );
+}
+
+void BatchRenderer::addTriangle( float x1, float y1, float x2, float y2,
+                                    float x3, float y3 )
+{
+    GLfloat points[] = { x1, y1,  x2, y2,  x3, y3 };
+    addVertices( GL_TRIANGLES, points, 3, NULL );
+}
+
+void BatchRenderer::addText( const std::string& text, float x, float y,
+                                float scale )
+{
+    GlyphAtlas* atlas = GLUtil::getInstance()->getTextAtlas();
+    if ( atlas != NULL )
+    {
+        float lx, ly, ux, uy;
+        scratchGlyphs.clear();
+        atlas->layout( text, scratchGlyphs, lx, ly, ux, uy );
+        addGlyphs( scratchGlyphs, lx, ly, ux, uy, x, y, scale );
+        return;
+    }
+
+    FTFont* font = GLUtil::getInstance()->getMainFont();
+    if ( font == NULL )
+        return;
+
+    TextItem item;
+    item.text = text;
+    item.r = color[0]; item.g = color[1];
+    item.b = color[2]; item.a = color[3];
+    getTextMatrix( x, y, scale, item.matrix );
+
+    float l = 0.0f, r = 0.0f, d = 0.0f, u = 0.0f;
+    bool bounded = false;
+    if ( recording )
+    {
+        FTBBox box = font->BBox( text.c_str() );
+        float lx = box.Lower().Xf(), ly = box.Lower().Yf();
+        float ux = box.Upper().Xf(), uy = box.Upper().Yf();
+        GLfloat corners[] = { lx, ly,  lx, uy,  ux, uy,  ux, ly };
+        GLfloat world[12];
+        for ( int i = 0; i < 4; i++ )
+        {
+            for ( int j = 0; j < 3; j++ )
+                world[ i*3 + j ] = item.matrix[ j ] * corners[ i*2 ] +
+                    item.matrix[ 4 + j ] * corners[ i*2 + 1 ] +
+                    item.matrix[ 12 + j ];
+        }
+        bounded = project( world, 4, l, r, d, u );
+    }
+
+    Batch* b = findBatch( GL_NONE, l, r, d, u, !bounded );
+    b->texts.push_back( item );
+
+    if ( !recording )
+        flush();
+}
+
+void BatchRenderer::addLabel( TextLabel& label, float x, float y,
+                                float scale )
+{
+    GlyphAtlas* atlas = GLUtil::getInstance()->getTextAtlas();
+    if ( atlas == NULL )
+    {
+        addText( label.getText(), x, y, scale );
+        return;
+    }
+
+    label.update( atlas );
+    float lx, ly, ux, uy;
+    label.getBounds( lx, ly, ux, uy );
+    addGlyphs( label.getQuads(), lx, ly, ux, uy, x, y, scale );
+}
+
+int BatchRenderer::getLastBatchCount()
+{
+    return lastBatchCount;
+}
+
+BatchRenderer::Batch* BatchRenderer::findBatch( GLenum primitive, float l,
+                                float r, float d, float u, bool unbounded )
+{
+    State key = current;
+    key.primitive = primitive;
+    // text ignores these, so don't let them keep it from joining other text
+    if ( primitive == GL_NONE )
+    {
+        key.numTextures = 0;
+        key.program = GLUtil::PROGRAM_NONE;
+    }
+
+    // pad by a pixel for filtering/rasterization at the edges, and by half
+    // the line width for lines
+    float pad = 1.0f;
+    if ( primitive == GL_LINES )
+        pad += current.lineWidth / 2.0f;
+    l -= pad * pixelWidth; r += pad * pixelWidth;
+    d -= pad * pixelHeight; u += pad * pixelHeight;
+
+    // go back through the batches until one we can join, stopping at anything
+    // we'd end up getting drawn underneath if we went past it
+    int stop = std::max( 0, numBatches - maxLookback );
+    for ( int i = numBatches - 1; i >= stop; i-- )
+    {
+        Batch& b = batches[i];
+        if ( b.state == key )
+        {
+            if ( unbounded )
+            {
+                b.unbounded = true;
+            }
+            else
+            {
+                b.left = std::min( b.left, l );
+                b.right = std::max( b.right, r );
+                b.bottom = std::min( b.bottom, d );
+                b.top = std::max( b.top, u );
+            }
+            return &b;
+        }
+
+        if ( unbounded || b.unbounded || ( l <= b.right && r >= b.left &&
+                d <= b.top && u >= b.bottom ) )
+            break;
+    }
+
+    if ( numBatches == (int)batches.size() )
+        batches.push_back( Batch() );
+    Batch& b = batches[ numBatches++ ];
+    b.state = key;
+    b.left = l; b.right = r;
+    b.bottom = d; b.top = u;
+    b.unbounded = unbounded;
+    b.vertices.clear();
+    b.texts.clear();
+    batchCount++;
+    return &b;
+}
+
+void BatchRenderer::getTextMatrix( float x, float y, float scale,
+                                    GLfloat* matrix )
+{
+    // same as translating to x,y then scaling
+    memcpy( matrix, transform.get(), sizeof( GLfloat ) * 16 );
+    for ( int r = 0; r < 4; r++ )
+    {
+        matrix[ 12 + r ] += transform[ r ] * x + transform[ 4 + r ] * y;
+        matrix[ r ] *= scale;
+        matrix[ 4 + r ] *= scale;
+        matrix[ 8 + r ] *= scale;
+    }
+}
+
+void BatchRenderer::addGlyphs( const std::vector<GlyphQuad>& glyphs,
+                                float lx, float ly, float ux, float uy,
+                                float x, float y, float scale )
+{
+    if ( glyphs.empty() )
+        return;
+
+    GLfloat matrix[16];
+    getTextMatrix( x, y, scale, matrix );
+
+    // one batch lookup for the whole string, by its bounds
+    float l = 0.0f, r = 0.0f, d = 0.0f, u = 0.0f;
+    bool bounded = false;
+    if ( recording )
+    {
+        GLfloat corners[] = { lx, ly,  lx, uy,  ux, uy,  ux, ly };
+        GLfloat world[12];
+        for ( int i = 0; i < 4; i++ )
+        {
+            for ( int j = 0; j < 3; j++ )
+                world[ i*3 + j ] = matrix[ j ] * corners[ i*2 ] +
+                    matrix[ 4 + j ] * corners[ i*2 + 1 ] + matrix[ 12 + j ];
+        }
+        bounded = project( world, 4, l, r, d, u );
+    }
+
+    // text always blends (the font did it itself before), and only needs the
+    // atlas - the alpha texture modulates the color
+    State saved = current;
+    current.numTextures = 1;
+    current.textures[0] = GLUtil::getInstance()->getTextAtlas()->getTexture();
+    current.program = GLUtil::PROGRAM_NONE;
+    current.blend = true;
+    Batch* b = findBatch( GL_QUADS, l, r, d, u, !bounded );
+    current = saved;
+
+    for ( unsigned int i = 0; i < glyphs.size(); i++ )
+    {
+        const GlyphQuad& q = glyphs[i];
+        GLfloat points[] = { q.x1, q.y1,  q.x1, q.y2,  q.x2, q.y2,
+                             q.x2, q.y1 };
+        GLfloat texCoords[] = { q.s1, q.t1,  q.s1, q.t2,  q.s2, q.t2,
+                                q.s2, q.t1 };
+        for ( int k = 0; k < 4; k++ )
+        {
+            Vertex v;
+            v.s = texCoords[ k*2 ];
+            v.t = texCoords[ k*2 + 1 ];
+            v.r = color[0]; v.g = color[1]; v.b = color[2]; v.a = color[3];
+            v.x = matrix[0] * points[ k*2 ] + matrix[4] * points[ k*2 + 1 ] +
+                    matrix[12];
+            v.y = matrix[1] * points[ k*2 ] + matrix[5] * points[ k*2 + 1 ] +
+                    matrix[13];
+            v.z = matrix[2] * points[ k*2 ] + matrix[6] * points[ k*2 + 1 ] +
+                    matrix[14];
+            b->vertices.push_back( v );
+        }
+    }
+
+    if ( !recording )
+        flush();
+}
+
+void BatchRenderer::addVertices( GLenum primitive, const GLfloat* points,
+                                    int count, const GLfloat* texCoords )
+{
+    // max is a quad
+    GLfloat world[12];
+    for ( int i = 0; i < count; i++ )
+    {
+        for ( int j = 0; j < 3; j++ )
+            world[ i*3 + j ] = transform[ j ] * points[ i*2 ] +
+                transform[ 4 + j ] * points[ i*2 + 1 ] + transform[ 12 + j ];
+    }
+
+    float l = 0.0f, r = 0.0f, d = 0.0f, u = 0.0f;
+    bool bounded = recording && project( world, count, l, r, d, u );
+    Batch* b = findBatch( primitive, l, r, d, u, !bounded );
+
+    for ( int i = 0; i < count; i++ )
+    {
+        Vertex v;
+        v.s = texCoords ? texCoords[ i*2 ] : 0.0f;
+        v.t = texCoords ? texCoords[ i*2 + 1 ] : 0.0f;
+        v.r = color[0]; v.g = color[1]; v.b = color[2]; v.a = color[3];
+        v.x = world[ i*3 ]; v.y = world[ i*3 + 1 ]; v.z = world[ i*3 + 2 ];
+        b->vertices.push_back( v );
+    }
+
+    if ( !recording )
+        flush();
+}
+
+bool BatchRenderer::project( const GLfloat* world, int count,
+                                float& l, float& r, float& d, float& u )
+{
+    for ( int i = 0; i < count; i++ )
+    {
+        const GLfloat* p = &world[ i*3 ];
+        float clip[4];
+        for ( int j = 0; j < 4; j++ )
+            clip[j] = viewProjection[ j ] * p[0] +
+                viewProjection[ 4 + j ] * p[1] +
+                viewProjection[ 8 + j ] * p[2] + viewProjection[ 12 + j ];
+
+        // behind (or right at) the camera, so we can't say where it ends up -
+        // treat it as covering everything
+        if ( clip[3] <= 1e-6f )
+            return false;
+
+        float x = clip[0] / clip[3];
+        float y = clip[1] / clip[3];
+        if ( i == 0 )
+        {
+            l = r = x;
+            d = u = y;
+        }
+        else
+        {
+            l = std::min( l, x ); r = std::max( r, x );
+            d = std::min( d, y ); u = std::max( u, y );
+        }
+    }
+    return true;
+}
+
+void BatchRenderer::applyState( const State& s )
+{
+    if ( s.blend )
+    {
+        glEnable( GL_BLEND );
+        glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
+    }
+
+    if ( s.primitive == GL_NONE )
+        return;
+
+    if ( s.primitive == GL_LINES )
+    {
+        glLineWidth( s.lineWidth );
+        if ( s.smooth )
+            glEnable( GL_LINE_SMOOTH );
+    }
+
+    GLUtil* glUtil = GLUtil::getInstance();
+    if ( s.program != GLUtil::PROGRAM_NONE )
+    {
+        glUseProgram( glUtil->getProgram( s.program ) );
+        glUniform1f( glUtil->getProgramAlphaID( s.program ), s.programAlpha );
+    }
+
+    // bind to units in reverse, ending up back on unit 0
+    for ( int i = s.numTextures - 1; i >= 0; i-- )
+    {
+        glActiveTexture( GL_TEXTURE0 + i );
+        glBindTexture( GL_TEXTURE_2D, s.textures[i] );
+    }
+    if ( s.numTextures > 0 )
+        glEnable( GL_TEXTURE_2D );
+}
+
+void BatchRenderer::clearState( const State& s )
+{
+    for ( int i = s.numTextures - 1; i > 0; i-- )
+    {
+        glActiveTexture( GL_TEXTURE0 + i );
+        glBindTexture( GL_TEXTURE_2D, 0 );
+    }
+    if ( s.numTextures > 1 )
+        glActiveTexture( GL_TEXTURE0 );
+    if ( s.numTextures > 0 )
+        glDisable( GL_TEXTURE_2D );
+
+    if ( s.program != GLUtil::PROGRAM_NONE )
+        glUseProgram( 0 );
+
+    if ( s.primitive == GL_LINES )
+    {
+        glLineWidth( 1.0f );
+        if ( s.smooth )
+            glDisable( GL_LINE_SMOOTH );
+    }
+
+    if ( s.blend )
+        glDisable( GL_BLEND );
+}
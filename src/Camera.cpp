@@ -25,120 +25,112 @@
 
 #include "Camera.h"
 #include "Earth.h"
+#include "Animator.h"
+#include "GLUtil.h"
 
 Camera::Camera( Point c, Point l )
-    : center( c ), lookat( l )
 {
     earth = NULL;
     animated = true;
-    centerMoving = false;
-    lookatMoving = false;
 
     up = Vector( 0.0f, 1.0f, 0.0f );
 
-    destCenter = center;
-    destLookat = lookat;
+    setCenter( c );
+    setLookat( l );
 
-    origCenter = center;
-    origLookat = lookat;
+    origCenter = c;
+    origLookat = l;
+}
+
+Camera::~Camera()
+{
+    Animator::getInstance()->stop( this );
 }
 
 void Camera::doGLLookat()
 {
-    glLoadIdentity();
-    gluLookAt( center.getX(), center.getY(), center.getZ(),
-                lookat.getX(), lookat.getY(), lookat.getZ(),
-                up.getX(), up.getY(), up.getZ() );
+    GLUtil::getInstance()->setModelview(
+            Matrix::lookAt( getCenter(), getLookat(), up ) );
 }
 
 Point Camera::getCenter()
 {
-    return center;
+    return Point( center[0], center[1], center[2] );
 }
 
 Point Camera::getDestCenter()
 {
-    return destCenter;
+    return Point( destCenter[0], destCenter[1], destCenter[2] );
 }
 
 Point Camera::getLookat()
 {
-    return lookat;
+    return Point( lookat[0], lookat[1], lookat[2] );
 }
 
 Point Camera::getDestLookat()
 {
-    return destLookat;
+    return Point( destLookat[0], destLookat[1], destLookat[2] );
 }
 
 Vector Camera::getLookatDir()
 {
-    return lookat - center;
+    return getLookat() - getCenter();
 }
 
 Vector Camera::getDestLookatDir()
 {
-    return destLookat - destCenter;
+    return getDestLookat() - getDestCenter();
 }
 
 void Camera::setCenter( float x, float y, float z )
 {
-    center = Point( x, y, z );
-    destCenter = Point( x, y, z );
+    center[0] = destCenter[0] = x;
+    center[1] = destCenter[1] = y;
+    center[2] = destCenter[2] = z;
 }
 
 void Camera::setCenter( Point p )
 {
-    center = p;
-    destCenter = p;
+    setCenter( p.getX(), p.getY(), p.getZ() );
 }
 
 void Camera::moveCenter( float x, float y, float z )
 {
-    destCenter = Point( x, y, z );
-    if ( !animated )
-        center = Point( x, y, z );
-    else
-        centerMoving = true;
+    destCenter[0] = x;
+    destCenter[1] = y;
+    destCenter[2] = z;
+    movePoint( center, destCenter );
 }
 
 void Camera::moveCenter( Point p )
 {
-    destCenter = p;
-    if ( !animated )
-        center = p;
-    else
-        centerMoving = true;
+    moveCenter( p.getX(), p.getY(), p.getZ() );
 }
 
 void Camera::setLookat( float x, float y, float z )
 {
-    lookat = Point( x, y, z );
-    destLookat = Point( x, y, z );
+    lookat[0] = destLookat[0] = x;
+    lookat[1] = destLookat[1] = y;
+    lookat[2] = destLookat[2] = z;
 }
 
 void Camera::setLookat( Point p )
 {
-    lookat = p;
-    destLookat = p;
+    setLookat( p.getX(), p.getY(), p.getZ() );
 }
 
 void Camera::moveLookat( float x, float y, float z )
 {
-    destLookat = Point( x, y, z );
-    if ( !animated )
-        lookat = Point( x, y, z );
-    else
-        lookatMoving = true;
+    destLookat[0] = x;
+    destLookat[1] = y;
+    destLookat[2] = z;
+    movePoint( lookat, destLookat );
 }
 
 void Camera::moveLookat( Point p )
 {
-    destLookat = p;
-    if ( !animated )
-        lookat = p;
-    else
-        lookatMoving = true;
+    moveLookat( p.getX(), p.getY(), p.getZ() );
 }
 
 void Camera::setEarth( Earth* e )
@@ -160,29 +152,14 @@ void Camera::resetPosition( bool anim )
     }
 }
 
-void Camera::animateValues()
+void Camera::movePoint( float* point, const float* dest )
 {
-    if ( centerMoving )
+    for ( int i = 0; i < 3; i++ )
     {
-        center = center + ( ( destCenter - center ) / 5.0f );
-
-        if ( center.findDistance( destCenter ) < 0.01f )
-        {
-            center = destCenter;
-            centerMoving = false;
-        }
-    }
-
-    if ( lookatMoving )
-    {
-        lookat = lookat + ( ( destLookat - lookat ) / 5.0f );
-
-        if ( lookat.findDistance( destLookat ) < 0.01f )
-        {
-            lookat = destLookat;
-            lookatMoving = false;
-        }
+        if ( !animated )
+            point[i] = dest[i];
+        else
+            Animator::getInstance()->animate( this, &point[i], &dest[i],
+                                                5.0f );
     }
-
-    // not doing anim for up vector yet, might have to be different?
 }
@@ -0,0 +1,508 @@
+/*
+ * @file ColorConverter.cpp
+ *
+ * Implementation of the YUV420P to RGB conversion functions. See
+ * ColorConverter.h for details.
+ *
+ * All of the kernels use the same 16-bit fixed point math, so they match
+ * bit for bit: each of Y-16, U-128 and V-128 is shifted up by 6 and
+ * multiplied by its coefficient (scaled by 2^13) keeping the top 16 bits of
+ * the product (ie, the value * coefficient, in 1/8ths), then the terms are
+ * summed, rounded and shifted back down by 3. That keeps everything in range
+ * for 16-bit lanes, which is the main thing that makes SIMD worth it here.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ColorConverter.h"
+#include "WorkerPool.h"
+#include "gravUtil.h"
+
+#include <cstring>
+#include <vector>
+#include <sys/time.h>
+
+#if defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) )
+#define GRAV_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace ColorConverter
+{
+
+// BT.601 video range coefficients, scaled by 2^13
+static const int coefY = 9539;     // 1.164
+static const int coefRV = 13075;   // 1.596
+static const int coefGU = -3209;   // -0.392
+static const int coefGV = -6660;   // -0.813
+static const int coefBU = 16525;   // 2.017
+
+// don't bother splitting images smaller than this (in rows) across threads
+static const unsigned int minBandRows = 32;
+
+static inline int mulHigh( int a, int b )
+{
+    return ( a * b ) >> 16;
+}
+
+static inline unsigned char clampByte( int v )
+{
+    return v < 0 ? 0 : ( v > 255 ? 255 : (unsigned char)v );
+}
+
+/*
+ * Converts pixels [start, width) of one row. Also does the leftovers at the
+ * end of rows for the SIMD kernels.
+ */
+static void convertRowScalar( const unsigned char* yRow,
+                              const unsigned char* uRow,
+                              const unsigned char* vRow, unsigned char* out,
+                              unsigned int start, unsigned int width,
+                              unsigned int chromaWidth,
+                              unsigned int bytesPerPixel )
+{
+    for ( unsigned int x = start; x < width; x++ )
+    {
+        // odd widths don't have chroma for the last column, so reuse the
+        // previous one
+        unsigned int cx = x / 2;
+        if ( cx >= chromaWidth && chromaWidth > 0 )
+            cx = chromaWidth - 1;
+
+        int c = ( yRow[x] - 16 ) << 6;
+        int d = ( uRow[cx] - 128 ) << 6;
+        int e = ( vRow[cx] - 128 ) << 6;
+        int yTerm = mulHigh( c, coefY );
+
+        unsigned char* p = out + x * bytesPerPixel;
+        p[0] = clampByte( ( yTerm + mulHigh( e, coefRV ) + 4 ) >> 3 );
+        p[1] = clampByte( ( yTerm + mulHigh( d, coefGU ) +
+                            mulHigh( e, coefGV ) + 4 ) >> 3 );
+        p[2] = clampByte( ( yTerm + mulHigh( d, coefBU ) + 4 ) >> 3 );
+        if ( bytesPerPixel == 4 )
+            p[3] = 255;
+    }
+}
+
+#ifdef GRAV_X86_SIMD
+
+/*
+ * 8 pixels worth of shifted 16-bit Y, U & V in, 8 16-bit R, G & B out (not
+ * clamped yet - that happens when packing down to bytes).
+ */
+__attribute__((target("sse2")))
+static inline void yuvToRGB16SSE2( __m128i y, __m128i u, __m128i v,
+                                   __m128i& r, __m128i& g, __m128i& b )
+{
+    const __m128i round = _mm_set1_epi16( 4 );
+    __m128i yTerm = _mm_add_epi16( _mm_mulhi_epi16( y,
+                        _mm_set1_epi16( coefY ) ), round );
+
+    r = _mm_add_epi16( yTerm,
+            _mm_mulhi_epi16( v, _mm_set1_epi16( coefRV ) ) );
+    g = _mm_add_epi16( yTerm, _mm_add_epi16(
+            _mm_mulhi_epi16( u, _mm_set1_epi16( coefGU ) ),
+            _mm_mulhi_epi16( v, _mm_set1_epi16( coefGV ) ) ) );
+    b = _mm_add_epi16( yTerm,
+            _mm_mulhi_epi16( u, _mm_set1_epi16( coefBU ) ) );
+
+    r = _mm_srai_epi16( r, 3 );
+    g = _mm_srai_epi16( g, 3 );
+    b = _mm_srai_epi16( b, 3 );
+}
+
+/*
+ * Interleaves 16 pixels of R, G & B bytes into 4 vectors of 4 RGBA pixels.
+ */
+__attribute__((target("sse2")))
+static inline void interleaveRGBA( __m128i r, __m128i g, __m128i b,
+                                   __m128i* px )
+{
+    const __m128i a = _mm_set1_epi8( (char)0xFF );
+    __m128i rgLow = _mm_unpacklo_epi8( r, g );
+    __m128i rgHigh = _mm_unpackhi_epi8( r, g );
+    __m128i baLow = _mm_unpacklo_epi8( b, a );
+    __m128i baHigh = _mm_unpackhi_epi8( b, a );
+
+    px[0] = _mm_unpacklo_epi16( rgLow, baLow );
+    px[1] = _mm_unpackhi_epi16( rgLow, baLow );
+    px[2] = _mm_unpacklo_epi16( rgHigh, baHigh );
+    px[3] = _mm_unpackhi_epi16( rgHigh, baHigh );
+}
+
+/*
+ * Returns how many pixels it did - the rest are left for the scalar version.
+ */
+__attribute__((target("sse2")))
+static unsigned int convertRowSSE2( const unsigned char* yRow,
+                                    const unsigned char* uRow,
+                                    const unsigned char* vRow,
+                                    unsigned char* out, unsigned int width,
+                                    unsigned int bytesPerPixel )
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i yOffset = _mm_set1_epi16( 16 );
+    const __m128i cOffset = _mm_set1_epi16( 128 );
+    unsigned int x = 0;
+
+    for ( ; x + 16 <= width; x += 16 )
+    {
+        __m128i y8 = _mm_loadu_si128( (const __m128i*)( yRow + x ) );
+        __m128i u8 = _mm_loadl_epi64( (const __m128i*)( uRow + x / 2 ) );
+        __m128i v8 = _mm_loadl_epi64( (const __m128i*)( vRow + x / 2 ) );
+
+        __m128i yLow = _mm_slli_epi16( _mm_sub_epi16(
+                        _mm_unpacklo_epi8( y8, zero ), yOffset ), 6 );
+        __m128i yHigh = _mm_slli_epi16( _mm_sub_epi16(
+                        _mm_unpackhi_epi8( y8, zero ), yOffset ), 6 );
+        __m128i u16 = _mm_slli_epi16( _mm_sub_epi16(
+                        _mm_unpacklo_epi8( u8, zero ), cOffset ), 6 );
+        __m128i v16 = _mm_slli_epi16( _mm_sub_epi16(
+                        _mm_unpacklo_epi8( v8, zero ), cOffset ), 6 );
+
+        // each chroma sample covers 2 pixels
+        __m128i rLow, gLow, bLow, rHigh, gHigh, bHigh;
+        yuvToRGB16SSE2( yLow, _mm_unpacklo_epi16( u16, u16 ),
+                        _mm_unpacklo_epi16( v16, v16 ), rLow, gLow, bLow );
+        yuvToRGB16SSE2( yHigh, _mm_unpackhi_epi16( u16, u16 ),
+                        _mm_unpackhi_epi16( v16, v16 ), rHigh, gHigh, bHigh );
+
+        __m128i px[4];
+        interleaveRGBA( _mm_packus_epi16( rLow, rHigh ),
+                        _mm_packus_epi16( gLow, gHigh ),
+                        _mm_packus_epi16( bLow, bHigh ), px );
+
+        unsigned char* dst = out + x * bytesPerPixel;
+        if ( bytesPerPixel == 4 )
+        {
+            for ( int i = 0; i < 4; i++ )
+                _mm_storeu_si128( (__m128i*)( dst + 16 * i ), px[i] );
+        }
+        else
+        {
+            // no byte shuffle in SSE2, so squeeze out the alpha with
+            // overlapping 4-byte stores - each one's extra byte gets
+            // overwritten by the next, and the last one only writes 3
+            unsigned char rgba[64];
+            for ( int i = 0; i < 4; i++ )
+                _mm_storeu_si128( (__m128i*)( rgba + 16 * i ), px[i] );
+            for ( int i = 0; i < 15; i++ )
+                memcpy( dst + 3 * i, rgba + 4 * i, 4 );
+            memcpy( dst + 45, rgba + 60, 3 );
+        }
+    }
+
+    return x;
+}
+
+__attribute__((target("avx2")))
+static inline __m128i packBytesAVX2( __m256i v )
+{
+    return _mm_packus_epi16( _mm256_castsi256_si128( v ),
+                             _mm256_extracti128_si256( v, 1 ) );
+}
+
+/*
+ * Same idea as the SSE2 version, but 16 pixels per 256-bit vector so the
+ * math is done in half the instructions, and SSSE3's byte shuffle (which
+ * comes along with AVX2) for packing RGB24.
+ */
+__attribute__((target("avx2")))
+static unsigned int convertRowAVX2( const unsigned char* yRow,
+                                    const unsigned char* uRow,
+                                    const unsigned char* vRow,
+                                    unsigned char* out, unsigned int width,
+                                    unsigned int bytesPerPixel )
+{
+    const __m256i yOffset = _mm256_set1_epi16( 16 );
+    const __m256i cOffset = _mm256_set1_epi16( 128 );
+    const __m256i round = _mm256_set1_epi16( 4 );
+    const __m256i cY = _mm256_set1_epi16( coefY );
+    const __m256i cRV = _mm256_set1_epi16( coefRV );
+    const __m256i cGU = _mm256_set1_epi16( coefGU );
+    const __m256i cGV = _mm256_set1_epi16( coefGV );
+    const __m256i cBU = _mm256_set1_epi16( coefBU );
+    const __m128i dropAlpha = _mm_setr_epi8( 0, 1, 2, 4, 5, 6, 8, 9, 10,
+                                             12, 13, 14, -1, -1, -1, -1 );
+    unsigned int x = 0;
+
+    for ( ; x + 16 <= width; x += 16 )
+    {
+        __m128i y8 = _mm_loadu_si128( (const __m128i*)( yRow + x ) );
+        __m128i u8 = _mm_loadl_epi64( (const __m128i*)( uRow + x / 2 ) );
+        __m128i v8 = _mm_loadl_epi64( (const __m128i*)( vRow + x / 2 ) );
+
+        // duplicate chroma bytes before widening, so they line up with Y
+        __m256i y16 = _mm256_slli_epi16( _mm256_sub_epi16(
+                        _mm256_cvtepu8_epi16( y8 ), yOffset ), 6 );
+        __m256i u16 = _mm256_slli_epi16( _mm256_sub_epi16(
+                        _mm256_cvtepu8_epi16( _mm_unpacklo_epi8( u8, u8 ) ),
+                        cOffset ), 6 );
+        __m256i v16 = _mm256_slli_epi16( _mm256_sub_epi16(
+                        _mm256_cvtepu8_epi16( _mm_unpacklo_epi8( v8, v8 ) ),
+                        cOffset ), 6 );
+
+        __m256i yTerm = _mm256_add_epi16( _mm256_mulhi_epi16( y16, cY ),
+                                          round );
+        __m256i r = _mm256_add_epi16( yTerm,
+                        _mm256_mulhi_epi16( v16, cRV ) );
+        __m256i g = _mm256_add_epi16( yTerm, _mm256_add_epi16(
+                        _mm256_mulhi_epi16( u16, cGU ),
+                        _mm256_mulhi_epi16( v16, cGV ) ) );
+        __m256i b = _mm256_add_epi16( yTerm,
+                        _mm256_mulhi_epi16( u16, cBU ) );
+
+        __m128i px[4];
+        interleaveRGBA( packBytesAVX2( _mm256_srai_epi16( r, 3 ) ),
+                        packBytesAVX2( _mm256_srai_epi16( g, 3 ) ),
+                        packBytesAVX2( _mm256_srai_epi16( b, 3 ) ), px );
+
+        unsigned char* dst = out + x * bytesPerPixel;
+        if ( bytesPerPixel == 4 )
+        {
+            for ( int i = 0; i < 4; i++ )
+                _mm_storeu_si128( (__m128i*)( dst + 16 * i ), px[i] );
+        }
+        else
+        {
+            // 12 good bytes out of each shuffle - the first 3 stores spill
+            // into the next one's space, the last is done in two parts so it
+            // doesn't spill past the end
+            for ( int i = 0; i < 3; i++ )
+                _mm_storeu_si128( (__m128i*)( dst + 12 * i ),
+                                  _mm_shuffle_epi8( px[i], dropAlpha ) );
+            __m128i last = _mm_shuffle_epi8( px[3], dropAlpha );
+            _mm_storel_epi64( (__m128i*)( dst + 36 ), last );
+            int tail = _mm_cvtsi128_si32( _mm_srli_si128( last, 8 ) );
+            memcpy( dst + 44, &tail, 4 );
+        }
+    }
+
+    return x;
+}
+
+#endif
+
+Kernel getBestKernel()
+{
+    static int best = -1;
+
+    if ( best == -1 )
+    {
+        int found = KERNEL_SCALAR;
+#ifdef GRAV_X86_SIMD
+        __builtin_cpu_init();
+        if ( __builtin_cpu_supports( "avx2" ) )
+            found = KERNEL_AVX2;
+        else if ( __builtin_cpu_supports( "sse2" ) )
+            found = KERNEL_SSE2;
+#endif
+        best = found;
+        gravUtil::logVerbose( "ColorConverter::getBestKernel: using %s\n",
+                getKernelName( (Kernel)best ) );
+    }
+
+    return (Kernel)best;
+}
+
+const char* getKernelName( Kernel k )
+{
+    switch ( k )
+    {
+    case KERNEL_SSE2:
+        return "SSE2";
+    case KERNEL_AVX2:
+        return "AVX2";
+    default:
+        return "scalar";
+    }
+}
+
+void YUV420toRGB( const unsigned char* src, unsigned int width,
+                  unsigned int height, unsigned char* dst,
+                  unsigned int bytesPerPixel, unsigned int startRow,
+                  unsigned int endRow, Kernel kernel )
+{
+    unsigned int chromaWidth = width / 2;
+    unsigned int chromaHeight = height / 2;
+    const unsigned char* uPlane = src + width * height;
+    const unsigned char* vPlane = uPlane + chromaWidth * chromaHeight;
+
+    if ( endRow > height )
+        endRow = height;
+    if ( chromaWidth == 0 || chromaHeight == 0 )
+        return;
+
+    for ( unsigned int row = startRow; row < endRow; row++ )
+    {
+        unsigned int chromaRow = row / 2;
+        if ( chromaRow >= chromaHeight && chromaHeight > 0 )
+            chromaRow = chromaHeight - 1;
+
+        const unsigned char* yRow = src + row * width;
+        const unsigned char* uRow = uPlane + chromaRow * chromaWidth;
+        const unsigned char* vRow = vPlane + chromaRow * chromaWidth;
+        unsigned char* out = dst + row * width * bytesPerPixel;
+
+        unsigned int done = 0;
+#ifdef GRAV_X86_SIMD
+        if ( kernel == KERNEL_AVX2 )
+            done = convertRowAVX2( yRow, uRow, vRow, out, width,
+                                   bytesPerPixel );
+        else if ( kernel == KERNEL_SSE2 )
+            done = convertRowSSE2( yRow, uRow, vRow, out, width,
+                                   bytesPerPixel );
+#endif
+        convertRowScalar( yRow, uRow, vRow, out, done, width, chromaWidth,
+                          bytesPerPixel );
+    }
+}
+
+typedef struct
+{
+    const unsigned char* src;
+    unsigned int width;
+    unsigned int height;
+    unsigned char* dst;
+    unsigned int bytesPerPixel;
+    Kernel kernel;
+} ConvertJob;
+
+static void convertBand( void* data, int index, int count )
+{
+    ConvertJob* job = (ConvertJob*)data;
+
+    // keep bands an even number of rows so they start on a chroma row
+    unsigned int bandRows = ( job->height + count - 1 ) / count;
+    bandRows += bandRows % 2;
+    unsigned int start = index * bandRows;
+
+    YUV420toRGB( job->src, job->width, job->height, job->dst,
+                 job->bytesPerPixel, start, start + bandRows, job->kernel );
+}
+
+static void convert( const unsigned char* src, unsigned int width,
+                     unsigned int height, unsigned char* dst,
+                     unsigned int bytesPerPixel, Kernel kernel,
+                     WorkerPool* pool )
+{
+    int bands = 1;
+    if ( pool != NULL )
+    {
+        bands = pool->getNumThreads() + 1;
+        if ( height / minBandRows < (unsigned int)bands )
+            bands = height / minBandRows;
+    }
+
+    if ( bands <= 1 )
+    {
+        YUV420toRGB( src, width, height, dst, bytesPerPixel, 0, height,
+                     kernel );
+        return;
+    }
+
+    ConvertJob job;
+    job.src = src;
+    job.width = width;
+    job.height = height;
+    job.dst = dst;
+    job.bytesPerPixel = bytesPerPixel;
+    job.kernel = kernel;
+    pool->run( convertBand, &job, bands );
+}
+
+void YUV420toRGB( const unsigned char* src, unsigned int width,
+                  unsigned int height, unsigned char* dst,
+                  unsigned int bytesPerPixel, WorkerPool* pool )
+{
+    convert( src, width, height, dst, bytesPerPixel, getBestKernel(), pool );
+}
+
+static double getTimeMS()
+{
+    struct timeval now;
+    gettimeofday( &now, NULL );
+    return (double)now.tv_sec * 1000.0 + (double)now.tv_usec / 1000.0;
+}
+
+bool runBenchmark( unsigned int width, unsigned int height, int iterations,
+                   WorkerPool* pool )
+{
+    // something vaguely like real video - smooth gradients plus some noise,
+    // so the clamping gets exercised a bit too
+    std::vector<unsigned char> src( width * height * 3 / 2 );
+    unsigned int seed = 12345;
+    for ( unsigned int i = 0; i < src.size(); i++ )
+    {
+        seed = seed * 1103515245 + 12345;
+        src[i] = (unsigned char)( ( i * 7 ) / 5 + ( ( seed >> 16 ) & 0x3F ) );
+    }
+
+    Kernel best = getBestKernel();
+    bool allMatch = true;
+    unsigned int depths[2] = { 3, 4 };
+
+    gravUtil::logMessage( "ColorConverter::runBenchmark: %ux%u, %i "
+            "iterations, %i worker threads\n", width, height, iterations,
+            pool != NULL ? pool->getNumThreads() : 0 );
+
+    for ( int d = 0; d < 2; d++ )
+    {
+        unsigned int bytesPerPixel = depths[d];
+        std::vector<unsigned char> reference( width * height * bytesPerPixel );
+        std::vector<unsigned char> out( reference.size() );
+        YUV420toRGB( &src[0], width, height, &reference[0], bytesPerPixel, 0,
+                     height, KERNEL_SCALAR );
+
+        double scalarTime = 0.0;
+        for ( int k = KERNEL_SCALAR; k <= (int)best; k++ )
+        {
+            for ( int threaded = 0; threaded < 2; threaded++ )
+            {
+                WorkerPool* p = threaded ? pool : NULL;
+                if ( threaded && ( pool == NULL ||
+                                   pool->getNumThreads() == 0 ) )
+                    continue;
+
+                memset( &out[0], 0, out.size() );
+                double start = getTimeMS();
+                for ( int i = 0; i < iterations; i++ )
+                    convert( &src[0], width, height, &out[0], bytesPerPixel,
+                             (Kernel)k, p );
+                double perFrame = ( getTimeMS() - start ) / iterations;
+                if ( k == KERNEL_SCALAR && !threaded )
+                    scalarTime = perFrame;
+
+                bool match = ( out == reference );
+                allMatch = allMatch && match;
+
+                gravUtil::logMessage( "  %s %-6s %-8s %8.3f ms/frame  "
+                        "%5.2fx%s\n", bytesPerPixel == 3 ? "RGB24" : "RGBA ",
+                        getKernelName( (Kernel)k ),
+                        threaded ? "threaded" : "single", perFrame,
+                        perFrame > 0.0 ? scalarTime / perFrame : 0.0,
+                        match ? "" : "  MISMATCH" );
+            }
+        }
+    }
+
+    return allMatch;
+}
+
+}
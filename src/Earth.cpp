@@ -24,8 +24,12 @@
  */
 
 #include "Earth.h"
+#include "EarthTiles.h"
+#include "Animator.h"
+#include "Matrix.h"
 
 #include <cmath>
+#include <cstddef>
 
 Earth::Earth()
 {
@@ -41,46 +45,28 @@ Earth::Earth()
     texHeight = t.height;
 
     animated = true;
-    rotating = false;
 
-    sphereQuad = gluNewQuadric();
-    gluQuadricTexture( sphereQuad, GL_TRUE );
-
-    // create the display list for rendering the sphere
-    sphereIndex = glGenLists( 1 );
-    glNewList( sphereIndex, GL_COMPILE );
-    glEnable( GL_TEXTURE_2D );
-    glBindTexture( GL_TEXTURE_2D, earthTex );
-
-    glEnable( GL_CULL_FACE );
-    glCullFace( GL_BACK );
-
-    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP );
-    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP );
-    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
-    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
-
-    gluSphere( sphereQuad, radius, 40, 40 );
-
-    glDisable( GL_CULL_FACE );
-    glDisable( GL_TEXTURE_2D );
-    glEndList();
-
-    matrix = new GLdouble[16];
+    useVertexBuffers = GLUtil::getInstance()->areVertexBuffersAvailable();
+    vertexBuffer = 0;
+    indexBuffer = 0;
+    lastLevel = 0;
+    tiles = NULL;
+    buildSphere();
 }
 
 Earth::~Earth()
 {
+    Animator::getInstance()->stop( this );
+    delete tiles;
     glDeleteTextures( 1, &earthTex );
-    gluDeleteQuadric( sphereQuad );
-    delete[] matrix;
-    glDeleteLists( sphereIndex, 1 );
+    if ( vertexBuffer != 0 )
+        glDeleteBuffers( 1, &vertexBuffer );
+    if ( indexBuffer != 0 )
+        glDeleteBuffers( 1, &indexBuffer );
 }
 
 void Earth::draw()
 {
-    animateValues();
-
     glPushMatrix();
 
     glTranslatef( x, y, z );
@@ -123,8 +109,20 @@ void Earth::draw()
 
     glColor4f( 1.0f, 1.0f, 1.0f, 1.0f );
 
-    // render the sphere using its display list
-    glCallList( sphereIndex );
+    // the tiles need the same transform as above, to work out what's in view
+    bool drewTiles = false;
+    if ( tiles != NULL )
+    {
+        Matrix modelview = GLUtil::getInstance()->getModelview();
+        modelview.translate( x, y, z );
+        modelview.rotate( xRot-90.0f, 1.0f, 0.0f, 0.0f );
+        modelview.rotate( yRot, 0.0f, 1.0f, 0.0f );
+        modelview.rotate( zRot, 0.0f, 0.0f, 1.0f );
+        drewTiles = tiles->draw( modelview, radius, getScreenRadius(),
+                                    earthTex, texWidth );
+    }
+    if ( !drewTiles )
+        drawSphere();
 
     glPopMatrix();
 
@@ -134,6 +132,47 @@ void Earth::draw()
         moveAmt *= -1.0f;*/
 }
 
+void Earth::drawSphere()
+{
+    lastLevel = chooseLevel();
+    const DetailLevel& level = levels[ lastLevel ];
+
+    glEnable( GL_TEXTURE_2D );
+    glBindTexture( GL_TEXTURE_2D, earthTex );
+    glEnable( GL_CULL_FACE );
+    glCullFace( GL_BACK );
+
+    const GLubyte* vertexBase = (const GLubyte*)&sphereVertices[0];
+    const GLubyte* indexBase = (const GLubyte*)&sphereIndices[0];
+    if ( useVertexBuffers )
+    {
+        glBindBuffer( GL_ARRAY_BUFFER, vertexBuffer );
+        glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, indexBuffer );
+        vertexBase = NULL;
+        indexBase = NULL;
+    }
+
+    glEnableClientState( GL_VERTEX_ARRAY );
+    glEnableClientState( GL_TEXTURE_COORD_ARRAY );
+    glVertexPointer( 3, GL_FLOAT, sizeof( SphereVertex ), vertexBase );
+    glTexCoordPointer( 2, GL_FLOAT, sizeof( SphereVertex ),
+                        vertexBase + offsetof( SphereVertex, s ) );
+
+    glDrawElements( GL_TRIANGLES, level.numIndices, GL_UNSIGNED_SHORT,
+                    indexBase + level.firstIndex * sizeof( GLushort ) );
+
+    glDisableClientState( GL_TEXTURE_COORD_ARRAY );
+    glDisableClientState( GL_VERTEX_ARRAY );
+    if ( useVertexBuffers )
+    {
+        glBindBuffer( GL_ARRAY_BUFFER, 0 );
+        glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 );
+    }
+
+    glDisable( GL_CULL_FACE );
+    glDisable( GL_TEXTURE_2D );
+}
+
 void Earth::convertLatLong( float lat, float lon, float &ex, float &ey,
                             float &ez, bool dest )
 {
@@ -141,16 +180,13 @@ void Earth::convertLatLong( float lat, float lon, float &ex, float &ey,
     float yr = dest ? destYRot : yRot;
     float zr = dest ? destZRot : zRot;
 
-    // grab the modelview matrix so we can calculate the result of the
+    // work out the earth's transform so we can calculate the result of the
     // rotation manually
-    glPushMatrix();
-    glLoadIdentity();
-    glTranslatef( x, y, z );
-    glRotatef( xr, 1.0f, 0.0f, 0.0f );
-    glRotatef( yr, 0.0f, 0.0f, 1.0f );
-    glRotatef( zr, 0.0f, 1.0f, 0.0f );
-    glGetDoublev( GL_MODELVIEW_MATRIX, matrix );
-    glPopMatrix();
+    Matrix matrix;
+    matrix.translate( x, y, z );
+    matrix.rotate( xr, 1.0f, 0.0f, 0.0f );
+    matrix.rotate( yr, 0.0f, 0.0f, 1.0f );
+    matrix.rotate( zr, 0.0f, 1.0f, 0.0f );
 
     float rlat = lat;//-90.0f); //-xRot
     float rlon = lon; //+zRot
@@ -192,7 +228,19 @@ void Earth::rotate( float x, float y, float z )
         zRot += z;
     }
     else
-        rotating = true;
+    {
+        Animator* anim = Animator::getInstance();
+        anim->animate( this, &xRot, &destXRot, 5.0f );
+        anim->animate( this, &yRot, &destYRot, 5.0f );
+        anim->animate( this, &zRot, &destZRot, 5.0f );
+    }
+}
+
+void Earth::getRotation( float& x, float& y, float& z )
+{
+    x = xRot;
+    y = yRot;
+    z = zRot;
 }
 
 float Earth::getX()
@@ -220,23 +268,144 @@ float Earth::getRadius()
     return radius;
 }
 
-void Earth::animateValues()
+int Earth::getDetail()
+{
+    return levels[ lastLevel ].slices;
+}
+
+void Earth::setTiles( EarthTiles* t )
+{
+    delete tiles;
+    tiles = t;
+}
+
+EarthTiles* Earth::getTiles()
+{
+    return tiles;
+}
+
+bool Earth::needsRedraw()
+{
+    return tiles != NULL && tiles->hasPendingUploads();
+}
+
+void Earth::buildSphere()
 {
-    // this could be a bit better (individual bools for each axis) but this
-    // should be fine for now
-    if ( rotating )
+    // stacks are half the slices, so the quads come out roughly square
+    const int slices[] = { 16, 24, 32, 48, 64, 96, 128 };
+    const int numLevels = sizeof( slices ) / sizeof( slices[0] );
+
+    for ( int l = 0; l < numLevels; l++ )
     {
-        xRot = xRot + ( ( destXRot - xRot ) / 5.0f );
-        yRot = yRot + ( ( destYRot - yRot ) / 5.0f );
-        zRot = zRot + ( ( destZRot - zRot ) / 5.0f );
+        DetailLevel level;
+        level.slices = slices[l];
+        level.stacks = slices[l] / 2;
+        level.firstIndex = sphereIndices.size();
+
+        // a ring of slices+1 vertices (the seam is doubled, for the texture)
+        // for each stack boundary, from the +z pole down - positions &
+        // texture coords are the same as gluSphere's
+        unsigned int base = sphereVertices.size();
+        int ring = level.slices + 1;
+        for ( int j = 0; j <= level.stacks; j++ )
+        {
+            float rho = PI * (float)j / (float)level.stacks;
+            for ( int i = 0; i <= level.slices; i++ )
+            {
+                float theta = 2.0f * PI * (float)i / (float)level.slices;
+                SphereVertex v;
+                v.x = radius * sin( rho ) * sin( theta );
+                v.y = radius * sin( rho ) * cos( theta );
+                v.z = radius * cos( rho );
+                v.s = 1.0f - (float)i / (float)level.slices;
+                v.t = 1.0f - (float)j / (float)level.stacks;
+                sphereVertices.push_back( v );
+            }
+        }
 
-        if ( fabs( xRot - destXRot ) < 0.01f && fabs( yRot - destYRot ) < 0.01f
-                && fabs( zRot - destZRot ) < 0.01f )
+        // two triangles per quad, counterclockwise from outside - except at
+        // the poles, where one of them would have no area
+        for ( int j = 0; j < level.stacks; j++ )
         {
-            xRot = destXRot;
-            yRot = destYRot;
-            zRot = destZRot;
-            rotating = false;
+            for ( int i = 0; i < level.slices; i++ )
+            {
+                GLushort upper = base + ( j * ring ) + i;
+                GLushort lower = upper + ring;
+                if ( j != level.stacks - 1 )
+                {
+                    sphereIndices.push_back( lower );
+                    sphereIndices.push_back( upper );
+                    sphereIndices.push_back( lower + 1 );
+                }
+                if ( j != 0 )
+                {
+                    sphereIndices.push_back( upper );
+                    sphereIndices.push_back( upper + 1 );
+                    sphereIndices.push_back( lower + 1 );
+                }
+            }
         }
+
+        level.numIndices = sphereIndices.size() - level.firstIndex;
+        levels.push_back( level );
+    }
+
+    gravUtil::logVerbose( "Earth::buildSphere: %u vertices, %u indices in %i "
+            "levels\n", (unsigned int)sphereVertices.size(),
+            (unsigned int)sphereIndices.size(), numLevels );
+
+    if ( useVertexBuffers )
+    {
+        glGenBuffers( 1, &vertexBuffer );
+        glBindBuffer( GL_ARRAY_BUFFER, vertexBuffer );
+        glBufferData( GL_ARRAY_BUFFER,
+                        sizeof( SphereVertex ) * sphereVertices.size(),
+                        &sphereVertices[0], GL_STATIC_DRAW );
+        glBindBuffer( GL_ARRAY_BUFFER, 0 );
+
+        glGenBuffers( 1, &indexBuffer );
+        glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, indexBuffer );
+        glBufferData( GL_ELEMENT_ARRAY_BUFFER,
+                        sizeof( GLushort ) * sphereIndices.size(),
+                        &sphereIndices[0], GL_STATIC_DRAW );
+        glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 );
+    }
+}
+
+int Earth::chooseLevel()
+{
+    // if we're inside it or right up against it, everything shows
+    int top = levels.size() - 1;
+    float screenRadius = getScreenRadius();
+    if ( screenRadius < 0.0f )
+        return top;
+
+    // aim for the edge of each slice to be a few pixels long around the
+    // outline
+    float wantedSlices = 2.0f * PI * screenRadius / 6.0f;
+
+    for ( int l = 0; l < top; l++ )
+    {
+        if ( (float)levels[l].slices >= wantedSlices )
+            return l;
     }
+    return top;
+}
+
+float Earth::getScreenRadius()
+{
+    // how far the center is in front of the camera
+    GLUtil* glUtil = GLUtil::getInstance();
+    float center[4] = { x, y, z, 1.0f };
+    float eye[4];
+    glUtil->getModelview().transform( center, eye );
+    float depth = -eye[2];
+
+    if ( depth <= radius )
+        return -1.0f;
+
+    GLint viewport[4];
+    glUtil->getViewport( viewport );
+    return radius * glUtil->getProjection()[5] * (float)viewport[3] /
+            ( 2.0f * depth );
 }
@@ -0,0 +1,631 @@
+/*
+ * @file EarthTiles.cpp
+ *
+ * Implementation of the EarthTiles class. See EarthTiles.h for details.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "EarthTiles.h"
+#include "PNGLoader.h"
+#include "gravUtil.h"
+
+#include <wx/thread.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+// each one is a whole tile going over the bus, so only do a few at a time
+static const int maxUploadsPerFrame = 4;
+
+// roughly how far apart the points on the tile meshes are, in degrees
+static const float segmentDegrees = 3.0f;
+
+// past this the tile counts don't fit in an int
+static const int maxLevels = 14;
+
+EarthTiles::EarthTiles( unsigned int b )
+{
+    budget = b;
+    numLevels = 0;
+    tileSize = 0;
+    capacity = 0;
+    frame = 0;
+    tileIndexSegments = 0;
+
+    queueMutex = mutex_create();
+    wake = new wxSemaphore();
+    loaderThread = NULL;
+    quit = false;
+}
+
+EarthTiles::~EarthTiles()
+{
+    if ( loaderThread != NULL )
+    {
+        quit = true;
+        wake->Post();
+        thread_join( loaderThread );
+    }
+    delete wake;
+    mutex_free( queueMutex );
+
+    for ( unsigned int i = 0; i < loaded.size(); i++ )
+        delete[] loaded[i].pixels;
+
+    std::map<TileKey, Resident>::iterator r;
+    for ( r = resident.begin(); r != resident.end(); ++r )
+        glDeleteTextures( 1, &r->second.tex );
+}
+
+bool EarthTiles::load( std::string infoFile )
+{
+    std::map<std::string, std::string> info =
+        gravUtil::getInstance()->parseThumbnailFile( infoFile );
+    numLevels = atoi( info[ "levels" ].c_str() );
+    tileSize = atoi( info[ "tilesize" ].c_str() );
+
+    if ( numLevels < 1 || numLevels > maxLevels || tileSize < 1 )
+    {
+        gravUtil::logError( "EarthTiles::load: %s doesn't have a valid "
+                "levels (1-%i) & tilesize\n", infoFile.c_str(), maxLevels );
+        return false;
+    }
+
+    GLUtil* glUtil = GLUtil::getInstance();
+    if ( glUtil->pow2( tileSize ) != tileSize &&
+            !glUtil->areNonPow2TexturesAvailable() )
+    {
+        gravUtil::logError( "EarthTiles::load: tile size %i isn't a power of "
+                "2, and this card needs one\n", tileSize );
+        return false;
+    }
+
+    // need room for at least both top tiles, plus what's visible of the
+    // next level down while it's coming in
+    capacity = budget / ( tileSize * tileSize * 4 );
+    if ( capacity < 4 )
+    {
+        gravUtil::logError( "EarthTiles::load: budget of %u bytes only fits "
+                "%i tiles, need at least 4\n", budget, capacity );
+        return false;
+    }
+
+    size_t sepPos = infoFile.find_last_of( "/\\" );
+    if ( sepPos != std::string::npos )
+        tileDir = infoFile.substr( 0, sepPos + 1 );
+    else
+        tileDir = "";
+
+    loaderThread = thread_start( loaderThreadFunc, this );
+
+    gravUtil::logVerbose( "EarthTiles::load: %i levels of %ix%i tiles in "
+            "%s, room for %i on the GPU\n", numLevels, tileSize, tileSize,
+            tileDir.c_str(), capacity );
+    return true;
+}
+
+bool EarthTiles::draw( const Matrix& modelview, float radius,
+                        float screenRadius, GLuint baseTex, int baseWidth )
+{
+    if ( loaderThread == NULL )
+        return false;
+
+    // aim for about a texel per pixel around the outline - negative screen
+    // radius means we're right up against it, so go as far as we can
+    float wanted = 2.0f * M_PI * screenRadius;
+    if ( screenRadius >= 0.0f && (float)baseWidth >= wanted )
+    {
+        visible.clear();
+        visibleSet.clear();
+        deferred.clear();
+        return false;
+    }
+
+    int level = 0;
+    while ( level < numLevels - 1 && ( screenRadius < 0.0f ||
+            (float)tileSize * (float)( 2 << level ) < wanted ) )
+        level++;
+
+    // work out where the eye & the sides of the view are, relative to a unit
+    // sphere in the earth's orientation
+    Matrix local = modelview;
+    local.scale( radius, radius, radius );
+
+    float eye[3] = { 0.0f, 0.0f, 0.0f };
+    Matrix inverse;
+    if ( local.invert( inverse ) )
+    {
+        Point e = inverse.transformPoint( Point( 0.0f, 0.0f, 0.0f ) );
+        eye[0] = e.getX(); eye[1] = e.getY(); eye[2] = e.getZ();
+    }
+
+    Matrix toClip = GLUtil::getInstance()->getProjection() * local;
+    float planes[6][4];
+    for ( int p = 0; p < 3; p++ )
+    {
+        for ( int c = 0; c < 4; c++ )
+        {
+            planes[ p*2 ][c] = toClip[ c*4 + 3 ] + toClip[ c*4 + p ];
+            planes[ p*2 + 1 ][c] = toClip[ c*4 + 3 ] - toClip[ c*4 + p ];
+        }
+    }
+    for ( int p = 0; p < 6; p++ )
+    {
+        float len = sqrt( planes[p][0] * planes[p][0] +
+                          planes[p][1] * planes[p][1] +
+                          planes[p][2] * planes[p][2] );
+        if ( len > 0.0f )
+        {
+            for ( int c = 0; c < 4; c++ )
+                planes[p][c] /= len;
+        }
+    }
+
+    // drop down a level if this many wouldn't leave room for the ones being
+    // replaced while the new ones come in
+    while ( true )
+    {
+        visible.clear();
+        for ( int x = 0; x < 2; x++ )
+        {
+            TileKey top = { 0, x, 0 };
+            findVisible( top, level, eye, planes );
+        }
+        if ( level == 0 || (int)visible.size() * 2 <= capacity )
+            break;
+        level--;
+    }
+    std::set<TileKey> newVisibleSet( visible.begin(), visible.end() );
+    if ( newVisibleSet != visibleSet )
+        deferred.clear();
+    visibleSet.swap( newVisibleSet );
+
+    // mark what's going to be drawn first, so uploads don't push it out
+    frame++;
+    for ( unsigned int i = 0; i < visible.size(); i++ )
+        findSource( visible[i] );
+
+    uploadLoaded();
+    requestVisible();
+
+    glPushMatrix();
+    glScalef( radius, radius, radius );
+
+    glEnable( GL_TEXTURE_2D );
+    glEnable( GL_CULL_FACE );
+    glCullFace( GL_BACK );
+    glEnableClientState( GL_VERTEX_ARRAY );
+    glEnableClientState( GL_TEXTURE_COORD_ARRAY );
+
+    for ( unsigned int i = 0; i < visible.size(); i++ )
+        drawTile( visible[i], baseTex );
+
+    glMatrixMode( GL_TEXTURE );
+    glLoadIdentity();
+    glMatrixMode( GL_MODELVIEW );
+
+    glDisableClientState( GL_TEXTURE_COORD_ARRAY );
+    glDisableClientState( GL_VERTEX_ARRAY );
+    glDisable( GL_CULL_FACE );
+    glDisable( GL_TEXTURE_2D );
+
+    glPopMatrix();
+
+    return true;
+}
+
+bool EarthTiles::hasPendingUploads()
+{
+    mutex_lock( queueMutex );
+    bool ret = !loaded.empty();
+    mutex_unlock( queueMutex );
+    return ret;
+}
+
+int EarthTiles::getResidentCount()
+{
+    return resident.size();
+}
+
+int EarthTiles::getLastVisibleCount()
+{
+    return visible.size();
+}
+
+bool EarthTiles::TileKey::operator<( const TileKey& other ) const
+{
+    if ( level != other.level )
+        return level < other.level;
+    if ( y != other.y )
+        return y < other.y;
+    return x < other.x;
+}
+
+bool EarthTiles::TileKey::operator==( const TileKey& other ) const
+{
+    return level == other.level && x == other.x && y == other.y;
+}
+
+void* EarthTiles::loaderThreadFunc( void* args )
+{
+    EarthTiles* tiles = (EarthTiles*)args;
+    tiles->loaderLoop();
+    return NULL;
+}
+
+void EarthTiles::loaderLoop()
+{
+    while ( !quit )
+    {
+        wake->Wait();
+
+        // go through everything that's been asked for - it's fine if this
+        // finds nothing, since the semaphore gets posted once per batch
+        while ( !quit )
+        {
+            Loaded l;
+            mutex_lock( queueMutex );
+            if ( requests.empty() )
+            {
+                mutex_unlock( queueMutex );
+                break;
+            }
+            l.key = requests.front();
+            requests.pop_front();
+            mutex_unlock( queueMutex );
+
+            char name[64];
+            sprintf( name, "%i/%i_%i.png", l.key.level, l.key.x, l.key.y );
+            int width, height;
+            l.pixels = PNGLoader::readPNG( tileDir + name, width, height );
+            if ( l.pixels != NULL &&
+                    ( width != tileSize || height != tileSize ) )
+            {
+                gravUtil::logWarning( "EarthTiles::loaderLoop: %s is %ix%i, "
+                        "should be %ix%i\n", name, width, height, tileSize,
+                        tileSize );
+                delete[] l.pixels;
+                l.pixels = NULL;
+            }
+
+            mutex_lock( queueMutex );
+            loaded.push_back( l );
+            mutex_unlock( queueMutex );
+        }
+    }
+}
+
+void EarthTiles::findVisible( const TileKey& key, int level,
+                                const float* eye, const float planes[6][4] )
+{
+    if ( !isVisible( key, eye, planes ) )
+        return;
+
+    if ( key.level == level )
+    {
+        visible.push_back( key );
+        return;
+    }
+
+    for ( int j = 0; j < 2; j++ )
+    {
+        for ( int i = 0; i < 2; i++ )
+        {
+            TileKey child = { key.level + 1, key.x * 2 + i, key.y * 2 + j };
+            findVisible( child, level, eye, planes );
+        }
+    }
+}
+
+bool EarthTiles::isVisible( const TileKey& key, const float* eye,
+                            const float planes[6][4] )
+{
+    float u0, u1, v0, v1;
+    getArea( key, u0, u1, v0, v1 );
+
+    float c[3];
+    mapToSphere( ( u0 + u1 ) / 2.0f, ( v0 + v1 ) / 2.0f, c );
+
+    // how far the tile reaches from its center, as an angle - the farthest
+    // of a grid of points over it, plus enough for anything in between them
+    const int samples = 4;
+    float minDot = 1.0f;
+    for ( int j = 0; j <= samples; j++ )
+    {
+        for ( int i = 0; i <= samples; i++ )
+        {
+            float p[3];
+            mapToSphere( u0 + ( u1 - u0 ) * i / samples,
+                         v0 + ( v1 - v0 ) * j / samples, p );
+            float d = p[0] * c[0] + p[1] * c[1] + p[2] * c[2];
+            if ( d < minDot )
+                minDot = d;
+        }
+    }
+    if ( minDot < -1.0f )
+        minDot = -1.0f;
+    float spread = acos( minDot ) + 0.5f *
+        ( 2.0f * M_PI * ( u1 - u0 ) + M_PI * ( v1 - v0 ) ) / samples;
+
+    // facing away - the closest any of it gets to pointing at the eye is
+    // still past the horizon
+    float eyeDist = sqrt( eye[0] * eye[0] + eye[1] * eye[1] +
+                          eye[2] * eye[2] );
+    if ( eyeDist > 1.0f )
+    {
+        float cosAngle = ( c[0] * eye[0] + c[1] * eye[1] + c[2] * eye[2] ) /
+                            eyeDist;
+        if ( cosAngle > 1.0f ) cosAngle = 1.0f;
+        if ( cosAngle < -1.0f ) cosAngle = -1.0f;
+        float closest = acos( cosAngle ) - spread;
+        if ( closest > 0.0f && eyeDist * cos( closest ) <= 1.0f )
+            return false;
+    }
+
+    // entirely outside one of the sides of the view - checked with a ball
+    // around the part of the sphere the tile could be on
+    float ballRadius = spread >= M_PI ? 2.0f : 2.0f * sin( spread / 2.0f );
+    for ( int p = 0; p < 6; p++ )
+    {
+        if ( planes[p][0] * c[0] + planes[p][1] * c[1] +
+                planes[p][2] * c[2] + planes[p][3] < -ballRadius )
+            return false;
+    }
+
+    return true;
+}
+
+EarthTiles::Resident* EarthTiles::findSource( const TileKey& key )
+{
+    TileKey source = key;
+    while ( source.level >= 0 )
+    {
+        std::map<TileKey, Resident>::iterator r = resident.find( source );
+        if ( r != resident.end() )
+        {
+            lru.splice( lru.begin(), lru, r->second.lruPos );
+            r->second.lastUsed = frame;
+            return &r->second;
+        }
+        source.level--;
+        source.x /= 2;
+        source.y /= 2;
+    }
+    return NULL;
+}
+
+void EarthTiles::uploadLoaded()
+{
+    std::vector<Loaded> batch;
+    mutex_lock( queueMutex );
+    while ( !loaded.empty() && (int)batch.size() < maxUploadsPerFrame )
+    {
+        batch.push_back( loaded.front() );
+        loaded.pop_front();
+    }
+    mutex_unlock( queueMutex );
+
+    for ( unsigned int i = 0; i < batch.size(); i++ )
+    {
+        const TileKey& key = batch[i].key;
+        pending.erase( key );
+
+        if ( batch[i].pixels == NULL )
+        {
+            missing.insert( key );
+            continue;
+        }
+
+        // if the view moved on while it was loading, only keep it if it
+        // doesn't push anything else out
+        bool wanted = visibleSet.find( key ) != visibleSet.end();
+        if ( wanted || (int)resident.size() < capacity )
+        {
+            // everything resident is being drawn - hold off on asking for
+            // this one again until something changes
+            if ( !upload( key, batch[i].pixels ) )
+                deferred.insert( key );
+        }
+        delete[] batch[i].pixels;
+    }
+}
+
+bool EarthTiles::upload( const TileKey& key, unsigned char* pixels )
+{
+    GLuint tex;
+    if ( (int)resident.size() < capacity )
+    {
+        tex = GLUtil::getInstance()->borrowTexture( GL_RGBA, tileSize,
+                                                    tileSize );
+    }
+    else
+    {
+        // reuse the least recently used one's texture - unless it's being
+        // drawn this frame, in which case everything else is too
+        std::map<TileKey, Resident>::iterator oldest =
+            resident.find( lru.back() );
+        if ( oldest->second.lastUsed == frame )
+            return false;
+        tex = oldest->second.tex;
+        lru.pop_back();
+        resident.erase( oldest );
+    }
+
+    glBindTexture( GL_TEXTURE_2D, tex );
+    glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+    glTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, tileSize, tileSize, GL_RGBA,
+                        GL_UNSIGNED_BYTE, pixels );
+    glBindTexture( GL_TEXTURE_2D, 0 );
+
+    Resident r;
+    r.tex = tex;
+    lru.push_front( key );
+    r.lruPos = lru.begin();
+    r.lastUsed = 0;
+    resident[ key ] = r;
+    return true;
+}
+
+void EarthTiles::requestVisible()
+{
+    bool added = false;
+    mutex_lock( queueMutex );
+
+    // anything still waiting from before isn't wanted anymore if it's not
+    // in view - what is gets put back below
+    for ( unsigned int i = 0; i < requests.size(); i++ )
+        pending.erase( requests[i] );
+    requests.clear();
+
+    for ( unsigned int i = 0; i < visible.size(); i++ )
+    {
+        const TileKey& key = visible[i];
+        if ( resident.find( key ) == resident.end() &&
+                missing.find( key ) == missing.end() &&
+                pending.find( key ) == pending.end() &&
+                deferred.find( key ) == deferred.end() )
+        {
+            requests.push_back( key );
+            pending.insert( key );
+            added = true;
+        }
+    }
+
+    mutex_unlock( queueMutex );
+
+    if ( added )
+        wake->Post();
+}
+
+void EarthTiles::drawTile( const TileKey& key, GLuint baseTex )
+{
+    // the tile itself if it's in, otherwise the closest one above it that
+    // is, otherwise the plain earth texture
+    float au0 = 0.0f, au1 = 1.0f, av0 = 0.0f, av1 = 1.0f;
+    GLuint tex = baseTex;
+    TileKey source = key;
+    Resident* r = findSource( key );
+    if ( r != NULL )
+    {
+        tex = r->tex;
+        while ( resident.find( source ) == resident.end() )
+        {
+            source.level--;
+            source.x /= 2;
+            source.y /= 2;
+        }
+        getArea( source, au0, au1, av0, av1 );
+    }
+
+    // the tile mesh's texture coords are 0-1 over the tile, so map them to
+    // the part of the texture that covers it
+    float u0, u1, v0, v1;
+    getArea( key, u0, u1, v0, v1 );
+    glMatrixMode( GL_TEXTURE );
+    glLoadIdentity();
+    glTranslatef( ( u0 - au0 ) / ( au1 - au0 ),
+                    1.0f - ( v1 - av0 ) / ( av1 - av0 ), 0.0f );
+    glScalef( ( u1 - u0 ) / ( au1 - au0 ), ( v1 - v0 ) / ( av1 - av0 ),
+                1.0f );
+    glMatrixMode( GL_MODELVIEW );
+
+    glBindTexture( GL_TEXTURE_2D, tex );
+
+    int segments = (int)ceil( ( 180.0f / (float)( 1 << key.level ) ) /
+                                segmentDegrees );
+    if ( segments < 2 ) segments = 2;
+    if ( segments > 32 ) segments = 32;
+    buildTile( key, segments );
+
+    glVertexPointer( 3, GL_FLOAT, sizeof( TileVertex ), &tileVertices[0].x );
+    glTexCoordPointer( 2, GL_FLOAT, sizeof( TileVertex ),
+                        &tileVertices[0].s );
+    glDrawElements( GL_TRIANGLES, tileIndices.size(), GL_UNSIGNED_SHORT,
+                    &tileIndices[0] );
+}
+
+void EarthTiles::buildTile( const TileKey& key, int segments )
+{
+    float u0, u1, v0, v1;
+    getArea( key, u0, u1, v0, v1 );
+
+    // rows from the top of the tile down, and going west within each row, to
+    // match the order of Earth's sphere
+    int ring = segments + 1;
+    tileVertices.resize( ring * ring );
+    for ( int j = 0; j <= segments; j++ )
+    {
+        float v = v0 + ( v1 - v0 ) * (float)j / (float)segments;
+        for ( int i = 0; i <= segments; i++ )
+        {
+            float u = u1 - ( u1 - u0 ) * (float)i / (float)segments;
+            TileVertex& tv = tileVertices[ j * ring + i ];
+            float p[3];
+            mapToSphere( u, v, p );
+            tv.x = p[0]; tv.y = p[1]; tv.z = p[2];
+            tv.s = 1.0f - (float)i / (float)segments;
+            tv.t = 1.0f - (float)j / (float)segments;
+        }
+    }
+
+    if ( segments == tileIndexSegments )
+        return;
+
+    // counterclockwise from outside, same as the sphere - the ones at the
+    // poles have no area, but that doesn't hurt anything
+    tileIndices.clear();
+    for ( int j = 0; j < segments; j++ )
+    {
+        for ( int i = 0; i < segments; i++ )
+        {
+            GLushort upper = ( j * ring ) + i;
+            GLushort lower = upper + ring;
+            tileIndices.push_back( lower );
+            tileIndices.push_back( upper );
+            tileIndices.push_back( lower + 1 );
+            tileIndices.push_back( upper );
+            tileIndices.push_back( upper + 1 );
+            tileIndices.push_back( lower + 1 );
+        }
+    }
+    tileIndexSegments = segments;
+}
+
+void EarthTiles::getArea( const TileKey& key, float& u0, float& u1,
+                            float& v0, float& v1 )
+{
+    float columns = (float)( 2 << key.level );
+    float rows = (float)( 1 << key.level );
+    u0 = (float)key.x / columns;
+    u1 = (float)( key.x + 1 ) / columns;
+    v0 = (float)key.y / rows;
+    v1 = (float)( key.y + 1 ) / rows;
+}
+
+void EarthTiles::mapToSphere( float u, float v, float* p )
+{
+    // the inverse of the texture coords on Earth's sphere
+    float theta = 2.0f * M_PI * ( 1.0f - u );
+    float rho = M_PI * v;
+    p[0] = sin( rho ) * sin( theta );
+    p[1] = sin( rho ) * cos( theta );
+    p[2] = cos( rho );
+}
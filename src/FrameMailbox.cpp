@@ -0,0 +1,177 @@
+/*
+ * @file FrameMailbox.cpp
+ *
+ * Implementation of the FrameMailbox class. See FrameMailbox.h for details.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "FrameMailbox.h"
+
+#include <cstddef>
+
+FrameMailbox::FrameMailbox()
+{
+    for ( int i = 0; i < numSlots; i++ )
+    {
+        slots[i].data = NULL;
+        slots[i].capacity = 0;
+        slots[i].size = 0;
+        slots[i].width = 0;
+        slots[i].height = 0;
+        slots[i].nativeWidth = 0;
+        slots[i].nativeHeight = 0;
+        slots[i].format = 0;
+    }
+
+    front = 0;
+    ready = 1;
+    back = 2;
+
+    scaleLevel = 0;
+
+    refCount = 1;
+    droppedCount = 0;
+    publishedCount = 0;
+    queuedCount = 0;
+    queueDroppedCount = 0;
+}
+
+FrameMailbox::~FrameMailbox()
+{
+    for ( int i = 0; i < numSlots; i++ )
+        delete[] slots[i].data;
+}
+
+void FrameMailbox::retain()
+{
+    __sync_add_and_fetch( &refCount, 1 );
+}
+
+void FrameMailbox::release()
+{
+    if ( __sync_sub_and_fetch( &refCount, 1 ) == 0 )
+        delete this;
+}
+
+unsigned char* FrameMailbox::beginWrite( unsigned int size, unsigned int width,
+                                            unsigned int height,
+                                            unsigned int nativeWidth,
+                                            unsigned int nativeHeight,
+                                            int format )
+{
+    FrameSlot& slot = slots[ back ];
+
+    if ( slot.capacity < size )
+    {
+        delete[] slot.data;
+        slot.data = new unsigned char[ size ];
+        slot.capacity = size;
+    }
+
+    slot.size = size;
+    slot.width = width;
+    slot.height = height;
+    slot.nativeWidth = nativeWidth;
+    slot.nativeHeight = nativeHeight;
+    slot.format = format;
+
+    return slot.data;
+}
+
+void FrameMailbox::publish()
+{
+    int old = exchangeReady( back | freshBit );
+
+    // if the old one was never picked up the renderer is behind
+    if ( old & freshBit )
+        __sync_add_and_fetch( &droppedCount, 1 );
+    __sync_add_and_fetch( &publishedCount, 1 );
+
+    back = old & indexMask;
+}
+
+bool FrameMailbox::acquire()
+{
+    if ( !( ready & freshBit ) )
+        return false;
+
+    int old = exchangeReady( front );
+    front = old & indexMask;
+    return true;
+}
+
+const FrameSlot* FrameMailbox::getFront()
+{
+    return &slots[ front ];
+}
+
+bool FrameMailbox::hasFresh()
+{
+    return ( ready & freshBit ) != 0;
+}
+
+void FrameMailbox::setScaleLevel( int level )
+{
+    scaleLevel = level;
+}
+
+int FrameMailbox::getScaleLevel()
+{
+    return scaleLevel;
+}
+
+unsigned int FrameMailbox::getDroppedCount()
+{
+    return droppedCount;
+}
+
+unsigned int FrameMailbox::getPublishedCount()
+{
+    return publishedCount;
+}
+
+void FrameMailbox::setQueueState( int queued, unsigned int dropped )
+{
+    queuedCount = queued;
+    queueDroppedCount = dropped;
+}
+
+int FrameMailbox::getQueuedCount()
+{
+    return queuedCount;
+}
+
+unsigned int FrameMailbox::getQueueDroppedCount()
+{
+    return queueDroppedCount;
+}
+
+int FrameMailbox::exchangeReady( int value )
+{
+    // the CAS is a full barrier, so the slot contents written before this are
+    // visible to whoever swaps it out next
+    int old;
+    do
+    {
+        old = ready;
+    } while ( __sync_val_compare_and_swap( &ready, old, value ) != old );
+
+    return old;
+}
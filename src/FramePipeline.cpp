@@ -0,0 +1,247 @@
+/*
+ * @file FramePipeline.cpp
+ *
+ * Implementation of the FramePipeline class. See FramePipeline.h for details.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "FramePipeline.h"
+#include "gravUtil.h"
+
+#include <wx/thread.h>
+
+#include <algorithm>
+#include <cstring>
+
+FramePipeline::FramePipeline( int numThreads )
+{
+    quit = false;
+    wake = new wxSemaphore();
+    pipelineMutex = mutex_create();
+    queuedCount = 0;
+    droppedCount = 0;
+
+    if ( numThreads < 1 )
+        numThreads = 1;
+    for ( int i = 0; i < numThreads; i++ )
+        threads.push_back( thread_start( workerThread, this ) );
+
+    gravUtil::logVerbose( "FramePipeline::FramePipeline: started %i "
+            "threads\n", numThreads );
+}
+
+FramePipeline::~FramePipeline()
+{
+    // queues belong to the sinks, which should all be gone by now
+    quit = true;
+    for ( unsigned int i = 0; i < threads.size(); i++ )
+        wake->Post();
+    for ( unsigned int i = 0; i < threads.size(); i++ )
+        thread_join( threads[i] );
+
+    delete wake;
+    mutex_free( pipelineMutex );
+}
+
+FramePipeline::Queue* FramePipeline::createQueue( Handler handler,
+                                                    void* data, int depth )
+{
+    Queue* queue = new Queue;
+    queue->pipeline = this;
+    queue->handler = handler;
+    queue->handlerData = data;
+    queue->depth = std::max( depth, 2 );
+    queue->scheduled = false;
+    queue->running = false;
+    queue->closed = false;
+    queue->droppedCount = 0;
+    queue->finished = NULL;
+    return queue;
+}
+
+void FramePipeline::destroyQueue( Queue* queue )
+{
+    mutex_lock( pipelineMutex );
+    queue->closed = true;
+    if ( queue->scheduled )
+    {
+        ready.erase( std::find( ready.begin(), ready.end(), queue ) );
+        queue->scheduled = false;
+    }
+    queuedCount -= queue->frames.size();
+    // if a thread's in the middle of one of its frames, it lets us know when
+    // it's done - should only be a frame's worth of waiting at most
+    if ( queue->running )
+        queue->finished = new wxSemaphore();
+    mutex_unlock( pipelineMutex );
+
+    if ( queue->finished != NULL )
+    {
+        queue->finished->Wait();
+        delete queue->finished;
+    }
+
+    for ( unsigned int i = 0; i < queue->frames.size(); i++ )
+        delete queue->frames[i];
+    for ( unsigned int i = 0; i < queue->spares.size(); i++ )
+        delete queue->spares[i];
+    delete queue;
+}
+
+int FramePipeline::getNumThreads()
+{
+    return threads.size();
+}
+
+int FramePipeline::getQueuedCount()
+{
+    mutex_lock( pipelineMutex );
+    int ret = queuedCount;
+    mutex_unlock( pipelineMutex );
+    return ret;
+}
+
+unsigned int FramePipeline::getDroppedCount()
+{
+    mutex_lock( pipelineMutex );
+    unsigned int ret = droppedCount;
+    mutex_unlock( pipelineMutex );
+    return ret;
+}
+
+void FramePipeline::schedule( Queue* queue )
+{
+    queue->scheduled = true;
+    ready.push_back( queue );
+    // one post per time a queue gets in line, so each wakeup has one to take
+    // (or none, if it was destroyed in between)
+    wake->Post();
+}
+
+void* FramePipeline::workerThread( void* args )
+{
+    FramePipeline* pipeline = (FramePipeline*)args;
+    pipeline->workerLoop();
+    return NULL;
+}
+
+void FramePipeline::workerLoop()
+{
+    while ( true )
+    {
+        wake->Wait();
+        if ( quit )
+            break;
+
+        mutex_lock( pipelineMutex );
+        if ( ready.empty() )
+        {
+            mutex_unlock( pipelineMutex );
+            continue;
+        }
+        Queue* queue = ready.front();
+        ready.pop_front();
+        queue->scheduled = false;
+        queue->running = true;
+        Queue::Frame* frame = queue->frames.front();
+        queue->frames.pop_front();
+        queuedCount--;
+        mutex_unlock( pipelineMutex );
+
+        queue->handler( queue->handlerData, &frame->data[0], frame->width,
+                        frame->height );
+
+        mutex_lock( pipelineMutex );
+        queue->spares.push_back( frame );
+        queue->running = false;
+        // back of the line, so busy sources don't starve the others
+        if ( queue->closed )
+        {
+            // destroyQueue is waiting on this - the queue can be gone as
+            // soon as it's posted
+            if ( queue->finished != NULL )
+                queue->finished->Post();
+        }
+        else if ( !queue->frames.empty() )
+        {
+            schedule( queue );
+        }
+        mutex_unlock( pipelineMutex );
+    }
+}
+
+void FramePipeline::Queue::push( const unsigned char* frame,
+                                    unsigned int size, unsigned int width,
+                                    unsigned int height )
+{
+    // the frames in the queue stay where they are until the new one is
+    // ready, since a thread could take the queue any time it's in line
+    mutex_lock( pipeline->pipelineMutex );
+    Frame* dest;
+    if ( !spares.empty() )
+    {
+        dest = spares.back();
+        spares.pop_back();
+    }
+    else
+    {
+        dest = new Frame;
+    }
+    mutex_unlock( pipeline->pipelineMutex );
+
+    // copying outside the lock, since the buffer isn't in the queue right now
+    // & nothing else touches it
+    dest->data.resize( size );
+    memcpy( &dest->data[0], frame, size );
+    dest->width = width;
+    dest->height = height;
+
+    mutex_lock( pipeline->pipelineMutex );
+    if ( (int)frames.size() >= depth )
+    {
+        // full - the oldest one gets dropped & its buffer saved for later
+        spares.push_back( frames.front() );
+        frames.pop_front();
+        pipeline->queuedCount--;
+        droppedCount++;
+        pipeline->droppedCount++;
+    }
+    frames.push_back( dest );
+    pipeline->queuedCount++;
+    if ( !scheduled && !running )
+        pipeline->schedule( this );
+    mutex_unlock( pipeline->pipelineMutex );
+}
+
+int FramePipeline::Queue::getQueuedCount()
+{
+    mutex_lock( pipeline->pipelineMutex );
+    int ret = frames.size();
+    mutex_unlock( pipeline->pipelineMutex );
+    return ret;
+}
+
+unsigned int FramePipeline::Queue::getDroppedCount()
+{
+    mutex_lock( pipeline->pipelineMutex );
+    unsigned int ret = droppedCount;
+    mutex_unlock( pipeline->pipelineMutex );
+    return ret;
+}
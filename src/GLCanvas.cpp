@@ -28,6 +28,7 @@
 #include "GLCanvas.h"
 #include "InputHandler.h"
 #include "Timers.h"
+#include "Matrix.h"
 
 BEGIN_EVENT_TABLE(GLCanvas, wxGLCanvas)
 EVT_PAINT(GLCanvas::handlePaintEvent)
@@ -124,8 +125,16 @@ void GLCanvas::resize( wxSizeEvent& evt )
 
 void GLCanvas::GLreshape( int w, int h )
 {
-    glViewport(0, 0, w, h);
+    setupView( objectMan, w, h );
+}
+
+void GLCanvas::setupView( ObjectManager* objectMan, int w, int h )
+{
+    GLUtil* glUtil = GLUtil::getInstance();
+    glUtil->setViewport( 0, 0, w, h );
 
+    // tracks the aspect ratio of the screen
+    float screen_width, screen_height;
     if (w > h)
     {
         screen_height = 1.0;
@@ -137,20 +146,17 @@ void GLCanvas::GLreshape( int w, int h )
         screen_width = 1.0;
     }
 
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
     //glFrustum(-screen_width/10.0, screen_width/10.0,
     //          -screen_height/10.0, screen_height/10.0,
     //          0.1, 50.0);
-    glFrustum(-screen_width, screen_width,
-              -screen_height, screen_height,
-              1.0, 50.0);
-
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
-    gluLookAt(objectMan->getCamX(), objectMan->getCamY(), objectMan->getCamZ(),
-              0.0, 0.0, -25.0,
-              0.0, 1.0, 0.0);
+    glUtil->setProjection( Matrix::frustum( -screen_width, screen_width,
+                                            -screen_height, screen_height,
+                                            1.0f, 50.0f ) );
+
+    glUtil->setModelview( Matrix::lookAt(
+            Point( objectMan->getCamX(), objectMan->getCamY(),
+                   objectMan->getCamZ() ),
+            Point( 0.0f, 0.0f, -25.0f ), Vector( 0.0f, 1.0f, 0.0f ) ) );
 
     // note this should be done last since stuff inside setwindowsize
     // (finding the world space bounds for the screen) depends on the matrices
@@ -25,6 +25,10 @@
 #include "VideoSource.h"
 #include "GLUtil.h"
 #include "PNGLoader.h"
+#include "BatchRenderer.h"
+#include "GlyphAtlas.h"
+#include "ResourceLoader.h"
+#include "WorkerPool.h"
 
 #include <string>
 
@@ -49,12 +53,11 @@ bool GLUtil::initGL()
     sscanf( glVer, "%d.%d", &glMajorVer, &glMinorVer );
     if ( glMajorVer >= 2 && enableShaders )
     {
-        YUV420Program = GLUtil::loadShaders( "GLSL/YUV420toRGB24" );
-        if ( YUV420Program )
+        const char* planarSamplers[] = { "yTexture", "uTexture", "vTexture" };
+
+        if ( loadProgram( PROGRAM_YUV_PLANAR, fragYUVPlanar, 3,
+                            planarSamplers ) )
         {
-            YUV420xOffsetID = glGetUniformLocation( YUV420Program, "xOffset" );
-            YUV420yOffsetID = glGetUniformLocation( YUV420Program, "yOffset" );
-            YUV420alphaID = glGetUniformLocation( YUV420Program, "alpha" );
             shadersAvailable = true;
             gravUtil::logVerbose( "GLUtil::initGL(): shaders are available "
                     "(GL v%s)\n", glVer );
@@ -79,6 +82,33 @@ bool GLUtil::initGL()
                 "(GL v%s)\n", glVer );
     }
 
+    // NPOT is core in 2.0, but check the extension as well for older cards
+    nonPow2TexturesAvailable = glMajorVer >= 2 ||
+        GLEW_ARB_texture_non_power_of_two;
+
+    // PBOs + fences for async texture uploads - PBOs alone would still block
+    // when we go to write to one the GL hasn't finished reading from yet
+    if ( enablePixelBuffers && GLEW_ARB_pixel_buffer_object && GLEW_ARB_sync )
+    {
+        pixelBuffersAvailable = true;
+        gravUtil::logVerbose( "GLUtil::initGL(): pixel buffer objects are "
+                "available\n" );
+    }
+    else
+    {
+        pixelBuffersAvailable = false;
+        gravUtil::logVerbose( "GLUtil::initGL(): pixel buffer objects NOT "
+                "available or disabled, using direct texture uploads\n" );
+    }
+
+    // VBOs are core in 1.5
+    vertexBuffersAvailable = glMajorVer >= 2 ||
+        ( glMajorVer == 1 && glMinorVer >= 5 ) ||
+        GLEW_ARB_vertex_buffer_object;
+    batchRenderer = new BatchRenderer( vertexBuffersAvailable );
+    gravUtil::logVerbose( "GLUtil::initGL(): batching %s vertex buffers\n",
+            vertexBuffersAvailable ? "with" : "without" );
+
     gravUtil* util = gravUtil::getInstance();
     std::string fontLoc = util->findFile( "FreeSans.ttf" );
     bool found = fontLoc.compare( "" ) != 0;
@@ -108,7 +138,16 @@ bool GLUtil::initGL()
     else
     {
         gravUtil::logVerbose( "GLUtil::initGL(): font created\n" );
-        mainFont->FaceSize( 100 );
+        mainFont->FaceSize( fontSize );
+    }
+
+    textAtlas = new GlyphAtlas();
+    if ( !textAtlas->load( fontLoc, fontSize ) )
+    {
+        gravUtil::logWarning( "GLUtil::initGL(): glyph atlas failed, text "
+                "will not be batched\n" );
+        delete textAtlas;
+        textAtlas = NULL;
     }
 
     // TODO this is platform-specific, see the glxew include in glutil.h
@@ -122,6 +161,9 @@ bool GLUtil::initGL()
 
     glEnable( GL_DEPTH_TEST );
 
+    // decoding is the slow part of loading, so spread it over a few threads
+    resourceLoader = new ResourceLoader( WorkerPool::getDefaultSize( 4 ) );
+
     return true;
 }
 
@@ -134,17 +176,50 @@ void GLUtil::cleanupGL()
     }
 }
 
-void GLUtil::updateMatrices()
+void GLUtil::setProjection( const Matrix& p )
 {
-    glGetDoublev( GL_MODELVIEW_MATRIX, modelview );
-    glGetDoublev( GL_PROJECTION_MATRIX, projection );
-    glGetIntegerv( GL_VIEWPORT, viewport );
+    projection = p;
+    inverseValid = false;
+
+    glMatrixMode( GL_PROJECTION );
+    glLoadMatrixf( projection.get() );
+    glMatrixMode( GL_MODELVIEW );
 }
 
-void GLUtil::printMatrices()
+void GLUtil::setModelview( const Matrix& m )
+{
+    modelview = m;
+    inverseValid = false;
+
+    glLoadMatrixf( modelview.get() );
+}
+
+void GLUtil::setViewport( int x, int y, int w, int h )
 {
-    updateMatrices();
+    viewport[0] = x; viewport[1] = y;
+    viewport[2] = w; viewport[3] = h;
 
+    glViewport( x, y, w, h );
+}
+
+const Matrix& GLUtil::getProjection()
+{
+    return projection;
+}
+
+const Matrix& GLUtil::getModelview()
+{
+    return modelview;
+}
+
+void GLUtil::getViewport( int* v )
+{
+    for ( int i = 0; i < 4; i++ )
+        v[i] = viewport[i];
+}
+
+void GLUtil::printMatrices()
+{
     gravUtil::logVerbose( "printing modelview matrix:\n[" );
     int c = 0;
     for ( int i = 0; i < 16; i++ )
@@ -199,18 +274,26 @@ void GLUtil::printMatrices()
 void GLUtil::worldToScreen( GLdouble x, GLdouble y, GLdouble z,
                                 GLdouble* scrX, GLdouble* scrY, GLdouble* scrZ )
 {
-    updateMatrices();
+    // same as gluProject, but with our copies of the matrices
+    float world[4] = { (float)x, (float)y, (float)z, 1.0f };
+    float eye[4], clip[4];
+    modelview.transform( world, eye );
+    projection.transform( eye, clip );
+    if ( clip[3] == 0.0f )
+    {
+        gravUtil::logWarning( "GLUtil::worldToScreen: point can't be "
+                "projected\n" );
+        return;
+    }
 
-    GLint ret = gluProject( x, y, z, modelview, projection, viewport,
-                            scrX, scrY, scrZ );
-    if ( ret == 0 )
-        gravUtil::logWarning( "GLUtil::worldToScreen: gluproject returned "
-                "false\n" );
+    *scrX = viewport[0] + viewport[2] * ( clip[0] / clip[3] + 1.0 ) / 2.0;
+    *scrY = viewport[1] + viewport[3] * ( clip[1] / clip[3] + 1.0 ) / 2.0;
+    *scrZ = ( clip[2] / clip[3] + 1.0 ) / 2.0;
 }
 
 void GLUtil::worldToScreen( Point worldPoint, Point& screenPoint )
 {
-    GLdouble screenX, screenY, screenZ;
+    GLdouble screenX = 0.0, screenY = 0.0, screenZ = 0.0;
     worldToScreen( (GLdouble)worldPoint.getX(), (GLdouble)worldPoint.getY(),
             (GLdouble)worldPoint.getZ(), &screenX, &screenY, &screenZ );
     screenPoint.setX( (float)screenX );
@@ -221,18 +304,44 @@ void GLUtil::worldToScreen( Point worldPoint, Point& screenPoint )
 void GLUtil::screenToWorld( GLdouble scrX, GLdouble scrY, GLdouble scrZ,
                                 GLdouble* x, GLdouble* y, GLdouble* z )
 {
-    updateMatrices();
+    // same as gluUnProject, but with our copies of the matrices
+    if ( !inverseValid )
+    {
+        inverseValid = ( projection * modelview ).invert(
+                                                    inverseViewProjection );
+        if ( !inverseValid )
+        {
+            gravUtil::logWarning( "GLUtil::screenToWorld: camera matrix "
+                    "can't be inverted\n" );
+            return;
+        }
+    }
 
-    GLint ret = gluUnProject( scrX, scrY, scrZ, modelview, projection, viewport,
-                    x, y, z );
-    if ( ret == 0 )
-        gravUtil::logWarning( "GLUtil::screenToWorld: gluunproject returned "
-                "false\n" );
+    if ( viewport[2] == 0 || viewport[3] == 0 )
+        return;
+
+    float device[4] = {
+        (float)( ( scrX - viewport[0] ) * 2.0 / viewport[2] - 1.0 ),
+        (float)( ( scrY - viewport[1] ) * 2.0 / viewport[3] - 1.0 ),
+        (float)( scrZ * 2.0 - 1.0 ),
+        1.0f };
+    float world[4];
+    inverseViewProjection.transform( device, world );
+    if ( world[3] == 0.0f )
+    {
+        gravUtil::logWarning( "GLUtil::screenToWorld: point can't be "
+                "unprojected\n" );
+        return;
+    }
+
+    *x = world[0] / world[3];
+    *y = world[1] / world[3];
+    *z = world[2] / world[3];
 }
 
 void GLUtil::screenToWorld( Point screenPoint, Point& worldPoint )
 {
-    GLdouble worldX, worldY, worldZ;
+    GLdouble worldX = 0.0, worldY = 0.0, worldZ = 0.0;
     screenToWorld( (GLdouble)screenPoint.getX(), (GLdouble)screenPoint.getY(),
             (GLdouble)screenPoint.getZ(), &worldX, &worldY, &worldZ );
     worldPoint.setX( (float)worldX );
@@ -255,19 +364,14 @@ bool GLUtil::screenToRectIntersect( GLdouble x, GLdouble y, RectangleBase rect,
     return rect.findRayIntersect( r, intersect );
 }
 
-GLuint GLUtil::loadShaders( const char* location )
+GLuint GLUtil::loadShaders( const GLchar* vertSource,
+                            const GLchar* fragSource )
 {
-    /*std::string vertLoc;
-    std::string fragLoc;
-
-    vertLoc = std::string(location) + std::string(".vert");
-    fragLoc = std::string(location) + std::string(".frag");*/
-
     GLuint vertexShader = glCreateShader( GL_VERTEX_SHADER );
     GLuint fragmentShader = glCreateShader( GL_FRAGMENT_SHADER );
 
-    glShaderSource( vertexShader, 1, (const GLchar**)&vert420, NULL );
-    glShaderSource( fragmentShader, 1, (const GLchar**)&frag420, NULL );
+    glShaderSource( vertexShader, 1, &vertSource, NULL );
+    glShaderSource( fragmentShader, 1, &fragSource, NULL );
 
     glCompileShader( vertexShader );
 
@@ -334,24 +438,43 @@ GLuint GLUtil::loadShaders( const char* location )
     return program;
 }
 
-GLuint GLUtil::getYUV420Program()
+bool GLUtil::loadProgram( ShaderProgram p, const GLchar* fragSource,
+                            int numSamplers, const char** samplerNames )
 {
-    return YUV420Program;
+    GLuint program = loadShaders( vertVideo, fragSource );
+    if ( program == 0 )
+        return false;
+
+    programs[ p ] = program;
+    programAlphaIDs[ p ] = glGetUniformLocation( program, "alpha" );
+
+    // samplers are fixed to units 0 and up, so just set them once here
+    glUseProgram( program );
+    for ( int i = 0; i < numSamplers; i++ )
+        glUniform1i( glGetUniformLocation( program, samplerNames[i] ), i );
+    glUseProgram( 0 );
+
+    return true;
 }
 
-GLuint GLUtil::getYUV420xOffsetID()
+GLuint GLUtil::getProgram( ShaderProgram p )
 {
-    return YUV420xOffsetID;
+    return programs[ p ];
 }
 
-GLuint GLUtil::getYUV420yOffsetID()
+GLint GLUtil::getProgramAlphaID( ShaderProgram p )
 {
-    return YUV420yOffsetID;
+    return programAlphaIDs[ p ];
 }
 
-GLuint GLUtil::getYUV420alphaID()
+bool GLUtil::isProgramAvailable( ShaderProgram p )
 {
-    return YUV420alphaID;
+    return p == PROGRAM_NONE || programs[ p ] != 0;
+}
+
+BatchRenderer* GLUtil::getBatchRenderer()
+{
+    return batchRenderer;
 }
 
 FTFont* GLUtil::getMainFont()
@@ -359,6 +482,26 @@ FTFont* GLUtil::getMainFont()
     return mainFont;
 }
 
+GlyphAtlas* GLUtil::getTextAtlas()
+{
+    return textAtlas;
+}
+
+FTBBox GLUtil::getTextBounds( const std::string& text )
+{
+    if ( textAtlas != NULL )
+    {
+        float lx, ly, ux, uy;
+        textAtlas->getBounds( text, lx, ly, ux, uy );
+        return FTBBox( lx, ly, 0.0f, ux, uy, 0.0f );
+    }
+    else if ( mainFont != NULL )
+    {
+        return mainFont->BBox( text.c_str() );
+    }
+    return FTBBox();
+}
+
 bool GLUtil::areShadersAvailable()
 {
     return shadersAvailable;
@@ -369,22 +512,58 @@ void GLUtil::setShaderEnable( bool es )
     enableShaders = es;
 }
 
+bool GLUtil::arePixelBuffersAvailable()
+{
+    return pixelBuffersAvailable;
+}
+
+bool GLUtil::areVertexBuffersAvailable()
+{
+    return vertexBuffersAvailable;
+}
+
+void GLUtil::setPixelBufferEnable( bool epb )
+{
+    enablePixelBuffers = epb;
+}
+
+bool GLUtil::areNonPow2TexturesAvailable()
+{
+    return nonPow2TexturesAvailable;
+}
+
 void GLUtil::setBufferFontUsage( bool buf )
 {
     useBufferFont = buf;
 }
 
-bool GLUtil::addTexture( std::string name, std::string fileName )
+bool GLUtil::addTexture( std::string name, std::string fileName,
+                            bool mipmap )
 {
     Texture t;
 
     std::string texLoc = gravUtil::getInstance()->findFile( fileName );
     if ( texLoc.compare( "" ) != 0 )
     {
-        t.ID = PNGLoader::loadPNG( texLoc, t.width, t.height );
-        if ( t.ID != 0 )
+        // only the header is read here, so things that use the texture can
+        // get its size & ID right away
+        if ( PNGLoader::readPNGSize( texLoc, t.width, t.height ) )
         {
+            t.ID = PNGLoader::createTexture( t.width, t.height );
             textures[ name ] = t;
+
+            ResourceLoader::Job* job = new TextureLoadJob( t.ID, texLoc,
+                    t.width, t.height, mipmap );
+            if ( resourceLoader != NULL )
+            {
+                resourceLoader->add( job );
+            }
+            else
+            {
+                job->load();
+                job->finish();
+                delete job;
+            }
             return true;
         }
         else
@@ -421,6 +600,117 @@ Texture GLUtil::getTexture( std::string name )
     }
 }
 
+void GLUtil::finishResourceLoads()
+{
+    // each of these can be a whole texture upload (plus mipmaps), so only do
+    // a couple per frame
+    if ( resourceLoader != NULL )
+        resourceLoader->finishLoaded( 2 );
+}
+
+bool GLUtil::areResourcesLoading()
+{
+    return resourceLoader != NULL && resourceLoader->isBusy();
+}
+
+ResourceLoader* GLUtil::getResourceLoader()
+{
+    return resourceLoader;
+}
+
+bool GLUtil::generateMipmaps( GLuint tex )
+{
+    if ( !GLEW_VERSION_3_0 && !GLEW_ARB_framebuffer_object &&
+            !GLEW_EXT_framebuffer_object )
+    {
+        gravUtil::logVerbose( "GLUtil::generateMipmaps: mipmap generation not "
+                "available\n" );
+        return false;
+    }
+
+    glBindTexture( GL_TEXTURE_2D, tex );
+    if ( GLEW_VERSION_3_0 || GLEW_ARB_framebuffer_object )
+        glGenerateMipmap( GL_TEXTURE_2D );
+    else
+        glGenerateMipmapEXT( GL_TEXTURE_2D );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                        GL_LINEAR_MIPMAP_LINEAR );
+    glBindTexture( GL_TEXTURE_2D, 0 );
+    return true;
+}
+
+GLuint GLUtil::borrowTexture( GLenum format, int width, int height )
+{
+    TexturePoolKey key( format, std::pair<int, int>( width, height ) );
+    std::vector<GLuint>& spares = texturePool[ key ];
+    if ( !spares.empty() )
+    {
+        GLuint tex = spares.back();
+        spares.pop_back();
+        return tex;
+    }
+
+    GLuint tex;
+    glGenTextures( 1, &tex );
+    glBindTexture( GL_TEXTURE_2D, tex );
+
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+
+    // storage only, whoever borrows it will fill it
+    glTexImage2D( GL_TEXTURE_2D, 0, format, width, height, 0, format,
+                    GL_UNSIGNED_BYTE, NULL );
+    glBindTexture( GL_TEXTURE_2D, 0 );
+
+    return tex;
+}
+
+void GLUtil::returnTexture( GLuint tex, GLenum format, int width, int height )
+{
+    if ( tex == 0 )
+        return;
+
+    TexturePoolKey key( format, std::pair<int, int>( width, height ) );
+    std::vector<GLuint>& spares = texturePool[ key ];
+    if ( spares.size() < maxPoolSize )
+        spares.push_back( tex );
+    else
+        glDeleteTextures( 1, &tex );
+}
+
+GLuint GLUtil::borrowPixelBuffer( unsigned int size )
+{
+    std::vector<GLuint>& spares = pixelBufferPool[ size ];
+    if ( !spares.empty() )
+    {
+        GLuint buf = spares.back();
+        spares.pop_back();
+        return buf;
+    }
+
+    GLuint buf;
+    glGenBuffers( 1, &buf );
+    glBindBuffer( GL_PIXEL_UNPACK_BUFFER, buf );
+    glBufferData( GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW );
+    glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0 );
+
+    return buf;
+}
+
+void GLUtil::returnPixelBuffer( GLuint buf, unsigned int size )
+{
+    if ( buf == 0 )
+        return;
+
+    std::vector<GLuint>& spares = pixelBufferPool[ size ];
+    if ( spares.size() < maxPoolSize )
+        spares.push_back( buf );
+    else
+        glDeleteBuffers( 1, &buf );
+}
+
 void GLUtil::setCanvas( GLCanvas* c )
 {
     canvas = c;
@@ -434,22 +724,39 @@ GLCanvas* GLUtil::getCanvas()
 GLUtil::GLUtil()
 {
     enableShaders = false;
+    shadersAvailable = false;
+    enablePixelBuffers = true;
+    pixelBuffersAvailable = false;
+    vertexBuffersAvailable = false;
+    nonPow2TexturesAvailable = false;
     useBufferFont = false;
     mainFont = NULL;
+    textAtlas = NULL;
+    batchRenderer = NULL;
+    resourceLoader = NULL;
+    maxPoolSize = 8;
+    for ( int i = 0; i < 4; i++ )
+        viewport[i] = 0;
+    inverseValid = false;
+    for ( int i = 0; i < NUM_PROGRAMS; i++ )
+    {
+        programs[i] = 0;
+        programAlphaIDs[i] = -1;
+    }
 
-    frag420 =
-    "uniform sampler2D texture;\n"
+    fragYUVPlanar =
+    "uniform sampler2D yTexture;\n"
+    "uniform sampler2D uTexture;\n"
+    "uniform sampler2D vTexture;\n"
     "uniform float alpha;\n"
     "\n"
-    "varying vec2 yCoord;\n"
-    "varying vec2 uCoord;\n"
-    "varying vec2 vCoord;\n"
+    "varying vec2 texCoord;\n"
     "\n"
     "void main( void )\n"
     "{\n"
-    "    float y = texture2D( texture, yCoord ).r;\n"
-    "    float u = texture2D( texture, uCoord ).r;\n"
-    "    float v = texture2D( texture, vCoord ).r;\n"
+    "    float y = texture2D( yTexture, texCoord ).r;\n"
+    "    float u = texture2D( uTexture, texCoord ).r;\n"
+    "    float v = texture2D( vTexture, texCoord ).r;\n"
     "\n"
     "    float cb = u - 0.5;\n"
     "    float cr = v - 0.5;\n"
@@ -460,24 +767,15 @@ GLUtil::GLUtil()
     "                         alpha );\n"
     "}\n";
 
-    vert420 =
-    "uniform float xOffset;\n"
-    "uniform float yOffset;\n"
-    "\n"
-    "varying vec2 yCoord;\n"
-    "varying vec2 uCoord;\n"
-    "varying vec2 vCoord;\n"
+    // planes are all exactly sized, so the only thing to do here is flip
+    // vertically since the image data is top row first
+    vertVideo =
+    "varying vec2 texCoord;\n"
     "\n"
     "void main( void )\n"
     "{\n"
-    "    yCoord.s = gl_MultiTexCoord0.s;\n"
-    "    yCoord.t = yOffset - gl_MultiTexCoord0.t;\n"
-    "\n"
-    "    uCoord.s = (gl_MultiTexCoord0.s/2.0);\n"
-    "    uCoord.t = (3.0*yOffset/2.0) - (gl_MultiTexCoord0.t/2.0);\n"
-    "\n"
-    "    vCoord.s = uCoord.s + xOffset/2.0;\n"
-    "    vCoord.t = uCoord.t;\n"
+    "    texCoord.s = gl_MultiTexCoord0.s;\n"
+    "    texCoord.t = 1.0 - gl_MultiTexCoord0.t;\n"
     "\n"
     "    gl_Position = ftransform();\n"
     "}\n";
@@ -485,14 +783,34 @@ GLUtil::GLUtil()
 
 GLUtil::~GLUtil()
 {
+    // first, so nothing's still loading into the textures deleted below
+    delete resourceLoader;
+
     if ( mainFont != NULL )
     {
         delete mainFont;
     }
 
+    delete textAtlas;
+    delete batchRenderer;
+
     std::map<std::string, Texture>::iterator i;
     for ( i = textures.begin(); i != textures.end(); ++i )
     {
         glDeleteTextures( 1, &( i->second.ID ) );
     }
+
+    std::map<TexturePoolKey, std::vector<GLuint> >::iterator j;
+    for ( j = texturePool.begin(); j != texturePool.end(); ++j )
+    {
+        if ( !j->second.empty() )
+            glDeleteTextures( j->second.size(), &( j->second[0] ) );
+    }
+
+    std::map<unsigned int, std::vector<GLuint> >::iterator k;
+    for ( k = pixelBufferPool.begin(); k != pixelBufferPool.end(); ++k )
+    {
+        if ( !k->second.empty() )
+            glDeleteBuffers( k->second.size(), &( k->second[0] ) );
+    }
 }
@@ -0,0 +1,329 @@
+/*
+ * @file GeoOverlay.cpp
+ *
+ * Implementation of the GeoOverlay class. See GeoOverlay.h for details.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "GeoOverlay.h"
+#include "Earth.h"
+#include "GLUtil.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
+static const float markerSize = 3.0f;
+static const float selectedMarkerSize = 6.0f;
+static const float linkWidth = 2.0f;
+
+GeoOverlay::GeoOverlay()
+{
+    for ( int i = 0; i < 3; i++ )
+    {
+        earthPos[i] = 0.0f;
+        earthRot[i] = 0.0f;
+    }
+
+    numMarkers = 0;
+    numSelectedMarkers = 0;
+    numLinkVertices = 0;
+
+    drawLinks = false;
+    lastUpdateCount = 0;
+
+    useVertexBuffers = false;
+    vertexBuffer = 0;
+    bufferDirty = false;
+    initialized = false;
+}
+
+GeoOverlay::~GeoOverlay()
+{
+    if ( vertexBuffer != 0 )
+        glDeleteBuffers( 1, &vertexBuffer );
+}
+
+void GeoOverlay::update( Earth* earth,
+                            const std::vector<RectangleBase*>& drawn,
+                            const std::vector<RectangleBase*>& selected )
+{
+    // everything on the globe moves if the globe does
+    float pos[3] = { earth->getX(), earth->getY(), earth->getZ() };
+    float rot[3];
+    earth->getRotation( rot[0], rot[1], rot[2] );
+    bool earthMoved = false;
+    for ( int i = 0; i < 3; i++ )
+    {
+        earthMoved = earthMoved || pos[i] != earthPos[i] ||
+                        rot[i] != earthRot[i];
+        earthPos[i] = pos[i];
+        earthRot[i] = rot[i];
+    }
+
+    std::map<RectangleBase*, Entry>::iterator ei;
+    for ( ei = entries.begin(); ei != entries.end(); ++ei )
+        ei->second.seen = false;
+    lastUpdateCount = 0;
+
+    // markers first, then selected ones on top
+    std::vector<Entry*> shown;
+    for ( unsigned int i = 0; i < drawn.size(); i++ )
+    {
+        if ( !drawn[i]->isGrouped() && !drawn[i]->isSelected() )
+            shown.push_back( &updateEntry( earth, drawn[i], earthMoved ) );
+    }
+    unsigned int firstSelected = shown.size();
+    for ( unsigned int i = 0; i < selected.size(); i++ )
+    {
+        if ( !selected[i]->isGrouped() )
+            shown.push_back( &updateEntry( earth, selected[i], earthMoved ) );
+    }
+
+    // forget about objects that are gone, or don't have markers anymore
+    ei = entries.begin();
+    while ( ei != entries.end() )
+    {
+        if ( !ei->second.seen )
+            entries.erase( ei++ );
+        else
+            ++ei;
+    }
+
+    scratch.clear();
+    for ( unsigned int i = 0; i < shown.size(); i++ )
+        scratch.push_back( shown[i]->marker );
+    if ( drawLinks )
+    {
+        for ( unsigned int i = 0; i < shown.size(); i++ )
+            scratch.insert( scratch.end(), shown[i]->link.begin(),
+                            shown[i]->link.end() );
+    }
+
+    numMarkers = firstSelected;
+    numSelectedMarkers = shown.size() - firstSelected;
+    numLinkVertices = scratch.size() - shown.size();
+
+    // only upload again if something's actually different
+    bool same = scratch.size() == vertices.size() && ( scratch.empty() ||
+        memcmp( &scratch[0], &vertices[0],
+                sizeof( Vertex ) * scratch.size() ) == 0 );
+    if ( !same )
+    {
+        vertices.swap( scratch );
+        bufferDirty = true;
+    }
+}
+
+void GeoOverlay::draw()
+{
+    if ( !initialized )
+    {
+        useVertexBuffers = GLUtil::getInstance()->areVertexBuffersAvailable();
+        if ( useVertexBuffers )
+            glGenBuffers( 1, &vertexBuffer );
+        initialized = true;
+    }
+
+    if ( vertices.empty() )
+        return;
+
+    const GLvoid* base = &vertices[0];
+    if ( useVertexBuffers )
+    {
+        glBindBuffer( GL_ARRAY_BUFFER, vertexBuffer );
+        if ( bufferDirty )
+            glBufferData( GL_ARRAY_BUFFER, sizeof( Vertex ) * vertices.size(),
+                            &vertices[0], GL_DYNAMIC_DRAW );
+        base = NULL;
+    }
+    bufferDirty = false;
+
+    glEnableClientState( GL_VERTEX_ARRAY );
+    glEnableClientState( GL_COLOR_ARRAY );
+    glVertexPointer( 3, GL_FLOAT, sizeof( Vertex ), base );
+    glColorPointer( 4, GL_FLOAT, sizeof( Vertex ),
+                    (const GLubyte*)base + offsetof( Vertex, r ) );
+
+    if ( numMarkers > 0 )
+    {
+        glPointSize( markerSize );
+        glDrawArrays( GL_POINTS, 0, numMarkers );
+    }
+    if ( numSelectedMarkers > 0 )
+    {
+        glPointSize( selectedMarkerSize );
+        glDrawArrays( GL_POINTS, numMarkers, numSelectedMarkers );
+    }
+    if ( numLinkVertices > 0 )
+    {
+        glLineWidth( linkWidth );
+        glDrawArrays( GL_LINES, numMarkers + numSelectedMarkers,
+                        numLinkVertices );
+    }
+
+    glDisableClientState( GL_COLOR_ARRAY );
+    glDisableClientState( GL_VERTEX_ARRAY );
+    if ( useVertexBuffers )
+        glBindBuffer( GL_ARRAY_BUFFER, 0 );
+}
+
+void GeoOverlay::setDrawLinks( bool l )
+{
+    drawLinks = l;
+}
+
+bool GeoOverlay::getDrawLinks()
+{
+    return drawLinks;
+}
+
+int GeoOverlay::getLastUpdateCount()
+{
+    return lastUpdateCount;
+}
+
+GeoOverlay::Entry& GeoOverlay::updateEntry( Earth* earth, RectangleBase* obj,
+                                            bool earthMoved )
+{
+    std::map<RectangleBase*, Entry>::iterator ei = entries.find( obj );
+    if ( ei == entries.end() )
+    {
+        Entry e;
+        e.valid = false;
+        e.haveLink = false;
+        ei = entries.insert( std::make_pair( obj, e ) ).first;
+    }
+    Entry& e = ei->second;
+    e.seen = true;
+
+    float lat = obj->getLat();
+    float lon = obj->getLon();
+    bool recalculated = false;
+
+    if ( !e.valid || earthMoved || lat != e.lat || lon != e.lon )
+    {
+        e.lat = lat;
+        e.lon = lon;
+        earth->convertLatLong( lat, lon, e.marker.x, e.marker.y, e.marker.z );
+        // the line starts at the marker, so it has to be redone as well
+        e.haveLink = false;
+        e.valid = true;
+        recalculated = true;
+    }
+
+    if ( drawLinks && ( !e.haveLink || obj->getX() != e.objX ||
+            obj->getY() != e.objY || obj->getZ() != e.objZ ) )
+    {
+        e.objX = obj->getX();
+        e.objY = obj->getY();
+        e.objZ = obj->getZ();
+        buildLink( earth, e );
+        e.haveLink = true;
+        recalculated = true;
+    }
+
+    // color changes are cheap, so just copy it every time
+    RGBAColor col = obj->getColor();
+    e.marker.r = col.R; e.marker.g = col.G;
+    e.marker.b = col.B; e.marker.a = col.A;
+    for ( unsigned int i = 0; i < e.link.size(); i++ )
+    {
+        e.link[i].r = col.R; e.link[i].g = col.G;
+        e.link[i].b = col.B; e.link[i].a = col.A;
+    }
+
+    if ( recalculated )
+        lastUpdateCount++;
+
+    return e;
+}
+
+void GeoOverlay::buildLink( Earth* earth, Entry& e )
+{
+    std::vector<Vertex> strip;
+    Vertex v = e.marker;
+    float destx = e.objX, desty = e.objY, destz = e.objZ;
+
+    float sx = e.marker.x, sy = e.marker.y, sz = e.marker.z;
+    float vecX = (sx - earth->getX()) * 0.08f;
+    float vecY = (sy - earth->getY()) * 0.08f;
+    float vecZ = (sz - earth->getZ()) * 0.08f;
+    float tx = vecX + sx;
+    float ty = vecY + sy;
+    float tz = vecZ + sz;
+
+    int iter = 15;
+    float zdist = destz-tz;
+    float maxzdist = (earth->getZ()+earth->getRadius())-destz;
+    float distanceScale = fabs(zdist/maxzdist);
+    int i = 0;
+
+    strip.push_back( v );
+
+    // the weight goes negative after iter steps, so the curve should have
+    // reached the object long before this - this is just so it can't go
+    // forever if the object is somewhere odd
+    while ( zdist > 1.0f && i < iter * 4 )
+    {
+        v.x = tx; v.y = ty; v.z = tz;
+        strip.push_back( v );
+        float weight = (((float)(iter-i))/(float)iter)*0.6f;
+
+        // this will push out the current point on the line away from the
+        // earth so it doesn't clip, scaled based on how far we are from the
+        // destination
+        float xpush = 1.5f * distanceScale;
+        float ypush = 1.5f * distanceScale;
+        if ( tx < earth->getX() ) xpush *= -1.0f;
+        if ( ty < earth->getY() ) ypush *= -1.0f;
+
+        // move the current point forward, based on progressively averaging
+        // the earth-pointing-out vector with the vector pointing towards
+        // the destination point
+        tx += (vecX * weight) +
+                ((destx-tx) * (1.0f-weight))
+                + xpush;
+        ty += (vecY * weight) +
+                ((desty-ty)  * (1.0f-weight))
+                + ypush;
+        tz += (vecZ * weight) +
+                ((destz-tz) * (1.0f-weight));
+
+        zdist = destz-tz;
+        distanceScale = fabs(zdist/maxzdist);
+        i++;
+    }
+    // shift the z back a bit so it doesn't overshoot the object
+    if ( tz > destz - 0.3f ) tz -= 0.3f;
+    v.x = tx; v.y = ty; v.z = tz;
+    strip.push_back( v );
+    // -0.05f is so the line doesn't poke through the objects
+    v.x = destx; v.y = desty; v.z = destz-0.05f;
+    strip.push_back( v );
+
+    // as separate segments, so all the lines can go in one draw
+    e.link.clear();
+    for ( unsigned int s = 1; s < strip.size(); s++ )
+    {
+        e.link.push_back( strip[ s-1 ] );
+        e.link.push_back( strip[ s ] );
+    }
+}
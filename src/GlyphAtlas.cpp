@@ -0,0 +1,292 @@
+/*
+ * @file GlyphAtlas.cpp
+ *
+ * Implementation of the GlyphAtlas class. See GlyphAtlas.h for details.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "GlyphAtlas.h"
+#include "gravUtil.h"
+
+#include <algorithm>
+
+GlyphAtlas::GlyphAtlas()
+{
+    library = NULL;
+    face = NULL;
+    texture = 0;
+    penX = padding;
+    penY = padding;
+    rowHeight = 0;
+    full = false;
+}
+
+GlyphAtlas::~GlyphAtlas()
+{
+    if ( texture != 0 )
+        glDeleteTextures( 1, &texture );
+    if ( face != NULL )
+        FT_Done_Face( face );
+    if ( library != NULL )
+        FT_Done_FreeType( library );
+}
+
+bool GlyphAtlas::load( const std::string& fontFile, unsigned int size )
+{
+    if ( FT_Init_FreeType( &library ) != 0 )
+    {
+        gravUtil::logError( "GlyphAtlas::load: failed to init FreeType\n" );
+        library = NULL;
+        return false;
+    }
+
+    if ( FT_New_Face( library, fontFile.c_str(), 0, &face ) != 0 )
+    {
+        gravUtil::logError( "GlyphAtlas::load: failed to load %s\n",
+                fontFile.c_str() );
+        face = NULL;
+        return false;
+    }
+
+    // 72 dpi makes the size in points the same as pixels, like FTGL
+    if ( FT_Set_Char_Size( face, size * 64, size * 64, 72, 72 ) != 0 )
+    {
+        gravUtil::logError( "GlyphAtlas::load: failed to set size %u\n",
+                size );
+        return false;
+    }
+
+    glGenTextures( 1, &texture );
+    glBindTexture( GL_TEXTURE_2D, texture );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+
+    // start out clear, so the padding between glyphs is empty
+    std::vector<GLubyte> blank( atlasWidth * atlasHeight, 0 );
+    glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+    glPixelStorei( GL_UNPACK_ROW_LENGTH, 0 );
+    glTexImage2D( GL_TEXTURE_2D, 0, GL_ALPHA, atlasWidth, atlasHeight, 0,
+                    GL_ALPHA, GL_UNSIGNED_BYTE, &blank[0] );
+
+    for ( unsigned long c = 32; c < 127; c++ )
+        getGlyph( c );
+
+    gravUtil::logVerbose( "GlyphAtlas::load: loaded ASCII from %s, %i rows "
+            "used\n", fontFile.c_str(), ( penY + rowHeight ) );
+    return true;
+}
+
+GLuint GlyphAtlas::getTexture()
+{
+    return texture;
+}
+
+void GlyphAtlas::layout( const std::string& text,
+                            std::vector<GlyphQuad>& quads,
+                            float& lx, float& ly, float& ux, float& uy )
+{
+    lx = ly = ux = uy = 0.0f;
+    bool first = true;
+
+    float x = 0.0f;
+    FT_UInt previous = 0;
+    bool kerning = FT_HAS_KERNING( face );
+
+    unsigned int pos = 0;
+    while ( pos < text.length() )
+    {
+        Glyph& g = getGlyph( decodeUTF8( text, pos ) );
+
+        if ( kerning && previous != 0 && g.index != 0 )
+        {
+            FT_Vector delta;
+            FT_Get_Kerning( face, previous, g.index, FT_KERNING_UNFITTED,
+                            &delta );
+            x += delta.x / 64.0f;
+        }
+
+        if ( g.visible )
+        {
+            GlyphQuad q = g.quad;
+            q.x1 += x;
+            q.x2 += x;
+            quads.push_back( q );
+
+            if ( first )
+            {
+                lx = q.x1; ly = q.y1;
+                ux = q.x2; uy = q.y2;
+                first = false;
+            }
+            else
+            {
+                lx = std::min( lx, q.x1 ); ly = std::min( ly, q.y1 );
+                ux = std::max( ux, q.x2 ); uy = std::max( uy, q.y2 );
+            }
+        }
+
+        x += g.advance;
+        previous = g.index;
+    }
+}
+
+void GlyphAtlas::getBounds( const std::string& text, float& lx, float& ly,
+                            float& ux, float& uy )
+{
+    std::vector<GlyphQuad> quads;
+    layout( text, quads, lx, ly, ux, uy );
+}
+
+unsigned long GlyphAtlas::decodeUTF8( const std::string& text,
+                                        unsigned int& pos )
+{
+    unsigned char lead = (unsigned char)text[ pos ];
+    int extra;
+    unsigned long c;
+    if ( lead < 0x80 )
+    {
+        pos++;
+        return lead;
+    }
+    else if ( ( lead & 0xE0 ) == 0xC0 )
+    {
+        extra = 1;
+        c = lead & 0x1F;
+    }
+    else if ( ( lead & 0xF0 ) == 0xE0 )
+    {
+        extra = 2;
+        c = lead & 0x0F;
+    }
+    else if ( ( lead & 0xF8 ) == 0xF0 )
+    {
+        extra = 3;
+        c = lead & 0x07;
+    }
+    else
+    {
+        pos++;
+        return lead;
+    }
+
+    // cut off at the end of the string
+    if ( pos + extra >= text.length() )
+    {
+        pos++;
+        return lead;
+    }
+    for ( int i = 1; i <= extra; i++ )
+    {
+        unsigned char cont = (unsigned char)text[ pos + i ];
+        if ( ( cont & 0xC0 ) != 0x80 )
+        {
+            pos++;
+            return lead;
+        }
+        c = ( c << 6 ) | ( cont & 0x3F );
+    }
+
+    // overlong forms & surrogates aren't valid either
+    static const unsigned long minForLength[] = { 0, 0x80, 0x800, 0x10000 };
+    if ( c < minForLength[ extra ] || c > 0x10FFFF ||
+            ( c >= 0xD800 && c <= 0xDFFF ) )
+    {
+        pos++;
+        return lead;
+    }
+
+    pos += extra + 1;
+    return c;
+}
+
+GlyphAtlas::Glyph& GlyphAtlas::getGlyph( unsigned long c )
+{
+    std::map<unsigned long, Glyph>::iterator it = glyphs.find( c );
+    if ( it != glyphs.end() )
+        return it->second;
+
+    Glyph& g = glyphs[c];
+    g.visible = false;
+    g.advance = 0.0f;
+    g.index = FT_Get_Char_Index( face, c );
+
+    // no hinting, same as FTGL, so the metrics match
+    if ( FT_Load_Glyph( face, g.index,
+                        FT_LOAD_NO_HINTING | FT_LOAD_NO_BITMAP ) != 0 )
+    {
+        gravUtil::logWarning( "GlyphAtlas::getGlyph: failed to load glyph "
+                "for U+%04lX\n", c );
+        return g;
+    }
+    g.advance = face->glyph->advance.x / 64.0f;
+
+    if ( FT_Render_Glyph( face->glyph, FT_RENDER_MODE_NORMAL ) != 0 )
+        return g;
+
+    FT_Bitmap& bitmap = face->glyph->bitmap;
+    int w = bitmap.width;
+    int h = bitmap.rows;
+    if ( w == 0 || h == 0 )
+        return g;
+
+    if ( penX + w + padding > atlasWidth )
+    {
+        penX = padding;
+        penY += rowHeight + padding;
+        rowHeight = 0;
+    }
+    if ( penY + h + padding > atlasHeight )
+    {
+        // takes a lot of different characters (or a huge font) to get here -
+        // the rest just won't show up, but will still take up space
+        if ( !full )
+            gravUtil::logWarning( "GlyphAtlas::getGlyph: atlas full\n" );
+        full = true;
+        return g;
+    }
+
+    glBindTexture( GL_TEXTURE_2D, texture );
+    glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+    glPixelStorei( GL_UNPACK_ROW_LENGTH, bitmap.pitch );
+    glTexSubImage2D( GL_TEXTURE_2D, 0, penX, penY, w, h, GL_ALPHA,
+                        GL_UNSIGNED_BYTE, bitmap.buffer );
+    glPixelStorei( GL_UNPACK_ROW_LENGTH, 0 );
+    glBindTexture( GL_TEXTURE_2D, 0 );
+
+    // bitmap rows go top to bottom, so the top of the glyph is at penY
+    float left = face->glyph->bitmap_left;
+    float top = face->glyph->bitmap_top;
+    g.quad.x1 = left;
+    g.quad.y1 = top - h;
+    g.quad.x2 = left + w;
+    g.quad.y2 = top;
+    g.quad.s1 = (float)penX / atlasWidth;
+    g.quad.t1 = (float)( penY + h ) / atlasHeight;
+    g.quad.s2 = (float)( penX + w ) / atlasWidth;
+    g.quad.t2 = (float)penY / atlasHeight;
+    g.visible = true;
+
+    penX += w + padding;
+    rowHeight = std::max( rowHeight, h );
+
+    return g;
+}
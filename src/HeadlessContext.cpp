@@ -0,0 +1,268 @@
+/*
+ * @file HeadlessContext.cpp
+ *
+ * Implementation of the HeadlessContext class. See HeadlessContext.h for
+ * details.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "HeadlessContext.h"
+#include "gravUtil.h"
+
+#include <cstdio>
+#include <cstring>
+
+#ifdef GRAV_HAVE_EGL
+// older eglext.h versions don't have the surfaceless platform, so just use
+// the values from the registry rather than depending on it
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+typedef EGLDisplay (*GetPlatformDisplayFunc)( EGLenum platform,
+                                              void* nativeDisplay,
+                                              const EGLint* attribs );
+
+static bool hasExtension( const char* list, const char* ext )
+{
+    if ( list == NULL )
+        return false;
+
+    // has to match a whole name, not just the start of a longer one
+    size_t len = strlen( ext );
+    const char* pos = list;
+    while ( ( pos = strstr( pos, ext ) ) != NULL )
+    {
+        if ( ( pos == list || pos[-1] == ' ' ) &&
+                ( pos[len] == ' ' || pos[len] == '\0' ) )
+            return true;
+        pos += len;
+    }
+    return false;
+}
+#endif
+
+HeadlessContext::HeadlessContext()
+{
+#ifdef GRAV_HAVE_EGL
+    display = EGL_NO_DISPLAY;
+    context = EGL_NO_CONTEXT;
+#endif
+    framebuffer = 0;
+    colorBuffer = 0;
+    depthBuffer = 0;
+    width = 0;
+    height = 0;
+}
+
+HeadlessContext::~HeadlessContext()
+{
+    if ( framebuffer != 0 )
+    {
+        glBindFramebuffer( GL_FRAMEBUFFER, 0 );
+        glDeleteFramebuffers( 1, &framebuffer );
+        glDeleteRenderbuffers( 1, &colorBuffer );
+        glDeleteRenderbuffers( 1, &depthBuffer );
+    }
+
+#ifdef GRAV_HAVE_EGL
+    if ( display != EGL_NO_DISPLAY )
+    {
+        eglMakeCurrent( display, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                        EGL_NO_CONTEXT );
+        if ( context != EGL_NO_CONTEXT )
+            eglDestroyContext( display, context );
+        eglTerminate( display );
+    }
+#endif
+}
+
+bool HeadlessContext::init()
+{
+#ifdef GRAV_HAVE_EGL
+    // surfaceless doesn't need a display server at all, so try that first
+    const char* clientExts = eglQueryString( EGL_NO_DISPLAY, EGL_EXTENSIONS );
+    GetPlatformDisplayFunc getPlatformDisplay = (GetPlatformDisplayFunc)
+            eglGetProcAddress( "eglGetPlatformDisplayEXT" );
+    if ( getPlatformDisplay != NULL &&
+            hasExtension( clientExts, "EGL_MESA_platform_surfaceless" ) )
+    {
+        display = getPlatformDisplay( EGL_PLATFORM_SURFACELESS_MESA,
+                                      EGL_DEFAULT_DISPLAY, NULL );
+    }
+    if ( display == EGL_NO_DISPLAY )
+    {
+        gravUtil::logVerbose( "HeadlessContext::init: surfaceless platform "
+                "not available, using default display\n" );
+        display = eglGetDisplay( EGL_DEFAULT_DISPLAY );
+    }
+
+    EGLint major, minor;
+    if ( display == EGL_NO_DISPLAY ||
+            !eglInitialize( display, &major, &minor ) )
+    {
+        gravUtil::logError( "HeadlessContext::init: couldn't initialize "
+                "EGL\n" );
+        display = EGL_NO_DISPLAY;
+        return false;
+    }
+    gravUtil::logVerbose( "HeadlessContext::init: EGL %i.%i (%s)\n", major,
+            minor, eglQueryString( display, EGL_VENDOR ) );
+
+    // there's never a surface, so the context has to work without one
+    if ( !hasExtension( eglQueryString( display, EGL_EXTENSIONS ),
+                        "EGL_KHR_surfaceless_context" ) )
+    {
+        gravUtil::logError( "HeadlessContext::init: EGL doesn't support "
+                "surfaceless contexts\n" );
+        return false;
+    }
+
+    // desktop GL rather than ES, since the drawing code is fixed function
+    if ( !eglBindAPI( EGL_OPENGL_API ) )
+    {
+        gravUtil::logError( "HeadlessContext::init: EGL doesn't support "
+                "desktop OpenGL\n" );
+        return false;
+    }
+
+    // surface type 0 so configs without window support still match
+    EGLint configAttribs[] = { EGL_SURFACE_TYPE, 0,
+                               EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+                               EGL_NONE };
+    EGLConfig config;
+    EGLint numConfigs = 0;
+    if ( !eglChooseConfig( display, configAttribs, &config, 1,
+                            &numConfigs ) || numConfigs < 1 )
+    {
+        gravUtil::logError( "HeadlessContext::init: no suitable EGL "
+                "config\n" );
+        return false;
+    }
+
+    context = eglCreateContext( display, config, EGL_NO_CONTEXT, NULL );
+    if ( context == EGL_NO_CONTEXT )
+    {
+        gravUtil::logError( "HeadlessContext::init: couldn't create GL "
+                "context (EGL error 0x%x)\n", eglGetError() );
+        return false;
+    }
+
+    if ( !eglMakeCurrent( display, EGL_NO_SURFACE, EGL_NO_SURFACE, context ) )
+    {
+        gravUtil::logError( "HeadlessContext::init: couldn't make context "
+                "current (EGL error 0x%x)\n", eglGetError() );
+        return false;
+    }
+
+    return true;
+#else
+    gravUtil::logError( "HeadlessContext::init: grav was built without EGL, "
+            "so headless mode isn't available\n" );
+    return false;
+#endif
+}
+
+bool HeadlessContext::createFramebuffer( int w, int h )
+{
+    if ( !GLEW_VERSION_3_0 && !GLEW_ARB_framebuffer_object )
+    {
+        gravUtil::logError( "HeadlessContext::createFramebuffer: framebuffer "
+                "objects not available\n" );
+        return false;
+    }
+
+    width = w;
+    height = h;
+
+    glGenRenderbuffers( 1, &colorBuffer );
+    glBindRenderbuffer( GL_RENDERBUFFER, colorBuffer );
+    glRenderbufferStorage( GL_RENDERBUFFER, GL_RGBA8, width, height );
+
+    // same depth as the canvas asks for
+    glGenRenderbuffers( 1, &depthBuffer );
+    glBindRenderbuffer( GL_RENDERBUFFER, depthBuffer );
+    glRenderbufferStorage( GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width,
+                            height );
+    glBindRenderbuffer( GL_RENDERBUFFER, 0 );
+
+    glGenFramebuffers( 1, &framebuffer );
+    glBindFramebuffer( GL_FRAMEBUFFER, framebuffer );
+    glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                                GL_RENDERBUFFER, colorBuffer );
+    glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                                GL_RENDERBUFFER, depthBuffer );
+
+    GLenum status = glCheckFramebufferStatus( GL_FRAMEBUFFER );
+    if ( status != GL_FRAMEBUFFER_COMPLETE )
+    {
+        gravUtil::logError( "HeadlessContext::createFramebuffer: framebuffer "
+                "incomplete (0x%x)\n", status );
+        return false;
+    }
+
+    // with no window there's no back buffer, so everything has to go here
+    glDrawBuffer( GL_COLOR_ATTACHMENT0 );
+    glReadBuffer( GL_COLOR_ATTACHMENT0 );
+
+    return true;
+}
+
+bool HeadlessContext::writeFrame( std::string fileName )
+{
+    if ( framebuffer == 0 )
+        return false;
+
+    pixels.resize( width * height * 3 );
+    glPixelStorei( GL_PACK_ALIGNMENT, 1 );
+    glReadPixels( 0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE,
+                    &pixels[0] );
+
+    FILE* file = fopen( fileName.c_str(), "wb" );
+    if ( file == NULL )
+    {
+        gravUtil::logWarning( "HeadlessContext::writeFrame: couldn't open "
+                "%s\n", fileName.c_str() );
+        return false;
+    }
+
+    fprintf( file, "P6\n%i %i\n255\n", width, height );
+    // GL's rows go bottom-up, PPM's top-down
+    bool ok = true;
+    for ( int y = height - 1; y >= 0 && ok; y-- )
+        ok = fwrite( &pixels[ y * width * 3 ], 1, width * 3, file ) ==
+                (size_t)( width * 3 );
+    fclose( file );
+
+    if ( !ok )
+        gravUtil::logWarning( "HeadlessContext::writeFrame: couldn't write "
+                "%s\n", fileName.c_str() );
+    return ok;
+}
+
+int HeadlessContext::getWidth()
+{
+    return width;
+}
+
+int HeadlessContext::getHeight()
+{
+    return height;
+}
@@ -0,0 +1,132 @@
+/*
+ * @file ImageScaler.cpp
+ *
+ * Implementation of the box-filter downscaling functions. See ImageScaler.h
+ * for details.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ImageScaler.h"
+
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace ImageScaler
+{
+
+void halve( const unsigned char* src, unsigned int width, unsigned int height,
+            unsigned int bytesPerPixel, unsigned char* dst )
+{
+    unsigned int dstWidth = width / 2;
+    unsigned int dstHeight = height / 2;
+    unsigned int srcStride = width * bytesPerPixel;
+    unsigned int dstStride = dstWidth * bytesPerPixel;
+
+    for ( unsigned int r = 0; r < dstHeight; r++ )
+    {
+        const unsigned char* row0 = src + ( 2 * r ) * srcStride;
+        const unsigned char* row1 = row0 + srcStride;
+        unsigned char* out = dst + r * dstStride;
+        unsigned int c = 0;
+
+#ifdef __SSE2__
+        // 16 source bytes from each row -> 8 output bytes. Each iteration
+        // reads its input before writing output that's always at or behind
+        // it, so this is safe in-place as well
+        if ( bytesPerPixel == 1 )
+        {
+            const __m128i lowMask = _mm_set1_epi16( 0x00FF );
+            const __m128i rounding = _mm_set1_epi16( 2 );
+            for ( ; c + 8 <= dstWidth; c += 8 )
+            {
+                __m128i a = _mm_loadu_si128( (const __m128i*)( row0 + 2*c ) );
+                __m128i b = _mm_loadu_si128( (const __m128i*)( row1 + 2*c ) );
+
+                // sum horizontal pairs as 16-bit, then the two rows
+                __m128i sum = _mm_add_epi16(
+                    _mm_add_epi16( _mm_and_si128( a, lowMask ),
+                                   _mm_srli_epi16( a, 8 ) ),
+                    _mm_add_epi16( _mm_and_si128( b, lowMask ),
+                                   _mm_srli_epi16( b, 8 ) ) );
+                sum = _mm_srli_epi16( _mm_add_epi16( sum, rounding ), 2 );
+
+                _mm_storel_epi64( (__m128i*)( out + c ),
+                                  _mm_packus_epi16( sum, sum ) );
+            }
+        }
+#endif
+
+        // remainder (or everything, for multi-byte pixels)
+        for ( ; c < dstWidth; c++ )
+        {
+            for ( unsigned int p = 0; p < bytesPerPixel; p++ )
+            {
+                unsigned int left = ( 2 * c ) * bytesPerPixel + p;
+                unsigned int right = left + bytesPerPixel;
+                unsigned int sum = row0[ left ] + row0[ right ] +
+                                   row1[ left ] + row1[ right ];
+                out[ c * bytesPerPixel + p ] =
+                    (unsigned char)( ( sum + 2 ) >> 2 );
+            }
+        }
+    }
+}
+
+void downscale( const unsigned char* src, unsigned int width,
+                unsigned int height, unsigned int bytesPerPixel,
+                unsigned int level, unsigned char* dst,
+                std::vector<unsigned char>& scratch )
+{
+    if ( level == 0 )
+    {
+        memcpy( dst, src, width * height * bytesPerPixel );
+        return;
+    }
+
+    if ( level == 1 )
+    {
+        halve( src, width, height, bytesPerPixel, dst );
+        return;
+    }
+
+    // first pass out of the source, then halve in-place in the scratch buffer
+    // until the last pass, which goes to dst
+    unsigned int size = ( width / 2 ) * ( height / 2 ) * bytesPerPixel;
+    if ( scratch.size() < size )
+        scratch.resize( size );
+
+    halve( src, width, height, bytesPerPixel, &scratch[0] );
+    width /= 2;
+    height /= 2;
+
+    for ( unsigned int i = 1; i < level - 1; i++ )
+    {
+        halve( &scratch[0], width, height, bytesPerPixel, &scratch[0] );
+        width /= 2;
+        height /= 2;
+    }
+
+    halve( &scratch[0], width, height, bytesPerPixel, dst );
+}
+
+}
@@ -145,6 +145,9 @@ InputHandler::InputHandler( ObjectManager* o, Frame* f )
                         &InputHandler::handleToggleGraphicsDebug;
     docstr[ktoh('D', wxMOD_SHIFT | wxMOD_CMD)] =
                         "Toggle graphics debugging information.";
+    lookup[ktoh('E', wxMOD_ALT)] = &InputHandler::handleToggleGeoLinks;
+    docstr[ktoh('E', wxMOD_ALT)] = "Toggle lines from the globe to each "
+                                    "object.";
 
     if ( debug )
     {
@@ -195,6 +198,7 @@ void InputHandler::wxKeyDown( wxKeyEvent& evt )
     ctrlHeld = ( evt.GetModifiers() == wxMOD_CMD );*/
     modifiers = evt.GetModifiers();
 
+    objectMan->markDirty();
     processKeyboard( evt.GetKeyCode(), 0, 0 );
 
     evt.Skip(); // so now the char event can grab this, if need be
@@ -226,6 +230,8 @@ void InputHandler::wxMouseMove( wxMouseEvent& evt )
 
     mouseX = intersect.getX();
     mouseY = intersect.getY();
+    // mouseover changes what's shown (ie the session manager)
+    objectMan->markDirty();
 
     if ( leftButtonHeld )
         mouseLeftHeldMove();
@@ -240,12 +246,14 @@ void InputHandler::wxMouseLDown( wxMouseEvent& evt )
         ctrlHeld = false;
     //modifiers = evt.GetModifiers();
 
+    objectMan->markDirty();
     leftClick();
     evt.Skip();
 }
 
 void InputHandler::wxMouseLUp( wxMouseEvent& evt )
 {
+    objectMan->markDirty();
     leftRelease();
     evt.Skip();
 }
@@ -259,6 +267,7 @@ void InputHandler::wxMouseLDClick( wxMouseEvent& evt )
         ctrlHeld = false;
     //modifiers = evt.GetModifiers();
 
+    objectMan->markDirty();
     leftClick( true );
     evt.Skip();
 }
@@ -636,6 +645,11 @@ void InputHandler::handleToggleGraphicsDebug()
     objectMan->setGraphicsDebugMode( !objectMan->getGraphicsDebugMode() );
 }
 
+void InputHandler::handleToggleGeoLinks()
+{
+    objectMan->setGeoLinks( !objectMan->getGeoLinks() );
+}
+
 void InputHandler::handleDownscaleSelected()
 {
     float scaleAmt = 0.25f;
@@ -920,31 +934,34 @@ bool InputHandler::selectVideos()
 {
     bool videoSelected = false;
 
-    std::vector<RectangleBase*>::reverse_iterator si;
-    // reverse means we'll get the video that's on top first, since videos
-    // later in the list will render on top of previous ones
-    std::vector<RectangleBase*>::const_iterator sli;
-
-    for ( si = objectMan->getDrawnObjects()->rbegin();
-            si != objectMan->getDrawnObjects()->rend(); ++si )
+    // rectangle that defines the selection area
+    float selectL, selectR, selectU, selectD;
+    if ( leftButtonHeld )
     {
-        // rectangle that defines the selection area
-        float selectL, selectR, selectU, selectD;
-        if ( leftButtonHeld )
-        {
-            selectL = std::min( dragStartX, dragEndX );
-            selectR = std::max( dragStartX, dragEndX );
-            selectD = std::min( dragStartY, dragEndY );
-            selectU = std::max( dragStartY, dragEndY );
-            //lastBoxed = true;
-        }
-        else
-        {
-            selectL = selectR = mouseX;
-            selectU = selectD = mouseY;
-            //lastBoxed = false;
-        }
+        selectL = std::min( dragStartX, dragEndX );
+        selectR = std::max( dragStartX, dragEndX );
+        selectD = std::min( dragStartY, dragEndY );
+        selectU = std::max( dragStartY, dragEndY );
+        //lastBoxed = true;
+    }
+    else
+    {
+        selectL = selectR = mouseX;
+        selectU = selectD = mouseY;
+        //lastBoxed = false;
+    }
 
+    // only the objects near the selection area - these come back with the
+    // one that's on top first, since videos later in the drawn list will
+    // render on top of previous ones
+    std::vector<RectangleBase*> candidates;
+    objectMan->getObjectsAt( selectL, selectR, selectU, selectD, candidates );
+    std::vector<RectangleBase*>::iterator si;
+
+    clickedInside = false;
+
+    for ( si = candidates.begin(); si != candidates.end(); ++si )
+    {
         bool intersect = (*si)->intersect( selectL, selectR, selectU, selectD )
                             && (*si)->isSelectable();
 
@@ -993,9 +1010,7 @@ bool InputHandler::selectVideos()
             // it'll be rendered on top - but only if we just clicked on it
             if ( !leftButtonHeld )
             {
-                objectMan->lockSources();
                 objectMan->moveToTop( temp );
-                objectMan->unlockSources();
 
                 break; // so we only select one video per click
                        // when single-clicking
@@ -0,0 +1,246 @@
+/*
+ * @file Matrix.cpp
+ *
+ * Implementation of the Matrix class. See Matrix.h for details.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Matrix.h"
+
+#include <cmath>
+#include <cstring>
+
+Matrix::Matrix()
+{
+    loadIdentity();
+}
+
+Matrix::Matrix( const float* values )
+{
+    memcpy( m, values, sizeof( m ) );
+}
+
+void Matrix::loadIdentity()
+{
+    memset( m, 0, sizeof( m ) );
+    m[0] = m[5] = m[10] = m[15] = 1.0f;
+}
+
+float& Matrix::operator[]( int i )
+{
+    return m[i];
+}
+
+float Matrix::operator[]( int i ) const
+{
+    return m[i];
+}
+
+const float* Matrix::get() const
+{
+    return m;
+}
+
+Matrix Matrix::operator*( const Matrix& other ) const
+{
+    // each column of the result is this matrix's columns weighted by the
+    // other's column, so the inner loop runs down a column
+    Matrix result;
+    for ( int c = 0; c < 4; c++ )
+    {
+        const float* b = &other.m[ c*4 ];
+        for ( int r = 0; r < 4; r++ )
+        {
+            result.m[ c*4 + r ] = m[ r ] * b[0] + m[ 4 + r ] * b[1] +
+                                  m[ 8 + r ] * b[2] + m[ 12 + r ] * b[3];
+        }
+    }
+    return result;
+}
+
+void Matrix::translate( float x, float y, float z )
+{
+    for ( int r = 0; r < 4; r++ )
+        m[ 12 + r ] += m[ r ] * x + m[ 4 + r ] * y + m[ 8 + r ] * z;
+}
+
+void Matrix::rotate( float angle, float x, float y, float z )
+{
+    // most things aren't rotated at all
+    if ( angle == 0.0f )
+        return;
+
+    float len = sqrt( x*x + y*y + z*z );
+    if ( len == 0.0f )
+        return;
+    x /= len; y /= len; z /= len;
+
+    float rad = angle * M_PI / 180.0f;
+    float c = cos( rad );
+    float s = sin( rad );
+    float ic = 1.0f - c;
+
+    Matrix rot;
+    rot.m[0] = x*x*ic + c;    rot.m[4] = x*y*ic - z*s;  rot.m[8] = x*z*ic + y*s;
+    rot.m[1] = y*x*ic + z*s;  rot.m[5] = y*y*ic + c;    rot.m[9] = y*z*ic - x*s;
+    rot.m[2] = x*z*ic - y*s;  rot.m[6] = y*z*ic + x*s;  rot.m[10] = z*z*ic + c;
+
+    *this = *this * rot;
+}
+
+void Matrix::scale( float x, float y, float z )
+{
+    for ( int r = 0; r < 4; r++ )
+    {
+        m[ r ] *= x;
+        m[ 4 + r ] *= y;
+        m[ 8 + r ] *= z;
+    }
+}
+
+Point Matrix::transformPoint( const Point& p ) const
+{
+    float x = p.getX(), y = p.getY(), z = p.getZ();
+    return Point( m[0] * x + m[4] * y + m[8] * z + m[12],
+                  m[1] * x + m[5] * y + m[9] * z + m[13],
+                  m[2] * x + m[6] * y + m[10] * z + m[14] );
+}
+
+void Matrix::transform( const float* in, float* out ) const
+{
+    for ( int r = 0; r < 4; r++ )
+    {
+        out[r] = m[ r ] * in[0] + m[ 4 + r ] * in[1] + m[ 8 + r ] * in[2] +
+                 m[ 12 + r ] * in[3];
+    }
+}
+
+bool Matrix::invert( Matrix& result ) const
+{
+    // cofactor expansion - done in double, since the projection matrix
+    // doesn't leave much float precision when unprojecting far points
+    double inv[16];
+
+    inv[0] = (double)m[5]*m[10]*m[15] - (double)m[5]*m[11]*m[14] -
+             (double)m[9]*m[6]*m[15] + (double)m[9]*m[7]*m[14] +
+             (double)m[13]*m[6]*m[11] - (double)m[13]*m[7]*m[10];
+    inv[4] = -(double)m[4]*m[10]*m[15] + (double)m[4]*m[11]*m[14] +
+             (double)m[8]*m[6]*m[15] - (double)m[8]*m[7]*m[14] -
+             (double)m[12]*m[6]*m[11] + (double)m[12]*m[7]*m[10];
+    inv[8] = (double)m[4]*m[9]*m[15] - (double)m[4]*m[11]*m[13] -
+             (double)m[8]*m[5]*m[15] + (double)m[8]*m[7]*m[13] +
+             (double)m[12]*m[5]*m[11] - (double)m[12]*m[7]*m[9];
+    inv[12] = -(double)m[4]*m[9]*m[14] + (double)m[4]*m[10]*m[13] +
+              (double)m[8]*m[5]*m[14] - (double)m[8]*m[6]*m[13] -
+              (double)m[12]*m[5]*m[10] + (double)m[12]*m[6]*m[9];
+    inv[1] = -(double)m[1]*m[10]*m[15] + (double)m[1]*m[11]*m[14] +
+             (double)m[9]*m[2]*m[15] - (double)m[9]*m[3]*m[14] -
+             (double)m[13]*m[2]*m[11] + (double)m[13]*m[3]*m[10];
+    inv[5] = (double)m[0]*m[10]*m[15] - (double)m[0]*m[11]*m[14] -
+             (double)m[8]*m[2]*m[15] + (double)m[8]*m[3]*m[14] +
+             (double)m[12]*m[2]*m[11] - (double)m[12]*m[3]*m[10];
+    inv[9] = -(double)m[0]*m[9]*m[15] + (double)m[0]*m[11]*m[13] +
+             (double)m[8]*m[1]*m[15] - (double)m[8]*m[3]*m[13] -
+             (double)m[12]*m[1]*m[11] + (double)m[12]*m[3]*m[9];
+    inv[13] = (double)m[0]*m[9]*m[14] - (double)m[0]*m[10]*m[13] -
+              (double)m[8]*m[1]*m[14] + (double)m[8]*m[2]*m[13] +
+              (double)m[12]*m[1]*m[10] - (double)m[12]*m[2]*m[9];
+    inv[2] = (double)m[1]*m[6]*m[15] - (double)m[1]*m[7]*m[14] -
+             (double)m[5]*m[2]*m[15] + (double)m[5]*m[3]*m[14] +
+             (double)m[13]*m[2]*m[7] - (double)m[13]*m[3]*m[6];
+    inv[6] = -(double)m[0]*m[6]*m[15] + (double)m[0]*m[7]*m[14] +
+             (double)m[4]*m[2]*m[15] - (double)m[4]*m[3]*m[14] -
+             (double)m[12]*m[2]*m[7] + (double)m[12]*m[3]*m[6];
+    inv[10] = (double)m[0]*m[5]*m[15] - (double)m[0]*m[7]*m[13] -
+              (double)m[4]*m[1]*m[15] + (double)m[4]*m[3]*m[13] +
+              (double)m[12]*m[1]*m[7] - (double)m[12]*m[3]*m[5];
+    inv[14] = -(double)m[0]*m[5]*m[14] + (double)m[0]*m[6]*m[13] +
+              (double)m[4]*m[1]*m[14] - (double)m[4]*m[2]*m[13] -
+              (double)m[12]*m[1]*m[6] + (double)m[12]*m[2]*m[5];
+    inv[3] = -(double)m[1]*m[6]*m[11] + (double)m[1]*m[7]*m[10] +
+             (double)m[5]*m[2]*m[11] - (double)m[5]*m[3]*m[10] -
+             (double)m[9]*m[2]*m[7] + (double)m[9]*m[3]*m[6];
+    inv[7] = (double)m[0]*m[6]*m[11] - (double)m[0]*m[7]*m[10] -
+             (double)m[4]*m[2]*m[11] + (double)m[4]*m[3]*m[10] +
+             (double)m[8]*m[2]*m[7] - (double)m[8]*m[3]*m[6];
+    inv[11] = -(double)m[0]*m[5]*m[11] + (double)m[0]*m[7]*m[9] +
+              (double)m[4]*m[1]*m[11] - (double)m[4]*m[3]*m[9] -
+              (double)m[8]*m[1]*m[7] + (double)m[8]*m[3]*m[5];
+    inv[15] = (double)m[0]*m[5]*m[10] - (double)m[0]*m[6]*m[9] -
+              (double)m[4]*m[1]*m[10] + (double)m[4]*m[2]*m[9] +
+              (double)m[8]*m[1]*m[6] - (double)m[8]*m[2]*m[5];
+
+    double det = m[0]*inv[0] + m[1]*inv[4] + m[2]*inv[8] + m[3]*inv[12];
+    if ( det == 0.0 )
+        return false;
+
+    det = 1.0 / det;
+    for ( int i = 0; i < 16; i++ )
+        result.m[i] = (float)( inv[i] * det );
+    return true;
+}
+
+Matrix Matrix::frustum( float left, float right, float bottom, float top,
+                        float near, float far )
+{
+    Matrix f;
+    f.m[0] = ( 2.0f * near ) / ( right - left );
+    f.m[5] = ( 2.0f * near ) / ( top - bottom );
+    f.m[8] = ( right + left ) / ( right - left );
+    f.m[9] = ( top + bottom ) / ( top - bottom );
+    f.m[10] = -( far + near ) / ( far - near );
+    f.m[11] = -1.0f;
+    f.m[14] = -( 2.0f * far * near ) / ( far - near );
+    f.m[15] = 0.0f;
+    return f;
+}
+
+Matrix Matrix::lookAt( const Point& eye, const Point& center,
+                        const Vector& up )
+{
+    // forward, then side = forward x up, then the real up = side x forward
+    float f[3] = { center.getX() - eye.getX(), center.getY() - eye.getY(),
+                   center.getZ() - eye.getZ() };
+    float flen = sqrt( f[0]*f[0] + f[1]*f[1] + f[2]*f[2] );
+    if ( flen > 0.0f )
+    {
+        f[0] /= flen; f[1] /= flen; f[2] /= flen;
+    }
+
+    float s[3] = { f[1] * up.getZ() - f[2] * up.getY(),
+                   f[2] * up.getX() - f[0] * up.getZ(),
+                   f[0] * up.getY() - f[1] * up.getX() };
+    float slen = sqrt( s[0]*s[0] + s[1]*s[1] + s[2]*s[2] );
+    if ( slen > 0.0f )
+    {
+        s[0] /= slen; s[1] /= slen; s[2] /= slen;
+    }
+
+    float u[3] = { s[1] * f[2] - s[2] * f[1],
+                   s[2] * f[0] - s[0] * f[2],
+                   s[0] * f[1] - s[1] * f[0] };
+
+    Matrix l;
+    l.m[0] = s[0];  l.m[4] = s[1];  l.m[8] = s[2];
+    l.m[1] = u[0];  l.m[5] = u[1];  l.m[9] = u[2];
+    l.m[2] = -f[0]; l.m[6] = -f[1]; l.m[10] = -f[2];
+    l.translate( -eye.getX(), -eye.getY(), -eye.getZ() );
+    return l;
+}
@@ -48,11 +48,19 @@
 #include "VenueClientController.h"
 #include "SessionManager.h"
 #include "SessionEntry.h"
+#include "SpatialIndex.h"
+#include "GeoOverlay.h"
 #include "Camera.h"
 #include "Point.h"
+#include "UploadScheduler.h"
+#include "BatchRenderer.h"
+#include "Animator.h"
+#include "SceneEventQueue.h"
 
 #include "ObjectManager.h"
 
+#include <wx/thread.h>
+
 #include <VPMedia/random_helper.h>
 
 ObjectManager::ObjectManager()
@@ -70,6 +78,8 @@ ObjectManager::ObjectManager()
 
     sources = new std::vector<VideoSource*>();
     drawnObjects = new std::vector<RectangleBase*>();
+    spatialIndex = new SpatialIndex();
+    geoOverlay = new GeoOverlay();
     selectedObjects = new std::vector<RectangleBase*>();
     siteIDGroups = new std::map<std::string,Group*>();
 
@@ -106,13 +116,13 @@ ObjectManager::ObjectManager()
     runway = new Runway( -10.0f, 0.0f );
     runway->setScale( 2.0f, 10.0f );
     drawnObjects->push_back( runway );
+    spatialIndex->add( runway );
 
     headerString = "";
     useHeader = false;
     textScale = 0.01;
     textOffset = 0.25;
 
-    usingThreads = false;
     useRunway = true;
     gridAuto = false;
     autoFocusRotate = false;
@@ -125,13 +135,25 @@ ObjectManager::ObjectManager()
 
     orbiting = false;
 
-    sourceMutex = mutex_create();
-    lockCount = 0;
+    sceneEvents = new SceneEventQueue();
+    frameEventCount = 0;
+    frameEventLatency = 0.0;
 
     graphicsDebugView = false;
     pixelCount = 0;
 
+    visibilityCulling = true;
+    suspendHiddenDecoding = false;
+    suspendedCount = 0;
+    uploadDownscaling = true;
+
+    uploadScheduler = new UploadScheduler();
+
+    dirty = 1;
+    maxRedrawInterval = 0;
+
     venueClientController = NULL; // just for before it gets set
+    videoListener = NULL;
 }
 
 ObjectManager::~ObjectManager()
@@ -140,22 +162,28 @@ ObjectManager::~ObjectManager()
 
     doDelayedDelete();
 
+    delete uploadScheduler;
+
     delete sources;
     delete drawnObjects;
     delete selectedObjects;
     delete siteIDGroups;
 
     delete layouts;
+    delete geoOverlay;
 
     delete runway;
 
     delete cam;
 
+    // last, since the objects above take themselves out of it
+    delete spatialIndex;
+
     delete objectsToDelete;
     delete objectsToAddToTree;
     delete objectsToRemoveFromTree;
 
-    mutex_free( sourceMutex );
+    delete sceneEvents;
 }
 
 void ObjectManager::draw()
@@ -163,9 +191,17 @@ void ObjectManager::draw()
     // don't draw if either of these objects haven't been initialized yet
     if ( !earth || !input ) return;
 
+    // anything that gets marked from here on shows up next frame
+    __sync_fetch_and_and( &dirty, 0 );
+    redrawStopwatch.Start();
+
     glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
 
-    cam->animateValues();
+    // textures etc. that finished loading in the background
+    GLUtil::getInstance()->finishResourceLoads();
+
+    // move everything that's animating along to where it should be by now
+    Animator::getInstance()->update();
     cam->doGLLookat();
 
     // audio test drawing
@@ -201,7 +237,11 @@ void ObjectManager::draw()
 
     std::vector<RectangleBase*>::const_iterator si;
 
-    lockSources();
+    // sources that came & went since last frame - after this the lists only
+    // change on this thread, so nothing below needs a lock
+    frameEventCount = 0;
+    frameEventLatency = 0.0;
+    applySceneEvents();
 
     // periodically automatically rearrange if on automatic - take last object
     // and put it in center
@@ -255,29 +295,12 @@ void ObjectManager::draw()
     // delete sources that need to be deleted - see deleteSource for the reason
     doDelayedDelete();
 
+    updateVisibility();
+    uploadFrames();
+
     // draw point on geographical position, selected ones on top (and bigger)
-    for ( si = drawnObjects->begin(); si != drawnObjects->end(); si++ )
-    {
-        RGBAColor col = (*si)->getColor();
-        glColor4f( col.R, col.G, col.B, col.A );
-        if ( !(*si)->isGrouped() && !(*si)->isSelected() )
-        {
-            //drawCurvedEarthLine( (*si)->getLat(), (*si)->getLon(),
-            //                    (*si)->getX(), (*si)->getY(), (*si)->getZ() );
-            drawEarthPoint( (*si)->getLat(), (*si)->getLon(), 3.0f );
-        }
-    }
-    for ( si = selectedObjects->begin(); si != selectedObjects->end(); si++ )
-    {
-        RGBAColor col = (*si)->getColor();
-        glColor4f( col.R, col.G, col.B, col.A );
-        if ( !(*si)->isGrouped() )
-        {
-            //drawCurvedEarthLine( (*si)->getLat(), (*si)->getLon(),
-            //                    (*si)->getX(), (*si)->getY(), (*si)->getZ() );
-            drawEarthPoint( (*si)->getLat(), (*si)->getLon(), 6.0f );
-        }
-    }
+    geoOverlay->update( earth, *drawnObjects, *selectedObjects );
+    geoOverlay->draw();
 
     earth->draw();
 
@@ -288,6 +311,11 @@ void ObjectManager::draw()
         glDepthMask( GL_FALSE );
     }
 
+    // objects add their shapes to the batch rather than drawing them right
+    // away, so they can be drawn together at the end
+    BatchRenderer* batch = GLUtil::getInstance()->getBatchRenderer();
+    batch->begin();
+
     // iterate through all objects to be drawn, and draw
     for ( si = drawnObjects->begin(); si != drawnObjects->end(); si++ )
     {
@@ -346,11 +374,13 @@ void ObjectManager::draw()
                 if ( level > 0.01f )
                 {
                     innerObjs.push_back( (*si) );
+                    talkingObjects.insert( (*si) );
                     audioFocusTrigger = true;
                 }
                 else
                 {
                     outerObjs.push_back( (*si) );
+                    talkingObjects.erase( (*si) );
                 }
             }
             (*si)->draw();
@@ -361,6 +391,8 @@ void ObjectManager::draw()
         }
     }
 
+    batch->end();
+
     // do the audio focus if it triggered
     if ( audioAvailable() )
     {
@@ -416,12 +448,9 @@ void ObjectManager::draw()
         }
     }
 
-    unlockSources();
-
     // check session manager for moved session entry objects & shift if
-    // necessary - this needs to be outside the lock() since a shift might
-    // trigger a session disable, which may delete a video which needs to lock
-    // on its own (ie, we're not doing reentrant mutexes)
+    // necessary - a shift might trigger a session disable, which deletes
+    // videos right away
     if ( intersectCounter == 0 && sessionManager->isShown() )
         sessionManager->checkGUISessionShift();
 
@@ -461,48 +490,47 @@ void ObjectManager::draw()
     // header text drawing
     if ( useHeader )
     {
-        glPushMatrix();
-
-        glEnable( GL_BLEND );
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-        glColor4f( 0.953f, 0.431f, 0.129f, 0.5f );
+        batch->reset();
+        batch->setColor( 0.953f, 0.431f, 0.129f, 0.5f );
         Bounds screenBounds = screenRectFull.getBounds();
         float textXPos = screenBounds.L + textOffset;
         float textYPos = screenBounds.U -
                 ( ( headerTextBox.Upper().Yf() - headerTextBox.Lower().Yf() )
                         * textScale ) - textOffset;
-        glTranslatef( textXPos, textYPos, 0.0f );
-        glScalef( textScale, textScale, textScale );
-        const char* text = headerString.c_str();
-        GLUtil::getInstance()->getMainFont()->Render( text );
-        glDisable( GL_BLEND );
-
-        glPopMatrix();
+        batch->addLabel( headerLabel, textXPos, textYPos, textScale );
     }
 
     // graphics debug drawing
     if ( graphicsDebugView )
     {
-        glPushMatrix();
-
+        // no canvas when running headless, so no timing from it either
         GLCanvas* canvas = GLUtil::getInstance()->getCanvas();
+        long drawTime = canvas != NULL ? canvas->getDrawTime() : 0;
+        long nonDrawTime = canvas != NULL ? canvas->getNonDrawTime() : 0;
+        float fps = canvas != NULL ? canvas->getFPS() : 0.0f;
 
-        long drawTime = canvas->getDrawTime();
         float color = (33.0f - (float)drawTime) / 17.0f;
-        glColor4f( 1.0f, color, color, 0.8f );
+        batch->reset();
+        batch->setColor( 1.0f, color, color, 0.8f );
         Bounds screenBounds = screenRectFull.getBounds();
-        glTranslatef( 0.0f, screenBounds.U * 0.9f, 0.0f );
         float debugScale = textScale / 2.5f;
-        glScalef( debugScale, debugScale, debugScale );
-        char text[100];
+        char text[320];
         sprintf( text,
                 "Draw time: %3ld  Non-draw time: %3ld  Pixel count: %8ld "
-                "FPS: %2.2f",
-                canvas->getDrawTime(), canvas->getNonDrawTime(),
-                videoListener->getPixelCount(), canvas->getFPS() );
-        GLUtil::getInstance()->getMainFont()->Render( text );
-
-        glPopMatrix();
+                "FPS: %2.2f  Suspended: %3d  Uploads: %2d (%5u KB) "
+                "Deferred: %2d  Batches: %3d  Animating: %3d  "
+                "Queued: %2d (%u dropped)  Events: %2d (%4.1f ms, %2d "
+                "waiting)",
+                drawTime, nonDrawTime, videoListener->getPixelCount(), fps,
+                suspendedCount, uploadScheduler->getLastUploadCount(),
+                uploadScheduler->getLastUploadBytes() / 1024,
+                uploadScheduler->getLastDeferredCount(),
+                batch->getLastBatchCount(),
+                Animator::getInstance()->getActiveCount(),
+                videoListener->getQueuedFrames(),
+                videoListener->getQueueDroppedFrames(), frameEventCount,
+                frameEventLatency, sceneEvents->getBacklog() );
+        batch->addText( text, 0.0f, screenBounds.U * 0.9f, debugScale );
     }
 
     // back to writeable z-buffer for proper earth/line rendering
@@ -525,6 +553,161 @@ void ObjectManager::draw()
     autoCounter = ( autoCounter + 1 ) % 900;
 }
 
+bool ObjectManager::needsRedraw()
+{
+    if ( maxRedrawInterval == 0 || dirty != 0 ||
+            redrawStopwatch.Time() >= maxRedrawInterval )
+        return true;
+
+    // nothing gets drawn until these are set anyway
+    if ( !earth || !input )
+        return false;
+
+    // things that change every frame, or that are only checked while drawing
+    if ( orbiting || graphicsDebugView || autoFocusRotate || audioAvailable() )
+        return true;
+
+    // selection box fading in or out
+    if ( input->isLeftButtonHeld() ? holdCounter < 24 : holdCounter > 1 )
+        return true;
+
+    // videos that didn't fit in the upload budget last frame
+    if ( uploadScheduler->getLastDeferredCount() > 0 )
+        return true;
+
+    if ( Animator::getInstance()->isAnimating() )
+        return true;
+
+    // earth tiles that came in since the last frame, or textures still
+    // loading in the background
+    if ( earth->needsRedraw() || GLUtil::getInstance()->areResourcesLoading() )
+        return true;
+
+    bool redraw = false;
+    std::vector<RectangleBase*>::const_iterator si;
+    for ( si = drawnObjects->begin(); si != drawnObjects->end() && !redraw;
+            ++si )
+    {
+        redraw = (*si)->needsRedraw();
+    }
+
+    return redraw;
+}
+
+void ObjectManager::markDirty()
+{
+    __sync_fetch_and_or( &dirty, 1 );
+}
+
+void ObjectManager::setMaxRedrawInterval( int ms )
+{
+    maxRedrawInterval = ms;
+}
+
+void ObjectManager::updateVisibility()
+{
+    suspendedCount = 0;
+    if ( !visibilityCulling && !uploadDownscaling )
+        return;
+
+    // find what part of the video plane is actually on screen with the
+    // current camera - if that fails (weird camera angle) or we're orbiting,
+    // only do the occlusion test
+    Point topRight, bottomLeft;
+    GLUtil* glUtil = GLUtil::getInstance();
+    bool haveScreen = !orbiting && windowWidth > 0 && windowHeight > 0 &&
+        glUtil->screenToRectIntersect( (GLdouble)windowWidth,
+                (GLdouble)windowHeight, screenRectFull, topRight ) &&
+        glUtil->screenToRectIntersect( 0.0f, 0.0f, screenRectFull,
+                bottomLeft );
+    float pixelsPerUnit = 0.0f;
+    if ( haveScreen && topRight.getY() - bottomLeft.getY() > 0.0f )
+        pixelsPerUnit = (float)windowHeight /
+                            ( topRight.getY() - bottomLeft.getY() );
+
+    // objects over each video, reused so it isn't reallocated every time
+    std::vector<RectangleBase*> over;
+
+    for ( unsigned int i = 0; i < sources->size(); i++ )
+    {
+        VideoSource* video = (*sources)[i];
+        Bounds b = video->getBounds();
+
+        // 0 for unknown means videos just get uploaded at full size
+        if ( uploadDownscaling )
+            video->setScreenHeight( ( b.U - b.D ) * pixelsPerUnit );
+        if ( !visibilityCulling )
+            continue;
+
+        VideoSource::Visibility vis = VideoSource::VISIBLE;
+
+        if ( haveScreen && ( b.R < bottomLeft.getX() ||
+                b.L > topRight.getX() || b.U < bottomLeft.getY() ||
+                b.D > topRight.getY() ||
+                ( b.U - b.D ) * pixelsPerUnit < minVisiblePixels ) )
+        {
+            vis = VideoSource::OFFSCREEN;
+        }
+        else if ( !orbiting )
+        {
+            // grouped videos get drawn when their group does
+            RectangleBase* top = video;
+            while ( top->isGrouped() )
+                top = top->getGroup();
+
+            // the index keeps the draw order, so only what overlaps the video
+            // and is drawn after it has to be looked at - that's everything
+            // up to the video itself (or its group), topmost first
+            spatialIndex->query( b.L, b.R, b.U, b.D, over );
+            for ( unsigned int j = 0; j < over.size() && over[j] != top; j++ )
+            {
+                VideoSource* other = dynamic_cast<VideoSource*>( over[j] );
+                if ( other == NULL || other->isGrouped() || !other->isOpaque() )
+                    continue;
+
+                Bounds ob = other->getBounds();
+                if ( ob.L <= b.L && ob.R >= b.R && ob.U >= b.U && ob.D <= b.D )
+                {
+                    vis = VideoSource::OCCLUDED;
+                    break;
+                }
+            }
+        }
+
+        video->setVisibility( vis, suspendHiddenDecoding );
+        if ( video->isSuspended() )
+            suspendedCount++;
+    }
+}
+
+void ObjectManager::uploadFrames()
+{
+    for ( unsigned int i = 0; i < sources->size(); i++ )
+    {
+        VideoSource* video = (*sources)[i];
+        if ( video->pollFrame() )
+            uploadScheduler->addPending( video, isUploadPriority( video ) );
+    }
+
+    uploadScheduler->uploadPending();
+}
+
+bool ObjectManager::isUploadPriority( VideoSource* s )
+{
+    if ( s->isSelected() || ( s->isGrouped() && s->getGroup()->isSelected() ) )
+        return true;
+
+    if ( focusSession.compare( "" ) != 0 &&
+            s->getSession()->getAddress().compare( focusSession ) == 0 )
+        return true;
+
+    // talking sites can be grouped by siteID, in which case the level is
+    // checked on the group
+    return talkingObjects.find( s ) != talkingObjects.end() ||
+        ( s->isGrouped() &&
+            talkingObjects.find( s->getGroup() ) != talkingObjects.end() );
+}
+
 void ObjectManager::clearSelected()
 {
     for ( std::vector<RectangleBase*>::iterator sli = selectedObjects->begin();
@@ -535,8 +718,6 @@ void ObjectManager::clearSelected()
 
 void ObjectManager::ungroupSiteIDGroups()
 {
-    lockSources();
-
     gravUtil::logVerbose( "ObjectManager::ungroupAll: deleting %i groups\n",
             siteIDGroups->size() );
     std::map<std::string,Group*>::iterator it;
@@ -558,16 +739,13 @@ void ObjectManager::ungroupSiteIDGroups()
     }
     siteIDGroups->clear();
     gravUtil::logVerbose( "ObjectManager::ungroupAll: siteIDgroups cleared\n" );
-
-    unlockSources();
 }
 
 void ObjectManager::addTestObject()
 {
-    lockSources();
-
     RectangleBase* obj = new RectangleBase( 0.0f, 0.0f );
     drawnObjects->push_back( obj );
+    spatialIndex->add( obj );
     bool useRandName = false;
     if ( useRandName )
     {
@@ -591,14 +769,10 @@ void ObjectManager::addTestObject()
     Texture t = GLUtil::getInstance()->getTexture( "border" );
     obj->setTexture( t.ID, t.width, t.height );
     obj->setUserDeletable( true );
-
-    unlockSources();
 }
 
 void ObjectManager::tryDeleteObject( RectangleBase* obj )
 {
-    lockSources();
-
     // note this will only check userdeletable objects. Videos should probably
     // not be deletable.
     if ( obj->isUserDeletable() )
@@ -610,13 +784,8 @@ void ObjectManager::tryDeleteObject( RectangleBase* obj )
         delete obj;
     }
 
-    unlockSources();
 }
 
-/*
- * Note this is NOT thread-safe, lockSources() should be called around any calls
- * to this.
- */
 void ObjectManager::moveToTop( RectangleBase* object, bool checkGrouping )
 {
     if ( object == NULL )
@@ -637,10 +806,6 @@ void ObjectManager::moveToTop( RectangleBase* object, bool checkGrouping )
     moveToTop( i, checkGrouping );
 }
 
-/*
- * Note this is NOT thread-safe, lockSources() should be called around any calls
- * to this.
- */
 void ObjectManager::moveToTop( std::vector<RectangleBase*>::iterator i,
                                 bool checkGrouping )
 {
@@ -659,6 +824,7 @@ void ObjectManager::moveToTop( std::vector<RectangleBase*>::iterator i,
     {
         drawnObjects->erase( i );
         drawnObjects->push_back( temp );
+        spatialIndex->raise( temp );
 
         if ( temp->isGroup() )
         {
@@ -669,225 +835,6 @@ void ObjectManager::moveToTop( std::vector<RectangleBase*>::iterator i,
     }
 }
 
-void ObjectManager::drawCurvedEarthLine( float lat, float lon,
-                                float destx, float desty, float destz )
-{
-    // old method
-    float sx, sy, sz;
-    earth->convertLatLong( lat, lon, sx, sy, sz );
-    float vecX = (sx - earth->getX()) * 0.08f;
-    float vecY = (sy - earth->getY()) * 0.08f;
-    float vecZ = (sz - earth->getZ()) * 0.08f;
-    float tx = vecX + sx;
-    float ty = vecY + sy;
-    float tz = vecZ + sz;
-
-    int iter = 15;
-    float zdist = destz-tz;
-    float maxzdist = (earth->getZ()+earth->getRadius())-destz;
-    float distanceScale = fabs(zdist/maxzdist);
-    int i = 0;
-
-    glLineWidth( 2.0f );
-    glBegin( GL_LINE_STRIP );
-    glVertex3f( sx, sy, sz );
-
-    while ( zdist > 1.0f )
-    {
-        glVertex3f( tx, ty, tz );
-        float weight = (((float)(iter-i))/(float)iter)*0.6f;
-        //float weight = 0.2f;
-        //weight *= weight;
-        float xpush = 0.0f;
-        float ypush = 0.0f;
-        //float curDistX = fabs(tx-earth->getX());
-        //float curDistY = fabs(ty-earth->getY());
-
-        // this will push out the current point on the line away from the
-        // earth so it doesn't clip, scaled based on how far we are from the
-        // destination
-        xpush = 1.5f * distanceScale;
-        ypush = 1.5f * distanceScale;
-        if ( tx < earth->getX() ) xpush *= -1.0f;
-        if ( ty < earth->getY() ) ypush *= -1.0f;
-
-        // move the current point forward, based on progressively averaging
-        // the earth-pointing-out vector with the vector pointing towards
-        // the destination point
-        tx += (vecX * weight) +
-                ((destx-tx) * (1.0f-weight))
-                + xpush;
-        ty += (vecY * weight) +
-                ((desty-ty)  * (1.0f-weight))
-                + ypush;
-        tz += (vecZ * weight) +
-                ((destz-tz) * (1.0f-weight));
-
-        zdist = destz-tz;
-        distanceScale = fabs(zdist/maxzdist);
-        i++;
-    }
-    // shift the z back a bit so it doesn't overshoot the object
-    if ( tz > destz - 0.3f ) tz -= 0.3f;
-    glVertex3f( tx, ty, tz );
-    // -0.05f is so the line doesn't poke through the objects
-    glVertex3f( destx, desty, destz-0.05f );
-    glEnd();
-
-    // new method
-    /*
-    float earthx, earthy, earthz;
-    earth->convertLatLong( lat, lon, earthx, earthy, earthz );
-
-    // this vector starts out as the one pointing into the lat/lon point,
-    // along the line to the center of the earth
-    float earthVecX = (earthx - earth->getX()) * -0.2f;
-    float earthVecY = (earthy - earth->getY()) * -0.2f;
-    float earthVecZ = (earthz - earth->getZ()) * -0.2f;
-
-    // this assumes that the general direction between the destination points
-    // and the earth is along the z-axis
-
-    glColor3f( 0.0f, 1.0f, 0.0f );
-    glLineWidth( 2.0f );
-
-    float fx = earthx;
-    float fy = earthy;
-    float fz;
-
-    // if the point isn't blocked by the earth, draw straight line
-
-    // move the first target point towards the camera based on how far the
-    // object is from the earth point in x/y
-    float xydiff = (abs(destx-earthx)+abs(desty-earthy))/
-                                            1.5f;
-    gravUtil::logVerbose( "xydiff: %f\n", xydiff );
-    if ( earthz > earth->getZ() )
-    {
-        fz = earthz;
-    }
-    else
-    {
-        gravUtil::logVerbose( "behind\n" );
-        fz = earth->getZ() + abs((earthz-earth->getZ()));
-    }
-    fz = std::min( fz+xydiff, destz-1.0f );
-
-    // shift the x/y out a bit on the edges
-    fx += destx-earthx/7.0f;
-    fy += desty-earthy/7.0f;
-
-    // go out to the radius of the earth, then average the path
-    // to travel progressively from -Z to the vector pointing directly to the
-    // point on the earth
-
-    float zDist = earthz - destz;
-    int iter = ceil( abs(zDist/2.0f) );
-    gravUtil::logVerbose( "%i iterations\n", iter );
-    //gravUtil::logVerbose( "in averaging mode\n" );
-
-    // find the radius point
-    float rx, ry, rz;
-    rz = earth->getZ();
-    float xDist = earthx - earth->getX();
-    float yDist = earthy - earth->getY();
-    float curRadius = sqrt((xDist)*(xDist) +
-                           (yDist)*(yDist));
-    gravUtil::logVerbose( "radius & curradius: %f, %f\n", earth->getRadius(),
-            curRadius );
-    rx = earth->getX() + (xDist*(earth->getRadius()*1.7f/curRadius));
-    ry = earth->getY() + (yDist*(earth->getRadius()*1.7f/curRadius));
-    gravUtil::logVerbose( "radiuspoint: %f,%f,%f\n", rx,ry,rz );
-
-    // draw & average the vectors
-    float tx = destx, ty = desty, tz = destz;
-    */
-    //glVertex3f( destx, desty, destz );
-    /*gravUtil::logVerbose( "earth x,y: %f,%f\n", earthx, earthy );
-    gravUtil::logVerbose( "fx,fy,fz: %f,%f,%f\n", fx, fy, fz );
-    int numVecs = 4;
-    int vecs[numVecs][3];
-    vecs[0][0] = (fx-tx)/2.0f; vecs[0][1] = (fy-ty)/2.0f;
-                vecs[0][2] = (fz-tz)/2.0f;
-    vecs[1][0] = (rx-fx)/5.0f; vecs[1][1] = (ry-fy)/5.0f;
-                vecs[1][2] = (rz-fz)/5.0f;
-    vecs[2][0] = 0.0f;  vecs[2][1] = 0.0f;  vecs[2][2] = -0.5f;
-    vecs[3][0] = earthVecX; vecs[3][1] = earthVecY;
-                vecs[3][2] = earthVecZ;*/
-
-    /*glBegin( GL_LINE_STRIP );
-    for ( int n = 0; n < 1; n++ )
-    {
-        for ( int i = 0; i < iter; i++ )
-        {
-            glVertex3f( tx, ty, tz );
-            float weight = ((float)(iter-i))/(float)iter;
-            weight *= weight;
-            tx += (vecs[n][0] * weight) +
-                    (vecs[n+1][0] * (1.0f-weight));
-            ty += (vecs[n][1] * weight) +
-                    (vecs[n+1][1] * (1.0f-weight));
-            tz += (vecs[n][2] * weight) +
-                    (vecs[n+1][2] * (1.0f-weight));
-        }
-    }
-    glEnd();*/
-
-    /*
-    // method: add the start vector, averaging in the pointing-in vector, then
-    // if we get close to the earth, average in the pointing-out vector
-    float distance = sqrt(((earthx-tx)*(earthx-tx))+
-                         ((earthy-ty)*(earthy-ty))+
-                         ((earthz-tz)*(earthz-tz)));
-    //gravUtil::logVerbose( "starting distance: %f\n", distance );
-    float startVecX = (fx-destx)/7.0f;
-    float startVecY = (fy-desty)/7.0f;
-    float startVecZ = (fz-destz)/7.0f;
-    float vecX = startVecX; float vecY = startVecY; float vecZ = startVecZ;
-    int count = 0;
-
-    glColor3f( 0.0f, 0.0f, 1.0f );
-    glBegin(GL_LINE_STRIP);
-    while ( count < iter )
-    {
-        glVertex3f( tx, ty, tz );
-        tx += vecX; ty += vecY; tz += vecZ;
-        float weight = ((float)(iter-count))/(float)iter;
-
-        vecX = (vecX*weight)+(earthVecX*(1-weight));
-        vecY = (vecY*weight)+(earthVecY*(1-weight));
-        vecZ = (vecZ*weight)+(earthVecZ*(1-weight));
-        //distance = sqrt(((earthx-tx)*(earthx-tx))+
-        //               ((earthy-ty)*(earthy-ty))+
-        //                ((earthz-tz)*(earthz-tz)));
-        //gravUtil::logVerbose( "distance: %f\n", distance );
-        count++;
-    }
-    glVertex3f( earthx, earthy, earthz );
-    glEnd();
-
-    // test render of lines with no averaging
-    glColor3f( 1.0f, 0.0f, 0.0f );
-    glBegin(GL_LINE_STRIP);
-    glVertex3f( destx, desty, destz );
-    glVertex3f( fx, fy, fz );
-    //glVertex3f( rx, ry, rz );
-    //glVertex3f( earthx, earthy, earthz );
-    glEnd();
-    */
-}
-
-void ObjectManager::drawEarthPoint( float lat, float lon, float size )
-{
-    float sx, sy, sz;
-    earth->convertLatLong( lat, lon, sx, sy, sz );
-
-    glPointSize( size );
-    glBegin( GL_POINTS );
-    glVertex3f( sx, sy, sz );
-    glEnd();
-}
-
 void ObjectManager::setBoxSelectDrawing( bool draw )
 {
     drawSelectionBox = draw;
@@ -905,6 +852,7 @@ int ObjectManager::getWindowHeight()
 
 void ObjectManager::setWindowSize( int w, int h )
 {
+    markDirty();
     windowWidth = w;
     windowHeight = h;
     GLdouble screenL, screenR, screenU, screenD;
@@ -1024,6 +972,12 @@ std::vector<RectangleBase*>* ObjectManager::getDrawnObjects()
     return drawnObjects;
 }
 
+void ObjectManager::getObjectsAt( float L, float R, float U, float D,
+                                    std::vector<RectangleBase*>& results )
+{
+    spatialIndex->query( L, R, U, D, results );
+}
+
 std::vector<RectangleBase*>* ObjectManager::getSelectedObjects()
 {
     return selectedObjects;
@@ -1067,18 +1021,107 @@ void ObjectManager::addNewSource( VideoSource* s )
 {
     if ( s == NULL ) return;
 
+    SceneEvent* event = new SceneEvent( SceneEvent::SOURCE_ADDED );
+    event->source = s;
+    pushSceneEvent( event );
+}
+
+void ObjectManager::removeSource( VPMSession* session, uint32_t ssrc )
+{
+    SceneEvent* event = new SceneEvent( SceneEvent::SOURCE_REMOVED );
+    event->session = session;
+    event->ssrc = ssrc;
+    pushSceneEvent( event );
+}
+
+void ObjectManager::setSourceSiteID( uint32_t ssrc, std::string siteID )
+{
+    SceneEvent* event = new SceneEvent( SceneEvent::SITE_ID );
+    event->ssrc = ssrc;
+    event->siteID = siteID;
+    pushSceneEvent( event );
+}
+
+void ObjectManager::pushSceneEvent( SceneEvent* event )
+{
+    sceneEvents->push( event );
+    markDirty();
+
+    if ( wxThread::IsMain() )
+        drainSceneEvents();
+}
+
+void ObjectManager::applySceneEvents()
+{
+    // anything pushed while this is going gets picked up too, unless it's
+    // still in the middle of being pushed - then it waits for the next call
+    SceneEvent* event;
+    while ( ( event = sceneEvents->pop() ) != NULL )
+    {
+        frameEventCount++;
+        if ( event->latency > frameEventLatency )
+            frameEventLatency = event->latency;
+
+        if ( event->type == SceneEvent::SOURCE_ADDED )
+        {
+            insertSource( event->source );
+        }
+        else if ( event->type == SceneEvent::SOURCE_REMOVED )
+        {
+            std::vector<VideoSource*>::iterator si = sources->begin();
+            while ( si != sources->end() &&
+                    ( (*si)->getSession()->getVPMSession() != event->session ||
+                      (*si)->getssrc() != event->ssrc ) )
+                ++si;
+
+            // seems to get a lot of these on exit - may be that view-only
+            // clients are listed in the session
+            if ( si == sources->end() )
+            {
+                gravUtil::logVerbose( "ObjectManager::applySceneEvents: "
+                        "deleted ssrc 0x%08x not in sources list\n",
+                        event->ssrc );
+            }
+            else
+            {
+                if ( videoListener != NULL )
+                    videoListener->sourceRemoved( *si );
+                deleteSource( si );
+            }
+        }
+        else if ( event->type == SceneEvent::SITE_ID )
+        {
+            groupBySiteID( event->ssrc, event->siteID );
+        }
+
+        delete event;
+    }
+}
+
+void ObjectManager::drainSceneEvents()
+{
+    // the backlog counts pushes from when they start, so it only gets to 0
+    // once everything pushed up to now has been linked up & applied
+    applySceneEvents();
+    while ( sceneEvents->getBacklog() > 0 )
+    {
+        wxThread::Yield();
+        applySceneEvents();
+    }
+}
+
+void ObjectManager::insertSource( VideoSource* s )
+{
     Texture t = GLUtil::getInstance()->getTexture( "border" );
     s->setTexture( t.ID, t.width, t.height );
 
-    lockSources();
-
     sources->push_back( s );
     drawnObjects->push_back( s );
+    spatialIndex->add( s );
+    markDirty();
     s->updateName();
 
-    // tree add needs to be done on main thread since WX accesses the tree in
-    // other places (ie, not thread safe, and this could be on a separate
-    // thread)
+    // tree adds happen in draw(), along with the rest of the tree changes
     if ( tree != NULL )
         objectsToAddToTree->push_back( (RectangleBase*)s );
 
@@ -1147,14 +1190,10 @@ void ObjectManager::addNewSource( VideoSource* s )
         runway->add( s );
     // base case will just use placement defined in VideoListener (9 grid with
     // stacking)
-
-    unlockSources();
 }
 
 void ObjectManager::deleteSource( std::vector<VideoSource*>::iterator si )
 {
-    lockSources();
-
     RectangleBase* temp = (RectangleBase*)(*si);
     VideoSource* s = *si;
 
@@ -1204,35 +1243,62 @@ void ObjectManager::deleteSource( std::vector<VideoSource*>::iterator si )
         layouts->arrange("grid", getScreenRect(), getEarthRect(), data);
     }
 
-    // we need to do videosource's delete somewhere else, since this function
-    // might be on a second thread, which would crash since the videosource
-    // delete needs to do a GL call to delete its texture and GL calls can only
-    // be on the main thread
+    // the actual delete waits for draw(), since the videosource delete does a
+    // GL call to delete its texture and this might be outside of a frame
     objectsToDelete->push_back( s );
+}
+
+void ObjectManager::groupBySiteID( uint32_t ssrc, std::string siteID )
+{
+    std::vector<VideoSource*>::iterator i = sources->begin();
+    while ( i != sources->end() && (*i)->getssrc() != ssrc )
+        ++i;
 
-    unlockSources();
+    // we can get RTCP APP before the source itself, in which case there's
+    // nothing to group yet
+    if ( i == sources->end() || (*i)->isGrouped() )
+        return;
+
+    Group* g;
+    std::map<std::string,Group*>::iterator mapi = siteIDGroups->find( siteID );
+    if ( mapi == siteIDGroups->end() )
+        g = createSiteIDGroup( siteID );
+    else
+        g = mapi->second;
+
+    (*i)->setSiteID( siteID );
+    g->add( *i );
+
+    // adding & removing will replace the object under its group
+    if ( tree != NULL )
+    {
+        tree->removeObject( (*i) );
+        tree->addObject( (*i) );
+
+        tree->updateObjectName( g );
+    }
 }
 
 void ObjectManager::deleteGroup( Group* g )
 {
-    lockSources();
-
     g->removeAll();
     removeFromLists( g );
     // need to delete groups later as well, since we need to remove them from
     // the tree first
     objectsToDelete->push_back( g );
-
-    unlockSources();
 }
 
 void ObjectManager::addToDrawList( RectangleBase* obj )
 {
     drawnObjects->push_back( obj );
+    spatialIndex->add( obj );
+    markDirty();
 }
 
 void ObjectManager::removeFromLists( RectangleBase* obj, bool treeRemove )
 {
+    markDirty();
+
     // remove it from the tree
     if ( tree && treeRemove )
     {
@@ -1247,6 +1313,7 @@ void ObjectManager::removeFromLists( RectangleBase* obj, bool treeRemove )
     //                      or not)
     if ( i != drawnObjects->end() )
         drawnObjects->erase( i );
+    spatialIndex->remove( obj );
 
     // same for session focus objs
     i = sessionFocusObjs.begin();
@@ -1254,6 +1321,8 @@ void ObjectManager::removeFromLists( RectangleBase* obj, bool treeRemove )
     if ( i != sessionFocusObjs.end() )
         sessionFocusObjs.erase( i );
 
+    talkingObjects.erase( obj );
+
     if ( obj->isSelected() )
     {
         std::vector<RectangleBase*>::iterator j =
@@ -1274,10 +1343,8 @@ Group* ObjectManager::createSiteIDGroup( std::string data )
     Texture t = GLUtil::getInstance()->getTexture( "border" );
     g->setTexture( t.ID, t.width, t.height );
 
-    // something that calls this function should mutex around it itself
-    //lockSources();
-
     drawnObjects->push_back( g );
+    spatialIndex->add( g );
     siteIDGroups->insert( std::pair<std::string,Group*>( data, g ) );
 
     if ( tree != NULL )
@@ -1288,8 +1355,6 @@ Group* ObjectManager::createSiteIDGroup( std::string data )
     else
         retileVideos();*/
 
-    //unlockSources();
-
     return g;
 }
 
@@ -1343,6 +1408,7 @@ void ObjectManager::resetCamPosition()
 
 void ObjectManager::toggleOrbit()
 {
+    markDirty();
     orbiting = !orbiting;
     orbiting ? orbitVideos() : resetOrbit();
 }
@@ -1489,11 +1555,13 @@ void ObjectManager::setVenueClientController( VenueClientController* vcc )
         while ( i != drawnObjects->end() && (*i) != venueClientController )
             i++;
         drawnObjects->erase( i );
+        spatialIndex->remove( venueClientController );
     }
     venueClientController = vcc;
     if ( venueClientController != NULL)
     {
         drawnObjects->push_back( venueClientController );
+        spatialIndex->add( venueClientController );
     }
 }
 
@@ -1501,6 +1569,7 @@ void ObjectManager::setSessionManager( SessionManager* s )
 {
     sessionManager = s;
     drawnObjects->push_back( sessionManager );
+    spatialIndex->add( sessionManager );
 }
 
 void ObjectManager::setHeaderString( std::string h )
@@ -1511,8 +1580,9 @@ void ObjectManager::setHeaderString( std::string h )
     // since BBox may do some GL calls, any calls to this function must be on
     // the main thread
     if ( GLUtil::getInstance()->getMainFont() )
-        headerTextBox = GLUtil::getInstance()->getMainFont()->BBox(
-                            headerString.c_str() );
+        headerTextBox = GLUtil::getInstance()->getTextBounds( headerString );
+    headerLabel.setText( headerString );
+    markDirty();
 
     recalculateRectSizes();
 }
@@ -1522,29 +1592,6 @@ TreeControl* ObjectManager::getTree()
     return tree;
 }
 
-void ObjectManager::lockSources()
-{
-    if ( usingThreads )
-    {
-        mutex_lock( sourceMutex );
-        lockCount++;
-    }
-}
-
-void ObjectManager::unlockSources()
-{
-    if ( usingThreads )
-    {
-        mutex_unlock( sourceMutex );
-        lockCount--;
-    }
-}
-
-void ObjectManager::setThreads( bool threads )
-{
-    usingThreads = threads;
-}
-
 bool ObjectManager::usingRunway()
 {
     return useRunway;
@@ -1591,7 +1638,44 @@ Runway* ObjectManager::getRunway()
 void ObjectManager::setGraphicsDebugMode( bool g )
 {
     graphicsDebugView = g;
-    GLUtil::getInstance()->getCanvas()->setDebugTimerUsage( g );
+    GLCanvas* canvas = GLUtil::getInstance()->getCanvas();
+    if ( canvas != NULL )
+        canvas->setDebugTimerUsage( g );
+}
+
+void ObjectManager::setVisibilityCulling( bool v )
+{
+    visibilityCulling = v;
+
+    // make sure nothing is left suspended
+    if ( !visibilityCulling )
+    {
+        for ( unsigned int i = 0; i < sources->size(); i++ )
+            (*sources)[i]->setVisibility( VideoSource::VISIBLE,
+                                            suspendHiddenDecoding );
+    }
+}
+
+void ObjectManager::setHiddenDecodeSuspension( bool s )
+{
+    suspendHiddenDecoding = s;
+}
+
+void ObjectManager::setUploadDownscaling( bool d )
+{
+    uploadDownscaling = d;
+
+    // back to full size for everything
+    if ( !uploadDownscaling )
+    {
+        for ( unsigned int i = 0; i < sources->size(); i++ )
+            (*sources)[i]->setScreenHeight( 0.0f );
+    }
+}
+
+void ObjectManager::setUploadBudget( unsigned int bytes )
+{
+    uploadScheduler->setBudget( bytes );
 }
 
 bool ObjectManager::getGraphicsDebugMode()
@@ -1599,6 +1683,17 @@ bool ObjectManager::getGraphicsDebugMode()
     return graphicsDebugView;
 }
 
+void ObjectManager::setGeoLinks( bool l )
+{
+    geoOverlay->setDrawLinks( l );
+    markDirty();
+}
+
+bool ObjectManager::getGeoLinks()
+{
+    return geoOverlay->getDrawLinks();
+}
+
 void ObjectManager::toggleShowVenueClientController()
 {
     if ( venueClientController != NULL )
@@ -1654,6 +1749,10 @@ void ObjectManager::doDelayedDelete()
     {
         for ( unsigned int i = 0; i < objectsToDelete->size(); i++ )
         {
+            VideoSource* s = dynamic_cast<VideoSource*>(
+                                (*objectsToDelete)[i] );
+            if ( s )
+                uploadScheduler->removeSource( s );
             delete (*objectsToDelete)[i];
         }
         objectsToDelete->clear();
@@ -27,6 +27,7 @@
 
 #include <string>
 #include <cstdio>
+#include <cstring>
 #include <png.h>
 
 #include "GLUtil.h"
@@ -39,23 +40,149 @@ GLuint PNGLoader::loadPNG( std::string filename, int &width, int &height )
     glGetIntegerv( GL_MAX_TEXTURE_SIZE, &size );
     gravUtil::logVerbose( "PNGLoader::loadPNG: max tex size is %i", size );
 
+    unsigned char* image = readPNG( filename, width, height );
+    if ( image == NULL )
+        return 0;
+
+    GLuint texID = createTexture( width, height );
+    uploadImage( texID, image, width, height );
+    delete[] image;
+
+    return texID;
+}
+
+GLuint PNGLoader::createTexture( int width, int height )
+{
+    int pwidth = GLUtil::getInstance()->pow2( width );
+    int pheight = GLUtil::getInstance()->pow2( height );
+    gravUtil::logVerbose( "PNGLoader::createTexture: image dimensions: "
+            "%ix%i, pow2 dimensions: %ix%i\n", width, height, pwidth,
+            pheight );
+
+    GLenum  gl_error = glGetError();
+    for ( ; (gl_error); gl_error = glGetError() )
+    {
+        gravUtil::logError( "PNGLoader::createTexture: GLError: %s\n",
+                (const GLchar*)gluErrorString( gl_error ) );
+    }
+
+    GLuint texID;
+    glGenTextures( 1, &texID );
+    glBindTexture( GL_TEXTURE_2D, texID );
+
+    // allocate a buffer for the pow2 size
+    unsigned char *buffer = new unsigned char[pwidth * pheight * 4];
+    gravUtil::logVerbose( "PNGLoader::createTexture: made buffer, "
+            "allocating texture\n" );
+    memset( buffer, 128, pwidth * pheight * 4 );
+
+    glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+    glPixelStorei( GL_UNPACK_ROW_LENGTH, pwidth );
+
+    glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA, pwidth, pheight, 0, GL_RGBA,
+                    GL_UNSIGNED_BYTE, (GLvoid*)buffer );
+
+    // everything that uses these wants them clamped & filtered the same way,
+    // so set it once here rather than every time they're drawn
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+
+    glPixelStorei( GL_UNPACK_ROW_LENGTH, 0 );
+    glBindTexture( GL_TEXTURE_2D, 0 );
+    delete[] buffer;
+
+    gl_error = glGetError();
+    for ( ; (gl_error); gl_error = glGetError() )
+    {
+        gravUtil::logError( "PNGLoader::createTexture: GLError: %s\n",
+                (const GLchar*)gluErrorString( gl_error ) );
+    }
+
+    gravUtil::logVerbose( "PNGLoader::createTexture: generated ID is %i\n",
+            texID );
+
+    return texID;
+}
+
+void PNGLoader::uploadImage( GLuint texID, unsigned char* image, int width,
+                                int height )
+{
+    glBindTexture( GL_TEXTURE_2D, texID );
+
+    glPixelStorei( GL_UNPACK_ALIGNMENT, 1);
+    glPixelStorei( GL_UNPACK_ROW_LENGTH, width);
+
+    gravUtil::logVerbose( "PNGLoader::uploadImage: putting PNG in texture "
+            "area\n" );
+
+    // put the actual image in a sub-area of the pow2 memory area
+    glTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA,
+                    GL_UNSIGNED_BYTE, (GLvoid*)image );
+
+    // back to the default, so other uploads don't pick up our row length
+    glPixelStorei( GL_UNPACK_ROW_LENGTH, 0 );
+    glBindTexture( GL_TEXTURE_2D, 0 );
+
+    GLenum gl_error = glGetError();
+    for ( ; (gl_error); gl_error = glGetError() )
+    {
+        gravUtil::logError("PNGLoader::uploadImage: GLError: %s\n",
+                (const GLchar*)gluErrorString( gl_error ) );
+    }
+}
+
+bool PNGLoader::readPNGSize( std::string filename, int &width, int &height )
+{
+    FILE* texfile = fopen( filename.c_str(), "rb" );
+    if ( !texfile )
+    {
+        gravUtil::logError( "PNGLoader::readPNGSize: error opening file %s\n",
+                filename.c_str() );
+        return false;
+    }
+
+    // the signature, then the IHDR chunk's length & type, then the width &
+    // height as big-endian 32-bit ints - IHDR is always the first chunk
+    png_byte header[24];
+    size_t retval = fread( header, 1, 24, texfile );
+    fclose( texfile );
+
+    if ( retval != 24 || png_sig_cmp( header, 0, 8 ) ||
+            memcmp( header + 12, "IHDR", 4 ) != 0 )
+    {
+        gravUtil::logError( "PNGLoader::readPNGSize: %s isn't a PNG?\n",
+                filename.c_str() );
+        return false;
+    }
+
+    width = png_get_uint_32( header + 16 );
+    height = png_get_uint_32( header + 20 );
+    return true;
+}
+
+unsigned char* PNGLoader::readPNG( std::string filename, int &width,
+                                    int &height )
+{
     png_byte PNGheader[8];
 
     // open the texture as a binary file
     FILE* texfile = fopen( filename.c_str(), "rb" );
     if ( !texfile )
     {
-        gravUtil::logError( "PNGLoader::loadPNG: error opening file %s\n",
+        gravUtil::logError( "PNGLoader::readPNG: error opening file %s\n",
                 filename.c_str() );
-        return 0;
+        return NULL;
     }
 
     size_t retval = fread( PNGheader, 1, 8, texfile );
     if ( retval == 0 )
     {
-        gravUtil::logError( "PNGLoader::loadPNG: error reading file %s?\n",
+        gravUtil::logError( "PNGLoader::readPNG: error reading file %s?\n",
                 filename.c_str() );
-        return 0;
+        fclose( texfile );
+        return NULL;
     }
 
     // check the header
@@ -63,7 +190,7 @@ GLuint PNGLoader::loadPNG( std::string filename, int &width, int &height )
     if ( !pngTest )
     {
         fclose( texfile );
-        return 0;
+        return NULL;
     }
 
     // make the main png struct
@@ -72,7 +199,7 @@ GLuint PNGLoader::loadPNG( std::string filename, int &width, int &height )
     if ( !png )
     {
         fclose( texfile );
-        return 0;
+        return NULL;
     }
 
     // make the info struct
@@ -81,7 +208,7 @@ GLuint PNGLoader::loadPNG( std::string filename, int &width, int &height )
     {
         png_destroy_read_struct( &png, (png_infopp)NULL, (png_infopp)NULL );
         fclose( texfile );
-        return 0;
+        return NULL;
     }
 
     // make the end struct
@@ -90,7 +217,7 @@ GLuint PNGLoader::loadPNG( std::string filename, int &width, int &height )
     {
         png_destroy_read_struct( &png, &pngInfo, (png_infopp)NULL );
         fclose( texfile );
-        return 0;
+        return NULL;
     }
 
     // weird png error stuff...
@@ -98,7 +225,7 @@ GLuint PNGLoader::loadPNG( std::string filename, int &width, int &height )
     {
         png_destroy_read_struct( &png, &pngInfo, &pngEnd );
         fclose ( texfile );
-        return 0;
+        return NULL;
     }
 
     // initialize reading, set that we already read the header & read the
@@ -115,15 +242,24 @@ GLuint PNGLoader::loadPNG( std::string filename, int &width, int &height )
                     NULL, NULL, NULL );
     width = iwidth; height = iheight;
 
-    gravUtil::logVerbose( "PNGLoader::loadPNG: bitDepth: %i, colorType: %i, "
+    gravUtil::logVerbose( "PNGLoader::readPNG: bitDepth: %i, colorType: %i, "
             "RGBA: %i\n", bitDepth, colorType, PNG_COLOR_TYPE_RGBA );
 
-    int pwidth = GLUtil::getInstance()->pow2( iwidth );
-    int pheight = GLUtil::getInstance()->pow2( iheight );
-    gravUtil::logVerbose( "PNGLoader::loadPNG: read in PNG: image dimensions: "
-            "%ux%u, pow2 dimensions: %ux%u\n",
-            (unsigned int)iwidth, (unsigned int)iheight,
-            (unsigned int)pwidth, (unsigned int)pheight );
+    // whatever it's stored as, get it out as 8-bit RGBA
+    bool hasTransparency = png_get_valid( png, pngInfo, PNG_INFO_tRNS );
+    if ( colorType == PNG_COLOR_TYPE_PALETTE )
+        png_set_palette_to_rgb( png );
+    if ( colorType == PNG_COLOR_TYPE_GRAY && bitDepth < 8 )
+        png_set_expand_gray_1_2_4_to_8( png );
+    if ( hasTransparency )
+        png_set_tRNS_to_alpha( png );
+    if ( bitDepth == 16 )
+        png_set_strip_16( png );
+    if ( colorType == PNG_COLOR_TYPE_GRAY ||
+            colorType == PNG_COLOR_TYPE_GRAY_ALPHA )
+        png_set_gray_to_rgb( png );
+    if ( !( colorType & PNG_COLOR_MASK_ALPHA ) && !hasTransparency )
+        png_set_filler( png, 0xFF, PNG_FILLER_AFTER );
 
     // update the info struct
     png_read_update_info( png, pngInfo );
@@ -136,63 +272,22 @@ GLuint PNGLoader::loadPNG( std::string filename, int &width, int &height )
     for ( unsigned int i = 0; i < iheight; i++ )
         rowPointers[iheight - 1 - i] = image + (i * rowBytes);
 
-    // read in the image
-    png_read_image( png, rowPointers );
-
-    GLenum  gl_error = glGetError();
-    for ( ; (gl_error); gl_error = glGetError() )
-    {
-        gravUtil::logError( "PNGLoader::loadPNG: GLError: %s\n",
-                (const GLchar*)gluErrorString( gl_error ) );
-    }
-
-    GLuint texID;
-    glGenTextures( 1, &texID );
-    glBindTexture( GL_TEXTURE_2D, texID );
-
-    // allocate a buffer for the pow2 size
-    unsigned char *buffer = new unsigned char[pwidth * pheight * 4];
-    gravUtil::logVerbose( "PNGLoader::loadPNG: made buffer, "
-            "allocating texture\n" );
-    memset( buffer, 128, pwidth * pheight * 4 );
-
-    gl_error = glGetError();
-    for ( ; (gl_error); gl_error = glGetError() )
-    {
-        gravUtil::logError( "PNGLoader::loadPNG: GLError: %s\n",
-                (const GLchar*)gluErrorString( gl_error ) );
-    }
-
-    glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
-    glPixelStorei( GL_UNPACK_ROW_LENGTH, pwidth );
-
-    glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA, pwidth, pheight, 0, GL_RGBA,
-                    GL_UNSIGNED_BYTE, (GLvoid*)buffer );
-
-    glPixelStorei( GL_UNPACK_ALIGNMENT, 1);
-    glPixelStorei( GL_UNPACK_ROW_LENGTH, iwidth);
-
-    gravUtil::logVerbose( "PNGLoader::loadPNG: putting PNG in texture area\n" );
-
-    // put the actual image in a sub-area of the pow2 memory area
-    glTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, iwidth, iheight, GL_RGBA,
-                    GL_UNSIGNED_BYTE, (GLvoid*)image );
-
-    gl_error = glGetError();
-    for ( ; (gl_error); gl_error = glGetError() )
+    // same as above, but now there's more to clean up
+    if ( setjmp( png_jmpbuf( png ) ) )
     {
-        gravUtil::logError("PNGLoader::loadPNG: GLError: %s\n",
-                (const GLchar*)gluErrorString( gl_error ) );
+        png_destroy_read_struct( &png, &pngInfo, &pngEnd );
+        delete[] image;
+        delete[] rowPointers;
+        fclose ( texfile );
+        return NULL;
     }
 
-    gravUtil::logVerbose( "PNGLoader::loadPNG: PNGLoader::generated ID is %i\n",
-            texID );
+    // read in the image
+    png_read_image( png, rowPointers );
 
     png_destroy_read_struct( &png, &pngInfo, &pngEnd );
-    delete[] image;
     delete[] rowPointers;
-    delete[] buffer;
     fclose( texfile );
 
-    return texID;
+    return image;
 }
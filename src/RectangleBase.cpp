@@ -27,6 +27,9 @@
 #include "Group.h"
 #include "PNGLoader.h"
 #include "GLUtil.h"
+#include "BatchRenderer.h"
+#include "Animator.h"
+#include "SpatialIndex.h"
 #include "Point.h"
 
 #include "gravUtil.h"
@@ -119,16 +122,21 @@ RectangleBase::RectangleBase( const RectangleBase& other )
     grouped = other.grouped;
     myGroup = other.myGroup;
 
+    // note that any animations in progress don't carry over to the copy, it
+    // just stays where the original was
     animated = other.animated;
-    positionAnimating = other.positionAnimating;
-    scaleAnimating = other.scaleAnimating;
-    borderColAnimating = other.borderColAnimating;
-    secondColAnimating = other.secondColAnimating;
-    rotationAnimating = other.rotationAnimating;
+
+    // copies aren't drawn, so they don't go in the index
+    spatialIndex = NULL;
 }
 
 RectangleBase::~RectangleBase()
 {
+    Animator::getInstance()->stop( this );
+
+    if ( spatialIndex != NULL )
+        spatialIndex->remove( this );
+
     if ( isGrouped() )
     {
         myGroup->remove( this );
@@ -180,15 +188,11 @@ void RectangleBase::setDefaults()
     altName = "";
     siteID = "";
     myGroup = NULL;
+    spatialIndex = NULL;
     twidth = 0; theight = 0;
     effectVal = 0.0f;
 
     animated = true;
-    positionAnimating = false;
-    scaleAnimating = false;
-    borderColAnimating = false;
-    secondColAnimating = false;
-    rotationAnimating = false;
 
     // TODO: this should be dynamic
     lat = 43.165556f; lon = -77.611389f;
@@ -450,7 +454,12 @@ void RectangleBase::move( float _x, float _y )
         y = _y;
     }
     else
-        positionAnimating = true;
+    {
+        Animator* anim = Animator::getInstance();
+        anim->animate( this, &x, &destX, 7.5f );
+        anim->animate( this, &y, &destY, 7.5f );
+    }
+    boundsChanged();
 }
 
 void RectangleBase::move( float _x, float _y, float _z )
@@ -461,12 +470,17 @@ void RectangleBase::move( float _x, float _y, float _z )
     {
         z = destZ;
     }
+    else
+    {
+        Animator::getInstance()->animate( this, &z, &destZ, 7.5f );
+    }
 }
 
 void RectangleBase::setPos( float _x, float _y )
 {
     destX = _x; x = _x;
     destY = _y; y = _y;
+    boundsChanged();
 }
 
 void RectangleBase::setPos( float _x, float _y, float _z )
@@ -494,7 +508,12 @@ void RectangleBase::setScale( float xs, float ys )
         scaleY = ys;
     }
     else
-        scaleAnimating = true;
+    {
+        Animator* anim = Animator::getInstance();
+        anim->animate( this, &scaleX, &destScaleX, 7.5f );
+        anim->animate( this, &scaleY, &destScaleY, 7.5f );
+    }
+    boundsChanged();
 
     intendedWidth = getDestTotalWidth();
     intendedHeight = getDestTotalHeight();
@@ -571,7 +590,10 @@ void RectangleBase::setRotation( float x, float y, float z )
     }
     else
     {
-        rotationAnimating = true;
+        Animator* anim = Animator::getInstance();
+        anim->animate( this, &xAngle, &destXAngle, 7.5f );
+        anim->animate( this, &yAngle, &destYAngle, 7.5f );
+        anim->animate( this, &zAngle, &destZAngle, 7.5f );
     }
 }
 
@@ -772,6 +794,17 @@ void RectangleBase::setAnimation( bool anim )
     animated = anim;
 }
 
+void RectangleBase::setSpatialIndex( SpatialIndex* index )
+{
+    spatialIndex = index;
+}
+
+void RectangleBase::boundsChanged()
+{
+    if ( spatialIndex != NULL )
+        spatialIndex->markMoved( this );
+}
+
 bool RectangleBase::isUserMovable()
 {
     return userMovable;
@@ -839,7 +872,7 @@ void RectangleBase::setColor( RGBAColor c )
     if ( !animated )
         borderColor = destBColor;
     else
-        borderColAnimating = true;
+        animateColor( borderColor, destBColor );
 }
 
 void RectangleBase::setBaseColor( RGBAColor c )
@@ -868,7 +901,7 @@ void RectangleBase::setSecondaryColor( RGBAColor c )
     if ( !animated )
         secondaryColor = destSecondaryColor;
     else
-        secondColAnimating = true;
+        animateColor( secondaryColor, destSecondaryColor );
 }
 
 void RectangleBase::resetColor()
@@ -908,9 +941,16 @@ void RectangleBase::updateTextBounds()
     if ( GLUtil::getInstance()->getMainFont() )
     {
         nameSizeDirty = true;
+        titleLabel.markDirty();
     }
 }
 
+bool RectangleBase::needsRedraw()
+{
+    // animations are covered by the Animator
+    return nameSizeDirty;
+}
+
 void RectangleBase::setSubstring( int start, int end )
 {
     nameStart = start;
@@ -982,8 +1022,8 @@ void RectangleBase::show( bool s, bool instant )
     }
     else
     {
-        borderColAnimating = true;
-        secondColAnimating = true;
+        animateColor( borderColor, destBColor );
+        animateColor( secondaryColor, destSecondaryColor );
     }
 
     // this is done late since setSelect( false ) above will call setcolor
@@ -1008,20 +1048,9 @@ void RectangleBase::draw()
         delayedNameSizeUpdate();
     }
 
-    animateValues();
-
     if ( borderColor.A < 0.01f )
         return;
 
-    // set up our position
-    glPushMatrix();
-
-    glTranslatef( x, y, z );
-
-    glRotatef( xAngle, 1.0, 0.0, 0.0 );
-    glRotatef( yAngle, 0.0, 1.0, 0.0 );
-    glRotatef( zAngle, 0.0, 0.0, 1.0 );
-
     // draw the border first
     float s = (float)twidth / (float)GLUtil::getInstance()->pow2( twidth );
     float t = (float)theight / (float)GLUtil::getInstance()->pow2( theight );
@@ -1030,9 +1059,23 @@ void RectangleBase::draw()
     float Xdist = (getWidth()/2.0f) + getBorderSize();
     float Ydist = (getHeight()/2.0f) + getBorderSize();
 
+    BatchRenderer* batch = GLUtil::getInstance()->getBatchRenderer();
+
     // DEBUG DRAW
     if ( debugDraw )
     {
+        // this is still drawn directly, so anything batched before it needs
+        // to go first
+        batch->flush();
+
+        glPushMatrix();
+
+        glTranslatef( x, y, z );
+
+        glRotatef( xAngle, 1.0, 0.0, 0.0 );
+        glRotatef( yAngle, 0.0, 1.0, 0.0 );
+        glRotatef( zAngle, 0.0, 0.0, 1.0 );
+
         glEnable( GL_BLEND );
         glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
 
@@ -1123,14 +1166,23 @@ void RectangleBase::draw()
         glEnd();
 
         glDisable( GL_BLEND );
+
+        glPopMatrix();
     }
 
+    // set up our position
+    batch->reset();
+
+    batch->translate( x, y, z );
+
+    batch->rotate( xAngle, 1.0, 0.0, 0.0 );
+    batch->rotate( yAngle, 0.0, 1.0, 0.0 );
+    batch->rotate( zAngle, 0.0, 0.0, 1.0 );
+
     drawBorder( Xdist, Ydist, s, t );
 
     if ( GLUtil::getInstance()->getMainFont() && titleStyle != NOTEXT )
     {
-        glPushMatrix();
-
         float textYPos = 0.0f;
         float textXPos = 0.0f;
         if ( titleStyle == TOPTEXT )
@@ -1151,19 +1203,6 @@ void RectangleBase::draw()
                     getTextOffset() - getTextHeight();
         }
 
-        float scaleFactor = getTextScale();
-
-        glTranslatef( textXPos, textYPos, 0.0f );
-        //glRasterPos2f( -getWidth()/2.0f, getHeight()/2.0f+yOffset );
-        glScalef( scaleFactor, scaleFactor, scaleFactor );
-
-        glEnable( GL_BLEND );
-        glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
-        glEnable( GL_LINE_SMOOTH );
-
-        glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
-        glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
-
         std::string renderedName = getSubName();
 
         if ( cutoffPos != -1 )
@@ -1178,80 +1217,41 @@ void RectangleBase::draw()
 
         if ( debugDraw )
         {
-            char* posString = new char[ 50 ];
+            char posString[ 50 ];
             sprintf( posString, "(%f,%f)", x, y );
             renderedName += posString;
         }
 
-        // color call from before will carry over otherwise
+        batch->setBlend( true );
+
+        // colored text uses the border color from before
         if ( !coloredText )
         {
-            glColor4f( 1.0f, 1.0f, 1.0f, borderColor.A );
+            batch->setColor( 1.0f, 1.0f, 1.0f, borderColor.A );
         }
 
-        const char* nc = renderedName.c_str();
-        GLUtil::getInstance()->getMainFont()->Render( nc );
-
-        glDisable( GL_BLEND );
-        glDisable( GL_LINE_SMOOTH );
-
-        glPopMatrix();
+        titleLabel.setText( renderedName );
+        batch->addLabel( titleLabel, textXPos, textYPos, getTextScale() );
     }
-
-    glPopMatrix(); // from initial position setup
-
-    /*float spacing = 0.20f;
-    //float i = -name.length()*spacing/2.0f;
-    float i = -getWidth();
-    for (; *nc != '\0'; nc++)
-    {
-        glRasterPos2f( i*spacing, getHeight()/2.0f+0.2f );
-        //glutBitmapCharacter(GLUT_BITMAP_TIMES_ROMAN_10,*nc);
-        i++;
-    }
-    //glutStrokeString(GLUT_STROKE_MONO_ROMAN, uc);*/
-    /*zAngle += 0.5f;
-    yAngle += 0.1f;
-    xAngle += 0.01f;*/
 }
 
 void RectangleBase::drawBorder( float Xdist, float Ydist, float s, float t )
 {
-    glEnable( GL_BLEND );
-    glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
-
-    glEnable( GL_TEXTURE_2D );
-    glBindTexture( GL_TEXTURE_2D, borderTex );
-    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP );
-    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP );
-    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
-    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+    BatchRenderer* batch = GLUtil::getInstance()->getBatchRenderer();
 
-    glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
-    glPixelStorei( GL_UNPACK_ROW_LENGTH, twidth );
+    batch->setBlend( true );
+    batch->setTextures( 1, &borderTex );
 
-    glBegin( GL_QUADS );
     // set the border color
-    glColor4f( borderColor.R-(effectVal*3.0f),
-               borderColor.G-(effectVal*3.0f),
-               borderColor.B+(effectVal*6.0f),
-               borderColor.A+(effectVal*3.0f) );
+    batch->setColor( borderColor.R-(effectVal*3.0f),
+                     borderColor.G-(effectVal*3.0f),
+                     borderColor.B+(effectVal*6.0f),
+                     borderColor.A+(effectVal*3.0f) );
 
-    glTexCoord2f(0.0, 0.0);
-    glVertex3f(-Xdist, -Ydist, 0.0);
+    batch->addQuad( -Xdist, -Ydist, Xdist, Ydist, s, t );
 
-    glTexCoord2f(0.0, t);
-    glVertex3f(-Xdist, Ydist, 0.0);
-
-    glTexCoord2f(s, t);
-    glVertex3f(Xdist, Ydist, 0.0);
-
-    glTexCoord2f(s, 0.0);
-    glVertex3f(Xdist, -Ydist, 0.0);
-
-    glEnd();
-    glDisable( GL_BLEND );
-    glDisable( GL_TEXTURE_2D );
+    batch->setTextures( 0, NULL );
+    batch->setBlend( false );
 }
 
 /*
@@ -1272,8 +1272,7 @@ void RectangleBase::delayedNameSizeUpdate()
     intended.setPos( posX, posY );
 
     cutoffPos = -1;
-    textBounds = GLUtil::getInstance()->getMainFont()->BBox(
-            getSubName().c_str() );
+    textBounds = GLUtil::getInstance()->getTextBounds( getSubName() );
     // only do cutoff if title is at top - so if centered (or other?)
     // display whole name even if it goes out of bounds
     while ( titleStyle == TOPTEXT && getTextWidth() > getWidth() )
@@ -1293,8 +1292,7 @@ void RectangleBase::delayedNameSizeUpdate()
 
         cutoffPos = curEnd - ceil( ( 1.0f -
               ( getWidth() / getTextWidth() ) ) * numChars ) - 1;
-        textBounds = GLUtil::getInstance()->getMainFont()->BBox(
-                getSubName().c_str() );
+        textBounds = GLUtil::getInstance()->getTextBounds( getSubName() );
     }
 
     // also, since the text bounds might change, resize to fill the intended
@@ -1304,95 +1302,12 @@ void RectangleBase::delayedNameSizeUpdate()
     nameSizeDirty = false;
 }
 
-void RectangleBase::animateValues()
+void RectangleBase::animateColor( RGBAColor& col, const RGBAColor& dest )
 {
-    // note the fabs stuff is to snap to the destination, since we'll never
-    // actually get there via the division calls due to roundoff errors
-
-    // movement animation
-    if ( positionAnimating )
-    {
-        x += ( destX - x ) / 7.5f;
-        y += ( destY - y ) / 7.5f;
-        z += ( destZ - z ) / 7.5f;
-
-        if ( fabs( destX - x ) < 0.01f && fabs( destY - y ) < 0.01f &&
-                fabs( destZ - z ) < 0.01f )
-        {
-            x = destX;
-            y = destY;
-            z = destZ;
-            positionAnimating = false;
-        }
-    }
-
-    if ( scaleAnimating )
-    {
-        scaleX += ( destScaleX - scaleX ) / 7.5f;
-        scaleY += ( destScaleY - scaleY ) / 7.5f;
-
-        if ( fabs( destScaleX - scaleX ) < 0.01f &&
-             fabs( destScaleY - scaleY ) < 0.01f )
-        {
-            scaleX = destScaleX;
-            scaleY = destScaleY;
-            scaleAnimating = false;
-        }
-    }
-
-    if ( borderColAnimating )
-    {
-        borderColor.R += ( destBColor.R - borderColor.R ) / 3.0f;
-        borderColor.G += ( destBColor.G - borderColor.G ) / 3.0f;
-        borderColor.B += ( destBColor.B - borderColor.B ) / 3.0f;
-        borderColor.A += ( destBColor.A - borderColor.A ) / 7.0f;
-
-        if ( fabs( destBColor.R - borderColor.R ) < 0.01f &&
-             fabs( destBColor.G - borderColor.G ) < 0.01f &&
-             fabs( destBColor.B - borderColor.B ) < 0.01f &&
-             fabs( destBColor.A - borderColor.A ) < 0.01f )
-        {
-            borderColor.R = destBColor.R;
-            borderColor.G = destBColor.G;
-            borderColor.B = destBColor.B;
-            borderColor.A = destBColor.A;
-            borderColAnimating = false;
-        }
-    }
-
-    if ( secondColAnimating )
-    {
-        secondaryColor.R += ( destSecondaryColor.R - secondaryColor.R ) / 3.0f;
-        secondaryColor.G += ( destSecondaryColor.G - secondaryColor.G ) / 3.0f;
-        secondaryColor.B += ( destSecondaryColor.B - secondaryColor.B ) / 3.0f;
-        secondaryColor.A += ( destSecondaryColor.A - secondaryColor.A ) / 7.0f;
-
-        if ( fabs( destSecondaryColor.R - secondaryColor.R ) < 0.01f &&
-             fabs( destSecondaryColor.G - secondaryColor.G ) < 0.01f &&
-             fabs( destSecondaryColor.B - secondaryColor.B ) < 0.01f &&
-             fabs( destSecondaryColor.A - secondaryColor.A ) < 0.01f )
-        {
-            secondaryColor.R = destSecondaryColor.R;
-            secondaryColor.G = destSecondaryColor.G;
-            secondaryColor.B = destSecondaryColor.B;
-            secondaryColor.A = destSecondaryColor.A;
-            secondColAnimating = false;
-        }
-    }
-
-    if ( rotationAnimating )
-    {
-        xAngle += ( destXAngle - xAngle ) / 7.5f;
-        yAngle += ( destYAngle - yAngle ) / 7.5f;
-        zAngle += ( destZAngle - zAngle ) / 7.5f;
-
-        if ( fabs( destXAngle - xAngle ) < 0.01f && fabs( destYAngle - yAngle ) < 0.01f &&
-                fabs( destZAngle - zAngle ) < 0.01f )
-        {
-            xAngle = destXAngle;
-            yAngle = destYAngle;
-            zAngle = destZAngle;
-            rotationAnimating = false;
-        }
-    }
+    // alpha fades slower than the color changes
+    Animator* anim = Animator::getInstance();
+    anim->animate( this, &col.R, &dest.R, 3.0f );
+    anim->animate( this, &col.G, &dest.G, 3.0f );
+    anim->animate( this, &col.B, &dest.B, 3.0f );
+    anim->animate( this, &col.A, &dest.A, 7.0f );
 }
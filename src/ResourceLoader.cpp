@@ -0,0 +1,182 @@
+/*
+ * @file ResourceLoader.cpp
+ *
+ * Implementation of the ResourceLoader class. See ResourceLoader.h for
+ * details.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ResourceLoader.h"
+#include "PNGLoader.h"
+#include "gravUtil.h"
+
+#include <wx/thread.h>
+
+ResourceLoader::ResourceLoader( int numThreads )
+{
+    quit = false;
+    unfinished = 0;
+    wake = new wxSemaphore();
+    queueMutex = mutex_create();
+
+    if ( numThreads < 1 )
+        numThreads = 1;
+    for ( int i = 0; i < numThreads; i++ )
+        threads.push_back( thread_start( loaderThread, this ) );
+
+    gravUtil::logVerbose( "ResourceLoader::ResourceLoader: started %i "
+            "threads\n", numThreads );
+}
+
+ResourceLoader::~ResourceLoader()
+{
+    quit = true;
+    for ( unsigned int i = 0; i < threads.size(); i++ )
+        wake->Post();
+    for ( unsigned int i = 0; i < threads.size(); i++ )
+        thread_join( threads[i] );
+
+    // anything that didn't get to finish just gets thrown away
+    for ( unsigned int i = 0; i < waiting.size(); i++ )
+        delete waiting[i];
+    for ( unsigned int i = 0; i < loaded.size(); i++ )
+        delete loaded[i];
+
+    delete wake;
+    mutex_free( queueMutex );
+}
+
+void ResourceLoader::add( Job* job )
+{
+    mutex_lock( queueMutex );
+    waiting.push_back( job );
+    unfinished++;
+    mutex_unlock( queueMutex );
+
+    // one post per job, so each wakeup has exactly one job to take
+    wake->Post();
+}
+
+int ResourceLoader::finishLoaded( int maxJobs )
+{
+    std::vector<Job*> batch;
+    mutex_lock( queueMutex );
+    while ( !loaded.empty() && (int)batch.size() < maxJobs )
+    {
+        batch.push_back( loaded.front() );
+        loaded.pop_front();
+    }
+    mutex_unlock( queueMutex );
+
+    for ( unsigned int i = 0; i < batch.size(); i++ )
+    {
+        batch[i]->finish();
+        delete batch[i];
+    }
+
+    if ( !batch.empty() )
+    {
+        mutex_lock( queueMutex );
+        unfinished -= batch.size();
+        mutex_unlock( queueMutex );
+    }
+
+    return batch.size();
+}
+
+bool ResourceLoader::isBusy()
+{
+    mutex_lock( queueMutex );
+    bool ret = unfinished > 0;
+    mutex_unlock( queueMutex );
+    return ret;
+}
+
+void* ResourceLoader::loaderThread( void* args )
+{
+    ResourceLoader* loader = (ResourceLoader*)args;
+
+    while ( true )
+    {
+        loader->wake->Wait();
+        if ( loader->quit )
+            break;
+
+        mutex_lock( loader->queueMutex );
+        Job* job = loader->waiting.front();
+        loader->waiting.pop_front();
+        mutex_unlock( loader->queueMutex );
+
+        job->load();
+
+        mutex_lock( loader->queueMutex );
+        loader->loaded.push_back( job );
+        mutex_unlock( loader->queueMutex );
+    }
+
+    return NULL;
+}
+
+TextureLoadJob::TextureLoadJob( GLuint tex, std::string file, int w, int h,
+                                bool m )
+{
+    texID = tex;
+    fileName = file;
+    width = w;
+    height = h;
+    mipmap = m;
+    image = NULL;
+}
+
+TextureLoadJob::~TextureLoadJob()
+{
+    delete[] image;
+}
+
+void TextureLoadJob::load()
+{
+    int w, h;
+    image = PNGLoader::readPNG( fileName, w, h );
+
+    // the texture was allocated from the size in the header, so this would
+    // only happen if the file changed in between
+    if ( image != NULL && ( w != width || h != height ) )
+    {
+        delete[] image;
+        image = NULL;
+    }
+}
+
+void TextureLoadJob::finish()
+{
+    if ( image == NULL )
+    {
+        gravUtil::logWarning( "TextureLoadJob::finish: texture %s failed to "
+                "load\n", fileName.c_str() );
+        return;
+    }
+
+    PNGLoader::uploadImage( texID, image, width, height );
+    if ( mipmap )
+        GLUtil::getInstance()->generateMipmaps( texID );
+
+    gravUtil::logVerbose( "TextureLoadJob::finish: %s loaded into %u\n",
+            fileName.c_str(), texID );
+}
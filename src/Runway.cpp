@@ -24,6 +24,8 @@
  */
 
 #include "Runway.h"
+#include "GLUtil.h"
+#include "BatchRenderer.h"
 #include <sstream>
 
 Runway::Runway( float _x, float _y ) :
@@ -47,8 +49,6 @@ Runway::Runway( float _x, float _y ) :
 
 void Runway::draw()
 {
-    animateValues();
-
     drawRunwayBorder();
 
     // draw members like a normal group
@@ -65,49 +65,34 @@ void Runway::drawRunwayBorder()
 
     // note this must set up the position itself, since it doesn't call the
     // inherited draw method from RectangleBase
-    glPushMatrix();
+    BatchRenderer* batch = GLUtil::getInstance()->getBatchRenderer();
+    batch->reset();
 
-    glRotatef( xAngle, 1.0, 0.0, 0.0 );
-    glRotatef( yAngle, 0.0, 1.0, 0.0 );
-    glRotatef( zAngle, 0.0, 0.0, 1.0 );
+    batch->rotate( xAngle, 1.0, 0.0, 0.0 );
+    batch->rotate( yAngle, 0.0, 1.0, 0.0 );
+    batch->rotate( zAngle, 0.0, 0.0, 1.0 );
 
-    glTranslatef( x, y, z );
+    batch->translate( x, y, z );
 
-    glEnable( GL_BLEND );
-    glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
+    batch->setBlend( true );
 
     float Xdist = scaleX / 2;
     float Ydist = scaleY / 2;
 
     // the main box
-    glBegin( GL_QUADS );
-
-    glColor4f( borderColor.R * 0.5f, borderColor.G * 0.5f,
-                borderColor.B * 0.5f, borderColor.A * 0.7f );
+    batch->setColor( borderColor.R * 0.5f, borderColor.G * 0.5f,
+                        borderColor.B * 0.5f, borderColor.A * 0.7f );
 
-    glVertex3f( -Xdist, -Ydist, 0.0 );
-    glVertex3f( -Xdist, Ydist, 0.0 );
-    glVertex3f( Xdist, Ydist, 0.0 );
-    glVertex3f( Xdist, -Ydist, 0.0 );
-
-    glEnd();
+    batch->addQuad( -Xdist, -Ydist, Xdist, Ydist );
 
     // the outline
-    glBegin( GL_LINE_LOOP );
-
-    glColor4f( borderColor.R, borderColor.G,
-                borderColor.B, borderColor.A );
-
-    glVertex3f( -Xdist, -Ydist, 0.0 );
-    glVertex3f( -Xdist, Ydist, 0.0 );
-    glVertex3f( Xdist, Ydist, 0.0 );
-    glVertex3f( Xdist, -Ydist, 0.0 );
-
-    glEnd();
-
-    glDisable( GL_BLEND );
+    batch->setColor( borderColor.R, borderColor.G,
+                        borderColor.B, borderColor.A );
 
-    glPopMatrix();
+    batch->addLine( -Xdist, -Ydist, -Xdist, Ydist );
+    batch->addLine( -Xdist, Ydist, Xdist, Ydist );
+    batch->addLine( Xdist, Ydist, Xdist, -Ydist );
+    batch->addLine( Xdist, -Ydist, -Xdist, -Ydist );
 }
 
 bool Runway::updateName()
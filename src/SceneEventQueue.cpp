@@ -0,0 +1,127 @@
+/*
+ * @file SceneEventQueue.cpp
+ *
+ * Implementation of the SceneEventQueue class. See SceneEventQueue.h for
+ * details.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SceneEventQueue.h"
+
+#include <cstddef>
+#include <sys/time.h>
+
+static double getTimeMS()
+{
+    struct timeval now;
+    gettimeofday( &now, NULL );
+    return (double)now.tv_sec * 1000.0 + (double)now.tv_usec / 1000.0;
+}
+
+SceneEvent::SceneEvent( Type t )
+{
+    type = t;
+    source = NULL;
+    session = NULL;
+    ssrc = 0;
+    siteID = "";
+    latency = 0.0;
+    pushTime = 0.0;
+    next = NULL;
+}
+
+SceneEventQueue::SceneEventQueue() :
+    stub( SceneEvent::SOURCE_ADDED )
+{
+    head = &stub;
+    tail = &stub;
+    backlog = 0;
+}
+
+SceneEventQueue::~SceneEventQueue()
+{
+    // nothing should be pushing by now, so everything's linked up
+    SceneEvent* event;
+    while ( ( event = pop() ) != NULL )
+        delete event;
+}
+
+void SceneEventQueue::push( SceneEvent* event )
+{
+    event->pushTime = getTimeMS();
+    event->next = NULL;
+    __atomic_add_fetch( &backlog, 1, __ATOMIC_SEQ_CST );
+
+    // the link is a release store, so everything written to the event is
+    // visible to the popper by the time it can get to it through prev
+    SceneEvent* prev = exchangeHead( event );
+    __atomic_store_n( &prev->next, event, __ATOMIC_RELEASE );
+}
+
+SceneEvent* SceneEventQueue::pop()
+{
+    // links are loaded with acquire, pairing with the stores in push(), so
+    // an event's contents are there once we can see the link to it
+    SceneEvent* first = tail;
+    SceneEvent* next = __atomic_load_n( &first->next, __ATOMIC_ACQUIRE );
+
+    // skip over the stub if it's at the front
+    if ( first == &stub )
+    {
+        if ( next == NULL )
+            return NULL;
+        tail = next;
+        first = next;
+        next = __atomic_load_n( &next->next, __ATOMIC_ACQUIRE );
+    }
+
+    // first can only be taken once something's linked after it
+    if ( next == NULL )
+    {
+        // this one's last - if it isn't the head, someone's in the middle of
+        // pushing after it and we can't unlink it until they're done
+        if ( first != __atomic_load_n( &head, __ATOMIC_ACQUIRE ) )
+            return NULL;
+
+        // put the stub back behind it, so it isn't the last one anymore
+        __atomic_store_n( &stub.next, (SceneEvent*)NULL, __ATOMIC_RELAXED );
+        SceneEvent* prev = exchangeHead( &stub );
+        __atomic_store_n( &prev->next, &stub, __ATOMIC_RELEASE );
+
+        next = __atomic_load_n( &first->next, __ATOMIC_ACQUIRE );
+        if ( next == NULL )
+            return NULL;
+    }
+
+    tail = next;
+    first->latency = getTimeMS() - first->pushTime;
+    __atomic_sub_fetch( &backlog, 1, __ATOMIC_SEQ_CST );
+    return first;
+}
+
+int SceneEventQueue::getBacklog()
+{
+    return __atomic_load_n( &backlog, __ATOMIC_SEQ_CST );
+}
+
+SceneEvent* SceneEventQueue::exchangeHead( SceneEvent* event )
+{
+    return __atomic_exchange_n( &head, event, __ATOMIC_ACQ_REL );
+}
@@ -30,6 +30,9 @@
 #include "SessionEntry.h"
 #include "Group.h"
 #include "SessionManager.h"
+#include "SessionReactor.h"
+
+#include <cstdlib>
 
 SessionEntry::SessionEntry( std::string addr, bool aud )
 {
@@ -92,7 +95,13 @@ bool SessionEntry::initSession( VPMSessionListener* listener )
         session->enableAudio( audio );
         session->enableOther( false );
 
-        if ( !session->initialise() )
+        // the session's sockets are the ones that show up while it
+        // initializes on its port - see SessionReactor
+        std::set<int> socketsBefore = SessionReactor::findDatagramSockets();
+        bool initOK = session->initialise();
+        std::set<int> socketsAfter = SessionReactor::findDatagramSockets();
+
+        if ( !initOK )
         {
             gravUtil::logError( "SessionEntry::init: failed to initialize on "
                                 "address %s\n", address.c_str() );
@@ -110,6 +119,16 @@ bool SessionEntry::initSession( VPMSessionListener* listener )
             session->setEncryptionKey( encryptionKey.c_str() );
         }
 
+        // addresses are address/port - if there's no port, there's nothing
+        // to match on, so it just gets polled
+        std::string::size_type slash = address.find( '/' );
+        int port = slash != std::string::npos ?
+                    atoi( address.c_str() + slash + 1 ) : 0;
+        socketFDs = SessionReactor::findSessionSockets( socketsBefore,
+                                                        socketsAfter, port );
+        gravUtil::logVerbose( "SessionEntry::init: %s is using %u sockets\n",
+                                address.c_str(), socketFDs.size() );
+
         sessionTS = random32();
 
         initialized = true;
@@ -143,6 +162,7 @@ void SessionEntry::disableSession()
     }
 
     initialized = false;
+    socketFDs.clear();
     setBaseColor( disabledColor );
     inFailedState = false;
     // was originally going to call this var "lastInitFailed" but that name
@@ -215,6 +235,11 @@ VPMSession* SessionEntry::getVPMSession()
     return session;
 }
 
+std::vector<int> SessionEntry::getSocketFDs()
+{
+    return socketFDs;
+}
+
 bool SessionEntry::iterate()
 {
     bool running = isSessionEnabled() && processingEnabled;
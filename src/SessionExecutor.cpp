@@ -0,0 +1,301 @@
+/*
+ * @file SessionExecutor.cpp
+ *
+ * Implementation of the SessionExecutor class. See SessionExecutor.h for
+ * details.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SessionExecutor.h"
+#include "SessionEntry.h"
+#include "SessionReactor.h"
+#include "gravUtil.h"
+
+#include <wx/thread.h>
+
+#include <sys/time.h>
+
+// longest a worker goes without iterating all of its sessions, waiting or
+// not, so RTCP & anything else VPMedia does on a timer still happens on time
+static const int fullPassIntervalMS = 10;
+
+// how often sessions that can't be waited on get polled
+static const int pollIntervalMS = 1;
+
+static double getTimeMS()
+{
+    struct timeval now;
+    gettimeofday( &now, NULL );
+    return (double)now.tv_sec * 1000.0 + (double)now.tv_usec / 1000.0;
+}
+
+SessionExecutor::SessionExecutor( int numThreads )
+{
+    quit = false;
+    registryMutex = mutex_create();
+
+    if ( numThreads < 1 )
+        numThreads = 1;
+    for ( int i = 0; i < numThreads; i++ )
+    {
+        Worker* worker = new Worker;
+        worker->executor = this;
+        worker->listMutex = mutex_create();
+        worker->count = 0;
+        worker->reactor = new SessionReactor();
+        worker->wake = new wxSemaphore();
+        worker->handle = thread_start( workerThread, worker );
+        workers.push_back( worker );
+    }
+
+    gravUtil::logVerbose( "SessionExecutor::SessionExecutor: started %i "
+            "threads\n", numThreads );
+}
+
+SessionExecutor::~SessionExecutor()
+{
+    quit = true;
+    for ( unsigned int i = 0; i < workers.size(); i++ )
+        workers[i]->wake->Post();
+    for ( unsigned int i = 0; i < workers.size(); i++ )
+        thread_join( workers[i]->handle );
+
+    for ( unsigned int i = 0; i < workers.size(); i++ )
+    {
+        Worker* worker = workers[i];
+        for ( unsigned int j = 0; j < worker->slots.size(); j++ )
+        {
+            mutex_free( worker->slots[j]->busy );
+            delete worker->slots[j];
+        }
+        mutex_free( worker->listMutex );
+        delete worker->reactor;
+        delete worker->wake;
+        delete worker;
+    }
+
+    mutex_free( registryMutex );
+}
+
+void SessionExecutor::add( SessionEntry* entry )
+{
+    mutex_lock( registryMutex );
+
+    if ( assignments.find( entry ) != assignments.end() )
+    {
+        mutex_unlock( registryMutex );
+        gravUtil::logWarning( "SessionExecutor::add: session %s already "
+                "added\n", entry->getAddress().c_str() );
+        return;
+    }
+
+    Worker* worker = workers[0];
+    for ( unsigned int i = 1; i < workers.size(); i++ )
+    {
+        if ( workers[i]->count < worker->count )
+            worker = workers[i];
+    }
+    worker->count++;
+    assignments[ entry ] = worker;
+    entries[ entry->getVPMSession() ] = entry;
+
+    mutex_unlock( registryMutex );
+
+    Slot* slot = new Slot;
+    slot->entry = entry;
+    slot->busy = mutex_create();
+    if ( worker->reactor->isAvailable() )
+        slot->fds = entry->getSocketFDs();
+    slot->watching = !slot->fds.empty();
+    worker->reactor->add( slot->fds );
+
+    mutex_lock( worker->listMutex );
+    worker->slots.push_back( slot );
+    mutex_unlock( worker->listMutex );
+    worker->wake->Post();
+}
+
+void SessionExecutor::remove( SessionEntry* entry )
+{
+    mutex_lock( registryMutex );
+    std::map<SessionEntry*, Worker*>::iterator it = assignments.find( entry );
+    Worker* worker = it != assignments.end() ? it->second : NULL;
+    mutex_unlock( registryMutex );
+
+    if ( worker == NULL )
+        return;
+
+    Slot* slot = NULL;
+    mutex_lock( worker->listMutex );
+    for ( unsigned int i = 0; i < worker->slots.size(); i++ )
+    {
+        if ( worker->slots[i]->entry == entry )
+        {
+            slot = worker->slots[i];
+            worker->slots.erase( worker->slots.begin() + i );
+            break;
+        }
+    }
+    mutex_unlock( worker->listMutex );
+
+    // the worker grabs a slot's lock before letting go of the list, so once
+    // it's out of the list the only one who could still have it is a worker
+    // that's iterating it right now - wait for that to finish before taking
+    // it out of the registry, since the session's callbacks can still be
+    // looking it up until then
+    if ( slot != NULL )
+    {
+        mutex_lock( slot->busy );
+        mutex_unlock( slot->busy );
+    }
+
+    mutex_lock( registryMutex );
+    worker->count--;
+    assignments.erase( entry );
+    entries.erase( entry->getVPMSession() );
+    mutex_unlock( registryMutex );
+
+    if ( slot == NULL )
+        return;
+
+    // after the wait, since the worker might have started watching it again
+    if ( slot->watching )
+        worker->reactor->remove( slot->fds );
+
+    mutex_free( slot->busy );
+    delete slot;
+}
+
+SessionEntry* SessionExecutor::find( VPMSession* session )
+{
+    mutex_lock( registryMutex );
+
+    SessionEntry* ret = NULL;
+    std::map<VPMSession*, SessionEntry*>::iterator it =
+            entries.find( session );
+    if ( it != entries.end() )
+        ret = it->second;
+
+    mutex_unlock( registryMutex );
+    return ret;
+}
+
+int SessionExecutor::getNumThreads()
+{
+    return workers.size();
+}
+
+int SessionExecutor::getSessionCount()
+{
+    mutex_lock( registryMutex );
+    int ret = assignments.size();
+    mutex_unlock( registryMutex );
+    return ret;
+}
+
+void* SessionExecutor::workerThread( void* args )
+{
+    Worker* worker = (Worker*)args;
+    worker->executor->iterateLoop( worker );
+    return NULL;
+}
+
+void SessionExecutor::iterateLoop( Worker* worker )
+{
+    std::set<int> ready;
+    bool fullPass = true;
+    double lastFullPass = getTimeMS();
+
+    while ( !quit )
+    {
+        // nothing to wait on or poll, so sleep until there is - a post left
+        // over from an earlier add just makes for one extra time around
+        mutex_lock( worker->listMutex );
+        bool empty = worker->slots.empty();
+        mutex_unlock( worker->listMutex );
+        if ( empty )
+        {
+            worker->wake->Wait();
+            fullPass = true;
+            continue;
+        }
+
+        bool polling = false;
+
+        // a session getting removed in the middle of this shifts the rest
+        // down, so one might get skipped this time around - that's fine
+        for ( unsigned int i = 0; !quit; i++ )
+        {
+            mutex_lock( worker->listMutex );
+            if ( i >= worker->slots.size() )
+            {
+                mutex_unlock( worker->listMutex );
+                break;
+            }
+            Slot* slot = worker->slots[i];
+            mutex_lock( slot->busy );
+            mutex_unlock( worker->listMutex );
+
+            if ( slot->fds.empty() )
+            {
+                polling = slot->entry->iterate() || polling;
+            }
+            else if ( fullPass || isReady( slot, ready ) )
+            {
+                bool running = slot->entry->iterate();
+                if ( running != slot->watching )
+                {
+                    if ( running )
+                        worker->reactor->add( slot->fds );
+                    else
+                        worker->reactor->remove( slot->fds );
+                    slot->watching = running;
+                }
+            }
+
+            mutex_unlock( slot->busy );
+        }
+
+        double now = getTimeMS();
+        if ( fullPass )
+            lastFullPass = now;
+
+        // sleep until something comes in or it's time for the next full
+        // pass, or just a little if anything has to be polled
+        int timeout = (int)( lastFullPass + fullPassIntervalMS - now );
+        if ( polling && timeout > pollIntervalMS )
+            timeout = pollIntervalMS;
+
+        ready.clear();
+        worker->reactor->wait( timeout, ready );
+
+        fullPass = getTimeMS() - lastFullPass >= fullPassIntervalMS;
+    }
+}
+
+bool SessionExecutor::isReady( Slot* slot, const std::set<int>& ready )
+{
+    for ( unsigned int i = 0; i < slot->fds.size(); i++ )
+    {
+        if ( ready.count( slot->fds[i] ) > 0 )
+            return true;
+    }
+    return false;
+}
@@ -28,6 +28,8 @@
 #include "SessionGroupButton.h"
 #include "GLCanvas.h"
 #include "Timers.h"
+#include "GLUtil.h"
+#include "BatchRenderer.h"
 
 SessionGroup::SessionGroup( float _x, float _y ) :
     Runway( _x, _y )
@@ -50,8 +52,6 @@ void SessionGroup::draw()
 {
     // note this duplicates runway's draw so we can stick the rotating animation
     // in between the border/background and the member drawing
-    animateValues();
-
     drawRunwayBorder();
 
     if ( rotating && timer != NULL )
@@ -59,30 +59,22 @@ void SessionGroup::draw()
         float xPos = getBounds().L + ( scaleX * timer->getProgress() );
         float size = scaleY / 4.0f;
 
-        glPushMatrix();
-
-        glRotatef( xAngle, 1.0, 0.0, 0.0 );
-        glRotatef( yAngle, 0.0, 1.0, 0.0 );
-        glRotatef( zAngle, 0.0, 0.0, 1.0 );
-
-        glTranslatef( xPos, y, z );
-
-        glEnable( GL_BLEND );
-        glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
-
-        glColor4f( borderColor.R, borderColor.G, borderColor.B, borderColor.A );
+        BatchRenderer* batch = GLUtil::getInstance()->getBatchRenderer();
+        batch->reset();
 
-        glBegin( GL_TRIANGLES );
+        batch->rotate( xAngle, 1.0, 0.0, 0.0 );
+        batch->rotate( yAngle, 0.0, 1.0, 0.0 );
+        batch->rotate( zAngle, 0.0, 0.0, 1.0 );
 
-        glVertex3f( -size * 0.7f, -size, 0.0 );
-        glVertex3f( -size * 0.7f, size, 0.0 );
-        glVertex3f( size, 0.0, 0.0 );
+        batch->translate( xPos, y, z );
 
-        glEnd();
+        batch->setBlend( true );
 
-        glDisable( GL_BLEND );
+        batch->setColor( borderColor.R, borderColor.G, borderColor.B,
+                            borderColor.A );
 
-        glPopMatrix();
+        batch->addTriangle( -size * 0.7f, -size, -size * 0.7f, size,
+                            size, 0.0f );
     }
 
     // draw members like a normal group
@@ -25,6 +25,8 @@
 
 #include "SessionGroupButton.h"
 #include "SessionManager.h"
+#include "GLUtil.h"
+#include "BatchRenderer.h"
 
 SessionGroupButton::SessionGroupButton( float _x, float _y ) :
     RectangleBase( _x, _y )
@@ -38,65 +40,42 @@ void SessionGroupButton::draw()
 {
     RectangleBase::draw();
 
-    glPushMatrix();
+    BatchRenderer* batch = GLUtil::getInstance()->getBatchRenderer();
+    batch->reset();
 
-    glRotatef( xAngle, 1.0, 0.0, 0.0 );
-    glRotatef( yAngle, 0.0, 1.0, 0.0 );
-    glRotatef( zAngle, 0.0, 0.0, 1.0 );
+    batch->rotate( xAngle, 1.0, 0.0, 0.0 );
+    batch->rotate( yAngle, 0.0, 1.0, 0.0 );
+    batch->rotate( zAngle, 0.0, 0.0, 1.0 );
 
-    glTranslatef( x, y, z );
+    batch->translate( x, y, z );
 
-    glEnable( GL_BLEND );
-    glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
+    batch->setBlend( true );
 
     float Xdist = scaleX / 2.5;
     float Ydist = scaleY / 2.5;
 
-    glColor4f( borderColor.R * 0.5f, borderColor.G * 0.5f,
-                borderColor.B * 0.5f, borderColor.A * 0.7f );
+    batch->setColor( borderColor.R * 0.5f, borderColor.G * 0.5f,
+                        borderColor.B * 0.5f, borderColor.A * 0.7f );
 
     if ( playing )
     {
         // stop symbol
-        glBegin( GL_QUADS );
-
-        glVertex3f( -Xdist * 0.7f, -Ydist * 0.7f, 0.0 );
-        glVertex3f( -Xdist * 0.7f, Ydist * 0.7f, 0.0 );
-        glVertex3f( Xdist * 0.7f, Ydist * 0.7f, 0.0 );
-        glVertex3f( Xdist * 0.7f, -Ydist * 0.7f, 0.0 );
-
-        glEnd();
+        batch->addQuad( -Xdist * 0.7f, -Ydist * 0.7f,
+                        Xdist * 0.7f, Ydist * 0.7f );
 
         // here's the pause symbol if that ever gets implemented
-        /*glBegin( GL_QUADS );
-
-        glVertex3f( -Xdist * 0.7f, -Ydist * 0.8f, 0.0 );
-        glVertex3f( -Xdist * 0.7f, Ydist * 0.8f, 0.0 );
-        glVertex3f( -Xdist * 0.25f, Ydist * 0.8f, 0.0 );
-        glVertex3f( -Xdist * 0.25f, -Ydist * 0.8f, 0.0 );
-
-        glVertex3f( Xdist * 0.7f, -Ydist * 0.8f, 0.0 );
-        glVertex3f( Xdist * 0.7f, Ydist * 0.8f, 0.0 );
-        glVertex3f( Xdist * 0.25f, Ydist * 0.8f, 0.0 );
-        glVertex3f( Xdist * 0.25f, -Ydist * 0.8f, 0.0 );
-
-        glEnd();*/
+        /*batch->addQuad( -Xdist * 0.7f, -Ydist * 0.8f,
+                        -Xdist * 0.25f, Ydist * 0.8f );
+        batch->addQuad( Xdist * 0.25f, -Ydist * 0.8f,
+                        Xdist * 0.7f, Ydist * 0.8f );*/
     }
     else
     {
         // the main triangle
-        glBegin( GL_TRIANGLES );
-
-        glVertex3f( -Xdist * 0.7f, -Ydist * 0.8f, 0.0 );
-        glVertex3f( -Xdist * 0.7f, Ydist * 0.8f, 0.0 );
-        glVertex3f( Xdist * 0.8f, 0.0, 0.0 );
-
-        glEnd();
+        batch->addTriangle( -Xdist * 0.7f, -Ydist * 0.8f,
+                            -Xdist * 0.7f, Ydist * 0.8f,
+                            Xdist * 0.8f, 0.0f );
     }
-
-    glDisable( GL_BLEND );
-
-    glPopMatrix();
 }
 
 void SessionGroupButton::doubleClickAction()
@@ -25,12 +25,11 @@
 
 #include <VPMedia/thread_helper.h>
 
-#include <wx/utils.h>
-
 #include <stdio.h>
 
 #include "SessionManager.h"
 #include "SessionEntry.h"
+#include "SessionExecutor.h"
 #include "SessionGroup.h"
 #include "SessionGroupButton.h"
 #include "VideoListener.h"
@@ -54,7 +53,7 @@ SessionManager::SessionManager( VideoListener* vl, AudioManager* al,
     videoSessionCount = 0;
     audioSessionCount = 0;
     lockCount = 0;
-    pause = false;
+    executor = NULL;
 
     rotatePos = -1;
     lastRotateSession = NULL;
@@ -120,11 +119,9 @@ SessionManager::SessionManager( VideoListener* vl, AudioManager* al,
     add( videoSessions );
     add( availableVideoSessions );
     add( avButton );
-    objectManager->lockSources();
     objectManager->addToDrawList( videoSessions );
     objectManager->addToDrawList( availableVideoSessions );
     objectManager->addToDrawList( avButton );
-    objectManager->unlockSources();
 
     sessionMap[ VIDEOSESSION ] = videoSessions;
     sessionMap[ AVAILABLEVIDEOSESSION ] = availableVideoSessions;
@@ -135,6 +132,10 @@ SessionManager::SessionManager( VideoListener* vl, AudioManager* al,
 
 SessionManager::~SessionManager()
 {
+    // make sure nothing's still iterating the sessions we're about to delete
+    stopThreads();
+    objectManager->drainSceneEvents();
+
     mutex_free( sessionMutex );
 
     Group* sessions;
@@ -153,23 +154,17 @@ SessionManager::~SessionManager()
             RectangleBase* session = *sessionIt;
             sessionIt = sessions->remove( sessionIt );
 
-            objectManager->lockSources();
             objectManager->removeFromLists( session, false );
-            objectManager->unlockSources();
 
             delete session;
         }
 
-        objectManager->lockSources();
         objectManager->removeFromLists( sessions, false );
-        objectManager->unlockSources();
 
         delete sessions;
     }
 
-    objectManager->lockSources();
     objectManager->removeFromLists( avButton, false );
-    objectManager->unlockSources();
 
     delete avButton;
 }
@@ -233,9 +228,7 @@ bool SessionManager::addSession( std::string address, SessionType type )
      */
 
     sessions->add( entry );
-    objectManager->lockSources();
     objectManager->addToDrawList( entry );
-    objectManager->unlockSources();
     entry->show( shown, !shown );
 
     recalculateSize();
@@ -266,9 +259,12 @@ bool SessionManager::removeSession( std::string addr, SessionType type )
             rotatePos--;
     }
 
-    objectManager->lockSources();
+    if ( executor != NULL )
+        executor->remove( entry );
+    // same as in disableSession()
+    objectManager->drainSceneEvents();
+
     objectManager->removeFromLists( entry, false );
-    objectManager->unlockSources();
     delete entry; //destructor will remove object from its group
 
     recalculateSize();
@@ -606,7 +602,18 @@ bool SessionManager::setEncryptionKey( std::string addr, std::string key )
         return false;
     }
 
-    entry->setEncryptionKey( key );
+    // the key gets set on the VPMSession right away if it's running, so
+    // it can't be getting iterated at the same time
+    if ( executor != NULL && entry->isSessionEnabled() )
+    {
+        executor->remove( entry );
+        entry->setEncryptionKey( key );
+        executor->add( entry );
+    }
+    else
+    {
+        entry->setEncryptionKey( key );
+    }
 
     unlockSessions();
     return true;
@@ -623,7 +630,17 @@ bool SessionManager::disableEncryption( std::string addr )
         return false;
     }
 
-    entry->disableEncryption();
+    // see above
+    if ( executor != NULL && entry->isSessionEnabled() )
+    {
+        executor->remove( entry );
+        entry->disableEncryption();
+        executor->add( entry );
+    }
+    else
+    {
+        entry->disableEncryption();
+    }
 
     unlockSessions();
     return true;
@@ -648,15 +665,10 @@ bool SessionManager::isEncryptionEnabled( std::string addr )
 
 bool SessionManager::iterateSessions()
 {
-    // kind of a hack to force this to wait, when removing etc.
-    // mutex should do this but this thread seems way too eager
-    if ( pause )
-    {
-        gravUtil::logVerbose( "Sessions temporarily paused...\n" );
-        wxMicroSleep( 10 );
-    }
+    // the threads have it from here
+    if ( executor != NULL )
+        return false;
 
-    // note: iterate doesn't do lockSessions() since it shouldn't affect pause
     mutex_lock( sessionMutex );
     lockCount++;
 
@@ -694,6 +706,47 @@ bool SessionManager::iterateSessions()
     return haveSessions;
 }
 
+void SessionManager::startThreads( int numThreads )
+{
+    lockSessions();
+
+    if ( executor == NULL )
+    {
+        executor = new SessionExecutor( numThreads );
+
+        // same order iterateSessions() would go in
+        std::map<SessionType, Group*>::iterator i;
+        for ( i = sessionMap.begin(); i != sessionMap.end(); ++i )
+        {
+            Group* sessions = i->second;
+            for ( int j = 0; j < sessions->numObjects(); j++ )
+            {
+                SessionEntry* session =
+                        static_cast<SessionEntry*>( (*sessions)[j] );
+                if ( session->isSessionEnabled() )
+                    executor->add( session );
+            }
+        }
+    }
+
+    unlockSessions();
+}
+
+void SessionManager::stopThreads()
+{
+    lockSessions();
+
+    delete executor;
+    executor = NULL;
+
+    unlockSessions();
+}
+
+bool SessionManager::areThreadsRunning()
+{
+    return executor != NULL;
+}
+
 int SessionManager::getVideoSessionCount()
 {
     return videoSessionCount;
@@ -706,14 +759,12 @@ int SessionManager::getAudioSessionCount()
 
 void SessionManager::lockSessions()
 {
-    pause = true;
     mutex_lock( sessionMutex );
     lockCount++;
 }
 
 void SessionManager::unlockSessions()
 {
-    pause = false;
     lockCount--;
     mutex_unlock( sessionMutex );
 }
@@ -786,6 +837,17 @@ SessionEntry* SessionManager::findSessionByAddress( std::string address,
 
 SessionEntry* SessionManager::findSessionByVPMSession( VPMSession* s )
 {
+    // the groups can change under us if we're on one of the session threads,
+    // so go by what's being iterated instead
+    if ( executor != NULL )
+    {
+        SessionEntry* entry = executor->find( s );
+        if ( entry == NULL )
+            gravUtil::logWarning( "SessionManager::findSessionByVPMSession: "
+                                    "session 0x%08x not found\n", s );
+        return entry;
+    }
+
     Group* sessions;
     SessionEntry* session;
 
@@ -857,6 +919,9 @@ bool SessionManager::initSession( SessionEntry* session )
         return false;
     }
 
+    if ( executor != NULL )
+        executor->add( session );
+
     gravUtil::logVerbose( "SessionManager::initialized %s session on %s\n",
             type.c_str(), session->getAddress().c_str() );
     return true;
@@ -864,6 +929,11 @@ bool SessionManager::initSession( SessionEntry* session )
 
 void SessionManager::disableSession( SessionEntry* session )
 {
+    if ( executor != NULL )
+        executor->remove( session );
+    // anything the session's thread pushed for its sources has to be applied
+    // while the session's still there to match them against
+    objectManager->drainSceneEvents();
     session->disableSession();
 }
 
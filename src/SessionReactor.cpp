@@ -0,0 +1,196 @@
+/*
+ * @file SessionReactor.cpp
+ *
+ * Implementation of the SessionReactor class. See SessionReactor.h for
+ * details.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SessionReactor.h"
+#include "gravUtil.h"
+
+#include <wx/utils.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+
+// most events to take per wait - if there are more, the rest just show up on
+// the next one
+static const int maxEvents = 64;
+
+SessionReactor::SessionReactor()
+{
+    epollFD = -1;
+#ifdef __linux__
+    epollFD = epoll_create( maxEvents );
+    if ( epollFD == -1 )
+        gravUtil::logWarning( "SessionReactor::SessionReactor: epoll not "
+                "available (%s), sessions will be polled\n",
+                strerror( errno ) );
+#endif
+}
+
+SessionReactor::~SessionReactor()
+{
+    if ( epollFD != -1 )
+        close( epollFD );
+}
+
+void SessionReactor::add( const std::vector<int>& fds )
+{
+#ifdef __linux__
+    if ( epollFD == -1 )
+        return;
+
+    for ( unsigned int i = 0; i < fds.size(); i++ )
+    {
+        // level triggered, so if iterate() leaves something in the socket
+        // the next wait comes right back for it
+        struct epoll_event event;
+        memset( &event, 0, sizeof( event ) );
+        event.events = EPOLLIN;
+        event.data.fd = fds[i];
+        if ( epoll_ctl( epollFD, EPOLL_CTL_ADD, fds[i], &event ) == -1 &&
+                errno != EEXIST )
+            gravUtil::logWarning( "SessionReactor::add: couldn't watch socket "
+                    "%i (%s)\n", fds[i], strerror( errno ) );
+    }
+#endif
+}
+
+void SessionReactor::remove( const std::vector<int>& fds )
+{
+#ifdef __linux__
+    if ( epollFD == -1 )
+        return;
+
+    // older kernels want an event even though it's ignored
+    struct epoll_event event;
+    memset( &event, 0, sizeof( event ) );
+    for ( unsigned int i = 0; i < fds.size(); i++ )
+        epoll_ctl( epollFD, EPOLL_CTL_DEL, fds[i], &event );
+#endif
+}
+
+bool SessionReactor::wait( int timeoutMS, std::set<int>& ready )
+{
+    if ( timeoutMS < 0 )
+        timeoutMS = 0;
+
+#ifdef __linux__
+    if ( epollFD != -1 )
+    {
+        struct epoll_event events[ maxEvents ];
+        int num = epoll_wait( epollFD, events, maxEvents, timeoutMS );
+        for ( int i = 0; i < num; i++ )
+            ready.insert( events[i].data.fd );
+        return num > 0;
+    }
+#endif
+
+    // nothing to wait on, so just sleep a little - not long enough to hold up
+    // packets much, but enough not to spin. still a lot more wakeups than
+    // waiting would be, so say so (once)
+    static bool warned = false;
+    if ( !warned )
+    {
+        gravUtil::logWarning( "SessionReactor::wait: can't wait on sockets "
+                "here, session threads will poll every 0.5 ms\n" );
+        warned = true;
+    }
+    if ( timeoutMS > 0 )
+        wxMicroSleep( 500 );
+    return false;
+}
+
+bool SessionReactor::isAvailable()
+{
+    return epollFD != -1;
+}
+
+std::set<int> SessionReactor::findDatagramSockets()
+{
+    std::set<int> fds;
+
+    DIR* dir = opendir( "/proc/self/fd" );
+    if ( dir == NULL )
+        return fds;
+
+    struct dirent* entry;
+    while ( ( entry = readdir( dir ) ) != NULL )
+    {
+        if ( entry->d_name[0] < '0' || entry->d_name[0] > '9' )
+            continue;
+        int fd = atoi( entry->d_name );
+        if ( fd == dirfd( dir ) )
+            continue;
+
+        int type;
+        socklen_t len = sizeof( type );
+        if ( getsockopt( fd, SOL_SOCKET, SO_TYPE, &type, &len ) == 0 &&
+                type == SOCK_DGRAM )
+            fds.insert( fd );
+    }
+
+    closedir( dir );
+    return fds;
+}
+
+std::vector<int> SessionReactor::findSessionSockets(
+        const std::set<int>& before, const std::set<int>& after, int port )
+{
+    std::vector<int> fds;
+    if ( port <= 0 )
+        return fds;
+
+    for ( std::set<int>::const_iterator it = after.begin();
+            it != after.end(); ++it )
+    {
+        if ( before.count( *it ) > 0 )
+            continue;
+        int local = getLocalPort( *it );
+        if ( local == port || local == port + 1 )
+            fds.push_back( *it );
+    }
+    return fds;
+}
+
+int SessionReactor::getLocalPort( int fd )
+{
+    struct sockaddr_storage addr;
+    socklen_t len = sizeof( addr );
+    if ( getsockname( fd, (struct sockaddr*)&addr, &len ) != 0 )
+        return -1;
+
+    if ( addr.ss_family == AF_INET )
+        return ntohs( ((struct sockaddr_in*)&addr)->sin_port );
+    if ( addr.ss_family == AF_INET6 )
+        return ntohs( ((struct sockaddr_in6*)&addr)->sin6_port );
+    return -1;
+}
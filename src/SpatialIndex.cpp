@@ -0,0 +1,264 @@
+/*
+ * @file SpatialIndex.cpp
+ *
+ * Implementation of the SpatialIndex class. See SpatialIndex.h for details.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SpatialIndex.h"
+#include "RectangleBase.h"
+#include "Animator.h"
+
+#include <algorithm>
+#include <cmath>
+
+// in world units - the screen is around 30 across, and videos are usually a
+// few units wide
+static const float cellSize = 2.0f;
+
+// anything covering more cells than this just gets checked every time
+static const int maxCellsPerObject = 64;
+
+SpatialIndex::SpatialIndex()
+{
+    nextOrder = 0;
+    indexMutex = mutex_create();
+}
+
+SpatialIndex::~SpatialIndex()
+{
+    std::map<RectangleBase*, Entry>::iterator i;
+    for ( i = entries.begin(); i != entries.end(); ++i )
+        i->first->setSpatialIndex( NULL );
+    mutex_free( indexMutex );
+}
+
+void SpatialIndex::add( RectangleBase* obj )
+{
+    mutex_lock( indexMutex );
+
+    std::map<RectangleBase*, Entry>::iterator i = entries.find( obj );
+    if ( i != entries.end() )
+    {
+        i->second.order = nextOrder++;
+    }
+    else
+    {
+        Entry e;
+        e.order = nextOrder++;
+        e.inGrid = false;
+        e.oversized = false;
+        e.minX = e.maxX = e.minY = e.maxY = 0;
+        entries[ obj ] = e;
+        moving.insert( obj );
+        obj->setSpatialIndex( this );
+    }
+
+    mutex_unlock( indexMutex );
+}
+
+void SpatialIndex::remove( RectangleBase* obj )
+{
+    mutex_lock( indexMutex );
+
+    std::map<RectangleBase*, Entry>::iterator i = entries.find( obj );
+    if ( i != entries.end() )
+    {
+        removeCells( obj, i->second );
+        moving.erase( obj );
+        entries.erase( i );
+        obj->setSpatialIndex( NULL );
+    }
+
+    mutex_unlock( indexMutex );
+}
+
+void SpatialIndex::raise( RectangleBase* obj )
+{
+    mutex_lock( indexMutex );
+
+    std::map<RectangleBase*, Entry>::iterator i = entries.find( obj );
+    if ( i != entries.end() )
+        i->second.order = nextOrder++;
+
+    mutex_unlock( indexMutex );
+}
+
+void SpatialIndex::markMoved( RectangleBase* obj )
+{
+    mutex_lock( indexMutex );
+
+    std::map<RectangleBase*, Entry>::iterator i = entries.find( obj );
+    if ( i != entries.end() && moving.find( obj ) == moving.end() )
+    {
+        removeCells( obj, i->second );
+        moving.insert( obj );
+    }
+
+    mutex_unlock( indexMutex );
+}
+
+void SpatialIndex::query( float L, float R, float U, float D,
+                            std::vector<RectangleBase*>& results )
+{
+    mutex_lock( indexMutex );
+
+    settle();
+
+    results.clear();
+    results.insert( results.end(), moving.begin(), moving.end() );
+    results.insert( results.end(), oversized.begin(), oversized.end() );
+
+    int minX = toCell( L ), maxX = toCell( R );
+    int minY = toCell( D ), maxY = toCell( U );
+    std::map<Cell, std::vector<RectangleBase*> >::iterator c;
+
+    // for a big box selection it's cheaper to go through the cells that
+    // actually have something in them
+    if ( (long)( maxX - minX + 1 ) * (long)( maxY - minY + 1 ) >
+            (long)cells.size() )
+    {
+        for ( c = cells.begin(); c != cells.end(); ++c )
+        {
+            const Cell& cell = c->first;
+            if ( cell.first >= minX && cell.first <= maxX &&
+                    cell.second >= minY && cell.second <= maxY )
+                results.insert( results.end(), c->second.begin(),
+                                c->second.end() );
+        }
+    }
+    else
+    {
+        for ( int cx = minX; cx <= maxX; cx++ )
+        {
+            for ( int cy = minY; cy <= maxY; cy++ )
+            {
+                c = cells.find( Cell( cx, cy ) );
+                if ( c != cells.end() )
+                    results.insert( results.end(), c->second.begin(),
+                                    c->second.end() );
+            }
+        }
+    }
+
+    // objects in more than one cell will show up more than once
+    OrderCompare compare;
+    compare.entries = &entries;
+    std::sort( results.begin(), results.end(), compare );
+    results.erase( std::unique( results.begin(), results.end() ),
+                    results.end() );
+
+    mutex_unlock( indexMutex );
+}
+
+int SpatialIndex::getMovingCount()
+{
+    mutex_lock( indexMutex );
+    int count = moving.size();
+    mutex_unlock( indexMutex );
+    return count;
+}
+
+void SpatialIndex::settle()
+{
+    Animator* anim = Animator::getInstance();
+    std::set<RectangleBase*>::iterator i = moving.begin();
+    while ( i != moving.end() )
+    {
+        // once its animations are done it's as close to its destination as
+        // it's going to get, whether or not the floats come out equal
+        RectangleBase* obj = *i;
+        if ( !anim->isAnimating( obj ) )
+        {
+            insertCells( obj, entries[ obj ] );
+            moving.erase( i++ );
+        }
+        else
+        {
+            ++i;
+        }
+    }
+}
+
+void SpatialIndex::insertCells( RectangleBase* obj, Entry& e )
+{
+    Bounds b = obj->getBounds();
+    e.minX = toCell( b.L ); e.maxX = toCell( b.R );
+    e.minY = toCell( b.D ); e.maxY = toCell( b.U );
+    e.inGrid = true;
+
+    if ( (long)( e.maxX - e.minX + 1 ) * (long)( e.maxY - e.minY + 1 ) >
+            maxCellsPerObject )
+    {
+        e.oversized = true;
+        oversized.insert( obj );
+        return;
+    }
+
+    e.oversized = false;
+    for ( int cx = e.minX; cx <= e.maxX; cx++ )
+    {
+        for ( int cy = e.minY; cy <= e.maxY; cy++ )
+            cells[ Cell( cx, cy ) ].push_back( obj );
+    }
+}
+
+void SpatialIndex::removeCells( RectangleBase* obj, Entry& e )
+{
+    if ( !e.inGrid )
+        return;
+    e.inGrid = false;
+
+    if ( e.oversized )
+    {
+        oversized.erase( obj );
+        return;
+    }
+
+    for ( int cx = e.minX; cx <= e.maxX; cx++ )
+    {
+        for ( int cy = e.minY; cy <= e.maxY; cy++ )
+        {
+            std::map<Cell, std::vector<RectangleBase*> >::iterator c =
+                cells.find( Cell( cx, cy ) );
+            if ( c == cells.end() )
+                continue;
+
+            std::vector<RectangleBase*>& list = c->second;
+            list.erase( std::remove( list.begin(), list.end(), obj ),
+                        list.end() );
+            if ( list.empty() )
+                cells.erase( c );
+        }
+    }
+}
+
+int SpatialIndex::toCell( float v )
+{
+    return (int)floor( v / cellSize );
+}
+
+bool SpatialIndex::OrderCompare::operator()( RectangleBase* a,
+                                                RectangleBase* b ) const
+{
+    // topmost first
+    return entries->find( a )->second.order >
+            entries->find( b )->second.order;
+}
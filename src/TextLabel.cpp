@@ -0,0 +1,71 @@
+/*
+ * @file TextLabel.cpp
+ *
+ * Implementation of the TextLabel class. See TextLabel.h for details.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "TextLabel.h"
+
+TextLabel::TextLabel()
+{
+    dirty = true;
+    lowerX = lowerY = upperX = upperY = 0.0f;
+}
+
+void TextLabel::setText( const std::string& t )
+{
+    if ( t.compare( text ) != 0 )
+    {
+        text = t;
+        dirty = true;
+    }
+}
+
+const std::string& TextLabel::getText()
+{
+    return text;
+}
+
+void TextLabel::markDirty()
+{
+    dirty = true;
+}
+
+void TextLabel::update( GlyphAtlas* atlas )
+{
+    if ( !dirty || atlas == NULL )
+        return;
+
+    quads.clear();
+    atlas->layout( text, quads, lowerX, lowerY, upperX, upperY );
+    dirty = false;
+}
+
+const std::vector<GlyphQuad>& TextLabel::getQuads()
+{
+    return quads;
+}
+
+void TextLabel::getBounds( float& lx, float& ly, float& ux, float& uy )
+{
+    lx = lowerX; ly = lowerY;
+    ux = upperX; uy = upperY;
+}
@@ -0,0 +1,140 @@
+/*
+ * @file UploadScheduler.cpp
+ *
+ * Implementation of the UploadScheduler class. See UploadScheduler.h for
+ * details.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "UploadScheduler.h"
+#include "VideoSource.h"
+
+#include <algorithm>
+
+UploadScheduler::UploadScheduler()
+{
+    budget = 0;
+    frameNumber = 0;
+    lastUploadCount = 0;
+    lastDeferredCount = 0;
+    lastUploadBytes = 0;
+}
+
+void UploadScheduler::setBudget( unsigned int bytes )
+{
+    budget = bytes;
+}
+
+unsigned int UploadScheduler::getBudget()
+{
+    return budget;
+}
+
+void UploadScheduler::addPending( VideoSource* source, bool priority )
+{
+    PendingUpload p;
+    p.source = source;
+    p.priority = priority;
+    p.size = source->getUploadSize();
+
+    // new sources haven't had a turn yet, so they go first
+    std::map<VideoSource*, unsigned long>::iterator i =
+        lastUploads.find( source );
+    p.lastUpload = ( i != lastUploads.end() ) ? i->second : 0;
+
+    pending.push_back( p );
+}
+
+void UploadScheduler::uploadPending()
+{
+    frameNumber++;
+    lastUploadCount = 0;
+    lastDeferredCount = 0;
+    lastUploadBytes = 0;
+
+    // stable, so ties stay in source order
+    std::stable_sort( pending.begin(), pending.end(), comparePending );
+
+    for ( unsigned int i = 0; i < pending.size(); i++ )
+    {
+        PendingUpload& p = pending[i];
+
+        // keep going past ones that don't fit, since a smaller one further
+        // down might
+        if ( budget > 0 && lastUploadCount > 0 &&
+                lastUploadBytes + p.size > budget )
+        {
+            lastDeferredCount++;
+            continue;
+        }
+
+        // the upload can also be skipped if the GL is still busy with the
+        // source's last one, in which case it didn't use any of the budget
+        if ( p.source->upload() )
+        {
+            lastUploadBytes += p.size;
+            lastUploadCount++;
+            lastUploads[ p.source ] = frameNumber;
+        }
+        else
+        {
+            lastDeferredCount++;
+        }
+    }
+
+    pending.clear();
+}
+
+void UploadScheduler::removeSource( VideoSource* source )
+{
+    lastUploads.erase( source );
+
+    for ( unsigned int i = 0; i < pending.size(); i++ )
+    {
+        if ( pending[i].source == source )
+        {
+            pending.erase( pending.begin() + i );
+            i--;
+        }
+    }
+}
+
+int UploadScheduler::getLastUploadCount()
+{
+    return lastUploadCount;
+}
+
+int UploadScheduler::getLastDeferredCount()
+{
+    return lastDeferredCount;
+}
+
+unsigned int UploadScheduler::getLastUploadBytes()
+{
+    return lastUploadBytes;
+}
+
+bool UploadScheduler::comparePending( const PendingUpload& a,
+                                        const PendingUpload& b )
+{
+    if ( a.priority != b.priority )
+        return a.priority;
+    return a.lastUpload < b.lastUpload;
+}
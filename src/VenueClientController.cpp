@@ -28,6 +28,8 @@
 #include "SessionTreeControl.h"
 #include "VenueNode.h"
 #include "gravUtil.h"
+#include "GLUtil.h"
+#include "BatchRenderer.h"
 
 VenueClientController::VenueClientController( float _x, float _y,
                                                 ObjectManager* o )
@@ -69,28 +71,23 @@ VenueClientController::~VenueClientController()
 
 void VenueClientController::draw()
 {
-    animateValues();
-
     if ( borderColor.A < 0.01f )
         return;
 
-    glColor4f( borderColor.R, borderColor.G, borderColor.B, borderColor.A );
+    BatchRenderer* batch = GLUtil::getInstance()->getBatchRenderer();
+    batch->reset();
+
+    batch->setColor( borderColor.R, borderColor.G, borderColor.B,
+                        borderColor.A );
 
     // draw lines from center to each of the venues
-    glEnable( GL_BLEND );
-    glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
-    glLineWidth( 2.0f );
-    glEnable( GL_LINE_SMOOTH );
-    glBegin( GL_LINES );
+    batch->setBlend( true );
+    batch->setLineWidth( 2.0f, true );
     for ( unsigned int i = 0; i < objects.size(); i++ )
     {
-        glVertex3f( objects[i]->getX(), objects[i]->getY(), 0.0f );
-        glVertex3f( getX(), getY(), 0.0f );
+        batch->addLine( objects[i]->getX(), objects[i]->getY(),
+                        getX(), getY() );
     }
-    glEnd();
-    glDisable( GL_LINE_SMOOTH );
-    glDisable( GL_BLEND );
-    glLineWidth( 1.0f );
 
     for ( unsigned int i = 0; i < objects.size(); i++ )
     {
@@ -101,9 +98,7 @@ void VenueClientController::draw()
 void VenueClientController::remove( RectangleBase* object, bool move )
 {
     Group::remove( object, move );
-    objectMan->lockSources();
     objectMan->removeFromLists( object, false );
-    objectMan->unlockSources();
     delete object;
 }
 
@@ -112,9 +107,7 @@ std::vector<RectangleBase*>::iterator VenueClientController::remove(
 {
     RectangleBase* object = (*i);
     std::vector<RectangleBase*>::iterator ret = Group::remove( i, move );
-    objectMan->lockSources();
     objectMan->removeFromLists( object, false );
-    objectMan->unlockSources();
     delete object;
     return ret;
 }
@@ -174,9 +167,7 @@ void VenueClientController::updateExitMap()
         node->setName( i->first );
         Texture t = GLUtil::getInstance()->getTexture( "circle" );
         node->setTexture( t.ID, t.width, t.height );
-        objectMan->lockSources();
         objectMan->addToDrawList( node );
-        objectMan->unlockSources();
         add( node );
     }
 }
@@ -349,9 +340,7 @@ void VenueClientController::show( bool s, bool instant )
     else
     {
         rearrange();
-        objectMan->lockSources();
         objectMan->moveToTop( this );
-        objectMan->unlockSources();
     }
 }
 
@@ -0,0 +1,182 @@
+/*
+ * @file VideoFrameSink.cpp
+ *
+ * Implementation of the VideoFrameSink class. See VideoFrameSink.h for
+ * details.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "VideoFrameSink.h"
+#include "FrameMailbox.h"
+#include "ImageScaler.h"
+#include "ColorConverter.h"
+
+VideoFrameSink::VideoFrameSink( VPMVideoFormat format, WorkerPool* pool,
+                                FramePipeline* p, int depth ) :
+    VPMVideoBufferSink( format )
+{
+    mailbox = new FrameMailbox();
+    pipeline = p;
+    queue = NULL;
+    queueDepth = depth;
+    convertPool = pool;
+    convertToRGB = ( convertPool != NULL && format == VIDEO_FORMAT_YUV420 );
+
+    decodedLayout = VideoLayout::get( VideoLayout::fromVPMFormat( format ) );
+    if ( convertToRGB )
+        layout = VideoLayout::get( VideoLayout::RGB24 );
+    else
+        layout = decodedLayout;
+}
+
+VideoFrameSink::~VideoFrameSink()
+{
+    // has to be first, since a pipeline thread might be in handleFrame() now
+    if ( queue != NULL )
+        pipeline->destroyQueue( queue );
+
+    // VideoSource has its own reference, so this won't necessarily delete it
+    mailbox->release();
+}
+
+bool VideoFrameSink::initialise()
+{
+    if ( !VPMVideoBufferSink::initialise() )
+        return false;
+
+    if ( pipeline != NULL && queue == NULL )
+        queue = pipeline->createQueue( &VideoFrameSink::handleFrame,
+                                        (void*)this, queueDepth );
+
+    addNewFrameCallback( &VideoFrameSink::newFrameCallback, (void*)this );
+    return true;
+}
+
+FrameMailbox* VideoFrameSink::getMailbox()
+{
+    return mailbox;
+}
+
+const VideoLayout* VideoFrameSink::getLayout()
+{
+    return layout;
+}
+
+void VideoFrameSink::newFrameCallback( VPMVideoSink* sink, int bufferIndex,
+                                        void* data )
+{
+    VideoFrameSink* frameSink = (VideoFrameSink*)data;
+
+    unsigned int width = frameSink->getImageWidth();
+    unsigned int height = frameSink->getImageHeight();
+    const VideoLayout* decodedLayout = frameSink->decodedLayout;
+    if ( width == 0 || height == 0 ||
+            decodedLayout->getType() == VideoLayout::NONE )
+        return;
+
+    const unsigned char* src = (const unsigned char*)frameSink->getImageData();
+
+    if ( frameSink->queue != NULL )
+    {
+        frameSink->queue->push( src,
+                                decodedLayout->getFrameSize( width, height ),
+                                width, height );
+        frameSink->updateQueueState();
+    }
+    else
+    {
+        handleFrame( data, src, width, height );
+    }
+}
+
+void VideoFrameSink::handleFrame( void* data, const unsigned char* src,
+                                    unsigned int width, unsigned int height )
+{
+    VideoFrameSink* frameSink = (VideoFrameSink*)data;
+
+    const VideoLayout* decodedLayout = frameSink->decodedLayout;
+    const VideoLayout* layout = frameSink->layout;
+
+    int level = frameSink->mailbox->getScaleLevel();
+    while ( level > 0 && ( ( width >> level ) < minScaledSize * 2 ||
+                           ( height >> level ) < minScaledSize * 2 ) )
+        level--;
+
+    unsigned int scaledWidth = width >> level;
+    unsigned int scaledHeight = height >> level;
+
+    if ( frameSink->convertToRGB )
+    {
+        // downscale first, since it's cheaper to do on YUV
+        if ( level > 0 )
+        {
+            frameSink->scaledFrame.resize( decodedLayout->getFrameSize(
+                                                scaledWidth, scaledHeight ) );
+            frameSink->downscaleFrame( src, width, height, level,
+                                        &frameSink->scaledFrame[0] );
+            src = &frameSink->scaledFrame[0];
+        }
+
+        unsigned int size = layout->getFrameSize( scaledWidth, scaledHeight );
+        unsigned char* dest = frameSink->mailbox->beginWrite( size,
+                scaledWidth, scaledHeight, width, height, layout->getType() );
+        ColorConverter::YUV420toRGB( src, scaledWidth, scaledHeight, dest, 3,
+                                        frameSink->convertPool );
+    }
+    else
+    {
+        unsigned int size = layout->getFrameSize( scaledWidth, scaledHeight );
+        unsigned char* dest = frameSink->mailbox->beginWrite( size,
+                scaledWidth, scaledHeight, width, height, layout->getType() );
+        frameSink->downscaleFrame( src, width, height, level, dest );
+    }
+
+    frameSink->mailbox->publish();
+
+    if ( frameSink->queue != NULL )
+        frameSink->updateQueueState();
+}
+
+void VideoFrameSink::updateQueueState()
+{
+    mailbox->setQueueState( queue->getQueuedCount(),
+                            queue->getDroppedCount() );
+}
+
+void VideoFrameSink::downscaleFrame( const unsigned char* src,
+                                        unsigned int width,
+                                        unsigned int height, int level,
+                                        unsigned char* dest )
+{
+    unsigned int scaledWidth = width >> level;
+    unsigned int scaledHeight = height >> level;
+
+    for ( int i = 0; i < decodedLayout->getNumPlanes(); i++ )
+    {
+        ImageScaler::downscale(
+                src + decodedLayout->getPlaneOffset( i, width, height ),
+                decodedLayout->getPlaneWidth( i, width ),
+                decodedLayout->getPlaneHeight( i, height ),
+                decodedLayout->getBytesPerPixel( i ), level,
+                dest + decodedLayout->getPlaneOffset( i, scaledWidth,
+                                                        scaledHeight ),
+                scratch );
+    }
+}
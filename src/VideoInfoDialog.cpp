@@ -54,6 +54,8 @@ VideoInfoDialog::VideoInfoDialog( wxWindow* parent, RectangleBase* o )
                 "\n";
         labelTextStd += "Codec:\n";
         infoTextStd += std::string( video->getPayloadDesc() ) + "\n";
+        labelTextStd += "Upload format:\n";
+        infoTextStd += std::string( video->getLayoutName() ) + "\n";
         labelTextStd += "Alternate Address:\n";
         infoTextStd += video->getAltAddress() + "\n";
         char width[10];
@@ -63,6 +65,15 @@ VideoInfoDialog::VideoInfoDialog( wxWindow* parent, RectangleBase* o )
         labelTextStd += "Resolution:\n";
         infoTextStd += std::string( width ) + " x " + std::string( height ) +
                 "\n";
+        char dropped[12];
+        sprintf( dropped, "%u", video->getDroppedFrames() );
+        labelTextStd += "Dropped frames:\n";
+        infoTextStd += std::string( dropped ) + "\n";
+        char queued[32];
+        sprintf( queued, "%i (%u dropped)", video->getQueuedFrames(),
+                    video->getQueueDroppedFrames() );
+        labelTextStd += "Frame queue:\n";
+        infoTextStd += std::string( queued ) + "\n";
     }
     labelTextStd += "Grouped?";
     infoTextStd += std::string( obj->isGrouped() ? "Yes" : "No" );
@@ -0,0 +1,177 @@
+/*
+ * @file VideoLayout.cpp
+ *
+ * Implementation of the VideoLayout class. See VideoLayout.h for details.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "VideoLayout.h"
+
+typedef struct
+{
+    int widthShift;
+    int heightShift;
+    unsigned int bytesPerPixel;
+    GLenum textureFormat;
+    GLenum uploadFormat;
+} PlaneDesc;
+
+typedef struct
+{
+    const char* name;
+    int numPlanes;
+    PlaneDesc planes[ VideoLayout::maxPlanes ];
+    GLUtil::ShaderProgram program;
+} LayoutDesc;
+
+#define LUMA_PLANE { 0, 0, 1, GL_LUMINANCE, GL_LUMINANCE }
+#define NO_PLANE { 0, 0, 0, 0, 0 }
+
+// indexed by VideoLayout::Type, so keep this in the same order
+static const LayoutDesc descs[ VideoLayout::NUM_TYPES ] =
+{
+    { "none", 0, { NO_PLANE, NO_PLANE, NO_PLANE }, GLUtil::PROGRAM_NONE },
+
+    // packed formats go straight into a single texture, the GL does the
+    // swizzling for BGR
+    { "RGB24", 1, { { 0, 0, 3, GL_RGB, GL_RGB }, NO_PLANE, NO_PLANE },
+        GLUtil::PROGRAM_NONE },
+    { "BGR24", 1, { { 0, 0, 3, GL_RGB, GL_BGR }, NO_PLANE, NO_PLANE },
+        GLUtil::PROGRAM_NONE },
+    { "RGBA32", 1, { { 0, 0, 4, GL_RGBA, GL_RGBA }, NO_PLANE, NO_PLANE },
+        GLUtil::PROGRAM_NONE },
+    { "BGRA32", 1, { { 0, 0, 4, GL_RGBA, GL_BGRA }, NO_PLANE, NO_PLANE },
+        GLUtil::PROGRAM_NONE },
+
+    // planar YUV all uses the same shader, since texture coordinates are
+    // normalized and the chroma planes just end up being sampled differently
+    { "YUV420P", 3, { LUMA_PLANE,
+                      { 1, 1, 1, GL_LUMINANCE, GL_LUMINANCE },
+                      { 1, 1, 1, GL_LUMINANCE, GL_LUMINANCE } },
+        GLUtil::PROGRAM_YUV_PLANAR },
+    { "YUV422P", 3, { LUMA_PLANE,
+                      { 1, 0, 1, GL_LUMINANCE, GL_LUMINANCE },
+                      { 1, 0, 1, GL_LUMINANCE, GL_LUMINANCE } },
+        GLUtil::PROGRAM_YUV_PLANAR },
+    { "YUV444P", 3, { LUMA_PLANE, LUMA_PLANE, LUMA_PLANE },
+        GLUtil::PROGRAM_YUV_PLANAR }
+};
+
+const VideoLayout VideoLayout::layouts[ NUM_TYPES ] =
+{
+    VideoLayout( NONE ),
+    VideoLayout( RGB24 ),
+    VideoLayout( BGR24 ),
+    VideoLayout( RGBA32 ),
+    VideoLayout( BGRA32 ),
+    VideoLayout( YUV420P ),
+    VideoLayout( YUV422P ),
+    VideoLayout( YUV444P )
+};
+
+VideoLayout::VideoLayout( Type t ) :
+    type( t )
+{ }
+
+const VideoLayout* VideoLayout::get( Type t )
+{
+    if ( t < NONE || t >= NUM_TYPES )
+        t = NONE;
+    return &layouts[ t ];
+}
+
+VideoLayout::Type VideoLayout::fromVPMFormat( VPMVideoFormat format )
+{
+    // these are all the formats VPMedia's decoders can currently output - add
+    // new ones here as they come along and they'll get uploaded natively
+    switch ( format )
+    {
+    case VIDEO_FORMAT_YUV420:
+        return YUV420P;
+    case VIDEO_FORMAT_RGB24:
+        return RGB24;
+    default:
+        return NONE;
+    }
+}
+
+VideoLayout::Type VideoLayout::getType() const
+{
+    return type;
+}
+
+const char* VideoLayout::getName() const
+{
+    return descs[ type ].name;
+}
+
+int VideoLayout::getNumPlanes() const
+{
+    return descs[ type ].numPlanes;
+}
+
+unsigned int VideoLayout::getPlaneWidth( int plane, unsigned int width ) const
+{
+    return width >> descs[ type ].planes[ plane ].widthShift;
+}
+
+unsigned int VideoLayout::getPlaneHeight( int plane,
+                                            unsigned int height ) const
+{
+    return height >> descs[ type ].planes[ plane ].heightShift;
+}
+
+unsigned int VideoLayout::getBytesPerPixel( int plane ) const
+{
+    return descs[ type ].planes[ plane ].bytesPerPixel;
+}
+
+unsigned int VideoLayout::getPlaneOffset( int plane, unsigned int width,
+                                            unsigned int height ) const
+{
+    unsigned int offset = 0;
+    for ( int i = 0; i < plane; i++ )
+    {
+        offset += getPlaneWidth( i, width ) * getPlaneHeight( i, height ) *
+                    getBytesPerPixel( i );
+    }
+    return offset;
+}
+
+unsigned int VideoLayout::getFrameSize( unsigned int width,
+                                        unsigned int height ) const
+{
+    return getPlaneOffset( getNumPlanes(), width, height );
+}
+
+GLenum VideoLayout::getTextureFormat( int plane ) const
+{
+    return descs[ type ].planes[ plane ].textureFormat;
+}
+
+GLenum VideoLayout::getUploadFormat( int plane ) const
+{
+    return descs[ type ].planes[ plane ].uploadFormat;
+}
+
+GLUtil::ShaderProgram VideoLayout::getProgram() const
+{
+    return descs[ type ].program;
+}
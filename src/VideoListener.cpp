@@ -24,6 +24,8 @@
 
 #include "VideoListener.h"
 #include "VideoSource.h"
+#include "VideoFrameSink.h"
+#include "VideoLayout.h"
 #include "ObjectManager.h"
 #include "SessionManager.h"
 #include "SessionEntry.h"
@@ -31,6 +33,8 @@
 #include "Group.h"
 #include "TreeControl.h"
 #include "GLUtil.h"
+#include "WorkerPool.h"
+#include "FramePipeline.h"
 #include "gravUtil.h"
 
 #include <VPMedia/video/VPMVideoDecoder.h>
@@ -48,6 +52,20 @@ VideoListener::VideoListener( ObjectManager* o ) :
 
     sourceCount = 0;
     pixelCount = 0;
+
+    convertPool = NULL;
+    framePipeline = NULL;
+    listenerMutex = mutex_create();
+}
+
+VideoListener::~VideoListener()
+{
+    // sinks use these, so this should only happen after the sessions (and
+    // so the decoders & sinks) are gone. the pipeline's threads use the
+    // convert pool, so it goes first
+    delete framePipeline;
+    delete convertPool;
+    mutex_free( listenerMutex );
 }
 
 void VideoListener::vpmsession_source_created( VPMSession &session,
@@ -58,21 +76,33 @@ void VideoListener::vpmsession_source_created( VPMSession &session,
 
     if ( d )
     {
+        mutex_lock( listenerMutex );
         sourceCount++;
         VPMVideoFormat format = d->getOutputFormat();
-        VPMVideoBufferSink *sink;
-
-        // if we have shaders available, set the output format to YUV420P so
-        // the videosource class will apply the YUV420P -> RGB conversion shader
+        VideoFrameSink *sink;
+
+        // keep the decoder's own format if we can draw its layout as-is (with
+        // a shader, for YUV ones), so videosource can upload it without any
+        // CPU conversion. if the shader isn't available we can still take
+        // YUV420P and do the conversion ourselves, since ours is faster than
+        // VPMedia's - anything else gets converted to RGB by VPMedia
+        const VideoLayout* layout =
+            VideoLayout::get( VideoLayout::fromVPMFormat( format ) );
+        bool native = layout->getType() != VideoLayout::NONE &&
+            GLUtil::getInstance()->isProgramAvailable( layout->getProgram() );
         gravUtil::logVerbose( "VideoListener::vpmsession_source_created: "
-                "creating source, have shaders? %i format? %i (yuv420p: %i)\n",
-                GLUtil::getInstance()->areShadersAvailable(), format,
-                VIDEO_FORMAT_YUV420 );
-        if ( GLUtil::getInstance()->areShadersAvailable() &&
-                format == VIDEO_FORMAT_YUV420 )
-            sink = new VPMVideoBufferSink( format );
+                "creating source, have shaders? %i format? %i (layout: %s, "
+                "native? %i)\n", GLUtil::getInstance()->areShadersAvailable(),
+                format, layout->getName(), native );
+        if ( native )
+            sink = new VideoFrameSink( format, NULL, getFramePipeline(),
+                                        frameQueueDepth );
+        else if ( layout->getType() == VideoLayout::YUV420P )
+            sink = new VideoFrameSink( format, getConvertPool(),
+                                        getFramePipeline(), frameQueueDepth );
         else
-            sink = new VPMVideoBufferSink( VIDEO_FORMAT_RGB24 );
+            sink = new VideoFrameSink( VIDEO_FORMAT_RGB24, NULL,
+                                        getFramePipeline(), frameQueueDepth );
 
         // note that the buffer sink will be deleted when the decoder for the
         // source is (inside VPMedia), so that's why it isn't deleted here or in
@@ -82,6 +112,7 @@ void VideoListener::vpmsession_source_created( VPMSession &session,
         {
             gravUtil::logError( "VideoListener::vpmsession_source_created: "
                     "Failed to initialise video sink\n" );
+            mutex_unlock( listenerMutex );
             return;
         }
 
@@ -90,9 +121,8 @@ void VideoListener::vpmsession_source_created( VPMSession &session,
         // this is a bit clunky - VideoSource needs to have a reference to the
         // general SessionEntry but we only know the VPMSession pointer (not
         // even the address since that's only in VPMSession_net)
-        // this should be thread-safe since this function will be called on the
-        // second thread
-        // TODO will change if sessions are on their own threads?
+        // this is thread-safe even with the sessions spread over several
+        // threads, since it goes by the sessions that are being iterated
         SessionEntry* se = sessionMan->findSessionByVPMSession( &session );
 
         // if we're getting a new video from a VPMSession but it's not found in
@@ -102,6 +132,7 @@ void VideoListener::vpmsession_source_created( VPMSession &session,
             gravUtil::logError( "VideoListener::vpmsession_source_created: "
                     "session not found in SessionManager. Something is "
                     "horribly wrong :(\n" );
+            mutex_unlock( listenerMutex );
             return;
         }
 
@@ -129,32 +160,44 @@ void VideoListener::vpmsession_source_created( VPMSession &session,
             x = initialX + ( 0.5f * ( sourceCount / 9 ) );
             y = initialY - ( 0.5f * ( sourceCount / 9 ) );
         }
+
+        mutex_unlock( listenerMutex );
     }
 }
 
+WorkerPool* VideoListener::getConvertPool()
+{
+    // only called from source creation, which is already locked
+    if ( convertPool == NULL )
+        convertPool = new WorkerPool(
+                            WorkerPool::getDefaultSize( maxConvertThreads ) );
+    return convertPool;
+}
+
+FramePipeline* VideoListener::getFramePipeline()
+{
+    // same as above
+    if ( framePipeline == NULL )
+        framePipeline = new FramePipeline(
+                            WorkerPool::getDefaultSize( maxFrameThreads ) );
+    return framePipeline;
+}
+
 void VideoListener::vpmsession_source_deleted( VPMSession &session,
         uint32_t ssrc, const char *reason)
 {
     gravUtil::logVerbose( "VideoListener::deleting ssrc 0x%08x\n", ssrc );
-    std::vector<VideoSource*>::iterator si;
-    for ( si = objectMan->getSources()->begin();
-            si != objectMan->getSources()->end(); ++si )
-    {
-        if ( &session == (*si)->getSession()->getVPMSession() &&
-             (*si)->getssrc() == ssrc )
-        {
-            gravUtil::logVerbose( "VideoListener::found ssrc as source"
-                    " 0x%08x\n", (*si) );
-            sourceCount--;
-            updatePixelCount( -( (*si)->getVideoWidth() *
-                                 (*si)->getVideoHeight() ) );
-            objectMan->deleteSource( si );
-            return;
-        }
-    }
-    // seems to get a lot of "sources deleted but not in video sources list" on
-    // exit - may be that view-only clients are listed in the session. need to
-    // test more, but not that much of an issue
+    // the source gets found & taken out on the main thread (which calls
+    // sourceRemoved() below), so this doesn't wait for a frame to be drawn
+    objectMan->removeSource( &session, ssrc );
+}
+
+void VideoListener::sourceRemoved( VideoSource* s )
+{
+    mutex_lock( listenerMutex );
+    sourceCount--;
+    mutex_unlock( listenerMutex );
+    updatePixelCount( -( s->getVideoWidth() * s->getVideoHeight() ) );
 }
 
 void VideoListener::vpmsession_source_description( VPMSession &session,
@@ -171,59 +214,11 @@ void VideoListener::vpmsession_source_app( VPMSession &session,
 
     if ( appS.compare( "site" ) == 0 && objectMan->usingSiteIDGroups() )
     {
-        objectMan->lockSources();
-
         // vic sends 4 nulls at the end of the rtcp_app string for some
         // reason, so chop those off
         dataS = std::string( dataS, 0, 32 );
-        std::vector<VideoSource*>::iterator i =
-                objectMan->getSources()->begin();
-
-        // sometimes, if groups are enabled by default, we can get RTCP APP
-        // before we get any sources added, resulting in a crash when we try
-        // and dereference the sources pointer - so skip this if we don't have
-        // any sources yet
-        if ( objectMan->getSources()->size() == 0 )
-        {
-            objectMan->unlockSources();
-            return;
-        }
-
-        while ( (*i)->getssrc() != ssrc )
-        {
-            ++i;
-            if ( i == objectMan->getSources()->end() )
-            {
-                objectMan->unlockSources();
-                return;
-            }
-        }
-
-        if ( !(*i)->isGrouped() )
-        {
-            Group* g;
-            std::map<std::string,Group*>::iterator mapi =
-                    objectMan->getSiteIDGroups()->find( dataS );
-
-            if ( mapi == objectMan->getSiteIDGroups()->end() )
-                g = objectMan->createSiteIDGroup( dataS );
-            else
-                g = mapi->second;
-
-            (*i)->setSiteID( dataS );
-            g->add( *i );
-
-            // adding & removing will replace the object under its group
-            if ( objectMan->getTree() )
-            {
-                objectMan->getTree()->removeObject( (*i) );
-                objectMan->getTree()->addObject( (*i) );
-
-                objectMan->getTree()->updateObjectName( g );
-            }
-        }
-
-        objectMan->unlockSources();
+        // grouping happens on the main thread, like deletes
+        objectMan->setSourceSiteID( ssrc, dataS );
     }
 }
 
@@ -249,7 +244,20 @@ long VideoListener::getPixelCount()
 
 void VideoListener::updatePixelCount( long mod )
 {
-	pixelCount += mod;
+    __sync_fetch_and_add( &pixelCount, mod );
+}
+
+int VideoListener::getQueuedFrames()
+{
+    // only ever goes from NULL to set, on a session thread
+    FramePipeline* pipeline = framePipeline;
+    return pipeline != NULL ? pipeline->getQueuedCount() : 0;
+}
+
+unsigned int VideoListener::getQueueDroppedFrames()
+{
+    FramePipeline* pipeline = framePipeline;
+    return pipeline != NULL ? pipeline->getDroppedCount() : 0;
 }
 
 /*static void newFrameCallbackTest( VPMVideoSink* sink, int buffer_idx,
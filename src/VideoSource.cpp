@@ -23,31 +23,61 @@
  */
 
 #include "VideoSource.h"
+#include "VideoFrameSink.h"
+#include "FrameMailbox.h"
 #include "VideoListener.h"
 #include "SessionEntry.h"
 #include "SessionManager.h"
 #include "GLUtil.h"
+#include "BatchRenderer.h"
+#include "Animator.h"
 #include "gravUtil.h"
 #include <cmath>
 
 #include <VPMedia/video/VPMVideoDecoder.h>
 
 VideoSource::VideoSource( SessionEntry* _session, VideoListener* l,
-							uint32_t _ssrc, VPMVideoBufferSink* vs,
+							uint32_t _ssrc, VideoFrameSink* vs,
 							float _x, float _y ) :
-    RectangleBase( _x, _y ), session( _session ), listener( l ), ssrc( _ssrc ),
-		videoSink( vs )
+    RectangleBase( _x, _y ), session( _session ), listener( l ), ssrc( _ssrc )
 {
-    vwidth = videoSink->getImageWidth();
-    vheight = videoSink->getImageHeight();
-    aspect = (float)vwidth / (float)vheight;
+    // hang on to the mailbox rather than the sink, since the sink can get
+    // deleted out from under us on the network thread
+    mailbox = vs->getMailbox();
+    mailbox->retain();
+    frameDirty = false;
+    payloadDesc = std::string( vs->getVideoDecoder()->getDesc() );
+
+    vwidth = 0;
+    vheight = 0;
+    layout = vs->getLayout();
+    fwidth = 0;
+    fheight = 0;
     tex_width = 0; tex_height = 0;
-    texid = 0;
+    for ( int i = 0; i < maxPlanes; i++ )
+        texids[i] = 0;
+    numPlanes = 0;
+    texturesFilled = false;
+    init = true;
+    for ( int i = 0; i < numPixelBuffers; i++ )
+    {
+        pixelBuffers[i] = 0;
+        pixelBufferFences[i] = NULL;
+    }
+    pixelBufferIndex = 0;
+    pixelBufferSize = 0;
     aspect = 1.56f;
     destAspect = aspect;
-    aspectAnimating = false;
     useAlpha = false;
     enableRendering = true;
+    muted = false;
+    visibility = VISIBLE;
+    hiddenCount = 0;
+    renderSuspended = false;
+    decodeSuspended = false;
+    screenHeight = 0.0f;
+    scaleLevel = 0;
+    scaleDownCount = 0;
     altAddress = "";
 }
 
@@ -57,197 +87,77 @@ VideoSource::~VideoSource()
     // is (inside VPMedia), so that's why it isn't deleted here or in
     // videolistener
 
-    // gl destructors
-    glDeleteTextures( 1, &texid );
+    // gl resources go back to the pool for the next source to use
+    releaseTextures();
+    releasePixelBuffers();
+
+    mailbox->release();
 }
 
 void VideoSource::draw()
 {
-    // to draw the border/text/common stuff, also calls animateValues
+    // to draw the border/text/common stuff
     RectangleBase::draw();
 
     // replicate the invisible -> don't draw thing here; above needs to be
-    // called since it does the animation
+    // called since it updates the name size
     if ( borderColor.A < 0.01f )
         return;
 
     // set up our position
-    glPushMatrix();
+    BatchRenderer* batch = GLUtil::getInstance()->getBatchRenderer();
+    batch->reset();
 
     // dumb hack here to prevent z-fighting on orbit
-    glTranslatef( x, y, z + 0.05f );
-
-    glRotatef( xAngle, 1.0, 0.0, 0.0 );
-    glRotatef( yAngle, 0.0, 1.0, 0.0 );
-    glRotatef( zAngle, 0.0, 0.0, 1.0 );
+    batch->translate( x, y, z + 0.05f );
 
-    //glDepthMask( GL_FALSE );
-    //glEnable( GL_POLYGON_OFFSET_FILL );
-    //glDepthRange ( 0.0, 0.9 );
-    //glPolygonOffset( 1.0, 1.0 );
+    batch->rotate( xAngle, 1.0, 0.0, 0.0 );
+    batch->rotate( yAngle, 0.0, 1.0, 0.0 );
+    batch->rotate( zAngle, 0.0, 0.0, 1.0 );
 
     float s = 1.0;
     float t = 1.0;
-    // if the texture id hasn't been initialized yet, this must be the
-    // first draw call
-    init = (texid == 0);
 
-    // allocate the buffer if it's the first time or if it's been resized
-    if ( init || vwidth != videoSink->getImageWidth() ||
-         vheight != videoSink->getImageHeight() )
+    bool haveTexture = numPlanes > 0 && texturesFilled;
+    if ( haveTexture )
     {
-        resizeBuffer();
+        s = (float)fwidth/(float)tex_width;
+        t = (float)fheight/(float)tex_height;
     }
 
-    s = (float)vwidth/(float)tex_width;
-    //if ( videoSink->getImageFormat() == VIDEO_FORMAT_YUV420 )
-    //    t = (float)(3*vheight/2)/(float)tex_height;
-    //else
-    t = (float)vheight/(float)tex_height;
-
     // X & Y distances from center to edge
     float Xdist = aspect*scaleX/2;
     float Ydist = scaleY/2;
 
-    glBindTexture( GL_TEXTURE_2D, texid );
-
-    glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
-    glPixelStorei( GL_UNPACK_ROW_LENGTH, vwidth );
-
-    // only do this texture stuff if rendering is enabled
-    if ( enableRendering )
-    {
-        videoSink->lockImage();
-        // only bother doing a texture push if there's a new frame
-        if ( videoSink->haveNewFrameAvailable() )
-        {
-            if ( videoSink->getImageFormat() == VIDEO_FORMAT_RGB24 )
-            {
-                glTexSubImage2D( GL_TEXTURE_2D,
-                      0,
-                      0,
-                      0,
-                      vwidth,
-                      vheight,
-                      GL_RGB,
-                      GL_UNSIGNED_BYTE,
-                      videoSink->getImageData() );
-            }
-
-            // if we're doing yuv420, do the texture mapping for all 3 channels
-            // so the shader can properly work its magic
-            else if ( videoSink->getImageFormat() == VIDEO_FORMAT_YUV420 )
-            {
-                // experimental single-push method
-                /*glTexSubImage2D( GL_TEXTURE_2D,
-                                 0,
-                                 0,
-                                 0,
-                                 vwidth,
-                                 3*vheight/2,
-                                 GL_LUMINANCE,
-                                 GL_UNSIGNED_BYTE,
-                                 videoSink->getImageData() );*/
-
-                // 3 pushes separate
-                glTexSubImage2D( GL_TEXTURE_2D,
-                      0,
-                      0,
-                      0,
-                      vwidth,
-                      vheight,
-                      GL_LUMINANCE,
-                      GL_UNSIGNED_BYTE,
-                      videoSink->getImageData() );
-
-                // now map the U & V to the bottom chunk of the image
-                // each is 1/4 of the size of the Y (half width, half height)
-                glPixelStorei(GL_UNPACK_ROW_LENGTH, vwidth/2);
-
-                glTexSubImage2D( GL_TEXTURE_2D,
-                      0,
-                      0,
-                      vheight,
-                      vwidth/2,
-                      vheight/2,
-                      GL_LUMINANCE,
-                      GL_UNSIGNED_BYTE,
-                      (GLubyte*)videoSink->getImageData() + (vwidth*vheight) );
-
-                glTexSubImage2D( GL_TEXTURE_2D,
-                      0,
-                      vwidth/2,
-                      vheight,
-                      vwidth/2,
-                      vheight/2,
-                      GL_LUMINANCE,
-                      GL_UNSIGNED_BYTE,
-                      (GLubyte*)videoSink->getImageData() + 5*(vwidth*vheight)/4 );
-            }
-        }
-        videoSink->unlockImage();
-    }
-
     // draw video texture, regardless of whether we just pushed something
-    // new or not
-    if ( GLUtil::getInstance()->areShadersAvailable() )
+    // new or not - no texture yet if we haven't gotten any video (or pushed
+    // the first frame after a resize), so just draw it gray
+    if ( haveTexture )
     {
-        glUseProgram( GLUtil::getInstance()->getYUV420Program() );
-        glUniform1f( GLUtil::getInstance()->getYUV420xOffsetID(), s );
-        glUniform1f( GLUtil::getInstance()->getYUV420yOffsetID(), t );
-        if ( useAlpha )
-        {
-            glUniform1f( GLUtil::getInstance()->getYUV420alphaID(),
-                            borderColor.A );
-        }
+        batch->setTextures( numPlanes, texids );
+        batch->setProgram( layout->getProgram(),
+                            useAlpha ? borderColor.A : 1.0f );
     }
 
     // use alpha of border color for video if set
-    if ( useAlpha )
-    {
-        glColor4f( 1.0f, 1.0f, 1.0f, borderColor.A );
-        glEnable( GL_BLEND );
-        glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
-    }
-    else
-    {
-        glColor3f( 1.0f, 1.0f, 1.0f );
-    }
-
-    glEnable( GL_TEXTURE_2D );
-    glBegin( GL_QUADS );
+    float brightness = haveTexture ? 1.0f : 0.5f;
+    batch->setColor( brightness, brightness, brightness,
+                        useAlpha ? borderColor.A : 1.0f );
+    batch->setBlend( useAlpha );
 
     // now draw the actual quad that has the texture on it
     // size of the video in world space will be equivalent to getWidth x
     // getHeight, which is the same as (aspect*scaleX) x scaleY
-    glTexCoord2f( 0.0, 0.0 );
-    glVertex3f( -Xdist, -Ydist, 0.0 );
-
-    glTexCoord2f( 0.0, t );
-    glVertex3f( -Xdist, Ydist, 0.0 );
-
-    glTexCoord2f( s, t );
-    glVertex3f( Xdist, Ydist, 0.0 );
-
-    glTexCoord2f( s, 0.0 );
-    glVertex3f( Xdist, -Ydist, 0.0 );
-
-    glEnd();
+    batch->addQuad( -Xdist, -Ydist, Xdist, Ydist, s, t );
 
-    glDisable( GL_TEXTURE_2D );
-
-    if ( GLUtil::getInstance()->areShadersAvailable() )
-        glUseProgram( 0 );
+    batch->setTextures( 0, NULL );
+    batch->setProgram( GLUtil::PROGRAM_NONE, 1.0f );
 
     if ( vwidth == 0 || vheight == 0 )
     {
-        glPushMatrix();
-        glTranslatef( -(getWidth()*0.275f), getHeight()*0.3f, 0.0f );
-        float scaleFactor = getTextScale();
-        glScalef( scaleFactor, scaleFactor, scaleFactor );
         std::string waitingMessage( "Waiting for video..." );
-        GLUtil::getInstance()->getMainFont()->Render( waitingMessage.c_str() );
-        glPopMatrix();
+        batch->addText( waitingMessage, -(getWidth()*0.275f),
+                        getHeight()*0.3f, getTextScale() );
     }
 
     // draw a basic X in the top-left corner for signifying that rendering is
@@ -257,19 +167,11 @@ void VideoSource::draw()
     {
         float dist = getHeight() * 0.15f;
 
-        glBegin( GL_LINES );
-        glLineWidth( 3.0f );
-
-        glColor4f( secondaryColor.R, secondaryColor.G, secondaryColor.B,
-                    secondaryColor.A );
-
-        glVertex3f( -Xdist, Ydist - dist, 0.0f );
-        glVertex3f( -Xdist + dist, Ydist, 0.0f );
-
-        glVertex3f( -Xdist, Ydist, 0.0f );
-        glVertex3f( -Xdist + dist, Ydist - dist, 0.0f );
+        batch->setColor( secondaryColor.R, secondaryColor.G, secondaryColor.B,
+                            secondaryColor.A );
 
-        glEnd();
+        batch->addLine( -Xdist, Ydist - dist, -Xdist + dist, Ydist );
+        batch->addLine( -Xdist, Ydist, -Xdist + dist, Ydist - dist );
     }
 
     if ( altAddress.compare( "" ) != 0 )
@@ -277,44 +179,11 @@ void VideoSource::draw()
         float scaleFactor = getTextScale() * 1.25f;
         float offset = getHeight() * 0.01f;
 
-        glPushMatrix();
-
-        glTranslatef( -Xdist + offset, -Ydist + offset, 0.0f );
-        glScalef( scaleFactor, scaleFactor, scaleFactor );
-        glColor4f( 0.55f, 0.55f, 0.95f, borderColor.A + 0.1f );
+        batch->setColor( 0.55f, 0.55f, 0.95f, borderColor.A + 0.1f );
 
         std::string plus = "+HD";
-        GLUtil::getInstance()->getMainFont()->Render( plus.c_str() );
-
-        glPopMatrix();
-
-        /*glBegin( GL_QUADS );
-        float dist = getHeight() * 0.15f;
-
-        glColor4f( 0.4f, 0.4f, 0.8f, borderColor.A - 0.3f );
-
-        glVertex3f( Xdist - dist, -Ydist + ( dist / 3.0f ), 0.0f );
-        glVertex3f( Xdist - dist, -Ydist + ( 2.0f * dist / 3.0f ), 0.0f );
-        glVertex3f( Xdist, -Ydist + ( 2.0f * dist / 3.0f ), 0.0f );
-        glVertex3f( Xdist, -Ydist + ( dist / 3.0f ), 0.0f );
-
-        glVertex3f( Xdist - ( 2.0f * dist / 3.0f ), -Ydist, 0.0f );
-        glVertex3f( Xdist - ( 2.0f * dist / 3.0f ), -Ydist + dist, 0.0f );
-        glVertex3f( Xdist - ( dist / 3.0f ), -Ydist + dist, 0.0f );
-        glVertex3f( Xdist - ( dist / 3.0f ), -Ydist, 0.0f );
-
-        glEnd();*/
+        batch->addText( plus, -Xdist + offset, -Ydist + offset, scaleFactor );
     }
-
-    // see above
-    if ( useAlpha )
-    {
-        glDisable( GL_BLEND );
-    }
-
-    glPopMatrix();
-
-    //glDisable( GL_POLYGON_OFFSET_FILL );
 }
 
 void VideoSource::resizeBuffer()
@@ -332,8 +201,9 @@ void VideoSource::resizeBuffer()
     intended.setPos( posX, posY );
 
 	listener->updatePixelCount( -( vwidth * vheight ) );
-    vwidth = videoSink->getImageWidth();
-    vheight = videoSink->getImageHeight();
+    const FrameSlot* frame = mailbox->getFront();
+    vwidth = frame->nativeWidth;
+    vheight = frame->nativeHeight;
     listener->updatePixelCount(  vwidth * vheight );
 
     if ( vheight > 0 )
@@ -342,47 +212,15 @@ void VideoSource::resizeBuffer()
         destAspect = 1.33f;
 
     if ( animated )
-        aspectAnimating = true;
+        Animator::getInstance()->animate( this, &aspect, &destAspect, 7.5f );
     else
         aspect = destAspect;
-
-    tex_width = GLUtil::getInstance()->pow2( vwidth );
-    if ( videoSink->getImageFormat() == VIDEO_FORMAT_YUV420 )
-        tex_height = GLUtil::getInstance()->pow2( 3*vheight/2 );
-    else
-        tex_height = GLUtil::getInstance()->pow2( vheight );
+    boundsChanged();
 
     gravUtil::logVerbose( "VideoSource::resizeBuffer: image size is %ix%i\n",
             vwidth, vheight );
-    gravUtil::logVerbose( "VideoSource::resizeBuffer: texture size is %ix%i\n",
-            tex_width, tex_height );
-
-    // if it's not the first time we're allocating a texture
-    // (ie, it's a resize) delete the previous texture
-    if ( !init )
-        glDeleteTextures( 1, &texid );
-
-    glGenTextures( 1, &texid );
-
-    glBindTexture( GL_TEXTURE_2D, texid );
-
-    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP );
-    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP );
-    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
-    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
-
-    unsigned char *buffer = new unsigned char[ tex_width * tex_height * 3 ];
-    memset( buffer, 128, tex_width * tex_height * 3 );
-    glTexImage2D( GL_TEXTURE_2D,
-                  0,
-                  GL_RGB,
-                  tex_width,
-                  tex_height,
-                  0,
-                  GL_LUMINANCE,
-                  GL_UNSIGNED_BYTE,
-                  buffer );
-    delete[] buffer;
+
+    resizeTextures();
 
     // fill to intended size
     fillToRect( intended, lastFillFull );
@@ -391,6 +229,282 @@ void VideoSource::resizeBuffer()
     updateTextBounds();
 }
 
+void VideoSource::resizeTextures()
+{
+    // give back the old textures first, since we need the old sizes for it
+    releaseTextures();
+
+    const FrameSlot* frame = mailbox->getFront();
+    fwidth = frame->width;
+    fheight = frame->height;
+    if ( fwidth > 0 )
+        layout = VideoLayout::get( (VideoLayout::Type)frame->format );
+
+    // shader layouts only get used when we have shaders, which means we have
+    // NPOT as well, so only RGB on old cards needs the pow2 rounding
+    if ( GLUtil::getInstance()->areNonPow2TexturesAvailable() )
+    {
+        tex_width = fwidth;
+        tex_height = fheight;
+    }
+    else
+    {
+        tex_width = GLUtil::getInstance()->pow2( fwidth );
+        tex_height = GLUtil::getInstance()->pow2( fheight );
+    }
+
+    gravUtil::logVerbose( "VideoSource::resizeTextures: texture size is "
+            "%ix%i\n", tex_width, tex_height );
+
+    if ( fwidth == 0 || fheight == 0 )
+        numPlanes = 0;
+    else
+        numPlanes = layout->getNumPlanes();
+
+    // these don't get cleared - the video is just drawn without them until
+    // the first frame is pushed, which is usually on the same draw
+    texturesFilled = false;
+    for ( int i = 0; i < numPlanes; i++ )
+    {
+        texids[i] = GLUtil::getInstance()->borrowTexture(
+                        layout->getTextureFormat( i ),
+                        layout->getPlaneWidth( i, tex_width ),
+                        layout->getPlaneHeight( i, tex_height ) );
+    }
+
+    if ( GLUtil::getInstance()->arePixelBuffersAvailable() )
+        resizePixelBuffers();
+}
+
+void VideoSource::updateScaleLevel()
+{
+    // halve as long as the result is still at least as tall as what's
+    // actually on screen, so there's no visible loss. selected videos are
+    // probably being looked at closely, so leave those alone
+    int wanted = 0;
+    if ( screenHeight > 0.0f && !selected )
+    {
+        while ( wanted < maxScaleLevel &&
+                (float)( vheight >> ( wanted + 1 ) ) >= screenHeight )
+            wanted++;
+    }
+
+    if ( wanted < scaleLevel )
+    {
+        scaleLevel = wanted;
+        scaleDownCount = 0;
+        mailbox->setScaleLevel( scaleLevel );
+    }
+    else if ( wanted > scaleLevel )
+    {
+        if ( ++scaleDownCount >= scaleDownDelay )
+        {
+            scaleLevel = wanted;
+            scaleDownCount = 0;
+            mailbox->setScaleLevel( scaleLevel );
+        }
+    }
+    else
+    {
+        scaleDownCount = 0;
+    }
+}
+
+bool VideoSource::uploadFrame()
+{
+    const FrameSlot* frame = mailbox->getFront();
+
+    // the frame might be a different size than what we've got allocated if it
+    // changed since we checked - in that case we'll resize on the next draw
+    if ( frame->width != fwidth || frame->height != fheight )
+        return false;
+
+    // fallback: straight from the mailbox's front slot, which the decoder
+    // won't touch until we acquire again
+    if ( !GLUtil::getInstance()->arePixelBuffersAvailable() )
+    {
+        pushTexture( frame->data );
+        return true;
+    }
+
+    if ( pixelBufferSize == 0 )
+        return false;
+
+    // if the GL is still reading from the next buffer in the ring, skip the
+    // push for this draw rather than wait - the frame will still be there next
+    // time around (or a newer one will be)
+    GLsync& fence = pixelBufferFences[ pixelBufferIndex ];
+    if ( fence != NULL )
+    {
+        if ( glClientWaitSync( fence, 0, 0 ) == GL_TIMEOUT_EXPIRED )
+            return false;
+        glDeleteSync( fence );
+        fence = NULL;
+    }
+
+    glBindBuffer( GL_PIXEL_UNPACK_BUFFER, pixelBuffers[ pixelBufferIndex ] );
+    // orphan the old storage first - the buffer might have come from the pool
+    // with the GL still reading from it for someone else (its fence went away
+    // when it was returned), and mapping it as-is would wait for that
+    glBufferData( GL_PIXEL_UNPACK_BUFFER, pixelBufferSize, NULL,
+                    GL_STREAM_DRAW );
+    GLubyte* dest = (GLubyte*)glMapBuffer( GL_PIXEL_UNPACK_BUFFER,
+                                            GL_WRITE_ONLY );
+    if ( dest == NULL )
+    {
+        gravUtil::logWarning( "VideoSource::uploadFrame: failed to map pixel "
+                "buffer\n" );
+        glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0 );
+        return false;
+    }
+
+    memcpy( dest, frame->data, pixelBufferSize );
+    glUnmapBuffer( GL_PIXEL_UNPACK_BUFFER );
+
+    // with a PBO bound the data pointer is an offset into the buffer
+    pushTexture( (const GLubyte*)NULL );
+    fence = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+    pixelBufferIndex = ( pixelBufferIndex + 1 ) % numPixelBuffers;
+
+    glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0 );
+    return true;
+}
+
+void VideoSource::pushTexture( const GLubyte* data )
+{
+    // planes are tightly packed, so rows are just the width of the upload
+    glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+    glPixelStorei( GL_UNPACK_ROW_LENGTH, 0 );
+
+    // each plane follows the last one in the frame, straight into its own
+    // texture - the shader (if any) puts them back together
+    for ( int i = 0; i < numPlanes; i++ )
+    {
+        glBindTexture( GL_TEXTURE_2D, texids[i] );
+        glTexSubImage2D( GL_TEXTURE_2D,
+              0,
+              0,
+              0,
+              layout->getPlaneWidth( i, fwidth ),
+              layout->getPlaneHeight( i, fheight ),
+              layout->getUploadFormat( i ),
+              GL_UNSIGNED_BYTE,
+              data + layout->getPlaneOffset( i, fwidth, fheight ) );
+    }
+    texturesFilled = numPlanes > 0;
+}
+
+unsigned int VideoSource::getFrameSize()
+{
+    return layout->getFrameSize( fwidth, fheight );
+}
+
+void VideoSource::releaseTextures()
+{
+    for ( int i = 0; i < numPlanes; i++ )
+    {
+        GLUtil::getInstance()->returnTexture( texids[i],
+                layout->getTextureFormat( i ),
+                layout->getPlaneWidth( i, tex_width ),
+                layout->getPlaneHeight( i, tex_height ) );
+        texids[i] = 0;
+    }
+    numPlanes = 0;
+}
+
+void VideoSource::resizePixelBuffers()
+{
+    releasePixelBuffers();
+
+    pixelBufferSize = getFrameSize();
+    if ( pixelBufferSize == 0 )
+        return;
+
+    for ( int i = 0; i < numPixelBuffers; i++ )
+    {
+        pixelBuffers[i] = GLUtil::getInstance()->borrowPixelBuffer(
+                            pixelBufferSize );
+    }
+    pixelBufferIndex = 0;
+}
+
+void VideoSource::releasePixelBuffers()
+{
+    for ( int i = 0; i < numPixelBuffers; i++ )
+    {
+        if ( pixelBufferFences[i] != NULL )
+        {
+            glDeleteSync( pixelBufferFences[i] );
+            pixelBufferFences[i] = NULL;
+        }
+    }
+
+    if ( pixelBufferSize > 0 )
+    {
+        for ( int i = 0; i < numPixelBuffers; i++ )
+        {
+            GLUtil::getInstance()->returnPixelBuffer( pixelBuffers[i],
+                    pixelBufferSize );
+            pixelBuffers[i] = 0;
+        }
+        pixelBufferSize = 0;
+    }
+}
+
+bool VideoSource::pollFrame()
+{
+    // same as draw, don't bother if it's invisible - the frame stays in the
+    // mailbox until it's shown again
+    if ( borderColor.A < 0.01f )
+        return false;
+
+    updateScaleLevel();
+
+    // pick up the newest complete frame, if the decoder has published one
+    if ( mailbox->acquire() )
+        frameDirty = true;
+    const FrameSlot* frame = mailbox->getFront();
+
+    // allocate the buffer if it's the first time or if it's been resized -
+    // if only the scale level changed, just the textures need to be remade
+    if ( init || vwidth != frame->nativeWidth ||
+            vheight != frame->nativeHeight ||
+            ( frame->width > 0 && layout->getType() != frame->format ) )
+    {
+        resizeBuffer();
+        init = false;
+    }
+    else if ( fwidth != frame->width || fheight != frame->height )
+    {
+        resizeTextures();
+    }
+
+    // only do texture stuff if rendering is enabled
+    return enableRendering && !renderSuspended && numPlanes > 0 && frameDirty;
+}
+
+unsigned int VideoSource::getUploadSize()
+{
+    return getFrameSize();
+}
+
+bool VideoSource::upload()
+{
+    frameDirty = !uploadFrame();
+    return !frameDirty;
+}
+
+bool VideoSource::needsRedraw()
+{
+    if ( RectangleBase::needsRedraw() )
+        return true;
+
+    // new frames only matter if they'd actually get shown - a frame that's
+    // still waiting on the upload budget counts too
+    return borderColor.A >= 0.01f && enableRendering && !renderSuspended &&
+            ( frameDirty || mailbox->hasFresh() );
+}
+
 void VideoSource::scaleNative()
 {
     // no point in scaling to 0x0
@@ -497,7 +611,12 @@ std::string VideoSource::getName()
 
 const char* VideoSource::getPayloadDesc()
 {
-    return videoSink->getVideoDecoder()->getDesc();
+    return payloadDesc.c_str();
+}
+
+const char* VideoSource::getLayoutName()
+{
+    return layout->getName();
 }
 
 SessionEntry* VideoSource::getSession()
@@ -515,6 +634,21 @@ unsigned int VideoSource::getVideoHeight()
     return vheight;
 }
 
+unsigned int VideoSource::getDroppedFrames()
+{
+    return mailbox->getDroppedCount();
+}
+
+int VideoSource::getQueuedFrames()
+{
+    return mailbox->getQueuedCount();
+}
+
+unsigned int VideoSource::getQueueDroppedFrames()
+{
+    return mailbox->getQueueDroppedCount();
+}
+
 float VideoSource::getWidth()
 {
     return aspect * scaleX;
@@ -552,7 +686,8 @@ float VideoSource::getOriginalAspect()
 
 void VideoSource::toggleMute()
 {
-    session->getVPMSession()->enableSource( ssrc, isMuted() );
+    muted = !muted;
+    updateSourceEnable();
     enableRendering = !isMuted();
 
     if ( isMuted() )
@@ -574,7 +709,7 @@ void VideoSource::toggleMute()
 
 bool VideoSource::isMuted()
 {
-    return !( session->getVPMSession()->isSourceEnabled( ssrc ) );
+    return muted;
 }
 
 void VideoSource::setRendering( bool r )
@@ -608,6 +743,65 @@ bool VideoSource::getRendering()
     return enableRendering;
 }
 
+void VideoSource::setVisibility( Visibility v, bool suspendDecoding )
+{
+    visibility = v;
+
+    if ( visibility == VISIBLE )
+    {
+        hiddenCount = 0;
+        renderSuspended = false;
+    }
+    else if ( hiddenCount < suspendDelay )
+    {
+        hiddenCount++;
+        renderSuspended = ( hiddenCount >= suspendDelay );
+    }
+
+    bool decode = renderSuspended && suspendDecoding;
+    if ( decode != decodeSuspended )
+    {
+        decodeSuspended = decode;
+        updateSourceEnable();
+        gravUtil::logVerbose( "VideoSource::setVisibility: decoding %s for "
+                "%s\n", decodeSuspended ? "suspended" : "resumed",
+                name.c_str() );
+    }
+}
+
+VideoSource::Visibility VideoSource::getVisibility()
+{
+    return visibility;
+}
+
+bool VideoSource::isSuspended()
+{
+    return renderSuspended;
+}
+
+bool VideoSource::isOpaque()
+{
+    return numPlanes > 0 && texturesFilled && !useAlpha &&
+        borderColor.A > 0.99f;
+}
+
+void VideoSource::setScreenHeight( float h )
+{
+    screenHeight = h;
+}
+
+int VideoSource::getScaleLevel()
+{
+    return scaleLevel;
+}
+
+void VideoSource::updateSourceEnable()
+{
+    VPMSession* vpmSession = session->getVPMSession();
+    if ( vpmSession != NULL )
+        vpmSession->enableSource( ssrc, !muted && !decodeSuspended );
+}
+
 void VideoSource::show( bool s, bool instant )
 {
     RectangleBase::show( s, instant );
@@ -640,19 +834,3 @@ void VideoSource::doubleClickAction()
                 "address to connect to\n" );
     }
 }
-
-void VideoSource::animateValues()
-{
-    RectangleBase::animateValues();
-
-    if ( aspectAnimating )
-    {
-        aspect += ( destAspect - aspect ) / 7.5f;
-
-        if ( fabs( destAspect - aspect ) < 0.01f )
-        {
-            aspect = destAspect;
-            aspectAnimating = false;
-        }
-    }
-}
@@ -0,0 +1,155 @@
+/*
+ * @file WorkerPool.cpp
+ *
+ * Implementation of the WorkerPool class. See WorkerPool.h for details.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "WorkerPool.h"
+#include "gravUtil.h"
+
+#include <wx/thread.h>
+
+WorkerPool::WorkerPool( int numThreads )
+{
+    quit = false;
+    job = NULL;
+    jobData = NULL;
+    jobCount = 0;
+    done = new wxSemaphore();
+    runMutex = mutex_create();
+
+    if ( numThreads < 0 )
+        numThreads = 0;
+    workers.resize( numThreads );
+
+    // fill everything in before starting any threads, since the vector can't
+    // move after that
+    for ( int i = 0; i < numThreads; i++ )
+    {
+        workers[i].pool = this;
+        workers[i].id = i + 1;
+        workers[i].wake = new wxSemaphore();
+        workers[i].handle = NULL;
+    }
+    for ( int i = 0; i < numThreads; i++ )
+        workers[i].handle = thread_start( workerThread, &workers[i] );
+
+    gravUtil::logVerbose( "WorkerPool::WorkerPool: started %i threads\n",
+            numThreads );
+}
+
+WorkerPool::~WorkerPool()
+{
+    quit = true;
+    for ( unsigned int i = 0; i < workers.size(); i++ )
+        workers[i].wake->Post();
+
+    for ( unsigned int i = 0; i < workers.size(); i++ )
+    {
+        thread_join( workers[i].handle );
+        delete workers[i].wake;
+    }
+
+    delete done;
+    mutex_free( runMutex );
+}
+
+void WorkerPool::run( Job j, void* data, int count )
+{
+    if ( count <= 0 )
+        return;
+
+    // nothing to split across, so don't bother waking anyone
+    if ( workers.empty() || count == 1 )
+    {
+        for ( int i = 0; i < count; i++ )
+            j( data, i, count );
+        return;
+    }
+
+    mutex_lock( runMutex );
+
+    job = j;
+    jobData = data;
+    jobCount = count;
+
+    // only wake as many as there are pieces for - the semaphore post/wait
+    // pairs also act as the barriers for the job fields above
+    int woken = (int)workers.size();
+    if ( woken > count - 1 )
+        woken = count - 1;
+    for ( int i = 0; i < woken; i++ )
+        workers[i].wake->Post();
+
+    doPieces( 0 );
+
+    for ( int i = 0; i < woken; i++ )
+        done->Wait();
+
+    job = NULL;
+    jobData = NULL;
+    jobCount = 0;
+
+    mutex_unlock( runMutex );
+}
+
+int WorkerPool::getNumThreads()
+{
+    return (int)workers.size();
+}
+
+int WorkerPool::getDefaultSize( int maxThreads )
+{
+    int size = wxThread::GetCPUCount() - 1;
+    if ( size > maxThreads )
+        size = maxThreads;
+    return size > 0 ? size : 0;
+}
+
+void* WorkerPool::workerThread( void* args )
+{
+    Worker* worker = (Worker*)args;
+    WorkerPool* pool = worker->pool;
+
+    while ( true )
+    {
+        worker->wake->Wait();
+        if ( pool->quit )
+            break;
+
+        pool->doPieces( worker->id );
+        pool->done->Post();
+    }
+
+    return NULL;
+}
+
+void WorkerPool::doPieces( int id )
+{
+    // pieces are dealt out round-robin, so each one is done exactly once
+    // without the workers needing to coordinate
+    int stride = (int)workers.size() + 1;
+    if ( stride > jobCount )
+        stride = jobCount;
+
+    for ( int i = id; i < jobCount; i += stride )
+        job( jobData, i, jobCount );
+}
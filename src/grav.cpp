@@ -26,6 +26,7 @@
 #include "grav.h"
 #include "gravUtil.h"
 #include "Earth.h"
+#include "EarthTiles.h"
 #include "GLCanvas.h"
 #include "ObjectManager.h"
 #include "InputHandler.h"
@@ -40,12 +41,21 @@
 #include "SideFrame.h"
 #include "Timers.h"
 #include "VenueClientController.h"
+#include "ColorConverter.h"
+#include "WorkerPool.h"
+#include "Animator.h"
+#include "HeadlessContext.h"
 
 #include <VPMedia/VPMLog.h>
 #include <VPMedia/VPMPayloadDecoderFactory.h>
 #include <VPMedia/VPMSessionFactory.h>
 
-IMPLEMENT_APP( gravApp )
+#include <algorithm>
+#include <cstring>
+#include <sys/time.h>
+
+// main is below, so headless runs can skip the GUI init
+IMPLEMENT_APP_NO_MAIN( gravApp )
 
 BEGIN_EVENT_TABLE(gravApp, wxApp)
 EVT_IDLE(gravApp::idleHandler)
@@ -53,11 +63,74 @@ END_EVENT_TABLE(); // this ; is not necessary, just makes eclipse's syntax
                    // parser shut up
 
 bool gravApp::threadDebug = false;
-int gravApp::threadCounter = 0;
 
-bool gravApp::OnInit()
+static double getTimeMS()
 {
-    parser.SetCmdLine( argc, argv );
+    struct timeval now;
+    gettimeofday( &now, NULL );
+    return (double)now.tv_sec * 1000.0 + (double)now.tv_usec / 1000.0;
+}
+
+int main( int argc, char** argv )
+{
+    if ( !gravApp::isHeadlessRun( argc, argv ) )
+        return wxEntry( argc, argv );
+
+    // headless runs only need wxBase, so they're started as a console app
+    // rather than the GUI one, which won't start without a display. the
+    // gravApp is still what holds the options & does the setup, it just
+    // isn't the app wx initializes - making it points wxTheApp at it, so
+    // the console app has to be set after
+    gravApp* app = new gravApp();
+    wxApp::SetInstance( new wxAppConsole() );
+
+    int ret = 1;
+    if ( wxEntryStart( argc, argv ) )
+    {
+        ret = app->headlessMain();
+        delete app;
+        wxEntryCleanup();
+    }
+    else
+    {
+        fprintf( stderr, "grav: couldn't initialize wxWidgets\n" );
+        delete app;
+    }
+    return ret;
+}
+
+bool gravApp::isHeadlessRun( int argc, char** argv )
+{
+    for ( int i = 1; i < argc; i++ )
+    {
+        const char* arg = argv[i];
+        if ( strcmp( arg, "--headless" ) == 0 ||
+                strncmp( arg, "--headless=", 11 ) == 0 )
+            return true;
+        // -hl, -hl=N or -hlN, but not -hld
+        if ( strncmp( arg, "-hl", 3 ) == 0 && ( arg[3] == '\0' ||
+                arg[3] == '=' || ( arg[3] >= '0' && arg[3] <= '9' ) ) )
+            return true;
+    }
+    return false;
+}
+
+int gravApp::headlessMain()
+{
+    wxAppConsole* console = wxAppConsole::GetInstance();
+    parser.SetCmdLine( console->argc, console->argv );
+
+    if ( !initCommon() )
+        return 1;
+
+    return runHeadless() ? 0 : 1;
+}
+
+bool gravApp::initCommon()
+{
+    // defaults - can be changed by command line
+    windowWidth = 900; windowHeight = 550;
+    startX = 10; startY = 50;
 
     if ( !handleArgs() )
     {
@@ -67,10 +140,18 @@ bool gravApp::OnInit()
     // Some weirdness happens if this is called before arg handling, etc.
     gravUtil::initLogging();
 
+    if ( convertBenchmark )
+    {
+        // same pool size that VideoListener would use
+        WorkerPool pool( WorkerPool::getDefaultSize(
+                            VideoListener::maxConvertThreads ) );
+        if ( !ColorConverter::runBenchmark( 1280, 720, 100, &pool ) )
+            gravUtil::logError( "grav::initCommon: conversion kernels don't "
+                    "match\n" );
+        return false;
+    }
+
     objectMan = new ObjectManager();
-    // defaults - can be changed by command line
-    windowWidth = 900; windowHeight = 550;
-    startX = 10; startY = 50;
     // ObjectManager's windowwidth/height will be set by the glcanvas's resize
     // callback
 
@@ -95,6 +176,16 @@ bool gravApp::OnInit()
         av_log_set_level( AV_LOG_FATAL );
 #endif
 
+    return true;
+}
+
+bool gravApp::OnInit()
+{
+    parser.SetCmdLine( argc, argv );
+
+    if ( !initCommon() )
+        return false;
+
     // GUI setup
     mainFrame = new Frame( (wxFrame*)NULL, -1, _("grav"),
                         wxPoint( startX, startY ),
@@ -181,6 +272,7 @@ bool gravApp::OnInit()
 
     // since these bools are used in glinit, set them before glinit
     GLUtil::getInstance()->setShaderEnable( enableShaders );
+    GLUtil::getInstance()->setPixelBufferEnable( enablePixelBuffers );
     GLUtil::getInstance()->setBufferFontUsage( bufferFont );
 
     // initialize GL stuff (+ shaders) needs to be done AFTER attriblist is
@@ -199,7 +291,9 @@ bool gravApp::OnInit()
 
     GLUtil::getInstance()->addTexture( "border", "border.png" );
     GLUtil::getInstance()->addTexture( "circle", "circle.png" );
-    GLUtil::getInstance()->addTexture( "earth", "earth.png" );
+    // mipmapped, since most of the time the earth is a lot smaller on screen
+    // than the texture is
+    GLUtil::getInstance()->addTexture( "earth", "earth.png", true );
 
     GLUtil::getInstance()->setCanvas( canvas );
 
@@ -211,7 +305,7 @@ bool gravApp::OnInit()
     //wxStopWatch* t2 = new wxStopWatch();
     //videoSession_listener->setTimer( t2 );
 
-    earth = new Earth();
+    createEarth();
     input = new InputHandler( objectMan, mainFrame );
 
     // frame needs reference to inputhandler to generate help window for
@@ -242,6 +336,11 @@ bool gravApp::OnInit()
 
     objectMan->setAutoFocusRotate( autoFocusRotate );
     objectMan->setGridAuto( gridAuto );
+    objectMan->setVisibilityCulling( visibilityCulling );
+    objectMan->setHiddenDecodeSuspension( suspendHiddenDecoding );
+    objectMan->setUploadDownscaling( uploadDownscaling );
+    objectMan->setUploadBudget( (unsigned int)uploadBudget * 1024 );
+    objectMan->setMaxRedrawInterval( (int)maxRedrawInterval );
 
     if ( haveThumbnailFile )
     {
@@ -307,7 +406,7 @@ int gravApp::OnExit()
     if ( usingThreads )
     {
         threadRunning = false;
-        thread_join( VPMthread );
+        sessionManager->stopThreads();
     }
 
     // note, tree and canvas get deleted automatically since they're children
@@ -330,20 +429,191 @@ int gravApp::OnExit()
     VPMPayloadDecoderFactory::shutdown();
 
     GLUtil::cleanupGL();
+    Animator::cleanup();
     PythonTools::cleanup();
     gravUtil::cleanup();
 
     return 0;
 }
 
+void gravApp::createEarth()
+{
+    earth = new Earth();
+    if ( haveEarthTileFile )
+    {
+        std::string tilePath = gravUtil::getInstance()->findFile(
+                earthTileFile );
+        if ( tilePath.compare( "" ) != 0 )
+        {
+            EarthTiles* tiles = new EarthTiles(
+                    (unsigned int)earthTileBudget * 1024 * 1024 );
+            if ( tiles->load( tilePath ) )
+                earth->setTiles( tiles );
+            else
+                delete tiles;
+        }
+    }
+}
+
+bool gravApp::runHeadless()
+{
+    HeadlessContext* context = new HeadlessContext();
+    earth = NULL;
+    input = NULL;
+
+    GLUtil::getInstance()->setShaderEnable( enableShaders );
+    GLUtil::getInstance()->setPixelBufferEnable( enablePixelBuffers );
+    GLUtil::getInstance()->setBufferFontUsage( bufferFont );
+
+    bool ready = headlessFrames > 0 && context->init() &&
+                    GLUtil::getInstance()->initGL() &&
+                    context->createFramebuffer( windowWidth, windowHeight );
+    if ( ready )
+    {
+        GLUtil::getInstance()->addTexture( "border", "border.png" );
+        GLUtil::getInstance()->addTexture( "circle", "circle.png" );
+        GLUtil::getInstance()->addTexture( "earth", "earth.png", true );
+
+        if ( headerSet )
+            objectMan->setHeaderString( header );
+
+        createEarth();
+        // no frame, since the input handler only needs it for events
+        input = new InputHandler( objectMan, NULL );
+
+        objectMan->setEarth( earth );
+        objectMan->setInput( input );
+        objectMan->setVideoListener( videoSessionListener );
+        objectMan->setSessionManager( sessionManager );
+        objectMan->setAudio( audioSessionListener );
+
+        objectMan->setGridAuto( gridAuto );
+        objectMan->setVisibilityCulling( visibilityCulling );
+        objectMan->setHiddenDecodeSuspension( suspendHiddenDecoding );
+        objectMan->setUploadDownscaling( uploadDownscaling );
+        objectMan->setUploadBudget( (unsigned int)uploadBudget * 1024 );
+        // every frame gets drawn & timed, changed or not
+        objectMan->setMaxRedrawInterval( 0 );
+
+        if ( haveThumbnailFile )
+        {
+            std::string thumbPath = gravUtil::getInstance()->findFile(
+                    thumbnailFile );
+            if ( thumbPath.compare( "" ) != 0 )
+            {
+                objectMan->setThumbnailMap(
+                    gravUtil::getInstance()->parseThumbnailFile( thumbPath ) );
+            }
+        }
+
+        mapRTP();
+
+        // no session tree to go through, so straight to the manager
+        for ( unsigned int i = 0; i < initialVideoAddresses.size(); i++ )
+        {
+            sessionManager->addSession( initialVideoAddresses[i],
+                                        VIDEOSESSION );
+            if ( haveVideoKey )
+                sessionManager->setEncryptionKey( initialVideoAddresses[i],
+                                                    initialVideoKey );
+        }
+        for ( unsigned int i = 0; i < initialAudioAddresses.size(); i++ )
+        {
+            sessionManager->addSession( initialAudioAddresses[i],
+                                        AUDIOSESSION );
+            if ( haveAudioKey )
+                sessionManager->setEncryptionKey( initialAudioAddresses[i],
+                                                    initialAudioKey );
+        }
+
+        GLCanvas::setupView( objectMan, context->getWidth(),
+                                context->getHeight() );
+
+        // step animations by the framerate (or 60fps) per frame rather than
+        // by real time, so every run does the same thing frame for frame
+        float step = timerIntervalUS > 0 ?
+                        (float)timerIntervalUS / 1000000.0f : 1.0f / 60.0f;
+        Animator::getInstance()->setFixedStep( step );
+
+        gravUtil::logMessage( "grav::runHeadless: %li frames at %ix%i, "
+                "%.2f ms per step\n", headlessFrames, context->getWidth(),
+                context->getHeight(), step * 1000.0f );
+
+        double total = 0.0;
+        double fastest = 0.0;
+        double slowest = 0.0;
+        for ( int i = 0; i < (int)headlessFrames; i++ )
+        {
+            // network & decoding on this thread, between frames, so they
+            // don't land in the middle of the timing
+            sessionManager->iterateSessions();
+
+            double start = getTimeMS();
+            objectMan->draw();
+            // draw only queues things up, so wait for the GPU to get through
+            // it for the timing to mean anything
+            glFinish();
+            double elapsed = getTimeMS() - start;
+
+            total += elapsed;
+            if ( i == 0 || elapsed < fastest )
+                fastest = elapsed;
+            if ( i == 0 || elapsed > slowest )
+                slowest = elapsed;
+            gravUtil::logMessage( "grav::runHeadless: frame %5i %8.3f ms\n",
+                    i, elapsed );
+
+            if ( haveHeadlessDump )
+            {
+                char name[16];
+                sprintf( name, "%05i.ppm", i );
+                context->writeFrame( headlessDumpPrefix + name );
+            }
+        }
+
+        gravUtil::logMessage( "grav::runHeadless: average %.3f ms, fastest "
+                "%.3f ms, slowest %.3f ms\n", total / headlessFrames, fastest,
+                slowest );
+    }
+    else if ( headlessFrames <= 0 )
+    {
+        gravUtil::logError( "grav::runHeadless: nothing to render, the "
+                "frame count has to be above 0\n" );
+    }
+    else
+    {
+        gravUtil::logError( "grav::runHeadless: couldn't set up offscreen "
+                "rendering, exiting\n" );
+    }
+
+    // same as OnExit, minus everything that needs windows - the context
+    // goes after GL cleanup, since that needs it to still be current
+    delete sessionManager;
+    delete videoSessionListener;
+    delete audioSessionListener;
+    delete earth;
+    delete input;
+    delete objectMan;
+
+    VPMPayloadDecoderFactory::shutdown();
+
+    GLUtil::cleanupGL();
+    delete context;
+    Animator::cleanup();
+    PythonTools::cleanup();
+    gravUtil::cleanup();
+
+    return ready;
+}
+
 void gravApp::idleHandler( wxIdleEvent& evt )
 {
-    // start secondary thread if not running
+    // start the session threads if they're not running
     if ( usingThreads && !threadRunning )
     {
-        objectMan->setThreads( usingThreads );
+        gravUtil::logVerbose( "grav::starting network/decoding threads...\n" );
         threadRunning = true;
-        VPMthread = thread_start( threadTest, this );
+        sessionManager->startThreads( sessionThreads );
     }
 
     if ( !usingThreads )
@@ -357,7 +627,9 @@ void gravApp::idleHandler( wxIdleEvent& evt )
         if ( time > (unsigned long)timerIntervalUS )
         {
             //gravUtil::logVerbose( "%lu\n", time );
-            canvas->draw();
+            // if nothing changed, skip this one & check again next interval
+            if ( objectMan->needsRedraw() )
+                canvas->draw();
             timer->resetTiming();
         }
         else
@@ -366,25 +638,19 @@ void gravApp::idleHandler( wxIdleEvent& evt )
         }
     }
     // otherwise (if fps value isn't set) just constantly draw - if vsync is on,
-    // will be limited to vsync
+    // will be limited to vsync. skip frames where nothing changed, sleeping
+    // so we don't spin just checking for changes
     else if ( timerIntervalUS == 0 )
     {
-        canvas->draw();
+        if ( objectMan->needsRedraw() )
+            canvas->draw();
+        else
+            wxMilliSleep( 1 );
     }
 
     evt.RequestMore();
 }
 
-void gravApp::iterateSessions()
-{
-    bool haveSessions = sessionManager->iterateSessions();
-
-    // if there are no sessions, sleep so as not to spin and consume CPU
-    // needlessly
-    if ( !haveSessions )
-        wxMicroSleep( 500 );
-}
-
 bool gravApp::handleArgs()
 {
     parser.SetDesc( cmdLineDesc );
@@ -421,11 +687,48 @@ bool gravApp::handleArgs()
     printVersion = parser.Found( _("version") );
 
     usingThreads = !parser.Found( _("no-threads") );
+    threadRunning = false;
+
+    // one core is left for drawing, but more sessions than cores still
+    // spread out fine since they mostly wait on the network
+    if ( !parser.Found( _("session-threads"), &sessionThreads ) ||
+            sessionThreads < 1 )
+        sessionThreads = std::max( 1, WorkerPool::getDefaultSize( 4 ) );
 
     disablePython = parser.Found( _("no-python") );
 
     enableShaders = parser.Found( _("enable-shaders") );
 
+    enablePixelBuffers = !parser.Found( _("no-pixel-buffers") );
+
+    convertBenchmark = parser.Found( _("convert-benchmark") );
+
+    if ( !parser.Found( _("headless"), &headlessFrames ) ||
+            headlessFrames < 0 )
+        headlessFrames = 0;
+
+    wxString headlessDumpWX;
+    haveHeadlessDump = parser.Found( _("headless-dump"), &headlessDumpWX );
+    if ( haveHeadlessDump )
+    {
+        headlessDumpPrefix = std::string( headlessDumpWX.char_str() );
+    }
+
+    visibilityCulling = !parser.Found( _("no-visibility-culling") );
+
+    suspendHiddenDecoding = parser.Found( _("suspend-hidden-decoding") );
+
+    uploadDownscaling = !parser.Found( _("no-upload-downscaling") );
+
+    // enough for a few 1080p frames, so it only kicks in with lots of video
+    if ( !parser.Found( _("upload-budget"), &uploadBudget ) ||
+            uploadBudget < 0 )
+        uploadBudget = 16384;
+
+    if ( !parser.Found( _("max-redraw-interval"), &maxRedrawInterval ) ||
+            maxRedrawInterval < 0 )
+        maxRedrawInterval = 500;
+
     bufferFont = parser.Found( _("use-buffer-font") );
 
     startFullscreen = parser.Found( _("fullscreen") );
@@ -482,6 +785,17 @@ bool gravApp::handleArgs()
         thumbnailFile = std::string( thumbnailFileWX.char_str() );
     }
 
+    wxString earthTileFileWX;
+    haveEarthTileFile = parser.Found( _("earth-tiles"), &earthTileFileWX );
+    if ( haveEarthTileFile )
+    {
+        earthTileFile = std::string( earthTileFileWX.char_str() );
+    }
+
+    if ( !parser.Found( _("earth-tile-budget"), &earthTileBudget ) ||
+            earthTileBudget <= 0 )
+        earthTileBudget = 64;
+
     wxString videoKeyWX;
     haveVideoKey = parser.Found( _("video-key"), &videoKeyWX );
     if ( haveVideoKey )
@@ -536,30 +850,3 @@ void gravApp::mapRTP()
     decoderFactory->mapPayloadType( 116, "L16_48k_mono" );
     decoderFactory->mapPayloadType( 117, "L16_48k_stereo" );
 }
-
-void* gravApp::threadTest( void* args )
-{
-    gravUtil::logVerbose( "grav::starting network/decoding thread...\n" );
-    gravApp* g = (gravApp*)args;
-    // wait a bit before starting this thread, since doing it too early might
-    // affect the WX tree before it's fully initialized somehow, rarely
-    // resulting in broken text or a crash
-    wxMilliSleep( 100 );
-    while ( g->isThreadRunning() )
-    {
-        g->iterateSessions();
-        if ( threadDebug )
-        {
-            if ( threadCounter == 0 )
-                gravUtil::logVerbose( "grav::thread still running\n" );
-            threadCounter = (threadCounter+1)%1000;
-        }
-    }
-    gravUtil::logVerbose( "grav::thread ending...\n" );
-    return 0;
-}
-
-bool gravApp::isThreadRunning()
-{
-    return threadRunning;
-}
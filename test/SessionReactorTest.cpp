@@ -0,0 +1,172 @@
+/*
+ * @file SessionReactorTest.cpp
+ *
+ * Checks SessionReactor against real loopback UDP sockets: that a session's
+ * sockets are picked out by port even when something else opens a socket at
+ * the same time, that wait() sleeps while nothing comes in instead of
+ * spinning, and that it wakes up for a datagram.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SessionReactor.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+
+static int failures = 0;
+
+static void check( bool ok, const char* what )
+{
+    printf( "%s: %s\n", ok ? "ok" : "FAILED", what );
+    if ( !ok )
+        failures++;
+}
+
+static double getTimeMS()
+{
+    struct timeval now;
+    gettimeofday( &now, NULL );
+    return (double)now.tv_sec * 1000.0 + (double)now.tv_usec / 1000.0;
+}
+
+static double getCPUTimeMS()
+{
+    struct rusage usage;
+    getrusage( RUSAGE_SELF, &usage );
+    return (double)( usage.ru_utime.tv_sec + usage.ru_stime.tv_sec ) * 1000.0 +
+           (double)( usage.ru_utime.tv_usec + usage.ru_stime.tv_usec ) /
+               1000.0;
+}
+
+static struct sockaddr_in loopback( int port )
+{
+    struct sockaddr_in addr;
+    memset( &addr, 0, sizeof( addr ) );
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+    addr.sin_port = htons( port );
+    return addr;
+}
+
+// a loopback UDP socket on port (or any port, if 0), -1 if it can't be bound
+static int openSocket( int port )
+{
+    int fd = socket( AF_INET, SOCK_DGRAM, 0 );
+    struct sockaddr_in addr = loopback( port );
+    if ( fd == -1 || bind( fd, (struct sockaddr*)&addr, sizeof( addr ) ) != 0 )
+    {
+        if ( fd != -1 )
+            close( fd );
+        return -1;
+    }
+    return fd;
+}
+
+// an even port with the one after it free too, like an RTP/RTCP pair
+static int findPortPair()
+{
+    for ( int port = 40000; port < 41000; port += 2 )
+    {
+        int a = openSocket( port );
+        int b = openSocket( port + 1 );
+        if ( a != -1 )
+            close( a );
+        if ( b != -1 )
+            close( b );
+        if ( a != -1 && b != -1 )
+            return port;
+    }
+    return -1;
+}
+
+int main()
+{
+    int port = findPortPair();
+    if ( port == -1 )
+    {
+        printf( "FAILED: no free loopback ports\n" );
+        return 1;
+    }
+
+    // a session's RTP & RTCP sockets, plus one something else opens at the
+    // same time
+    std::set<int> before = SessionReactor::findDatagramSockets();
+    int rtp = openSocket( port );
+    int other = openSocket( 0 );
+    int rtcp = openSocket( port + 1 );
+    std::set<int> after = SessionReactor::findDatagramSockets();
+
+    check( after.count( rtp ) && after.count( rtcp ) && after.count( other ),
+           "findDatagramSockets sees new sockets" );
+    check( SessionReactor::getLocalPort( rtp ) == port,
+           "getLocalPort gives the bound port" );
+
+    std::vector<int> fds = SessionReactor::findSessionSockets( before, after,
+                                                                port );
+    check( fds.size() == 2 && ( ( fds[0] == rtp && fds[1] == rtcp ) ||
+                                ( fds[0] == rtcp && fds[1] == rtp ) ),
+           "findSessionSockets takes only the session's ports" );
+    check( SessionReactor::findSessionSockets( before, after, 0 ).empty(),
+           "findSessionSockets with no port finds nothing" );
+
+    SessionReactor reactor;
+    if ( !reactor.isAvailable() )
+    {
+        printf( "skipping wait checks, no epoll here\n" );
+        return failures > 0 ? 1 : 0;
+    }
+    reactor.add( fds );
+
+    std::set<int> ready;
+    double start = getTimeMS();
+    double cpuStart = getCPUTimeMS();
+    bool woke = reactor.wait( 200, ready );
+    double elapsed = getTimeMS() - start;
+    double cpu = getCPUTimeMS() - cpuStart;
+    check( !woke && ready.empty(), "idle wait reports nothing" );
+    check( elapsed >= 150.0, "idle wait sleeps for the timeout" );
+    check( cpu < 20.0, "idle wait doesn't spin" );
+
+    struct sockaddr_in to = loopback( port );
+    sendto( other, "rtp", 3, 0, (struct sockaddr*)&to, sizeof( to ) );
+    ready.clear();
+    woke = reactor.wait( 1000, ready );
+    check( woke && ready.count( rtp ) == 1 && ready.count( rtcp ) == 0,
+           "wait wakes up for a datagram on the session's socket" );
+
+    // nothing reads it, so it's still there - but not watched anymore
+    reactor.remove( fds );
+    ready.clear();
+    check( !reactor.wait( 50, ready ), "removed sockets aren't reported" );
+
+    close( rtp );
+    close( rtcp );
+    close( other );
+
+    printf( "%i failed\n", failures );
+    return failures > 0 ? 1 : 0;
+}